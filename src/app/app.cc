@@ -18,6 +18,7 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <string.h>
 #include <locale.h>
 #include <unistd.h>
@@ -32,6 +33,7 @@
 #include <cairo/cairo-gobject.h>
 #include <vte/vte.h>
 #include "vtepcre2.h"
+#include <zlib.h>
 
 #include <algorithm>
 
@@ -76,6 +78,8 @@ public:
         char* font_string{nullptr};
         char* geometry{nullptr};
         char* output_filename{nullptr};
+        char* replay{nullptr};
+        double replay_speed{1.0};
         char* word_char_exceptions{nullptr};
         char* working_directory{nullptr};
         char** dingus{nullptr};
@@ -91,6 +95,9 @@ public:
         int cjk_ambiguous_width{1};
         int extra_margin{-1};
         int scrollback_lines{-1 /* infinite */};
+        int stress_count{0};
+        int stress_columns{80};
+        int stress_rows{24};
         int transparency_percent{-1};
         int verbosity{0};
         double cell_height_scale{1.0};
@@ -208,6 +215,60 @@ private:
                 return that->parse_width_enum(value, that->cjk_ambiguous_width, error);
         };
 
+        static gboolean
+        parse_replay(char const* option, char const* value, void* data, GError** error)
+        {
+                Options* that = static_cast<Options*>(data);
+
+                /* FILE[:SPEED], e.g. "session.rec:2.5" for replaying at
+                 * 2.5x the recorded speed. */
+                auto colon = strrchr(value, ':');
+                if (colon != nullptr) {
+                        char* end = nullptr;
+                        auto speed = g_ascii_strtod(colon + 1, &end);
+                        if (end != colon + 1 && *end == '\0' && speed > 0) {
+                                that->replay = g_strndup(value, colon - value);
+                                that->replay_speed = speed;
+                                return true;
+                        }
+                }
+                that->replay = g_strdup(value);
+                that->replay_speed = 1.0;
+                return true;
+        }
+
+        static gboolean
+        parse_stress(char const* option, char const* value, void* data, GError** error)
+        {
+                Options* that = static_cast<Options*>(data);
+
+                /* COUNT[:COLSxROWS], e.g. "16:80x24" for sixteen 80x24
+                 * terminals. */
+                int columns = 80;
+                int rows = 24;
+                auto colon = strchr(value, ':');
+                if (colon != nullptr &&
+                    (sscanf(colon + 1, "%dx%d", &columns, &rows) != 2 ||
+                     columns <= 0 || rows <= 0)) {
+                        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                                    "Failed to parse \"%s\" as COUNT[:COLSxROWS]", value);
+                        return false;
+                }
+
+                char* end = nullptr;
+                auto count = g_ascii_strtoll(value, &end, 10);
+                if (count <= 0 || end == value || (*end != '\0' && *end != ':')) {
+                        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                                    "Failed to parse \"%s\" as COUNT[:COLSxROWS]", value);
+                        return false;
+                }
+
+                that->stress_count = count;
+                that->stress_columns = columns;
+                that->stress_rows = rows;
+                return true;
+        }
+
         static gboolean
         parse_cursor_blink(char const* option, char const* value, void* data, GError** error)
         {
@@ -409,10 +470,14 @@ public:
                           "Print VteTerminal object notifications", nullptr },
                         { "output-file", 0, 0, G_OPTION_ARG_FILENAME, &output_filename,
                           "Save terminal contents to file at exit", nullptr },
+                        { "replay", 0, 0, G_OPTION_ARG_CALLBACK, (void*)parse_replay,
+                          "Replay a session recorded with $VTE_RECORD instead of spawning a child", "FILE[:SPEED]" },
                         { "reverse", 0, 0, G_OPTION_ARG_NONE, &reverse,
                           "Reverse foreground/background colors", nullptr },
                         { "scrollback-lines", 'n', 0, G_OPTION_ARG_INT, &scrollback_lines,
                           "Specify the number of scrollback-lines (-1 for infinite)", nullptr },
+                        { "stress", 0, 0, G_OPTION_ARG_CALLBACK, (void*)parse_stress,
+                          "Open COUNT terminals and feed all of them concurrently, reporting aggregate statistics", "COUNT[:COLSxROWS]" },
                         { "transparent", 'T', 0, G_OPTION_ARG_INT, &transparency_percent,
                           "Enable the use of a transparent background", "0..100" },
                         { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
@@ -1332,13 +1397,326 @@ vteapp_window_fork(VteappWindow* window,
         return true;
 }
 
+static void stress_note_bytes(gsize length);
+
+/* Session replay: feed a log recorded with $VTE_RECORD (see the record
+ * framing described at Terminal::pty_record()) back to the terminal on
+ * the recorded schedule, so that rendering and scrolling performance can
+ * be measured repeatedly against bit-identical input.
+ */
+
+typedef struct {
+        VteTerminal* terminal;
+        gzFile file;
+        guint64 last_timestamp;
+        bool have_timestamp;
+} VteappReplay;
+
+static gboolean replay_next_cb(void* data);
+
+static void
+replay_finish(VteappReplay* replay)
+{
+        verbose_print("Replay finished.\n");
+        gzclose(replay->file);
+        g_object_unref(replay->terminal);
+        g_free(replay);
+}
+
+/* Read the next record's timestamp and arm a timeout preserving the
+ * recorded pacing (scaled by the SPEED factor). */
+static void
+replay_schedule(VteappReplay* replay)
+{
+        guint64 timestamp;
+        guint64 delay = 0;
+
+        if (gzread(replay->file, &timestamp, sizeof(timestamp)) != (int)sizeof(timestamp)) {
+                replay_finish(replay);
+                return;
+        }
+
+        if (replay->have_timestamp && timestamp > replay->last_timestamp)
+                delay = (guint64)((timestamp - replay->last_timestamp) / options.replay_speed);
+        replay->last_timestamp = timestamp;
+        replay->have_timestamp = true;
+
+        g_timeout_add(delay / 1000 /* µs -> ms */, replay_next_cb, replay);
+}
+
+static gboolean
+replay_next_cb(void* data)
+{
+        auto replay = static_cast<VteappReplay*>(data);
+        guint32 length;
+
+        if (gzread(replay->file, &length, sizeof(length)) != (int)sizeof(length)) {
+                verbose_printerr("Truncated replay record.\n");
+                replay_finish(replay);
+                return G_SOURCE_REMOVE;
+        }
+
+        auto buf = g_new(char, length);
+        if (gzread(replay->file, buf, length) != (int)length) {
+                verbose_printerr("Truncated replay record.\n");
+                g_free(buf);
+                replay_finish(replay);
+                return G_SOURCE_REMOVE;
+        }
+
+        vte_terminal_feed(replay->terminal, buf, length);
+        stress_note_bytes(length);
+        g_free(buf);
+
+        replay_schedule(replay);
+        return G_SOURCE_REMOVE;
+}
+
+static bool
+vteapp_replay_start(VteTerminal* terminal,
+                    GError** error)
+{
+        auto file = gzopen(options.replay, "rb");
+        if (file == nullptr) {
+                g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                            "Error opening replay file %s: %s",
+                            options.replay, g_strerror(errno));
+                return false;
+        }
+
+        auto replay = g_new0(VteappReplay, 1);
+        replay->terminal = VTE_TERMINAL(g_object_ref(terminal));
+        replay->file = file;
+        replay_schedule(replay);
+        return true;
+}
+
+static bool
+vteapp_window_replay(VteappWindow* window,
+                     GError** error)
+{
+        return vteapp_replay_start(VTE_TERMINAL(window->terminal), error);
+}
+
+/* Multi-terminal stress mode: tile COUNT bare terminals into one window
+ * and feed all of them concurrently, either replaying a recorded session
+ * into each one (--replay) or generating a colored scrolling workload.
+ * Once per second, print the aggregate feed throughput, percentiles of
+ * the window's frame clock intervals (jank shows up in the high ones)
+ * and the current RSS. The problems this exists for -- main loop
+ * sharing, chunk pool contention, timer storms -- do not reproduce with
+ * a single terminal.
+ */
+
+typedef struct {
+        GtkWidget* window;
+        GPtrArray* terminals;  /* VteTerminal*, owned by the window */
+        guint feed_timeout;
+        guint report_timeout;
+        guint64 bytes_fed;
+        guint64 lines_generated;
+        gint64 last_tick_time;
+        gint64 last_report_time;
+        GArray* frame_intervals;  /* double, in ms */
+} VteappStress;
+
+static VteappStress* stress_state = nullptr;
+
+/* Called from every feeder (including replay) so the periodic report can
+ * aggregate throughput across all terminals. No-op outside stress mode. */
+static void
+stress_note_bytes(gsize length)
+{
+        if (stress_state != nullptr)
+                stress_state->bytes_fed += length;
+}
+
+static int
+stress_compare_double(gconstpointer a,
+                      gconstpointer b)
+{
+        double const da = *static_cast<double const*>(a);
+        double const db = *static_cast<double const*>(b);
+        return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static double
+stress_percentile(GArray* sorted,
+                  double pct)
+{
+        if (sorted->len == 0)
+                return 0.;
+        return g_array_index(sorted, double, (guint)(pct * (sorted->len - 1) / 100.));
+}
+
+/* Current VmRSS, or 0 where /proc is unavailable */
+static gsize
+stress_rss_bytes(void)
+{
+        char* contents = nullptr;
+        gsize rss = 0;
+
+        if (g_file_get_contents("/proc/self/status", &contents, nullptr, nullptr)) {
+                auto line = strstr(contents, "VmRSS:");
+                if (line != nullptr)
+                        rss = g_ascii_strtoull(line + strlen("VmRSS:"), nullptr, 10) * 1024;
+                g_free(contents);
+        }
+        return rss;
+}
+
+static gboolean
+stress_report_cb(void* data)
+{
+        auto stress = static_cast<VteappStress*>(data);
+        auto const now = g_get_monotonic_time();
+        auto const elapsed = (now - stress->last_report_time) / 1e6;
+        stress->last_report_time = now;
+
+        g_array_sort(stress->frame_intervals, stress_compare_double);
+        g_print("stress: %u terminals, %.2f MiB/s fed, "
+                "frame p50/p95/p99 %.1f/%.1f/%.1f ms (%u frames), RSS %.1f MiB\n",
+                stress->terminals->len,
+                stress->bytes_fed / elapsed / (1024. * 1024.),
+                stress_percentile(stress->frame_intervals, 50),
+                stress_percentile(stress->frame_intervals, 95),
+                stress_percentile(stress->frame_intervals, 99),
+                stress->frame_intervals->len,
+                stress_rss_bytes() / (1024. * 1024.));
+
+        stress->bytes_fed = 0;
+        g_array_set_size(stress->frame_intervals, 0);
+        return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+stress_tick_cb(GtkWidget* widget,
+               GdkFrameClock* frame_clock,
+               void* data)
+{
+        auto stress = static_cast<VteappStress*>(data);
+        auto const now = g_get_monotonic_time();
+
+        if (stress->last_tick_time != 0) {
+                double const interval_ms = (now - stress->last_tick_time) / 1000.;
+                g_array_append_val(stress->frame_intervals, interval_ms);
+        }
+        stress->last_tick_time = now;
+        return G_SOURCE_CONTINUE;
+}
+
+/* The generated workload: numbered colored lines on every terminal at a
+ * steady ~60Hz. The mixed SGR keeps the attribute side of the pipeline
+ * as busy as the text side. */
+static gboolean
+stress_feed_cb(void* data)
+{
+        auto stress = static_cast<VteappStress*>(data);
+        auto buffer = g_string_sized_new(4096);
+
+        for (guint i = 0; i < stress->terminals->len; i++) {
+                auto terminal = static_cast<VteTerminal*>(g_ptr_array_index(stress->terminals, i));
+
+                g_string_truncate(buffer, 0);
+                for (int line = 0; line < 16; line++) {
+                        auto const n = stress->lines_generated++;
+                        g_string_append_printf(buffer,
+                                               "\033[3%dm\033[1mstress\033[0m line %08" G_GUINT64_FORMAT
+                                               " on terminal %03u: "
+                                               "the quick brown fox jumps over the lazy dog\r\n",
+                                               (int)(n % 8), n, i);
+                }
+                vte_terminal_feed(terminal, buffer->str, buffer->len);
+                stress_note_bytes(buffer->len);
+        }
+
+        g_string_free(buffer, TRUE);
+        return G_SOURCE_CONTINUE;
+}
+
+static void
+stress_window_destroy_cb(GtkWidget* widget,
+                         void* data)
+{
+        auto stress = static_cast<VteappStress*>(data);
+
+        stress_state = nullptr;
+        if (stress->feed_timeout != 0)
+                g_source_remove(stress->feed_timeout);
+        if (stress->report_timeout != 0)
+                g_source_remove(stress->report_timeout);
+        g_ptr_array_free(stress->terminals, TRUE);
+        g_array_free(stress->frame_intervals, TRUE);
+        g_free(stress);
+}
+
+static void
+vteapp_stress_start(GtkApplication* application)
+{
+        auto stress = g_new0(VteappStress, 1);
+        stress->terminals = g_ptr_array_new();
+        stress->frame_intervals = g_array_new(FALSE, FALSE, sizeof(double));
+
+        auto window = gtk_application_window_new(application);
+        gtk_window_set_title(GTK_WINDOW(window), "Terminal stress");
+        auto grid = gtk_grid_new();
+        gtk_container_add(GTK_CONTAINER(window), grid);
+
+        /* Tile roughly square */
+        int per_row = 1;
+        while (per_row * per_row < options.stress_count)
+                per_row++;
+
+        for (int i = 0; i < options.stress_count; i++) {
+                auto terminal = vte_terminal_new();
+                vte_terminal_set_size(VTE_TERMINAL(terminal),
+                                      options.stress_columns, options.stress_rows);
+                vte_terminal_set_scrollback_lines(VTE_TERMINAL(terminal),
+                                                  options.scrollback_lines);
+                if (options.font_string != nullptr) {
+                        auto desc = pango_font_description_from_string(options.font_string);
+                        vte_terminal_set_font(VTE_TERMINAL(terminal), desc);
+                        pango_font_description_free(desc);
+                }
+                gtk_grid_attach(GTK_GRID(grid), terminal,
+                                i % per_row, i / per_row, 1, 1);
+                g_ptr_array_add(stress->terminals, terminal);
+        }
+
+        stress->window = window;
+        stress_state = stress;
+
+        g_signal_connect(window, "destroy", G_CALLBACK(stress_window_destroy_cb), stress);
+        gtk_widget_add_tick_callback(window, stress_tick_cb, stress, nullptr);
+        gtk_widget_show_all(window);
+
+        if (options.replay != nullptr) {
+                for (guint i = 0; i < stress->terminals->len; i++) {
+                        GError* err = nullptr;
+                        auto terminal = static_cast<VteTerminal*>(g_ptr_array_index(stress->terminals, i));
+                        if (!vteapp_replay_start(terminal, &err)) {
+                                verbose_printerr("Error replaying: %s\n", err->message);
+                                g_error_free(err);
+                                break;
+                        }
+                }
+        } else {
+                stress->feed_timeout = g_timeout_add(1000 / 60, stress_feed_cb, stress);
+        }
+
+        stress->last_report_time = g_get_monotonic_time();
+        stress->report_timeout = g_timeout_add_seconds(1, stress_report_cb, stress);
+}
+
 static void
 vteapp_window_launch(VteappWindow* window)
 {
         bool rv;
         GError* err = nullptr;
 
-        if (options.exec_argv != nullptr)
+        if (options.replay != nullptr)
+                rv = vteapp_window_replay(window, &err);
+        else if (options.exec_argv != nullptr)
                 rv = vteapp_window_launch_argv(window, options.exec_argv, &err);
         else if (options.command != nullptr)
                 rv = vteapp_window_launch_commandline(window, options.command, &err);
@@ -2162,6 +2540,11 @@ vteapp_application_startup(GApplication* application)
 static void
 vteapp_application_activate(GApplication* application)
 {
+        if (options.stress_count > 0) {
+                vteapp_stress_start(GTK_APPLICATION(application));
+                return;
+        }
+
         auto action = g_action_map_lookup_action(G_ACTION_MAP(application), "new");
         g_action_activate(action, nullptr);
 }
@@ -61,6 +61,43 @@ static_assert (sizeof (FriBidiChar) == sizeof (gunichar), "Unexpected FriBidiCha
 
 using namespace vte::base;
 
+#ifdef WITH_FRIBIDI
+/* Get a scratch array, emptied but with its previous allocation retained.
+ * This keeps malloc out of the update path: the arrays quickly grow to the
+ * size required for the largest paragraph and are then recycled, until
+ * freed by pause(). */
+static GArray *
+scratch_array (GArray **array, guint element_size, guint reserved_size)
+{
+        if (G_UNLIKELY (*array == nullptr))
+                *array = g_array_sized_new (FALSE, FALSE, element_size, reserved_size);
+        else
+                g_array_set_size (*array, 0);
+        return *array;
+}
+#endif /* WITH_FRIBIDI */
+
+/* Free up the scratch buffers. Called when the RingView is paused, that is,
+ * the terminal is unlikely to be painted in the near future. */
+void
+BidiRunner::pause()
+{
+#ifdef WITH_FRIBIDI
+        if (m_fribidi_chars_array != nullptr) {
+                g_array_free (m_fribidi_chars_array, TRUE);
+                m_fribidi_chars_array = nullptr;
+        }
+        if (m_fribidi_map_array != nullptr) {
+                g_array_free (m_fribidi_map_array, TRUE);
+                m_fribidi_map_array = nullptr;
+        }
+        if (m_fribidi_to_term_array != nullptr) {
+                g_array_free (m_fribidi_to_term_array, TRUE);
+                m_fribidi_to_term_array = nullptr;
+        }
+#endif
+}
+
 BidiRow::~BidiRow()
 {
         g_free (m_log2vis);
@@ -223,7 +260,7 @@ BidiRunner::explicit_line_shape(vte::grid::row_t row)
         gunichar base;
         int i, j;  /* visual columns */
 
-        fribidi_chars_array = g_array_sized_new (FALSE, FALSE, sizeof (FriBidiChar), width);
+        fribidi_chars_array = scratch_array (&m_fribidi_chars_array, sizeof (FriBidiChar), width);
 
         /* Walk in visual order from right to left. */
         i = width - 1;
@@ -312,8 +349,6 @@ BidiRunner::explicit_line_shape(vte::grid::row_t row)
                 /* Ready to look for the next word. Skip the stop char which isn't Arabic. */
                 i = j - 1;
         }
-
-        g_array_free (fribidi_chars_array, TRUE);
 }
 #endif /* WITH_FRIBIDI */
 
@@ -356,6 +391,35 @@ BidiRunner::explicit_line(vte::grid::row_t row, bool rtl, bool do_shaping)
 #endif
 }
 
+/* Check whether the paragraph between the given rows is free of any
+ * character that could make a difference for the BiDi algorithm, so that it
+ * trivially resolves to the all-LTR identity mapping (provided that the
+ * paragraph's base direction isn't RTL).
+ *
+ * Codepoints below U+0590 (the beginning of the Hebrew block) are all
+ * strong LTR, weak or neutral, there are no directional formatting controls
+ * (those live at U+200C and above), and no Arabic characters to shape.
+ * Characters with combining accents are stored as synthetic values of at
+ * least VTE_UNISTR_START and thus take the slow path, as do erased cells'
+ * fragments etc. beyond the row's length (len is checked, not width).
+ */
+bool
+BidiRunner::paragraph_is_plain_ltr(vte::grid::row_t start, vte::grid::row_t end)
+{
+        const VteRowData *row_data;
+        vte::grid::row_t row;
+        int i;
+
+        for (row = start; row < end; row++) {
+                row_data = m_ringview->get_row(row);
+                for (i = 0; i < row_data->len; i++) {
+                        if (_vte_row_data_get (row_data, i)->c >= 0x0590)
+                                return false;
+                }
+        }
+        return true;
+}
+
 /* Figure out the mapping for the paragraph between the given rows. */
 void
 BidiRunner::paragraph(vte::grid::row_t start, vte::grid::row_t end,
@@ -381,6 +445,16 @@ BidiRunner::paragraph(vte::grid::row_t start, vte::grid::row_t end,
          * the current scroll position. */
         if ((row_data->attr.bidi_flags & VTE_BIDI_FLAG_IMPLICIT) &&
             end - start <= VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX) {
+                /* A quick pre-scan spares the entire FriBidi machinery (and
+                 * its per-character array extraction) for the overwhelmingly
+                 * common case of paragraphs without any BiDi-relevant
+                 * character: they trivially resolve to the LTR identity
+                 * mapping, unless an RTL base direction is requested. */
+                if (!(row_data->attr.bidi_flags & VTE_BIDI_FLAG_RTL) &&
+                    paragraph_is_plain_ltr(start, end)) {
+                        explicit_paragraph(start, end, false, false);
+                        return;
+                }
                 if (implicit_paragraph(start, end, do_shaping))
                         return;
         }
@@ -437,9 +511,9 @@ BidiRunner::implicit_paragraph(vte::grid::row_t start, vte::grid::row_t end, boo
         int fl, fv;     /* fribidi logical and visual */
         unsigned int col;
 
-        GArray *fribidi_chars_array   = g_array_sized_new (FALSE, FALSE, sizeof (FriBidiChar),     (end - start) * width);
-        GArray *fribidi_map_array     = g_array_sized_new (FALSE, FALSE, sizeof (FriBidiStrIndex), (end - start) * width);
-        GArray *fribidi_to_term_array = g_array_sized_new (FALSE, FALSE, sizeof (FriBidiStrIndex), (end - start) * width);
+        GArray *fribidi_chars_array   = scratch_array (&m_fribidi_chars_array,   sizeof (FriBidiChar),     (end - start) * width);
+        GArray *fribidi_map_array     = scratch_array (&m_fribidi_map_array,     sizeof (FriBidiStrIndex), (end - start) * width);
+        GArray *fribidi_to_term_array = scratch_array (&m_fribidi_to_term_array, sizeof (FriBidiStrIndex), (end - start) * width);
 
         /* Extract the paragraph's contents, omitting unused and fragment cells. */
 
@@ -579,9 +653,6 @@ BidiRunner::implicit_paragraph(vte::grid::row_t start, vte::grid::row_t end, boo
 
         if (level == (FriBidiLevel)(-1)) {
                 /* error */
-                g_array_free (fribidi_chars_array, TRUE);
-                g_array_free (fribidi_map_array, TRUE);
-                g_array_free (fribidi_to_term_array, TRUE);
                 return false;
         }
 
@@ -596,10 +667,7 @@ BidiRunner::implicit_paragraph(vte::grid::row_t start, vte::grid::row_t end, boo
         rtl = (pbase_dir == FRIBIDI_PAR_RTL || pbase_dir == FRIBIDI_PAR_WRTL);
 
         if (!rtl && level == 0) {
-                /* Fast and memory saving shortcut for LTR-only paragraphs. */
-                g_array_free (fribidi_chars_array, TRUE);
-                g_array_free (fribidi_map_array, TRUE);
-                g_array_free (fribidi_to_term_array, TRUE);
+                /* Fast shortcut for LTR-only paragraphs. */
                 explicit_paragraph (start, end, false, false);
                 return true;
         }
@@ -733,9 +801,6 @@ BidiRunner::implicit_paragraph(vte::grid::row_t start, vte::grid::row_t end, boo
                 }
         }
 
-        g_array_free (fribidi_chars_array, TRUE);
-        g_array_free (fribidi_map_array, TRUE);
-        g_array_free (fribidi_to_term_array, TRUE);
         return true;
 }
 #endif /* WITH_FRIBIDI */
@@ -83,7 +83,7 @@ private:
 class BidiRunner {
 public:
         constexpr BidiRunner(RingView *ringview) : m_ringview{ringview} { }
-        ~BidiRunner() { }
+        ~BidiRunner() { pause(); }
 
         // prevent accidents
         BidiRunner(BidiRunner& o) = delete;
@@ -95,14 +95,23 @@ public:
 
         void paragraph(vte::grid::row_t start, vte::grid::row_t end,
                        bool do_bidi, bool do_shaping);
+        void pause();
 
 private:
         RingView *m_ringview;
 
 #ifdef WITH_FRIBIDI
+        /* Scratch buffers for the FriBidi machinery. They are reset rather
+         * than freed after each paragraph, so that repeated updates don't
+         * hit malloc; see scratch_array(). Freed when the RingView pauses. */
+        GArray *m_fribidi_chars_array{nullptr};
+        GArray *m_fribidi_map_array{nullptr};
+        GArray *m_fribidi_to_term_array{nullptr};
+
         void explicit_line_shape(vte::grid::row_t row);
 #endif
 
+        bool paragraph_is_plain_ltr(vte::grid::row_t start, vte::grid::row_t end);
         void explicit_line(vte::grid::row_t row, bool rtl, bool do_shaping);
         void explicit_paragraph(vte::grid::row_t start, vte::grid::row_t end, bool rtl, bool do_shaping);
 #ifdef WITH_FRIBIDI
@@ -43,13 +43,10 @@
 
 #define VTE_TAB_WIDTH_MAX		((1 << VTE_ATTR_COLUMNS_BITS) - 1)
 
-#define VTE_CELL_ATTR_COMMON_BYTES      12  /* The number of common bytes in VteCellAttr and VteStreamCellAttr */
-
 /*
  * VteCellAttr: A single cell style attributes
  *
- * When adding new attributes, keep in sync with VteStreamCellAttr and
- * update VTE_CELL_ATTR_COMMON_BYTES accordingly.
+ * When adding new attributes, keep in sync with VteStreamCellAttr.
  * Also don't forget to update basic_cell below!
  */
 
@@ -94,6 +91,8 @@ typedef struct _VTE_GNUC_PACKED VteCellAttr {
 
         inline constexpr uint64_t colors() const { return m_colors; }
 
+        inline void set_colors(uint64_t value) { m_colors = value; }
+
         inline void copy_colors(VteCellAttr const& other)
         {
                 m_colors = vte_color_triple_copy(other.colors());
@@ -149,13 +148,18 @@ typedef struct _VTE_GNUC_PACKED VteCellAttr {
         /* ATTR_BOOL(boxed, BOXED) */
 } VteCellAttr;
 static_assert(sizeof (VteCellAttr) == 16, "VteCellAttr has wrong size");
-static_assert(offsetof (VteCellAttr, hyperlink_idx) == VTE_CELL_ATTR_COMMON_BYTES, "VteCellAttr layout is wrong");
+static_assert(offsetof (VteCellAttr, hyperlink_idx) == 12, "VteCellAttr layout is wrong");
+
+/* The colors of a VteStreamCellAttr are interned in the ring's color
+ * triple table and referenced by index; this sentinel marks a record
+ * whose 8-byte triple follows the record inline instead, used in the
+ * unlikely case that the table is full. */
+#define VTE_COLOR_TRIPLE_IDX_INLINE 0xFFFF
 
 /*
  * VteStreamCellAttr: Variant of VteCellAttr to be stored in attr_stream.
  *
- * When adding new attributes, keep in sync with VteCellAttr and
- * update VTE_CELL_ATTR_COMMON_BYTES accordingly.
+ * When adding new attributes, keep in sync with VteCellAttr.
  */
 
 typedef struct _VTE_GNUC_PACKED _VteStreamCellAttr {
@@ -163,16 +167,16 @@ typedef struct _VTE_GNUC_PACKED _VteStreamCellAttr {
                         * and fragment, however.
                         */
         /* 4-byte boundary */
-        uint64_t colors;
-        /* 12-byte boundary */
+        guint16 colors_idx;             /* index into the ring's color triple table,
+                                         * or VTE_COLOR_TRIPLE_IDX_INLINE */
+        /* 6-byte boundary */
         guint16 hyperlink_length;       /* make sure it fits VTE_HYPERLINK_TOTAL_LENGTH_MAX */
 
         /* Methods */
         CELL_ATTR_UINT(columns, COLUMNS)
         CELL_ATTR_BOOL(fragment, FRAGMENT)
 } VteStreamCellAttr;
-static_assert(sizeof (VteStreamCellAttr) == 14, "VteStreamCellAttr has wrong size");
-static_assert(offsetof (VteStreamCellAttr, hyperlink_length) == VTE_CELL_ATTR_COMMON_BYTES, "VteStreamCellAttr layout is wrong");
+static_assert(sizeof (VteStreamCellAttr) == 8, "VteStreamCellAttr has wrong size");
 
 #undef CELL_ATTR_BOOL
 #undef CELL_ATTR_UINT
@@ -19,6 +19,7 @@
 
 #include "chunk.hh"
 
+#include <algorithm>
 #include <cstddef> // offsetof
 #include <new>
 
@@ -29,23 +30,69 @@ namespace base {
 static_assert(sizeof(Chunk) <= Chunk::k_chunk_size - 2 *sizeof(void*), "Chunk too large");
 static_assert(offsetof(Chunk, data) == offsetof(Chunk, dataminusone) + 1, "Chunk layout wrong");
 
+std::atomic<Chunk*> Chunk::g_free_chunks{nullptr};
+std::atomic<unsigned int> Chunk::g_free_chunks_count{0};
+std::atomic<unsigned int> Chunk::g_chunks_in_flight{0};
+std::atomic<unsigned int> Chunk::g_in_flight_watermark{0};
+
+// static
+void
+Chunk::push_list(Chunk* head,
+                 Chunk* tail,
+                 unsigned int count) noexcept
+{
+        auto old_head = g_free_chunks.load(std::memory_order_relaxed);
+        do {
+                tail->next_free = old_head;
+        } while (!g_free_chunks.compare_exchange_weak(old_head, head,
+                                                      std::memory_order_release,
+                                                      std::memory_order_relaxed));
+
+        if (count != 0)
+                g_free_chunks_count.fetch_add(count, std::memory_order_relaxed);
+}
+
 void
 Chunk::recycle() noexcept
 {
-        g_free_chunks.push(std::unique_ptr<Chunk>(this));
+        /* Drop the reference on foreign data now, not when the chunk is
+         * reused; the pool must not keep caller buffers alive. */
+        if (foreign_bytes != nullptr) {
+                g_bytes_unref(foreign_bytes);
+                foreign_bytes = nullptr;
+                foreign_data = nullptr;
+                len = 0;
+        }
+
         /* FIXME: bzero out the chunk for security? */
+        push_list(this, this, 1);
+        g_chunks_in_flight.fetch_sub(1, std::memory_order_relaxed);
 }
 
-std::stack<std::unique_ptr<Chunk>, std::list<std::unique_ptr<Chunk>>> Chunk::g_free_chunks;
-
 Chunk::unique_type
 Chunk::get(void) noexcept
 {
-        Chunk* chunk;
-        if (!g_free_chunks.empty()) {
-                chunk = g_free_chunks.top().release();
-                g_free_chunks.pop();
+        auto const in_flight = g_chunks_in_flight.fetch_add(1, std::memory_order_relaxed) + 1;
+        auto watermark = g_in_flight_watermark.load(std::memory_order_relaxed);
+        while (watermark < in_flight &&
+               !g_in_flight_watermark.compare_exchange_weak(watermark, in_flight,
+                                                            std::memory_order_relaxed))
+                ;
+
+        /* Detach the entire free list; see chunk.hh on why. */
+        auto chunk = g_free_chunks.exchange(nullptr, std::memory_order_acquire);
+        if (chunk != nullptr) {
+                /* Take the first chunk and reattach the remainder. */
+                auto rest = chunk->next_free;
+                if (rest != nullptr) {
+                        auto tail = rest;
+                        while (tail->next_free != nullptr)
+                                tail = tail->next_free;
+                        push_list(rest, tail, 0);
+                }
+                g_free_chunks_count.fetch_sub(1, std::memory_order_relaxed);
 
+                chunk->next_free = nullptr;
                 chunk->reset();
         } else {
                 chunk = new Chunk();
@@ -53,11 +100,70 @@ Chunk::get(void) noexcept
 
         return Chunk::unique_type(chunk);
 }
+
+/*
+ * Chunk::get_foreign:
+ *
+ * Returns a chunk presenting @len bytes of @bytes starting at @offset,
+ * without copying them. The chunk holds a reference on @bytes until it
+ * is recycled.
+ */
+Chunk::unique_type
+Chunk::get_foreign(GBytes* bytes,
+                   size_t offset,
+                   size_t len) noexcept
+{
+        gsize size;
+        auto const* data = reinterpret_cast<uint8_t const*>(g_bytes_get_data(bytes, &size));
+        g_assert(offset + len <= size);
+
+        auto chunk = get();
+        chunk->foreign_bytes = g_bytes_ref(bytes);
+        chunk->foreign_data = data + offset;
+        chunk->len = len;
+        return chunk;
+}
+
 void
-Chunk::prune(unsigned int max_size) noexcept
+Chunk::prune() noexcept
 {
-        while (g_free_chunks.size() > max_size)
-                g_free_chunks.pop();
+        /* Retain as many free chunks as were recently in use at the same
+         * time, so that bursts of output don't thrash the allocator, while
+         * dropping back towards the minimum once the burst is over.
+         */
+        auto const limit = std::clamp(g_in_flight_watermark.load(std::memory_order_relaxed),
+                                      k_min_free_chunks, k_max_free_chunks);
+        g_in_flight_watermark.store(g_chunks_in_flight.load(std::memory_order_relaxed),
+                                    std::memory_order_relaxed);
+
+        if (g_free_chunks_count.load(std::memory_order_relaxed) <= limit)
+                return;
+
+        auto chunk = g_free_chunks.exchange(nullptr, std::memory_order_acquire);
+        if (chunk == nullptr)
+                return;
+
+        /* Keep the first @limit chunks, delete the rest. */
+        unsigned int kept = 0;
+        auto tail = chunk;
+        Chunk* last_kept = nullptr;
+        while (tail != nullptr && kept < limit) {
+                last_kept = tail;
+                tail = tail->next_free;
+                ++kept;
+        }
+        last_kept->next_free = nullptr;
+
+        unsigned int deleted = 0;
+        while (tail != nullptr) {
+                auto next = tail->next_free;
+                delete tail;
+                tail = next;
+                ++deleted;
+        }
+        g_free_chunks_count.fetch_sub(kept + deleted, std::memory_order_relaxed);
+
+        push_list(chunk, last_kept, kept);
 }
 
 } // namespace base
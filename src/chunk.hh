@@ -17,10 +17,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
-#include <list>
 #include <memory>
-#include <stack>
+
+#include <glib.h>
 
 namespace vte {
 
@@ -39,7 +40,8 @@ private:
 
         void recycle() noexcept;
 
-        static unsigned int const k_max_free_chunks = 16;
+        static unsigned int const k_min_free_chunks = 16;
+        static unsigned int const k_max_free_chunks = 128;
 
 public:
         using unique_type = std::unique_ptr<Chunk, Recycler>;
@@ -47,8 +49,18 @@ public:
         static unsigned int const k_chunk_size = 0x2000;
 
         unsigned int len{0};
+        Chunk* next_free{nullptr};  /* Intrusive link; only for use by the free pool */
+        int64_t arrival_time{0};    /* g_get_monotonic_time() of the first byte,
+                                     * for input-to-paint latency accounting */
+
+        /* For a foreign chunk (see get_foreign()), the caller-owned
+         * immutable data and the GBytes keeping it alive. Pool chunks
+         * leave these null and use the inline data[] array. */
+        GBytes* foreign_bytes{nullptr};
+        uint8_t const* foreign_data{nullptr};
+
         uint8_t dataminusone;    /* Hack: Keep it right before data, so that data[-1] is valid and usable */
-        uint8_t data[k_chunk_size - 2 * sizeof(void*) - 1 - sizeof(unsigned int)];
+        uint8_t data[k_chunk_size - 5 * sizeof(void*) - 2 * sizeof(unsigned int) - sizeof(int64_t) - 1];
 
         Chunk() = default;
         Chunk(Chunk const&) = delete;
@@ -61,18 +73,50 @@ public:
         void reset() noexcept
         {
                 len = 0;
+                arrival_time = 0;
+        }
+
+        inline bool is_foreign() const noexcept { return foreign_bytes != nullptr; }
+
+        /* Where the readable payload starts: the inline array for pool
+         * chunks, the caller-owned buffer for foreign chunks. */
+        inline uint8_t const* begin_reading() const noexcept
+        {
+                return foreign_data != nullptr ? foreign_data : data;
         }
 
         inline constexpr size_t capacity() const noexcept { return sizeof(data); }
-        inline constexpr size_t remaining_capacity() const noexcept { return capacity() - len; }
+
+        /* A foreign chunk is immutable; never append to it */
+        inline size_t remaining_capacity() const noexcept { return is_foreign() ? 0 : capacity() - len; }
 
         static unique_type get() noexcept;
-        static void prune(unsigned int max_size = k_max_free_chunks) noexcept;
+        static unique_type get_foreign(GBytes* bytes,
+                                       size_t offset,
+                                       size_t len) noexcept;
+        static void prune() noexcept;
 
 private:
 
-        /* Note that this is using the standard deleter, not Recycler */
-        static std::stack<std::unique_ptr<Chunk>, std::list<std::unique_ptr<Chunk>>> g_free_chunks;
+        /* The free pool is a lock-free intrusive stack, so that chunks can
+         * be obtained and recycled from any thread (the GTK thread and the
+         * parser thread in particular). Pushing links chunks in with a CAS
+         * loop; popping always detaches the entire list with an exchange
+         * and reattaches the remainder, which avoids the ABA problem
+         * without needing tagged pointers.
+         */
+        static void push_list(Chunk* head,
+                              Chunk* tail,
+                              unsigned int count) noexcept;
+
+        static std::atomic<Chunk*> g_free_chunks;
+        static std::atomic<unsigned int> g_free_chunks_count;
+
+        /* Approximate count and recent peak of chunks in use, to adapt
+         * how many free chunks prune() retains.
+         */
+        static std::atomic<unsigned int> g_chunks_in_flight;
+        static std::atomic<unsigned int> g_in_flight_watermark;
 };
 
 } // namespace base
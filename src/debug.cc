@@ -18,13 +18,144 @@
 
 #include "config.h"
 
+#include <signal.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
+#include <glib/gprintf.h>
 #include "debug.h"
 
 guint _vte_debug_flags;
 
+/* Ring-buffer logger:
+ *
+ * Writing every debug line to stderr synchronously is slow enough to
+ * distort the timing under investigation. When the VTE_DEBUG_RING
+ * environment variable is set to a number of records, each thread
+ * instead logs into its own fixed-size ring of preformatted records,
+ * overwriting the oldest; no locks are taken on the logging path.
+ * The rings are dumped to stderr on SIGUSR2 and at exit. The dump may
+ * read a record that another thread is concurrently overwriting; for
+ * diagnostics that's an acceptable trade for keeping logging cheap.
+ */
+
+typedef struct {
+        gint64 when;    /* g_get_monotonic_time() */
+        guint flags;
+        char msg[112];
+} VteDebugRecord;
+
+typedef struct _VteDebugRing VteDebugRing;
+struct _VteDebugRing {
+        VteDebugRing *next;     /* all threads' rings, for dumping */
+        guint64 head;           /* total records ever written */
+        guint size;
+        VteDebugRecord records[1];  /* really size records */
+};
+
+static guint _vte_debug_ring_size;      /* 0: ring logging disabled */
+static VteDebugRing *_vte_debug_rings;
+
+static VteDebugRing *
+_vte_debug_ring_get (void)
+{
+        static GPrivate ring_key = G_PRIVATE_INIT (NULL);
+        static GMutex rings_mutex;
+        VteDebugRing *ring;
+
+        ring = (VteDebugRing *) g_private_get (&ring_key);
+        if (G_UNLIKELY (ring == NULL)) {
+                ring = (VteDebugRing *) g_malloc0 (sizeof (VteDebugRing) +
+                                                   (_vte_debug_ring_size - 1) * sizeof (VteDebugRecord));
+                ring->size = _vte_debug_ring_size;
+                g_private_set (&ring_key, ring);
+
+                /* Rings are never freed so that a thread's last records
+                 * remain dumpable after it exits. */
+                g_mutex_lock (&rings_mutex);
+                ring->next = _vte_debug_rings;
+                _vte_debug_rings = ring;
+                g_mutex_unlock (&rings_mutex);
+        }
+
+        return ring;
+}
+
+void
+_vte_debug_logv (guint flags, const char *fmt, va_list ap)
+{
+        VteDebugRing *ring;
+        VteDebugRecord *record;
+
+        if (G_LIKELY (_vte_debug_ring_size == 0)) {
+                g_vfprintf (stderr, fmt, ap);
+                return;
+        }
+
+        ring = _vte_debug_ring_get ();
+        record = &ring->records[ring->head % ring->size];
+        record->when = g_get_monotonic_time ();
+        record->flags = flags;
+        g_vsnprintf (record->msg, sizeof (record->msg), fmt, ap);
+        ring->head++;
+}
+
+void
+_vte_debug_log (guint flags, const char *fmt, ...)
+{
+        va_list ap;
+
+        va_start (ap, fmt);
+        _vte_debug_logv (flags, fmt, ap);
+        va_end (ap);
+}
+
+void
+_vte_debug_ring_dump (void)
+{
+        VteDebugRing *ring;
+        char buf[160];
+        guint64 i, start;
+        int len;
+
+        for (ring = _vte_debug_rings; ring != NULL; ring = ring->next) {
+                start = ring->head > ring->size ? ring->head - ring->size : 0;
+                for (i = start; i < ring->head; i++) {
+                        VteDebugRecord *record = &ring->records[i % ring->size];
+                        len = g_snprintf (buf, sizeof (buf), "[%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT "] %s",
+                                          record->when / G_USEC_PER_SEC,
+                                          record->when % G_USEC_PER_SEC,
+                                          record->msg);
+                        if (write (STDERR_FILENO, buf, MIN (len, (int) sizeof (buf) - 1)) < 0)
+                                return;
+                }
+        }
+}
+
+static void
+_vte_debug_ring_dump_handler (int signum)
+{
+        _vte_debug_ring_dump ();
+}
+
+static void
+_vte_debug_ring_init (void)
+{
+        const char *env = g_getenv ("VTE_DEBUG_RING");
+
+        if (env == NULL)
+                return;
+
+        _vte_debug_ring_size = (guint) strtoul (env, NULL, 10);
+        if (_vte_debug_ring_size == 0)
+                _vte_debug_ring_size = 4096;
+
+        signal (SIGUSR2, _vte_debug_ring_dump_handler);
+        atexit (_vte_debug_ring_dump);
+}
+
 void
 _vte_debug_init(void)
 {
@@ -59,10 +190,12 @@ _vte_debug_init(void)
     { "emulation",    VTE_DEBUG_EMULATION    },
     { "ringview",     VTE_DEBUG_RINGVIEW     },
     { "bidi",         VTE_DEBUG_BIDI         },
+    { "latency",      VTE_DEBUG_LATENCY      },
   };
 
   _vte_debug_flags = g_parse_debug_string (g_getenv("VTE_DEBUG"),
                                            keys, G_N_ELEMENTS (keys));
+  _vte_debug_ring_init ();
   _vte_debug_print(0xFFFFFFFF, "VTE debug flags = %x\n", _vte_debug_flags);
 #endif /* VTE_DEBUG */
 }
@@ -22,6 +22,7 @@
 #define vte_debug_h_included
 
 #include <config.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <glib.h>
 
@@ -29,6 +30,9 @@
 #define _vte_debug_flags _vte_external_debug_flags
 #define _vte_debug_init  _vte_external_debug_init
 #define _vte_debug_on    _vte_external_debug_on
+#define _vte_debug_log   _vte_external_debug_log
+#define _vte_debug_logv  _vte_external_debug_logv
+#define _vte_debug_ring_dump _vte_external_debug_ring_dump
 #if !defined(__GNUC__) || !G_HAVE_GNUC_VARARGS
 #define _vte_debug_print _vte_external_debug_print
 #endif
@@ -66,6 +70,7 @@ typedef enum {
         VTE_DEBUG_EMULATION     = 1 << 26,
         VTE_DEBUG_RINGVIEW      = 1 << 27,
         VTE_DEBUG_BIDI          = 1 << 28,
+        VTE_DEBUG_LATENCY       = 1 << 29,
 } VteDebugFlags;
 
 void _vte_debug_init(void);
@@ -76,6 +81,12 @@ void _vte_debug_hexdump(char const* str,
                         uint8_t const* buf,
                         size_t len);
 
+/* The sink behind _vte_debug_print(): stderr by default, or a per-thread
+ * ring buffer when VTE_DEBUG_RING is set, see debug.cc. */
+void _vte_debug_log(guint flags, const char *fmt, ...) G_GNUC_PRINTF(2, 3);
+void _vte_debug_logv(guint flags, const char *fmt, va_list ap);
+void _vte_debug_ring_dump(void);
+
 extern guint _vte_debug_flags;
 static inline gboolean _vte_debug_on(guint flags) G_GNUC_CONST G_GNUC_UNUSED;
 
@@ -94,15 +105,14 @@ _vte_debug_on(guint flags)
 #ifdef VTE_DEBUG
 #if defined(__GNUC__) && G_HAVE_GNUC_VARARGS
 #define _vte_debug_print(flags, fmt, ...) \
-	G_STMT_START { _VTE_DEBUG_IF(flags) g_printerr(fmt, ##__VA_ARGS__); } G_STMT_END
+	G_STMT_START { _VTE_DEBUG_IF(flags) _vte_debug_log(flags, fmt, ##__VA_ARGS__); } G_STMT_END
 #else
-#include <stdarg.h>
 static void _vte_debug_print(guint flags, const char *fmt, ...)
 {
 	_VTE_DEBUG_IF(flags) {
 		va_list  ap;
 		va_start (ap, fmt);
-		g_vfprintf (stderr, fmt, ap);
+		_vte_debug_logv (flags, fmt, ap);
 		va_end (ap);
 	}
 }
@@ -111,6 +121,22 @@ static void _vte_debug_print(guint flags, const char *fmt, ...)
 #define _vte_debug_print(args...) do { } while(0)
 #endif /* VTE_DEBUG */
 
+/* Static tracepoints (USDT) at the stage boundaries of the ingest and
+ * paint pipelines, so that vte's stages can be overlaid on system-wide
+ * traces with perf/bpftrace/systemtap. Compiled out unless built with
+ * -Dsdt=true and <sys/sdt.h> available; the fallbacks expand to nothing.
+ */
+#ifdef WITH_SDT
+#include <sys/sdt.h>
+#define _vte_trace(name)	DTRACE_PROBE(vte, name)
+#define _vte_trace1(name, a)	DTRACE_PROBE1(vte, name, (a))
+#define _vte_trace2(name, a, b)	DTRACE_PROBE2(vte, name, (a), (b))
+#else
+#define _vte_trace(name)	do { } while(0)
+#define _vte_trace1(name, a)	do { } while(0)
+#define _vte_trace2(name, a, b)	do { } while(0)
+#endif /* WITH_SDT */
+
 G_END_DECLS
 
 #endif
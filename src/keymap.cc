@@ -601,109 +601,204 @@ static const struct _vte_keymap_entry _vte_keymap_GDK_F35[] = {
         {cursor_all, keypad_all, 0, X_NULL, 0},
 };
 
-static const struct _vte_keymap_group {
-	guint keyval;
-	const struct _vte_keymap_entry *entries;
-} _vte_keymap[] = {
-	{GDK_KEY_space,			_vte_keymap_GDK_space},
-	{GDK_KEY_Return,		_vte_keymap_GDK_Return},
-	{GDK_KEY_Escape,		_vte_keymap_GDK_Escape},
-	{GDK_KEY_Tab,			_vte_keymap_GDK_Tab},
-	{GDK_KEY_ISO_Left_Tab,		_vte_keymap_GDK_ISO_Left_Tab},
-	{GDK_KEY_Home,			_vte_keymap_GDK_Home},
-	{GDK_KEY_End,			_vte_keymap_GDK_End},
-	{GDK_KEY_Insert,		_vte_keymap_GDK_Insert},
-	{GDK_KEY_slash,			_vte_keymap_GDK_slash},
-	{GDK_KEY_question,		_vte_keymap_GDK_question},
+/* Find the entry list for a key. The switch compiles down to a dense
+ * jump table / binary search instead of the linear scan the old
+ * _vte_keymap[] group array required. */
+static const struct _vte_keymap_entry *
+_vte_keymap_find_entries(guint keyval)
+{
+	switch (keyval) {
+	case GDK_KEY_space:
+		return _vte_keymap_GDK_space;
+	case GDK_KEY_Return:
+		return _vte_keymap_GDK_Return;
+	case GDK_KEY_Escape:
+		return _vte_keymap_GDK_Escape;
+	case GDK_KEY_Tab:
+		return _vte_keymap_GDK_Tab;
+	case GDK_KEY_ISO_Left_Tab:
+		return _vte_keymap_GDK_ISO_Left_Tab;
+	case GDK_KEY_Home:
+		return _vte_keymap_GDK_Home;
+	case GDK_KEY_End:
+		return _vte_keymap_GDK_End;
+	case GDK_KEY_Insert:
+		return _vte_keymap_GDK_Insert;
+	case GDK_KEY_slash:
+		return _vte_keymap_GDK_slash;
+	case GDK_KEY_question:
+		return _vte_keymap_GDK_question;
 	/* GDK_Delete is all handled in code, due to funkiness. */
-	{GDK_KEY_Page_Up,		_vte_keymap_GDK_Page_Up},
-	{GDK_KEY_Page_Down,		_vte_keymap_GDK_Page_Down},
-
-	{GDK_KEY_2,			_vte_keymap_GDK_2},
-	{GDK_KEY_3,			_vte_keymap_GDK_3},
-	{GDK_KEY_4,			_vte_keymap_GDK_4},
-	{GDK_KEY_5,			_vte_keymap_GDK_5},
-	{GDK_KEY_6,			_vte_keymap_GDK_6},
-	{GDK_KEY_7,			_vte_keymap_GDK_7},
-	{GDK_KEY_8,			_vte_keymap_GDK_8},
-	{GDK_KEY_minus,			_vte_keymap_GDK_Minus},
-
-	{GDK_KEY_Up,			_vte_keymap_GDK_Up},
-	{GDK_KEY_Down,			_vte_keymap_GDK_Down},
-	{GDK_KEY_Right,			_vte_keymap_GDK_Right},
-	{GDK_KEY_Left,			_vte_keymap_GDK_Left},
-
-	{GDK_KEY_KP_Space,		_vte_keymap_GDK_KP_Space},
-	{GDK_KEY_KP_Tab,		_vte_keymap_GDK_KP_Tab},
-	{GDK_KEY_KP_Enter,		_vte_keymap_GDK_KP_Enter},
-	{GDK_KEY_KP_F1,			_vte_keymap_GDK_KP_F1},
-	{GDK_KEY_KP_F2,			_vte_keymap_GDK_KP_F2},
-	{GDK_KEY_KP_F3,			_vte_keymap_GDK_KP_F3},
-	{GDK_KEY_KP_F4,			_vte_keymap_GDK_KP_F4},
-	{GDK_KEY_KP_Multiply,		_vte_keymap_GDK_KP_Multiply},
-	{GDK_KEY_KP_Add,		_vte_keymap_GDK_KP_Add},
-	{GDK_KEY_KP_Separator,		_vte_keymap_GDK_KP_Separator},
-	{GDK_KEY_KP_Subtract,		_vte_keymap_GDK_KP_Subtract},
-	{GDK_KEY_KP_Decimal,		_vte_keymap_GDK_KP_Decimal_Delete},
-	{GDK_KEY_KP_Delete,		_vte_keymap_GDK_KP_Decimal_Delete},
-	{GDK_KEY_KP_Divide,		_vte_keymap_GDK_KP_Divide},
-	{GDK_KEY_KP_0,			_vte_keymap_GDK_KP_0},
-	{GDK_KEY_KP_Insert,		_vte_keymap_GDK_KP_Insert},
-	{GDK_KEY_KP_1,			_vte_keymap_GDK_KP_1},
-	{GDK_KEY_KP_End,		_vte_keymap_GDK_KP_End},
-	{GDK_KEY_KP_2,			_vte_keymap_GDK_KP_2},
-	{GDK_KEY_KP_Down,		_vte_keymap_GDK_KP_Down},
-	{GDK_KEY_KP_3,			_vte_keymap_GDK_KP_3},
-	{GDK_KEY_KP_Page_Down,		_vte_keymap_GDK_KP_Page_Down},
-	{GDK_KEY_KP_4,			_vte_keymap_GDK_KP_4},
-	{GDK_KEY_KP_Left,		_vte_keymap_GDK_KP_Left},
-	{GDK_KEY_KP_5,			_vte_keymap_GDK_KP_5},
-	{GDK_KEY_KP_Begin,		_vte_keymap_GDK_KP_Begin},
-	{GDK_KEY_KP_6,			_vte_keymap_GDK_KP_6},
-	{GDK_KEY_KP_Right,		_vte_keymap_GDK_KP_Right},
-	{GDK_KEY_KP_7,			_vte_keymap_GDK_KP_7},
-	{GDK_KEY_KP_Home,		_vte_keymap_GDK_KP_Home},
-	{GDK_KEY_KP_8,			_vte_keymap_GDK_KP_8},
-	{GDK_KEY_KP_Up,			_vte_keymap_GDK_KP_Up},
-	{GDK_KEY_KP_9,			_vte_keymap_GDK_KP_9},
-	{GDK_KEY_KP_Page_Up,		_vte_keymap_GDK_KP_Page_Up},
-
-	{GDK_KEY_F1,			_vte_keymap_GDK_F1},
-	{GDK_KEY_F2,			_vte_keymap_GDK_F2},
-	{GDK_KEY_F3,			_vte_keymap_GDK_F3},
-	{GDK_KEY_F4,			_vte_keymap_GDK_F4},
-	{GDK_KEY_F5,			_vte_keymap_GDK_F5},
-	{GDK_KEY_F6,			_vte_keymap_GDK_F6},
-	{GDK_KEY_F7,			_vte_keymap_GDK_F7},
-	{GDK_KEY_F8,			_vte_keymap_GDK_F8},
-	{GDK_KEY_F9,			_vte_keymap_GDK_F9},
-	{GDK_KEY_F10,			_vte_keymap_GDK_F10},
-	{GDK_KEY_F11,			_vte_keymap_GDK_F11},
-	{GDK_KEY_F12,			_vte_keymap_GDK_F12},
-	{GDK_KEY_F13,			_vte_keymap_GDK_F13},
-	{GDK_KEY_F14,			_vte_keymap_GDK_F14},
-	{GDK_KEY_F15,			_vte_keymap_GDK_F15},
-	{GDK_KEY_F16,			_vte_keymap_GDK_F16},
-	{GDK_KEY_F17,			_vte_keymap_GDK_F17},
-	{GDK_KEY_F18,			_vte_keymap_GDK_F18},
-	{GDK_KEY_F19,			_vte_keymap_GDK_F19},
-	{GDK_KEY_F20,			_vte_keymap_GDK_F20},
-	{GDK_KEY_F21,			_vte_keymap_GDK_F21},
-	{GDK_KEY_F22,			_vte_keymap_GDK_F22},
-	{GDK_KEY_F23,			_vte_keymap_GDK_F23},
-	{GDK_KEY_F24,			_vte_keymap_GDK_F24},
-	{GDK_KEY_F25,			_vte_keymap_GDK_F25},
-	{GDK_KEY_F26,			_vte_keymap_GDK_F26},
-	{GDK_KEY_F27,			_vte_keymap_GDK_F27},
-	{GDK_KEY_F28,			_vte_keymap_GDK_F28},
-	{GDK_KEY_F29,			_vte_keymap_GDK_F29},
-	{GDK_KEY_F30,			_vte_keymap_GDK_F30},
-	{GDK_KEY_F31,			_vte_keymap_GDK_F31},
-	{GDK_KEY_F32,			_vte_keymap_GDK_F32},
-	{GDK_KEY_F33,			_vte_keymap_GDK_F33},
-	{GDK_KEY_F34,			_vte_keymap_GDK_F34},
-	{GDK_KEY_F35,			_vte_keymap_GDK_F35},
-};
+	case GDK_KEY_Page_Up:
+		return _vte_keymap_GDK_Page_Up;
+	case GDK_KEY_Page_Down:
+		return _vte_keymap_GDK_Page_Down;
+	case GDK_KEY_2:
+		return _vte_keymap_GDK_2;
+	case GDK_KEY_3:
+		return _vte_keymap_GDK_3;
+	case GDK_KEY_4:
+		return _vte_keymap_GDK_4;
+	case GDK_KEY_5:
+		return _vte_keymap_GDK_5;
+	case GDK_KEY_6:
+		return _vte_keymap_GDK_6;
+	case GDK_KEY_7:
+		return _vte_keymap_GDK_7;
+	case GDK_KEY_8:
+		return _vte_keymap_GDK_8;
+	case GDK_KEY_minus:
+		return _vte_keymap_GDK_Minus;
+	case GDK_KEY_Up:
+		return _vte_keymap_GDK_Up;
+	case GDK_KEY_Down:
+		return _vte_keymap_GDK_Down;
+	case GDK_KEY_Right:
+		return _vte_keymap_GDK_Right;
+	case GDK_KEY_Left:
+		return _vte_keymap_GDK_Left;
+	case GDK_KEY_KP_Space:
+		return _vte_keymap_GDK_KP_Space;
+	case GDK_KEY_KP_Tab:
+		return _vte_keymap_GDK_KP_Tab;
+	case GDK_KEY_KP_Enter:
+		return _vte_keymap_GDK_KP_Enter;
+	case GDK_KEY_KP_F1:
+		return _vte_keymap_GDK_KP_F1;
+	case GDK_KEY_KP_F2:
+		return _vte_keymap_GDK_KP_F2;
+	case GDK_KEY_KP_F3:
+		return _vte_keymap_GDK_KP_F3;
+	case GDK_KEY_KP_F4:
+		return _vte_keymap_GDK_KP_F4;
+	case GDK_KEY_KP_Multiply:
+		return _vte_keymap_GDK_KP_Multiply;
+	case GDK_KEY_KP_Add:
+		return _vte_keymap_GDK_KP_Add;
+	case GDK_KEY_KP_Separator:
+		return _vte_keymap_GDK_KP_Separator;
+	case GDK_KEY_KP_Subtract:
+		return _vte_keymap_GDK_KP_Subtract;
+	case GDK_KEY_KP_Decimal:
+		return _vte_keymap_GDK_KP_Decimal_Delete;
+	case GDK_KEY_KP_Delete:
+		return _vte_keymap_GDK_KP_Decimal_Delete;
+	case GDK_KEY_KP_Divide:
+		return _vte_keymap_GDK_KP_Divide;
+	case GDK_KEY_KP_0:
+		return _vte_keymap_GDK_KP_0;
+	case GDK_KEY_KP_Insert:
+		return _vte_keymap_GDK_KP_Insert;
+	case GDK_KEY_KP_1:
+		return _vte_keymap_GDK_KP_1;
+	case GDK_KEY_KP_End:
+		return _vte_keymap_GDK_KP_End;
+	case GDK_KEY_KP_2:
+		return _vte_keymap_GDK_KP_2;
+	case GDK_KEY_KP_Down:
+		return _vte_keymap_GDK_KP_Down;
+	case GDK_KEY_KP_3:
+		return _vte_keymap_GDK_KP_3;
+	case GDK_KEY_KP_Page_Down:
+		return _vte_keymap_GDK_KP_Page_Down;
+	case GDK_KEY_KP_4:
+		return _vte_keymap_GDK_KP_4;
+	case GDK_KEY_KP_Left:
+		return _vte_keymap_GDK_KP_Left;
+	case GDK_KEY_KP_5:
+		return _vte_keymap_GDK_KP_5;
+	case GDK_KEY_KP_Begin:
+		return _vte_keymap_GDK_KP_Begin;
+	case GDK_KEY_KP_6:
+		return _vte_keymap_GDK_KP_6;
+	case GDK_KEY_KP_Right:
+		return _vte_keymap_GDK_KP_Right;
+	case GDK_KEY_KP_7:
+		return _vte_keymap_GDK_KP_7;
+	case GDK_KEY_KP_Home:
+		return _vte_keymap_GDK_KP_Home;
+	case GDK_KEY_KP_8:
+		return _vte_keymap_GDK_KP_8;
+	case GDK_KEY_KP_Up:
+		return _vte_keymap_GDK_KP_Up;
+	case GDK_KEY_KP_9:
+		return _vte_keymap_GDK_KP_9;
+	case GDK_KEY_KP_Page_Up:
+		return _vte_keymap_GDK_KP_Page_Up;
+	case GDK_KEY_F1:
+		return _vte_keymap_GDK_F1;
+	case GDK_KEY_F2:
+		return _vte_keymap_GDK_F2;
+	case GDK_KEY_F3:
+		return _vte_keymap_GDK_F3;
+	case GDK_KEY_F4:
+		return _vte_keymap_GDK_F4;
+	case GDK_KEY_F5:
+		return _vte_keymap_GDK_F5;
+	case GDK_KEY_F6:
+		return _vte_keymap_GDK_F6;
+	case GDK_KEY_F7:
+		return _vte_keymap_GDK_F7;
+	case GDK_KEY_F8:
+		return _vte_keymap_GDK_F8;
+	case GDK_KEY_F9:
+		return _vte_keymap_GDK_F9;
+	case GDK_KEY_F10:
+		return _vte_keymap_GDK_F10;
+	case GDK_KEY_F11:
+		return _vte_keymap_GDK_F11;
+	case GDK_KEY_F12:
+		return _vte_keymap_GDK_F12;
+	case GDK_KEY_F13:
+		return _vte_keymap_GDK_F13;
+	case GDK_KEY_F14:
+		return _vte_keymap_GDK_F14;
+	case GDK_KEY_F15:
+		return _vte_keymap_GDK_F15;
+	case GDK_KEY_F16:
+		return _vte_keymap_GDK_F16;
+	case GDK_KEY_F17:
+		return _vte_keymap_GDK_F17;
+	case GDK_KEY_F18:
+		return _vte_keymap_GDK_F18;
+	case GDK_KEY_F19:
+		return _vte_keymap_GDK_F19;
+	case GDK_KEY_F20:
+		return _vte_keymap_GDK_F20;
+	case GDK_KEY_F21:
+		return _vte_keymap_GDK_F21;
+	case GDK_KEY_F22:
+		return _vte_keymap_GDK_F22;
+	case GDK_KEY_F23:
+		return _vte_keymap_GDK_F23;
+	case GDK_KEY_F24:
+		return _vte_keymap_GDK_F24;
+	case GDK_KEY_F25:
+		return _vte_keymap_GDK_F25;
+	case GDK_KEY_F26:
+		return _vte_keymap_GDK_F26;
+	case GDK_KEY_F27:
+		return _vte_keymap_GDK_F27;
+	case GDK_KEY_F28:
+		return _vte_keymap_GDK_F28;
+	case GDK_KEY_F29:
+		return _vte_keymap_GDK_F29;
+	case GDK_KEY_F30:
+		return _vte_keymap_GDK_F30;
+	case GDK_KEY_F31:
+		return _vte_keymap_GDK_F31;
+	case GDK_KEY_F32:
+		return _vte_keymap_GDK_F32;
+	case GDK_KEY_F33:
+		return _vte_keymap_GDK_F33;
+	case GDK_KEY_F34:
+		return _vte_keymap_GDK_F34;
+	case GDK_KEY_F35:
+		return _vte_keymap_GDK_F35;
+	default:
+		return NULL;
+	}
+}
 
 /* Map the specified keyval/modifier setup, dependent on the mode, to
  * a literal string. */
@@ -716,66 +811,82 @@ _vte_keymap_map(guint keyval,
 		gssize *normal_length)
 {
 	gsize i;
-	const struct _vte_keymap_entry *entries;
+	const struct _vte_keymap_entry *entries, *entry;
 	enum _vte_cursor_mode cursor_mode;
 	enum _vte_keypad_mode keypad_mode;
 
+	/* Key repeat resolves the same key with the same modifiers and
+	 * modes over and over; remember the last resolved entry.  Key
+	 * handling only ever happens on the GTK thread. */
+	static guint last_keyval = 0;
+	static guint last_modifiers = 0;
+	static guint last_cursor_mode = 0;
+	static guint last_keypad_mode = 0;
+	static const struct _vte_keymap_entry *last_entry = NULL;
+
 	g_return_if_fail(normal != NULL);
 	g_return_if_fail(normal_length != NULL);
 
-	_VTE_DEBUG_IF(VTE_DEBUG_KEYBOARD) 
+	_VTE_DEBUG_IF(VTE_DEBUG_KEYBOARD)
 		_vte_keysym_print(keyval, modifiers);
 
 	/* Start from scratch. */
 	*normal = NULL;
 	*normal_length = 0;
 
-	/* Search for the list for this key. */
-	entries = NULL;
-	for (i = 0; i < G_N_ELEMENTS(_vte_keymap); i++) {
-		if (_vte_keymap[i].keyval == keyval) {
-			/* Found it! */
-			entries = _vte_keymap[i].entries;
-			break;
-		}
-	}
-	if (entries == NULL) {
-		_vte_debug_print(VTE_DEBUG_KEYBOARD,
-				" (ignoring, no map for key).\n");
-		return;
-	}
-
 	/* Build mode masks. */
 	cursor_mode = app_cursor_keys ? cursor_app : cursor_default;
 	keypad_mode = app_keypad_keys ? keypad_app : keypad_default;
 	modifiers &= GDK_SHIFT_MASK | GDK_CONTROL_MASK | VTE_META_MASK | VTE_NUMLOCK_MASK;
 
-	/* Search for the conditions. */
-	for (i = 0; entries[i].normal_length; i++)
-	if ((entries[i].cursor_mode & cursor_mode) &&
-	    (entries[i].keypad_mode & keypad_mode))
-	if ((modifiers & entries[i].mod_mask) == entries[i].mod_mask) {
-                if (entries[i].normal_length != -1) {
-                        *normal_length = entries[i].normal_length;
-                        *normal = (char*)g_memdup(entries[i].normal,
-                                                  entries[i].normal_length);
-                } else {
-                        *normal_length = strlen(entries[i].normal);
-                        *normal = g_strdup(entries[i].normal);
-                }
-                _vte_keymap_key_add_key_modifiers(keyval,
-                                                  modifiers,
-                                                  cursor_mode & cursor_app,
-                                                  normal,
-                                                  normal_length);
-                _vte_debug_print(VTE_DEBUG_KEYBOARD,
-                                 " to '%s'.\n",
-                                 _vte_debug_sequence_to_string(*normal, *normal_length));
-                return;
+	if (keyval == last_keyval && modifiers == last_modifiers &&
+	    (guint)cursor_mode == last_cursor_mode &&
+	    (guint)keypad_mode == last_keypad_mode) {
+		entry = last_entry;
+	} else {
+		/* Search for the list for this key. */
+		entries = _vte_keymap_find_entries(keyval);
+
+		/* Search for the conditions. */
+		entry = NULL;
+		if (entries != NULL)
+		for (i = 0; entries[i].normal_length; i++)
+		if ((entries[i].cursor_mode & cursor_mode) &&
+		    (entries[i].keypad_mode & keypad_mode))
+		if ((modifiers & entries[i].mod_mask) == entries[i].mod_mask) {
+			entry = &entries[i];
+			break;
+		}
+
+		last_keyval = keyval;
+		last_modifiers = modifiers;
+		last_cursor_mode = cursor_mode;
+		last_keypad_mode = keypad_mode;
+		last_entry = entry;
+	}
+
+	if (entry == NULL) {
+		_vte_debug_print(VTE_DEBUG_KEYBOARD,
+				" (ignoring, no match for key and modifier state).\n");
+		return;
 	}
 
-	_vte_debug_print(VTE_DEBUG_KEYBOARD,
-			" (ignoring, no match for modifier state).\n");
+        if (entry->normal_length != -1) {
+                *normal_length = entry->normal_length;
+                *normal = (char*)g_memdup(entry->normal,
+                                          entry->normal_length);
+        } else {
+                *normal_length = strlen(entry->normal);
+                *normal = g_strdup(entry->normal);
+        }
+        _vte_keymap_key_add_key_modifiers(keyval,
+                                          modifiers,
+                                          cursor_mode & cursor_app,
+                                          normal,
+                                          normal_length);
+        _vte_debug_print(VTE_DEBUG_KEYBOARD,
+                         " to '%s'.\n",
+                         _vte_debug_sequence_to_string(*normal, *normal_length));
 }
 
 gboolean
@@ -45,13 +45,6 @@ enum {
 
 using namespace std::literals;
 
-char*
-vte::parser::Sequence::ucs4_to_utf8(gunichar const* str,
-                                    ssize_t len) const noexcept
-{
-        return g_ucs4_to_utf8(str, len, nullptr, nullptr, nullptr);
-}
-
 static constexpr char const*
 seq_to_str(unsigned int type) noexcept
 {
@@ -254,13 +247,11 @@ private:
         void
         print_string(vte::parser::Sequence const& seq) noexcept
         {
-                auto u8str = seq.string_param();
+                auto const u8str = seq.string();
 
                 m_str.push_back('\"');
                 m_str.append(u8str);
                 m_str.push_back('\"');
-
-                g_free(u8str);
         }
 
         void
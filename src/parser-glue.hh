@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <algorithm>
 #include <string>
+#include <string_view>
 
 #include "parser.hh"
 
@@ -53,11 +54,23 @@ public:
                 return vte_parser_feed(&m_parser, raw);
         }
 
+        /* See vte_parser_feed_span(). */
+        inline size_t feed_span(uint32_t const* raw,
+                                size_t len) noexcept
+        {
+                return vte_parser_feed_span(&m_parser, raw, len);
+        }
+
         inline void reset() noexcept
         {
                 vte_parser_reset(&m_parser);
         }
 
+        inline bool in_ground_state() const noexcept
+        {
+                return vte_parser_in_ground_state(&m_parser) != 0;
+        }
+
 protected:
         vte_parser_t m_parser;
 }; // class Parser
@@ -77,9 +90,6 @@ public:
 
         typedef int number;
 
-        char* ucs4_to_utf8(gunichar const* str,
-                           ssize_t len = -1) const noexcept;
-
         void print() const noexcept;
 
         /* type:
@@ -173,51 +183,20 @@ public:
                 return m_seq->intermediates;
         }
 
-        // FIXMEchpe: upgrade to C++17 and use the u32string_view version below, instead
-        /*
-         * string:
-         *
-         * This is the string argument of a DCS or OSC sequence.
-         *
-         * Returns: the string argument
-         */
-        inline std::u32string string() const noexcept
-        {
-                size_t len;
-                auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-                return std::u32string(reinterpret_cast<char32_t*>(buf), len);
-        }
-
-        #if 0
         /*
          * string:
          *
-         * This is the string argument of a DCS or OSC sequence.
+         * This is the string argument of a DCS or OSC sequence, in UTF-8.
+         * The view borrows the parser's capture buffer and is only valid
+         * until the parser consumes further input or is reset.
          *
          * Returns: the string argument
          */
-        inline constexpr std::u32string_view string() const noexcept
+        inline constexpr std::string_view string() const noexcept
         {
                 size_t len = 0;
                 auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-                return std::u32string_view(buf, len);
-        }
-        #endif
-
-        /*
-         * string:
-         *
-         * This is the string argument of a DCS or OSC sequence.
-         *
-         * Returns: the string argument
-         */
-        std::string string_utf8() const noexcept;
-
-        inline char* string_param() const noexcept
-        {
-                size_t len = 0;
-                auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-                return ucs4_to_utf8(buf, len);
+                return std::string_view(buf, len);
         }
 
         /* size:
@@ -408,7 +387,8 @@ public:
 
         inline explicit operator bool() const { return m_seq != nullptr; }
 
-        /* This is only used in the test suite */
+        /* This is only used in the test suite, and to rebind the
+         * sequence when applying pre-parsed batches. */
         vte_seq_t** seq_ptr() { return &m_seq; }
 
 private:
@@ -800,21 +780,17 @@ public:
 class StringTokeniser {
 public:
         using string_type = std::string;
+        using stringview_type = std::string_view;
         using char_type = std::string::value_type;
 
 private:
-        string_type const& m_string;
+        stringview_type m_string;
         char_type m_separator{';'};
 
 public:
-        StringTokeniser(string_type& s,
-                        char_type separator = ';')
-                : m_string{s},
-                  m_separator{separator}
-        {
-        }
-
-        StringTokeniser(string_type&& s,
+        /* The tokeniser borrows @s, which must outlive it and its
+         * iterators; tokens come out as owned strings. */
+        StringTokeniser(stringview_type s,
                         char_type separator = ';')
                 : m_string{s},
                   m_separator{separator}
@@ -843,13 +819,13 @@ public:
                 using size_type = string_type::size_type;
 
         private:
-                string_type const* m_string;
+                stringview_type const* m_string;
                 char_type m_separator{';'};
                 string_type::size_type m_position;
                 string_type::size_type m_next_separator;
 
         public:
-                const_iterator(string_type const* str,
+                const_iterator(stringview_type const* str,
                                char_type separator,
                                size_type position)
                         : m_string{str},
@@ -859,7 +835,7 @@ public:
                 {
                 }
 
-                const_iterator(string_type const* str,
+                const_iterator(stringview_type const* str,
                                char_type separator)
                         : m_string{str},
                           m_separator{separator},
@@ -966,7 +942,7 @@ public:
 
                 inline string_type operator*() const noexcept
                 {
-                        return m_string->substr(m_position, size());
+                        return string_type{m_string->substr(m_position, size())};
                 }
 
                 /*
@@ -976,7 +952,7 @@ public:
                  */
                 inline string_type string_remaining() const noexcept
                 {
-                        return m_string->substr(m_position);
+                        return string_type{m_string->substr(m_position)};
                 }
 
                 inline void append(string_type& str) const noexcept
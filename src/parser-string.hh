@@ -26,15 +26,21 @@
  * vte_seq_string_t:
  *
  * A type to hold the argument string of a DSC or OSC sequence.
+ *
+ * The string is stored as UTF-8 as it is captured, so that handlers can
+ * be handed a zero-copy view of the payload instead of converting to a
+ * fresh allocation on every dispatch. The length limit is measured in
+ * characters, as before; the byte buffer grows as needed.
  */
 typedef struct vte_seq_string_t {
-        uint32_t capacity;
-        uint32_t len;
-        uint32_t* buf;
+        uint32_t capacity;  /* bytes */
+        uint32_t len;       /* bytes */
+        uint32_t chars;
+        char* buf;
 } vte_seq_string_t;
 
-#define VTE_SEQ_STRING_DEFAULT_CAPACITY (1 << 7) /* must be power of two */
-#define VTE_SEQ_STRING_MAX_CAPACITY     (1 << 12)
+#define VTE_SEQ_STRING_DEFAULT_CAPACITY (1 << 7) /* bytes; must be power of two */
+#define VTE_SEQ_STRING_MAX_CAPACITY     (1 << 12) /* characters */
 
 /*
  * vte_seq_string_init:
@@ -45,7 +51,8 @@ static inline void vte_seq_string_init(vte_seq_string_t* str) noexcept
 {
         str->capacity = VTE_SEQ_STRING_DEFAULT_CAPACITY;
         str->len = 0;
-        str->buf = (uint32_t*)g_malloc0_n(str->capacity, sizeof(uint32_t));
+        str->chars = 0;
+        str->buf = (char*)g_malloc0(str->capacity);
 }
 
 /*
@@ -63,20 +70,21 @@ static inline void vte_seq_string_free(vte_seq_string_t* str) noexcept
  * vte_seq_string_ensure_capacity:
  * @string:
  *
- * If @string's length is at capacity, and capacity is not maximal,
- * expands the string's capacity.
+ * Unless @string already holds the maximum number of characters,
+ * ensures the buffer has room for one more character, which takes
+ * up to 6 bytes of UTF-8.
  *
  * Returns: %true if the string has capacity for at least one more character
  */
 static inline bool vte_seq_string_ensure_capacity(vte_seq_string_t* str) noexcept
 {
-        if (str->len < str->capacity)
-                return true;
-        if (str->capacity >= VTE_SEQ_STRING_MAX_CAPACITY)
+        if (str->chars >= VTE_SEQ_STRING_MAX_CAPACITY)
                 return false;
+        if (str->len + 6 <= str->capacity)
+                return true;
 
         str->capacity *= 2;
-        str->buf = (uint32_t*)g_realloc_n(str->buf, str->capacity, sizeof(uint32_t));
+        str->buf = (char*)g_realloc(str->buf, str->capacity);
         return true;
 }
 
@@ -95,7 +103,8 @@ static inline bool vte_seq_string_push(vte_seq_string_t* str,
         if (!vte_seq_string_ensure_capacity(str))
                 return false;
 
-        str->buf[str->len++] = c;
+        str->len += g_unichar_to_utf8(c, str->buf + str->len);
+        ++str->chars;
         return true;
 }
 
@@ -120,17 +129,18 @@ static inline void vte_seq_string_reset(vte_seq_string_t* str) noexcept
 {
         /* Zero length. However, don't clear the buffer, nor shrink the capacity. */
         str->len = 0;
+        str->chars = 0;
 }
 
 /*
  * vte_seq_string_get:
  * @string:
- * @len: location to store the buffer length in code units
+ * @len: location to store the buffer length in bytes
  *
- * Returns: the string's buffer as an array of uint32_t code units
+ * Returns: the string's buffer as UTF-8 bytes
  */
-static constexpr inline uint32_t* vte_seq_string_get(vte_seq_string_t const* str,
-                                                     size_t* len) noexcept
+static constexpr inline char* vte_seq_string_get(vte_seq_string_t const* str,
+                                                 size_t* len) noexcept
 {
         assert(len != nullptr);
         *len = str->len;
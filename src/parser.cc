@@ -881,6 +881,12 @@ parser_dcs_consume(vte_parser_t* parser,
         parser->seq.terminator = raw;
         parser->seq.command = vte_parse_host_dcs(&parser->seq);
 
+        /* SIXEL data is streamed to the host character by character (see
+         * parser_dcs_collect() below); let it set up the decoder from the
+         * parameters before the data starts. */
+        if (parser->seq.command == VTE_CMD_DECSIXEL)
+                return VTE_SEQ_SIXEL_START;
+
         return VTE_SEQ_NONE;
 }
 
@@ -888,6 +894,16 @@ static int
 parser_dcs_collect(vte_parser_t* parser,
                    uint32_t raw)
 {
+        /* SIXEL data goes to the host as it streams in instead of being
+         * buffered: images routinely exceed VTE_SEQ_STRING_MAX_CAPACITY,
+         * and incremental decoding avoids a big stall at dispatch. The
+         * data character rides in the terminator field; the DCS dispatch
+         * at the string terminator overwrites it again. */
+        if (parser->seq.command == VTE_CMD_DECSIXEL) {
+                parser->seq.terminator = raw;
+                return VTE_SEQ_SIXEL_DATA;
+        }
+
         if (G_UNLIKELY(!vte_seq_string_push(&parser->seq.arg_str, raw)))
                 parser->state = STATE_DCS_IGNORE;
 
@@ -1007,19 +1023,51 @@ parser_sci(vte_parser_t* parser,
 #define ACTION_OSC_DISPATCH parser_osc
 #define ACTION_SCI_DISPATCH parser_sci
 
+/* Character classes for the ground state, used both for dispatch below
+ * and for the bulk scan in vte_parser_feed_span(). Codepoints >= 0xa0
+ * are always GROUND_CLASS_PRINT.
+ */
+enum {
+        GROUND_CLASS_PRINT = 0,   /* dispatches GRAPHIC via ACTION_PRINT */
+        GROUND_CLASS_EXECUTE,     /* C0 \ { ESC } and C1 */
+        GROUND_CLASS_ESC,         /* ESC */
+        GROUND_CLASS_DEL,         /* DEL; ignored, see vte_parser_feed() */
+};
+
+static uint8_t const ground_class_table[0xa0] = {
+        /* 0x00..0x1a: C0 \ { ESC } */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x00..0x0f */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,                /* 0x10..0x1a */
+        2,                                              /* 0x1b ESC */
+        1, 1, 1, 1,                                     /* 0x1c..0x1f */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x20..0x2f */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x30..0x3f */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x40..0x4f */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x50..0x5f */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x60..0x6f */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x70..0x7e */
+        3,                                              /* 0x7f DEL */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x80..0x8f C1 */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x90..0x9f C1 */
+};
+
+static inline unsigned int
+parser_ground_class(uint32_t raw)
+{
+        return G_LIKELY(raw >= 0xa0) ? GROUND_CLASS_PRINT : ground_class_table[raw];
+}
+
 static int
 parser_feed_to_state(vte_parser_t* parser,
                      uint32_t raw)
 {
         switch (parser->state) {
         case STATE_GROUND:
-                switch (raw) {
-                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                case 0x1c ... 0x1f:
-                case 0x80 ... 0x9f:        /* C1 */
+                switch (parser_ground_class(raw)) {
+                case GROUND_CLASS_EXECUTE:
                         return parser_action(parser, raw,
                                              ACTION_EXECUTE);
-                case 0x1b:                /* ESC */
+                case GROUND_CLASS_ESC:
                         return parser_transition(parser, raw, STATE_ESC,
                                                  ACTION_CLEAR_INT);
                 }
@@ -1437,8 +1485,58 @@ vte_parser_feed(vte_parser_t* parser,
         }
 }
 
+/**
+ * vte_parser_feed_span() - Feeds a run of codepoints in one step
+ * @parser: the struct vte_parser
+ * @raw: the codepoints, UCS-4
+ * @len: the number of codepoints
+ *
+ * Consumes the longest prefix of @raw consisting entirely of printable
+ * characters while the parser is in the ground state. Every consumed
+ * character would have dispatched %VTE_SEQ_GRAPHIC with itself as the
+ * terminator, and the parser state afterwards is exactly as if each
+ * had been fed through vte_parser_feed() individually; the caller is
+ * expected to handle the consumed characters as one graphic run.
+ *
+ * Returns: the number of codepoints consumed; 0 when the parser is not
+ *          in the ground state or the first codepoint is not printable.
+ */
+size_t
+vte_parser_feed_span(vte_parser_t* parser,
+                     uint32_t const* raw,
+                     size_t len)
+{
+        if (parser->state != STATE_GROUND)
+                return 0;
+
+        size_t n = 0;
+        while (n < len && parser_ground_class(raw[n]) == GROUND_CLASS_PRINT)
+                ++n;
+
+        /* ACTION_PRINT only records the last graphic character. */
+        if (n > 0)
+                parser_print(parser, raw[n - 1]);
+
+        return n;
+}
+
 void
 vte_parser_reset(vte_parser_t* parser)
 {
         parser_transition(parser, 0, STATE_GROUND, ACTION_IGNORE);
 }
+
+/**
+ * vte_parser_in_ground_state() - Query whether the parser is in ground state
+ * @parser: the struct vte_parser
+ *
+ * Returns: nonzero if the parser is in the ground state, i.e. not inside
+ *          an escape or control sequence. In ground state, feeding any
+ *          codepoint in [0x20, 0x7f) is guaranteed to dispatch GRAPHIC
+ *          with that codepoint as terminator.
+ */
+int
+vte_parser_in_ground_state(vte_parser_t const* parser)
+{
+        return parser->state == STATE_GROUND;
+}
@@ -53,6 +53,9 @@ enum {
         VTE_SEQ_PM,          /* privacy message */
         VTE_SEQ_SOS,         /* start of string */
 
+        VTE_SEQ_SIXEL_START, /* entered a SIXEL DCS; parameters complete */
+        VTE_SEQ_SIXEL_DATA,  /* one character of streamed SIXEL data */
+
         VTE_SEQ_N,
 };
 
@@ -206,4 +209,8 @@ void vte_parser_init(vte_parser_t* parser);
 void vte_parser_deinit(vte_parser_t* parser);
 int vte_parser_feed(vte_parser_t* parser,
                     uint32_t raw);
+size_t vte_parser_feed_span(vte_parser_t* parser,
+                            uint32_t const* raw,
+                            size_t len);
 void vte_parser_reset(vte_parser_t* parser);
+int vte_parser_in_ground_state(vte_parser_t const* parser);
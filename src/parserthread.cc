@@ -0,0 +1,254 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "parserthread.hh"
+
+#include "debug.h"
+
+namespace vte {
+
+namespace base {
+
+ParsedBatch::~ParsedBatch() noexcept
+{
+        for (auto& seq : m_seqs)
+                vte_seq_string_free(&seq.arg_str);
+}
+
+void
+ParsedBatch::add_seq_op(int status,
+                        vte_seq_t const* seq)
+{
+        m_seqs.push_back(*seq);
+
+        /* Deep-copy the string argument; the shallow copy above aliases
+         * the parser's own buffer, which will be reused.
+         */
+        auto& arg_str = m_seqs.back().arg_str;
+        arg_str.capacity = seq->arg_str.len;
+        arg_str.chars = seq->arg_str.chars;
+        arg_str.buf = (char*)g_memdup(seq->arg_str.buf, seq->arg_str.len);
+
+        m_ops.push_back({status, 0, int(m_seqs.size()) - 1, 0, 0});
+}
+
+bool
+ParserThread::enabled() noexcept
+{
+        static int enabled = -1;
+        if (G_UNLIKELY(enabled == -1))
+                enabled = g_getenv("VTE_THREADED_PARSING") != nullptr;
+        return enabled != 0;
+}
+
+ParserThread::ParserThread()
+{
+        vte_parser_init(&m_parser);
+        g_mutex_init(&m_mutex);
+        g_cond_init(&m_cond);
+
+        m_thread = g_thread_new("vte-parser", thread_func, this);
+}
+
+ParserThread::~ParserThread() noexcept
+{
+        g_mutex_lock(&m_mutex);
+        m_quit = true;
+        g_cond_broadcast(&m_cond);
+        g_mutex_unlock(&m_mutex);
+
+        g_thread_join(m_thread);
+
+        g_cond_clear(&m_cond);
+        g_mutex_clear(&m_mutex);
+        vte_parser_deinit(&m_parser);
+}
+
+void
+ParserThread::push_chunk(Chunk::unique_type chunk)
+{
+        g_mutex_lock(&m_mutex);
+        m_chunks.push(std::move(chunk));
+        g_cond_broadcast(&m_cond);
+        g_mutex_unlock(&m_mutex);
+}
+
+ParserThread::batch_queue_type
+ParserThread::take_batches()
+{
+        batch_queue_type batches;
+
+        g_mutex_lock(&m_mutex);
+        batches.swap(m_batches);
+        g_mutex_unlock(&m_mutex);
+
+        return batches;
+}
+
+bool
+ParserThread::has_work()
+{
+        g_mutex_lock(&m_mutex);
+        bool work = m_parsing || !m_chunks.empty() || !m_batches.empty();
+        g_mutex_unlock(&m_mutex);
+
+        return work;
+}
+
+void
+ParserThread::reset()
+{
+        g_mutex_lock(&m_mutex);
+
+        /* The decoder and parser must not be reset mid-parse. */
+        while (m_parsing)
+                g_cond_wait(&m_cond, &m_mutex);
+
+        while (!m_chunks.empty())
+                m_chunks.pop();
+        while (!m_batches.empty())
+                m_batches.pop();
+
+        m_decoder.reset();
+        vte_parser_reset(&m_parser);
+
+        g_mutex_unlock(&m_mutex);
+}
+
+// static
+gpointer
+ParserThread::thread_func(gpointer data)
+{
+        reinterpret_cast<ParserThread*>(data)->run();
+        return nullptr;
+}
+
+void
+ParserThread::run()
+{
+        g_mutex_lock(&m_mutex);
+        while (true) {
+                while (!m_quit && m_chunks.empty())
+                        g_cond_wait(&m_cond, &m_mutex);
+                if (m_quit)
+                        break;
+
+                auto chunk = std::move(m_chunks.front());
+                m_chunks.pop();
+                m_parsing = true;
+                g_mutex_unlock(&m_mutex);
+
+                auto batch = parse_chunk(std::move(chunk));
+
+                g_mutex_lock(&m_mutex);
+                m_parsing = false;
+                m_batches.push(std::move(batch));
+                g_cond_broadcast(&m_cond);
+        }
+        g_mutex_unlock(&m_mutex);
+}
+
+void
+ParserThread::feed(ParsedBatch* batch,
+                   uint32_t codepoint)
+{
+        auto rv = vte_parser_feed(&m_parser, codepoint);
+        if (G_UNLIKELY(rv < 0)) {
+                _vte_debug_print(VTE_DEBUG_PARSER,
+                                 "Parser error on U+%04X!\n", codepoint);
+                return;
+        }
+
+        switch (rv) {
+        case VTE_SEQ_NONE:
+        case VTE_SEQ_IGNORE:
+                break;
+        case VTE_SEQ_GRAPHIC:
+                batch->add_op(rv, codepoint);
+                break;
+        case VTE_SEQ_SIXEL_DATA:
+                /* One character of SIXEL data; the codepoint is all the
+                 * host needs, don't deep-copy the whole sequence. */
+                batch->add_op(rv, codepoint);
+                break;
+        default:
+                batch->add_seq_op(rv, &m_parser.seq);
+                break;
+        }
+}
+
+std::unique_ptr<ParsedBatch>
+ParserThread::parse_chunk(Chunk::unique_type chunk)
+{
+        auto batch = std::make_unique<ParsedBatch>();
+
+        auto const* ip = chunk->begin_reading();
+        auto const* iend = ip + chunk->len;
+
+        while (ip < iend) {
+                /* Same ASCII fast path as Terminal::process_incoming(). */
+                auto const* run = m_decoder.skip_ascii(ip, iend);
+                while (ip < run) {
+                        if (*ip >= 0x20 && *ip < 0x7f) {
+                                uint32_t chbuf[128];
+                                int n = 0;
+                                while (ip + n < run && n < int(G_N_ELEMENTS(chbuf)) &&
+                                       ip[n] >= 0x20 && ip[n] < 0x7f) {
+                                        chbuf[n] = ip[n];
+                                        ++n;
+                                }
+
+                                auto const consumed = vte_parser_feed_span(&m_parser, chbuf, n);
+                                if (G_LIKELY(consumed > 0)) {
+                                        batch->add_text_op(chbuf, consumed);
+                                        ip += consumed;
+                                        continue;
+                                }
+                        }
+                        feed(batch.get(), *ip);
+                        ++ip;
+                }
+                if (ip == iend)
+                        break;
+
+                switch (m_decoder.decode(*ip)) {
+                case UTF8Decoder::REJECT_REWIND:
+                        /* Rewind the stream; see process_incoming(). */
+                        --ip;
+                        [[fallthrough]];
+                case UTF8Decoder::REJECT:
+                        m_decoder.reset();
+                        /* Fall through to insert the U+FFFD replacement character. */
+                        [[fallthrough]];
+                case UTF8Decoder::ACCEPT:
+                        feed(batch.get(), m_decoder.codepoint());
+                        break;
+                }
+                ++ip;
+        }
+
+        batch->n_bytes = chunk->len;
+        batch->chunk = std::move(chunk);
+
+        return batch;
+}
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <list>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "chunk.hh"
+#include "parser.hh"
+#include "utf8.hh"
+
+namespace vte {
+
+namespace base {
+
+/*
+ * ParsedBatch:
+ *
+ * The result of parsing one Chunk off the GTK thread: the stream of
+ * parser dispatches, in order, ready to be applied to the screen model
+ * by Terminal::process_incoming(). GRAPHIC dispatches carry just their
+ * codepoint; completed control sequences carry a deep copy of the
+ * parser's vte_seq_t, since the parser will have reused its sequence
+ * state long before the batch is applied.
+ */
+class ParsedBatch {
+public:
+        struct Op {
+                int status;          /* the vte_parser_feed() return value */
+                uint32_t codepoint;  /* the codepoint, for a single %VTE_SEQ_GRAPHIC */
+                int seq_idx;         /* index into seq(), or -1 */
+                uint32_t text_start; /* graphic run start, see text() */
+                uint32_t text_len;   /* graphic run length, or 0 */
+        };
+
+        ParsedBatch() = default;
+        ParsedBatch(ParsedBatch const&) = delete;
+        ParsedBatch(ParsedBatch&&) = delete;
+        ~ParsedBatch() noexcept;
+
+        ParsedBatch& operator= (ParsedBatch const&) = delete;
+        ParsedBatch& operator= (ParsedBatch&&) = delete;
+
+        inline void add_op(int status,
+                           uint32_t codepoint)
+        {
+                m_ops.push_back({status, codepoint, -1, 0, 0});
+        }
+
+        /* A run of printable characters consumed with
+         * vte_parser_feed_span(), to be applied as one
+         * Terminal::insert_text_run(). Only width-1 non-combining
+         * characters may be batched this way.
+         */
+        inline void add_text_op(uint32_t const* chars,
+                                size_t len)
+        {
+                m_ops.push_back({VTE_SEQ_GRAPHIC, 0, -1,
+                                 uint32_t(m_text.size()), uint32_t(len)});
+                m_text.insert(m_text.end(), chars, chars + len);
+        }
+
+        void add_seq_op(int status,
+                        vte_seq_t const* seq);
+
+        inline std::vector<Op> const& ops() const noexcept { return m_ops; }
+        inline vte_seq_t* seq(int idx) noexcept { return &m_seqs[idx]; }
+        inline uint32_t const* text(Op const& op) const noexcept { return m_text.data() + op.text_start; }
+
+        size_t n_bytes{0};
+
+        /* The chunk this batch was parsed from, kept alive until the
+         * batch has been consumed. (The chunk pool is a lock-free
+         * stack, so recycling could happen on either thread; there is
+         * just no reason to do it any earlier.)
+         */
+        Chunk::unique_type chunk{};
+
+private:
+        std::vector<Op> m_ops;
+        std::vector<vte_seq_t> m_seqs;
+        std::vector<uint32_t> m_text;
+
+}; // class ParsedBatch
+
+/*
+ * ParserThread:
+ *
+ * A dedicated thread running the UTF-8 decoder and the control sequence
+ * parser, so that a pty flood does not stall the GTK main loop with
+ * per-byte parsing work. The GTK thread hands over raw Chunks with
+ * push_chunk() and collects the resulting ParsedBatches with
+ * take_batches() at its usual processing boundaries; applying the
+ * batches to the Ring and screen model stays on the GTK thread, which
+ * keeps those structures single-threaded.
+ *
+ * Only enabled when the VTE_THREADED_PARSING environment variable is
+ * set.
+ */
+class ParserThread {
+public:
+        ParserThread();
+        ParserThread(ParserThread const&) = delete;
+        ParserThread(ParserThread&&) = delete;
+        ~ParserThread() noexcept;
+
+        ParserThread& operator= (ParserThread const&) = delete;
+        ParserThread& operator= (ParserThread&&) = delete;
+
+        static bool enabled() noexcept;
+
+        void push_chunk(Chunk::unique_type chunk);
+
+        using batch_queue_type = std::queue<std::unique_ptr<ParsedBatch>,
+                                            std::list<std::unique_ptr<ParsedBatch>>>;
+        batch_queue_type take_batches();
+
+        /* Whether there are unparsed chunks, unapplied batches, or a
+         * parse in flight. */
+        bool has_work();
+
+        /* Discards all queued work and resets the decoder and parser,
+         * synchronously. */
+        void reset();
+
+private:
+        static gpointer thread_func(gpointer data);
+        void run();
+        void feed(ParsedBatch* batch,
+                  uint32_t codepoint);
+        std::unique_ptr<ParsedBatch> parse_chunk(Chunk::unique_type chunk);
+
+        /* Only touched by the parser thread while a parse is in flight,
+         * and under the mutex otherwise. */
+        UTF8Decoder m_decoder{};
+        vte_parser_t m_parser;
+
+        GThread* m_thread{nullptr};
+        GMutex m_mutex;
+        GCond m_cond;
+
+        /* All of the below are guarded by m_mutex. */
+        bool m_quit{false};
+        bool m_parsing{false};
+        std::queue<Chunk::unique_type, std::list<Chunk::unique_type>> m_chunks;
+        batch_queue_type m_batches;
+
+}; // class ParserThread
+
+} // namespace base
+
+} // namespace vte
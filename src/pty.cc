@@ -108,8 +108,17 @@ struct _VtePtyPrivate {
 
         VtePtyChildSetupData child_setup_data;
 
+        /* Coalesced TIOCSWINSZ: while size_coalescing is set, size
+         * updates within the quiet interval only record a pending size;
+         * see vte_pty_set_size_coalescing(). */
+        guint size_flush_source;
+        int pending_rows;
+        int pending_columns;
+
         guint utf8 : 1;
         guint foreign : 1;
+        guint size_coalescing : 1;
+        guint size_pending : 1;
 };
 
 struct _VtePtyClass {
@@ -475,32 +484,16 @@ __vte_pty_spawn (VtePty *pty,
         return FALSE;
 }
 
-/**
- * vte_pty_set_size:
- * @pty: a #VtePty
- * @rows: the desired number of rows
- * @columns: the desired number of columns
- * @error: (allow-none): return location to store a #GError, or %NULL
- *
- * Attempts to resize the pseudo terminal's window size.  If successful, the
- * OS kernel will send #SIGWINCH to the child process group.
- *
- * If setting the window size failed, @error will be set to a #GIOError.
- *
- * Returns: %TRUE on success, %FALSE on failure with @error filled in
- */
-gboolean
-vte_pty_set_size(VtePty *pty,
-                 int rows,
-                 int columns,
-                 GError **error)
+static gboolean
+vte_pty_set_size_real(VtePty *pty,
+                      int rows,
+                      int columns,
+                      GError **error)
 {
 	struct winsize size;
         int master;
 	int ret;
 
-        g_return_val_if_fail(VTE_IS_PTY(pty), FALSE);
-
         master = vte_pty_get_fd(pty);
 
 	memset(&size, 0, sizeof(size));
@@ -527,6 +520,162 @@ vte_pty_set_size(VtePty *pty,
         return TRUE;
 }
 
+/* How long after the last absorbed update the pending size is applied */
+#define VTE_PTY_SIZE_COALESCE_TIMEOUT 100 /* ms */
+
+static gboolean
+vte_pty_size_flush_cb(gpointer data)
+{
+        VtePty *pty = VTE_PTY(data);
+        VtePtyPrivate *priv = pty->priv;
+
+        priv->size_flush_source = 0;
+
+        if (priv->size_pending) {
+                GError *err = NULL;
+
+                priv->size_pending = FALSE;
+                if (!vte_pty_set_size_real(pty,
+                                           priv->pending_rows,
+                                           priv->pending_columns,
+                                           &err)) {
+                        _vte_debug_print(VTE_DEBUG_PTY,
+                                         "Deferred size update failed: %s\n",
+                                         err->message);
+                        g_error_free(err);
+                }
+        }
+
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * vte_pty_set_size_coalescing:
+ * @pty: a #VtePty
+ * @enable: whether to coalesce size updates
+ *
+ * Enables or disables coalescing of vte_pty_set_size() calls.
+ *
+ * While enabled, the first size update is applied to the PTY right away,
+ * and further updates arriving within a short quiet interval only record
+ * the most recent size, which is applied once the updates pause or when
+ * vte_pty_flush_size() is called.  Since every applied update makes the
+ * kernel deliver %SIGWINCH to the child's foreground process group, this
+ * keeps interactive resizes from flooding the child with resize signals.
+ *
+ * Note that while coalescing is enabled, an absorbed vte_pty_set_size()
+ * call reports success; an error from the deferred resize is not
+ * reported to the caller.
+ *
+ * Disabling coalescing flushes any pending size update.
+ *
+ * Since: 0.60
+ */
+void
+vte_pty_set_size_coalescing(VtePty *pty,
+                            gboolean enable)
+{
+        VtePtyPrivate *priv;
+
+        g_return_if_fail(VTE_IS_PTY(pty));
+
+        priv = pty->priv;
+        if (priv->size_coalescing == !!enable)
+                return;
+
+        priv->size_coalescing = !!enable;
+        if (!enable)
+                vte_pty_flush_size(pty, NULL);
+}
+
+/**
+ * vte_pty_flush_size:
+ * @pty: a #VtePty
+ * @error: (allow-none): return location to store a #GError, or %NULL
+ *
+ * Applies a size update held back by coalescing (see
+ * vte_pty_set_size_coalescing()) immediately.  Does nothing if no
+ * update is pending.
+ *
+ * Returns: %TRUE on success, %FALSE on failure with @error filled in
+ *
+ * Since: 0.60
+ */
+gboolean
+vte_pty_flush_size(VtePty *pty,
+                   GError **error)
+{
+        VtePtyPrivate *priv;
+
+        g_return_val_if_fail(VTE_IS_PTY(pty), FALSE);
+
+        priv = pty->priv;
+        if (priv->size_flush_source != 0) {
+                g_source_remove(priv->size_flush_source);
+                priv->size_flush_source = 0;
+        }
+
+        if (!priv->size_pending)
+                return TRUE;
+
+        priv->size_pending = FALSE;
+        return vte_pty_set_size_real(pty,
+                                     priv->pending_rows,
+                                     priv->pending_columns,
+                                     error);
+}
+
+/**
+ * vte_pty_set_size:
+ * @pty: a #VtePty
+ * @rows: the desired number of rows
+ * @columns: the desired number of columns
+ * @error: (allow-none): return location to store a #GError, or %NULL
+ *
+ * Attempts to resize the pseudo terminal's window size.  If successful, the
+ * OS kernel will send #SIGWINCH to the child process group.
+ *
+ * If setting the window size failed, @error will be set to a #GIOError.
+ *
+ * If coalescing has been enabled with vte_pty_set_size_coalescing(),
+ * the update may be held back and applied later; see there.
+ *
+ * Returns: %TRUE on success, %FALSE on failure with @error filled in
+ */
+gboolean
+vte_pty_set_size(VtePty *pty,
+                 int rows,
+                 int columns,
+                 GError **error)
+{
+        VtePtyPrivate *priv;
+
+        g_return_val_if_fail(VTE_IS_PTY(pty), FALSE);
+
+        priv = pty->priv;
+        if (priv->size_coalescing) {
+                if (priv->size_flush_source != 0) {
+                        /* Absorb: remember the size, restart the quiet
+                         * interval. */
+                        priv->pending_rows = rows;
+                        priv->pending_columns = columns;
+                        priv->size_pending = TRUE;
+                        g_source_remove(priv->size_flush_source);
+                        priv->size_flush_source = g_timeout_add(VTE_PTY_SIZE_COALESCE_TIMEOUT,
+                                                                vte_pty_size_flush_cb,
+                                                                pty);
+                        return TRUE;
+                }
+
+                /* Leading edge: apply right away, open the quiet interval */
+                priv->size_flush_source = g_timeout_add(VTE_PTY_SIZE_COALESCE_TIMEOUT,
+                                                        vte_pty_size_flush_cb,
+                                                        pty);
+        }
+
+        return vte_pty_set_size_real(pty, rows, columns, error);
+}
+
 /**
  * vte_pty_get_size:
  * @pty: a #VtePty
@@ -704,6 +853,72 @@ _vte_pty_open_posix(void)
         return fd.steal();
 }
 
+/* An opt-in pool of pre-opened pty masters, so that opening a new
+ * terminal doesn't pay for posix_openpt() and the follow-up fcntls and
+ * ioctl on its critical path. Set the VTE_PTY_POOL environment variable
+ * to the number of masters to keep warm (at most 16); the pool is
+ * refilled from a low-priority idle callback after each take. Only to
+ * be used from the main thread, like the rest of the VtePty API.
+ */
+
+static GQueue pty_pool = G_QUEUE_INIT;  /* of GINT_TO_POINTER(masterfd) */
+static guint pty_pool_refill_source = 0;
+static int pty_pool_wanted = -1;  /* -1 if VTE_PTY_POOL not read yet */
+
+static int
+pty_pool_wanted_size(void)
+{
+        if (G_UNLIKELY (pty_pool_wanted == -1)) {
+                auto env = g_getenv("VTE_PTY_POOL");
+                pty_pool_wanted = env != nullptr ? CLAMP(atoi(env), 0, 16) : 0;
+        }
+        return pty_pool_wanted;
+}
+
+static gboolean
+pty_pool_refill_cb(gpointer data G_GNUC_UNUSED)
+{
+        while ((int)pty_pool.length < pty_pool_wanted_size()) {
+                int fd = _vte_pty_open_posix();
+                if (fd == -1)
+                        break;
+                _vte_debug_print(VTE_DEBUG_PTY, "Pooling pty master fd %d.\n", fd);
+                g_queue_push_tail(&pty_pool, GINT_TO_POINTER(fd));
+        }
+
+        pty_pool_refill_source = 0;
+        return G_SOURCE_REMOVE;
+}
+
+static void
+pty_pool_schedule_refill(void)
+{
+        if (pty_pool_wanted_size() == 0 ||
+            pty_pool_refill_source != 0)
+                return;
+
+        pty_pool_refill_source = g_idle_add_full(G_PRIORITY_LOW,
+                                                 pty_pool_refill_cb,
+                                                 nullptr,
+                                                 nullptr);
+}
+
+static int
+pty_pool_take(void)
+{
+        if (pty_pool_wanted_size() == 0)
+                return -1;
+
+        pty_pool_schedule_refill();
+
+        if (g_queue_is_empty(&pty_pool))
+                return -1;
+
+        int fd = GPOINTER_TO_INT(g_queue_pop_head(&pty_pool));
+        _vte_debug_print(VTE_DEBUG_PTY, "Using pooled pty master fd %d.\n", fd);
+        return fd;
+}
+
 static int
 _vte_pty_open_foreign(int masterfd /* consumed */)
 {
@@ -813,7 +1028,9 @@ vte_pty_initable_init (GInitable *initable,
         if (priv->foreign) {
                 priv->pty_fd = _vte_pty_open_foreign(priv->pty_fd);
         } else {
-                priv->pty_fd = _vte_pty_open_posix();
+                priv->pty_fd = pty_pool_take();
+                if (priv->pty_fd == -1)
+                        priv->pty_fd = _vte_pty_open_posix();
         }
 
         if (priv->pty_fd == -1) {
@@ -856,6 +1073,9 @@ vte_pty_finalize (GObject *object)
         VtePty *pty = VTE_PTY (object);
         VtePtyPrivate *priv = pty->priv;
 
+        if (priv->size_flush_source != 0)
+                g_source_remove(priv->size_flush_source);
+
         /* Close the master FD */
         if (priv->pty_fd != -1) {
                 close(priv->pty_fd);
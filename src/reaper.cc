@@ -18,6 +18,15 @@
 
 #include "config.h"
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+#endif
+
 #include "debug.h"
 #include "reaper.hh"
 
@@ -54,6 +63,82 @@ vte_reaper_child_watch_cb(GPid pid,
         g_spawn_close_pid (pid);
 }
 
+#if defined(__linux__) && defined(SYS_pidfd_open)
+
+/* pidfd backend: one fd per child, polled on the main context. The fd
+ * becomes readable exactly when that child exits, so there is no
+ * SIGCHLD juggling and no per-signal scan over all watches, and the
+ * wakeup is O(1) per child.
+ */
+
+typedef struct {
+        GPid pid;
+        int fd;
+        VteReaper *reaper;
+} VteReaperPidfdData;
+
+static void
+vte_reaper_pidfd_data_free(VteReaperPidfdData *data)
+{
+        close(data->fd);
+        g_object_unref(data->reaper);
+        g_free(data);
+}
+
+static gboolean
+vte_reaper_pidfd_cb(int fd,
+                    GIOCondition condition,
+                    gpointer user_data)
+{
+        VteReaperPidfdData *data = (VteReaperPidfdData*)user_data;
+        int status = 0;
+        pid_t rv;
+
+        /* The child has exited; reap it. */
+        rv = waitpid(data->pid, &status, WNOHANG);
+        if (rv == 0)
+                return G_SOURCE_CONTINUE;
+        if (rv == -1) {
+                /* Reaped elsewhere; emit with a zero status rather than
+                 * leaving the listeners waiting forever. */
+                _vte_debug_print(VTE_DEBUG_SIGNALS,
+                                 "Reaper failed to wait for pid %d.\n",
+                                 (int)data->pid);
+                status = 0;
+        }
+
+        _vte_debug_print(VTE_DEBUG_SIGNALS,
+                         "Reaper emitting child-exited signal.\n");
+        g_signal_emit_by_name(data->reaper, "child-exited", data->pid, status);
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean
+vte_reaper_add_child_pidfd(GPid pid)
+{
+        VteReaperPidfdData *data;
+        int fd;
+
+        fd = (int)syscall(SYS_pidfd_open, (pid_t)pid, 0);
+        if (fd == -1)
+                return FALSE; /* ENOSYS on pre-5.3 kernels, EMFILE, ... */
+
+        data = g_new(VteReaperPidfdData, 1);
+        data->pid = pid;
+        data->fd = fd;
+        data->reaper = vte_reaper_ref();
+
+        g_unix_fd_add_full(G_PRIORITY_LOW,
+                           fd,
+                           G_IO_IN,
+                           vte_reaper_pidfd_cb,
+                           data,
+                           (GDestroyNotify)vte_reaper_pidfd_data_free);
+        return TRUE;
+}
+
+#endif /* __linux__ && SYS_pidfd_open */
+
 /*
  * vte_reaper_add_child:
  * @pid: the ID of a child process which will be monitored
@@ -63,6 +148,11 @@ vte_reaper_child_watch_cb(GPid pid,
 void
 vte_reaper_add_child(GPid pid)
 {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+        if (vte_reaper_add_child_pidfd(pid))
+                return;
+#endif
+
         g_child_watch_add_full(G_PRIORITY_LOW,
                                pid,
                                vte_reaper_child_watch_cb,
@@ -22,18 +22,14 @@
 
 #include "debug.h"
 #include "ring.hh"
+#include "stats.hh"
 #include "vterowdata.hh"
 
 #include <string.h>
 
-/*
- * Copy the common attributes from VteCellAttr to VteStreamCellAttr or vice versa.
- */
-static inline void
-_attrcpy (void *dst, void *src)
-{
-        memcpy(dst, src, VTE_CELL_ATTR_COMMON_BYTES);
-}
+/* How many rows freeze_row() may stage before freeze_flush() pushes them
+ * to the streams in a single append per stream. */
+#define VTE_FREEZE_BATCH_ROWS 64
 
 using namespace vte::base;
 
@@ -74,17 +70,29 @@ Ring::Ring(row_t max_rows,
 		m_attr_stream = _vte_file_stream_new ();
 		m_text_stream = _vte_file_stream_new ();
 		m_row_stream = _vte_file_stream_new ();
+		m_freeze_text_buffer = g_string_sized_new (1024);
+		m_freeze_attr_buffer = g_string_sized_new (128);
+		m_freeze_row_buffer = g_string_sized_new (VTE_FREEZE_BATCH_ROWS * sizeof (RowRecord));
 	} else {
 		m_attr_stream = m_text_stream = m_row_stream = nullptr;
+		m_freeze_text_buffer = m_freeze_attr_buffer = m_freeze_row_buffer = nullptr;
 	}
 
 	m_utf8_buffer = g_string_sized_new (128);
 
-	_vte_row_data_init (&m_cached_row);
+	for (size_t i = 0; i < VTE_RING_CACHED_ROWS; i++) {
+		_vte_row_data_init (&m_cached_row[i]);
+		m_cached_row_num[i] = (row_t)-1;
+		m_cached_row_stamp[i] = 0;
+	}
 
         m_hyperlinks = g_ptr_array_new();
         auto empty_str = g_string_new_len("", 0);
         g_ptr_array_add(m_hyperlinks, empty_str);
+        m_hyperlink_index = g_hash_table_new(g_str_hash, g_str_equal);
+
+        m_color_triples = g_ptr_array_new();
+        m_color_triple_index = g_hash_table_new(g_int64_hash, g_int64_equal);
 
 	validate();
 }
@@ -100,15 +108,24 @@ Ring::~Ring()
 		g_object_unref (m_attr_stream);
 		g_object_unref (m_text_stream);
 		g_object_unref (m_row_stream);
+		g_string_free (m_freeze_text_buffer, TRUE);
+		g_string_free (m_freeze_attr_buffer, TRUE);
+		g_string_free (m_freeze_row_buffer, TRUE);
 	}
 
 	g_string_free (m_utf8_buffer, TRUE);
 
+        g_hash_table_destroy (m_hyperlink_index);
         for (size_t i = 0; i < m_hyperlinks->len; i++)
                 g_string_free (hyperlink_get(i), TRUE);
         g_ptr_array_free (m_hyperlinks, TRUE);
 
-	_vte_row_data_fini(&m_cached_row);
+        color_triples_clear ();
+        g_hash_table_destroy (m_color_triple_index);
+        g_ptr_array_free (m_color_triples, TRUE);
+
+	for (size_t i = 0; i < VTE_RING_CACHED_ROWS; i++)
+		_vte_row_data_fini(&m_cached_row[i]);
 }
 
 #define SET_BIT(buf, n) buf[(n) / 8] |= (1 << ((n) % 8))
@@ -147,6 +164,7 @@ Ring::hyperlink_gc()
 
         for (i = m_writable; i < m_end; i++) {
                 row = get_writable_index(i);
+                _vte_row_data_materialize(row);
                 for (j = 0; j < row->len; j++) {
                         idx = row->cells[j].attr.hyperlink_idx;
                         SET_BIT(used, idx);
@@ -158,6 +176,7 @@ Ring::hyperlink_gc()
                         _vte_debug_print (VTE_DEBUG_HYPERLINK,
                                           "hyperlink: GC purging link %d to id;uri=\"%s\"\n",
                                           idx, hyperlink_get(idx)->str);
+                        g_hash_table_remove (m_hyperlink_index, hyperlink_get(idx)->str);
                         /* Wipe out the ID and URI itself so it doesn't linger on in the memory for a long time */
                         memset(hyperlink_get(idx)->str, 0, hyperlink_get(idx)->len);
                         g_string_truncate (hyperlink_get(idx), 0);
@@ -168,6 +187,8 @@ Ring::hyperlink_gc()
                m_hyperlink_highest_used_idx--;
         }
 
+        m_hyperlink_len_at_gc = m_hyperlinks->len;
+
         _vte_debug_print (VTE_DEBUG_HYPERLINK,
                           "hyperlink: GC done (highest used idx is now %d)\n",
                           m_hyperlink_highest_used_idx);
@@ -197,8 +218,6 @@ Ring::hyperlink_maybe_gc(row_t increment)
  * Returns 0 if given no hyperlink or an empty one, or if the pool is full.
  * Returns the idx (either already existing or newly allocated) from 1 up to
  * VTE_HYPERLINK_COUNT_MAX inclusive otherwise.
- *
- * FIXME do something more effective than a linear search
  */
 Ring::hyperlink_idx_t
 Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
@@ -206,27 +225,31 @@ Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
         hyperlink_idx_t idx;
         gsize len;
         GString *str;
+        gpointer value;
 
         if (!hyperlink || !hyperlink[0])
                 return 0;
 
         len = strlen(hyperlink);
 
-        /* Linear search for this particular URI */
-        auto const last_idx = m_hyperlink_highest_used_idx + 1;
-        for (idx = 1; idx < last_idx; ++idx) {
-                if (strcmp(hyperlink_get(idx)->str, hyperlink) == 0) {
-                        _vte_debug_print (VTE_DEBUG_HYPERLINK,
-                                          "get_hyperlink_idx: already existing idx %d for id;uri=\"%s\"\n",
-                                          idx, hyperlink);
-                        return idx;
-                }
+        /* Look up this particular URI in the index */
+        if (g_hash_table_lookup_extended (m_hyperlink_index, hyperlink, nullptr, &value)) {
+                idx = GPOINTER_TO_UINT (value);
+                _vte_debug_print (VTE_DEBUG_HYPERLINK,
+                                  "get_hyperlink_idx: already existing idx %d for id;uri=\"%s\"\n",
+                                  idx, hyperlink);
+                return idx;
         }
 
-        /* FIXME it's the second time we're GCing if coming from get_hyperlink_idx */
-        hyperlink_gc();
+        /* Reclaim slots of links that no longer occur in the ring before growing the
+         * pool further, but only once the pool has doubled since the last GC round:
+         * GCing for every brand new link would walk the entire ring once per OSC 8
+         * sequence in link-dense streams.  The GC triggered by scrolling keeps the
+         * memory bounded in any case. */
+        if (m_hyperlinks->len >= 2 * m_hyperlink_len_at_gc)
+                hyperlink_gc();
 
-        /* Another linear search for an empty slot where a GString is already allocated */
+        /* Linear search for an empty slot where a GString is already allocated */
         for (idx = 1; idx < m_hyperlinks->len; idx++) {
                 if (hyperlink_get(idx)->len == 0) {
                         _vte_debug_print (VTE_DEBUG_HYPERLINK,
@@ -234,6 +257,7 @@ Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
                                           idx, hyperlink);
                         /* Grow size if required, however, never shrink to avoid long-term memory fragmentation. */
                         g_string_append_len (hyperlink_get(idx), hyperlink, len);
+                        g_hash_table_insert (m_hyperlink_index, hyperlink_get(idx)->str, GUINT_TO_POINTER (idx));
                         m_hyperlink_highest_used_idx = MAX (m_hyperlink_highest_used_idx, idx);
                         return idx;
                 }
@@ -257,6 +281,7 @@ Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
                           idx, hyperlink);
         str = g_string_new_len (hyperlink, len);
         g_ptr_array_add(m_hyperlinks, str);
+        g_hash_table_insert (m_hyperlink_index, str->str, GUINT_TO_POINTER (idx));
 
         g_assert_cmpuint(m_hyperlink_highest_used_idx + 1, ==, m_hyperlinks->len);
 
@@ -275,35 +300,263 @@ Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
 Ring::hyperlink_idx_t
 Ring::get_hyperlink_idx(char const* hyperlink)
 {
-        /* Release current idx and do a round of GC to possibly purge its hyperlink,
-         * even if new hyperlink is nullptr or empty. */
+        /* Release current idx, so that its hyperlink can be purged by the next GC
+         * round if it no longer occurs in the ring, even if new hyperlink is
+         * nullptr or empty. */
         m_hyperlink_current_idx = 0;
-        hyperlink_gc();
 
         m_hyperlink_current_idx = get_hyperlink_idx_no_update_current(hyperlink);
         return m_hyperlink_current_idx;
 }
 
+/*
+ * Find the idx of @colors in the interned color triple table, adding it
+ * if not seen before.
+ *
+ * Returns VTE_COLOR_TRIPLE_IDX_INLINE if the table is full; the caller
+ * then stores the triple inline after the attr record.
+ */
+guint16
+Ring::get_color_triple_idx(guint64 colors)
+{
+        gpointer value;
+        guint64 *triple;
+
+        if (g_hash_table_lookup_extended (m_color_triple_index, &colors, nullptr, &value))
+                return GPOINTER_TO_UINT (value);
+
+        if (G_UNLIKELY (m_color_triples->len >= VTE_COLOR_TRIPLE_IDX_INLINE))
+                return VTE_COLOR_TRIPLE_IDX_INLINE;
+
+        triple = g_slice_new (guint64);
+        *triple = colors;
+        g_ptr_array_add (m_color_triples, triple);
+        g_hash_table_insert (m_color_triple_index, triple, GUINT_TO_POINTER (m_color_triples->len - 1));
+
+        _vte_debug_print (VTE_DEBUG_RING,
+                          "Interned color triple %" G_GUINT64_FORMAT " as idx %u.\n",
+                          colors, m_color_triples->len - 1);
+
+        return m_color_triples->len - 1;
+}
+
+void
+Ring::color_triples_clear()
+{
+        g_hash_table_remove_all (m_color_triple_index);
+        for (size_t i = 0; i < m_color_triples->len; i++)
+                g_slice_free (guint64, (guint64 *) g_ptr_array_index (m_color_triples, i));
+        g_ptr_array_set_size (m_color_triples, 0);
+}
+
+/*
+ * Attr stream record format:
+ *
+ * Each record says "these attrs end at @text_end_offset of the text
+ * stream". The fields are stored as unsigned LEB128 varints -- offsets
+ * are large but attr words, color indices and hyperlink lengths are
+ * almost always tiny, so a typical record takes 6-8 bytes instead of
+ * the 18 a fixed layout costs:
+ *
+ *  - varint text_end_offset
+ *  - varint attr (the packed VteCellAttr word)
+ *  - varint colors_idx: an index into the interned color triple table,
+ *    or VTE_COLOR_TRIPLE_IDX_INLINE
+ *  - varint hyperlink_length
+ *  - the raw 8-byte color triple, only if colors_idx is
+ *    VTE_COLOR_TRIPLE_IDX_INLINE because the table was full
+ *  - hyperlink_length bytes of opaque hyperlink data. Only the caller
+ *    cares that if nonempty it contains the ID and URI separated with
+ *    a semicolon. Not NUL terminated.
+ *  - 2 bytes with the total length of all of the above, so that
+ *    truncation can walk backwards
+ *
+ * Records are self-contained rather than delta-coded against their
+ * predecessor: rows enter the stream at arbitrary record boundaries
+ * through their attr_start_offset, and truncation walks it backwards.
+ */
+
+static void
+append_varint(GString* buffer,
+              guint64 value)
+{
+	while (value >= 0x80) {
+		g_string_append_c (buffer, (char)(value | 0x80));
+		value >>= 7;
+	}
+	g_string_append_c (buffer, (char)value);
+}
+
+/* Returns the advanced pointer, or nullptr on truncated/oversized input */
+static guchar const*
+parse_varint(guchar const* p,
+             guchar const* end,
+             guint64* value)
+{
+	guint64 v = 0;
+	unsigned int shift = 0;
+
+	while (p < end && shift < 64) {
+		v |= (guint64)(*p & 0x7f) << shift;
+		if (!(*p++ & 0x80)) {
+			*value = v;
+			return p;
+		}
+		shift += 7;
+	}
+	return nullptr;
+}
+
+/*
+ * Append one attr change record saying that @attr ends at
+ * @text_end_offset to the staging buffer.
+ *
+ * Returns the number of bytes appended.
+ */
+gsize
+Ring::append_attr_change(VteCellAttr const& attr,
+                         gsize text_end_offset)
+{
+	GString *buffer = m_freeze_attr_buffer;
+	gsize const start = buffer->len;
+	guint16 const colors_idx = get_color_triple_idx (attr.colors());
+	GString *hyperlink = hyperlink_get (attr.hyperlink_idx);
+
+	append_varint (buffer, text_end_offset);
+	append_varint (buffer, attr.attr);
+	append_varint (buffer, colors_idx);
+	append_varint (buffer, hyperlink->len);
+	if (G_UNLIKELY (colors_idx == VTE_COLOR_TRIPLE_IDX_INLINE)) {
+		guint64 colors = attr.colors();
+		g_string_append_len (buffer, (char const*) &colors, sizeof (colors));
+	}
+	if (G_UNLIKELY (hyperlink->len != 0))
+		g_string_append_len (buffer, hyperlink->str, hyperlink->len);
+
+	guint16 total_length = buffer->len - start;
+	g_string_append_len (buffer, (char const*) &total_length, 2);
+
+	return buffer->len - start;
+}
+
+/*
+ * Read and decode the attr change record at @offset.
+ *
+ * @colors, if non-null, receives the color triple, resolved through the
+ * interned table or the inline bytes. @hyperlink_readbuf, if non-null,
+ * must hold VTE_HYPERLINK_TOTAL_LENGTH_MAX + 1 bytes and receives the
+ * record's NUL-terminated hyperlink data. @next_offset, if non-null, is
+ * set to the first byte after the record.
+ *
+ * Returns false at or past the stream head, or on a corrupt record.
+ */
+bool
+Ring::read_attr_change(gsize offset,
+                       CellAttrChange* chg,
+                       guint64* colors,
+                       char* hyperlink_readbuf,
+                       gsize* next_offset)
+{
+	guchar buf[4 * 10];
+	guint64 text_end_offset, attr, colors_idx, hyperlink_length;
+
+	gsize const head = _vte_stream_head (m_attr_stream);
+	if (offset >= head)
+		return false;
+
+	gsize const len = MIN (head - offset, sizeof (buf));
+	if (!_vte_stream_read (m_attr_stream, offset, (char *) buf, len))
+		return false;
+
+	guchar const* p = buf;
+	guchar const* const end = buf + len;
+	if (!(p = parse_varint (p, end, &text_end_offset)) ||
+	    !(p = parse_varint (p, end, &attr)) ||
+	    !(p = parse_varint (p, end, &colors_idx)) ||
+	    !(p = parse_varint (p, end, &hyperlink_length)))
+		return false;
+	if (G_UNLIKELY (hyperlink_length > VTE_HYPERLINK_TOTAL_LENGTH_MAX))
+		return false;
+
+	chg->text_end_offset = text_end_offset;
+	chg->attr.attr = attr;
+	chg->attr.colors_idx = colors_idx;
+	chg->attr.hyperlink_length = hyperlink_length;
+
+	offset += p - buf;
+	if (G_UNLIKELY (colors_idx == VTE_COLOR_TRIPLE_IDX_INLINE)) {
+		guint64 inline_colors;
+		if (!_vte_stream_read (m_attr_stream, offset, (char *) &inline_colors, sizeof (inline_colors)))
+			return false;
+		offset += sizeof (inline_colors);
+		if (colors != nullptr)
+			*colors = inline_colors;
+	} else if (colors != nullptr) {
+		if (G_LIKELY (colors_idx < m_color_triples->len)) {
+			*colors = color_triple_get (colors_idx);
+		} else {
+			/* Corrupt stream or snapshot; don't read out of bounds. */
+			*colors = basic_cell.attr.colors();
+		}
+	}
+	if (hyperlink_readbuf != nullptr) {
+		if (hyperlink_length && !_vte_stream_read (m_attr_stream, offset, hyperlink_readbuf, hyperlink_length))
+			return false;
+		hyperlink_readbuf[hyperlink_length] = '\0';
+	}
+
+	if (next_offset != nullptr)
+		*next_offset = offset + hyperlink_length + 2;
+
+	return true;
+}
+
+/*
+ * Decode the attr change record that ends exactly at @end_offset, found
+ * through its trailing length; @start_offset receives where it begins.
+ */
+bool
+Ring::read_attr_change_back(gsize end_offset,
+                            CellAttrChange* chg,
+                            gsize* start_offset)
+{
+	guint16 total_length;
+
+	if (end_offset < 2 ||
+	    !_vte_stream_read (m_attr_stream, end_offset - 2, (char *) &total_length, 2))
+		return false;
+	if (G_UNLIKELY ((gsize)total_length + 2 > end_offset))
+		return false;
+
+	*start_offset = end_offset - 2 - total_length;
+	return read_attr_change (*start_offset, chg, nullptr, nullptr, nullptr);
+}
+
 void
 Ring::freeze_row(row_t position,
                  VteRowData const* row)
 {
 	VteCell *cell;
 	GString *buffer = m_utf8_buffer;
-        GString *hyperlink;
 	int i;
         gboolean froze_hyperlink = FALSE;
 
 	_vte_debug_print (VTE_DEBUG_RING, "Freezing row %lu.\n", position);
+        vte::stats::add(vte::stats::counters.rows_frozen);
+        _vte_trace1(freeze_row, position);
 
         g_assert(m_has_streams);
 
 	RowRecord record;
 	memset(&record, 0, sizeof(record));
-	record.text_start_offset = _vte_stream_head(m_text_stream);
-	record.attr_start_offset = _vte_stream_head(m_attr_stream);
+	/* All offsets are relative to the streams, with whatever is already
+	 * staged (but not yet flushed) accounted for. */
+	record.text_start_offset = _vte_stream_head(m_text_stream) + m_freeze_text_buffer->len;
+	record.attr_start_offset = _vte_stream_head(m_attr_stream) + m_freeze_attr_buffer->len;
 	record.is_ascii = 1;
 
+	_vte_row_data_materialize (row);
+
 	g_string_set_size (buffer, 0);
 	for (i = 0, cell = row->cells; i < row->len; i++, cell++) {
 		VteCellAttr attr;
@@ -322,26 +575,14 @@ Ring::freeze_row(row_t position,
 		 */
 		attr = cell->attr;
 		if (G_LIKELY (!attr.fragment())) {
-			CellAttrChange attr_change;
-                        guint16 hyperlink_length;
-
 			if (memcmp(&m_last_attr, &attr, sizeof (VteCellAttr)) != 0) {
 				m_last_attr_text_start_offset = record.text_start_offset + buffer->len;
-				memset(&attr_change, 0, sizeof (attr_change));
-				attr_change.text_end_offset = m_last_attr_text_start_offset;
-                                _attrcpy(&attr_change.attr, &m_last_attr);
-                                hyperlink = hyperlink_get(m_last_attr.hyperlink_idx);
-                                attr_change.attr.hyperlink_length = hyperlink->len;
-				_vte_stream_append (m_attr_stream, (char const* ) &attr_change, sizeof (attr_change));
-                                if (G_UNLIKELY (hyperlink->len != 0)) {
-                                        _vte_stream_append (m_attr_stream, hyperlink->str, hyperlink->len);
-                                        froze_hyperlink = TRUE;
-                                }
-                                hyperlink_length = attr_change.attr.hyperlink_length;
-                                _vte_stream_append (m_attr_stream, (char const* ) &hyperlink_length, 2);
+                                froze_hyperlink = froze_hyperlink ||
+                                        hyperlink_get(m_last_attr.hyperlink_idx)->len != 0;
+                                gsize const appended = append_attr_change(m_last_attr, m_last_attr_text_start_offset);
 				if (!buffer->len)
 					/* This row doesn't use last_attr, adjust */
-                                        record.attr_start_offset += sizeof (attr_change) + hyperlink_length + 2;
+                                        record.attr_start_offset += appended;
 				m_last_attr = attr;
 			}
 
@@ -351,18 +592,9 @@ Ring::freeze_row(row_t position,
 				attr.set_columns(0);
 				m_last_attr_text_start_offset = record.text_start_offset + buffer->len
 								  + g_unichar_to_utf8 (_vte_unistr_get_base (cell->c), nullptr);
-				memset(&attr_change, 0, sizeof (attr_change));
-				attr_change.text_end_offset = m_last_attr_text_start_offset;
-                                _attrcpy(&attr_change.attr, &m_last_attr);
-                                hyperlink = hyperlink_get(m_last_attr.hyperlink_idx);
-                                attr_change.attr.hyperlink_length = hyperlink->len;
-				_vte_stream_append (m_attr_stream, (char const* ) &attr_change, sizeof (attr_change));
-                                if (G_UNLIKELY (hyperlink->len != 0)) {
-                                        _vte_stream_append (m_attr_stream, hyperlink->str, hyperlink->len);
-                                        froze_hyperlink = TRUE;
-                                }
-                                hyperlink_length = attr_change.attr.hyperlink_length;
-                                _vte_stream_append (m_attr_stream, (char const* ) &hyperlink_length, 2);
+                                froze_hyperlink = froze_hyperlink ||
+                                        hyperlink_get(m_last_attr.hyperlink_idx)->len != 0;
+                                append_attr_change(m_last_attr, m_last_attr_text_start_offset);
 				m_last_attr = attr;
 			}
 
@@ -375,14 +607,53 @@ Ring::freeze_row(row_t position,
 	record.soft_wrapped = row->attr.soft_wrapped;
         record.bidi_flags = row->attr.bidi_flags;
 
-	_vte_stream_append(m_text_stream, buffer->str, buffer->len);
-	append_row_record(&record, position);
+	/* Note which bytes the row contains, so that searching can skip it
+	 * cheaply. Always claim ' ' and '\n': the text reconstructed from the
+	 * thawed cells may contain them for blank regions and row joins even
+	 * if they were never frozen. */
+	record.byteset = (G_GUINT64_CONSTANT(1) << (' ' & 63)) |
+			 (G_GUINT64_CONSTANT(1) << ('\n' & 63));
+	for (gsize j = 0; j < buffer->len; j++)
+		record.byteset |= G_GUINT64_CONSTANT(1) << (((guchar) buffer->str[j]) & 63);
+
+	g_string_append_len (m_freeze_text_buffer, buffer->str, buffer->len);
+	g_string_append_len (m_freeze_row_buffer, (char const* ) &record, sizeof (record));
+
+	if (m_freeze_row_buffer->len >= VTE_FREEZE_BATCH_ROWS * sizeof (record))
+		freeze_flush();
 
         /* After freezing some hyperlinks, do a hyperlink GC. The constant is totally arbitrary, feel free to fine tune. */
         if (froze_hyperlink)
                 hyperlink_maybe_gc(1024);
 }
 
+/*
+ * Push the rows staged by freeze_row() to the streams, in one append per
+ * stream for the whole batch.  Batching amortizes the per-append overhead
+ * (and, in the file streams, the per-block compression and encryption)
+ * during fast scrolling, where freeze_row() runs once per scrolled-out row.
+ *
+ * Every reader of the streams must call this first so that the stream heads
+ * cover all frozen rows again.
+ */
+void
+Ring::freeze_flush()
+{
+	if (G_LIKELY (m_freeze_row_buffer == nullptr || m_freeze_row_buffer->len == 0))
+		return;
+
+	_vte_debug_print (VTE_DEBUG_RING, "Flushing %" G_GSIZE_FORMAT " frozen rows.\n",
+			  m_freeze_row_buffer->len / sizeof (RowRecord));
+
+	_vte_stream_append (m_text_stream, m_freeze_text_buffer->str, m_freeze_text_buffer->len);
+	_vte_stream_append (m_attr_stream, m_freeze_attr_buffer->str, m_freeze_attr_buffer->len);
+	_vte_stream_append (m_row_stream, m_freeze_row_buffer->str, m_freeze_row_buffer->len);
+
+	g_string_set_size (m_freeze_text_buffer, 0);
+	g_string_set_size (m_freeze_attr_buffer, 0);
+	g_string_set_size (m_freeze_row_buffer, 0);
+}
+
 /* If do_truncate (data is placed back from the stream to the ring), real new hyperlink idxs are looked up or allocated.
  *
  * If !do_truncate (data is fetched only to be displayed), hyperlinked cells are given the pseudo idx VTE_HYPERLINK_IDX_TARGET_IN_STREAM,
@@ -399,6 +670,7 @@ Ring::thaw_row(row_t position,
 	RowRecord records[2], record;
 	VteCellAttr attr;
 	CellAttrChange attr_change;
+	guint64 colors;
 	VteCell cell;
 	char const* p, *q, *end;
 	GString *buffer = m_utf8_buffer;
@@ -411,9 +683,13 @@ Ring::thaw_row(row_t position,
         }
 
 	_vte_debug_print (VTE_DEBUG_RING, "Thawing row %lu.\n", position);
+        vte::stats::add(vte::stats::counters.rows_thawed);
+        _vte_trace1(thaw_row, position);
 
         g_assert(m_has_streams);
 
+	freeze_flush();
+
 	_vte_row_data_clear (row);
 
 	attr_change.text_end_offset = 0;
@@ -446,16 +722,12 @@ Ring::thaw_row(row_t position,
                         strcpy(hyperlink_readbuf, hyperlink_get(attr.hyperlink_idx)->str);
 		} else {
 			if (record.text_start_offset >= attr_change.text_end_offset) {
-				if (!_vte_stream_read (m_attr_stream, record.attr_start_offset, (char *) &attr_change, sizeof (attr_change)))
+                                if (!read_attr_change (record.attr_start_offset, &attr_change, &colors,
+                                                       hyperlink_readbuf, &record.attr_start_offset))
 					return;
-				record.attr_start_offset += sizeof (attr_change);
-                                g_assert_cmpuint (attr_change.attr.hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                if (attr_change.attr.hyperlink_length && !_vte_stream_read (m_attr_stream, record.attr_start_offset, hyperlink_readbuf, attr_change.attr.hyperlink_length))
-                                        return;
-                                hyperlink_readbuf[attr_change.attr.hyperlink_length] = '\0';
-                                record.attr_start_offset += attr_change.attr.hyperlink_length + 2;
-
-                                _attrcpy(&attr, &attr_change.attr);
+
+                                attr.attr = attr_change.attr.attr;
+                                attr.set_colors (colors);
                                 attr.hyperlink_idx = 0;
                                 if (G_UNLIKELY (attr_change.attr.hyperlink_length)) {
                                         if (do_truncate) {
@@ -527,35 +799,26 @@ Ring::thaw_row(row_t position,
 		_vte_debug_print (VTE_DEBUG_RING, "Truncating\n");
 		if (records[0].text_start_offset <= m_last_attr_text_start_offset) {
 			/* Check the previous attr record. If its text ends where truncating, this attr record also needs to be removed. */
-                        guint16 hyperlink_length;
-                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
-                                g_assert_cmpuint (hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
-                                        if (records[0].text_start_offset == attr_change.text_end_offset) {
-                                                _vte_debug_print (VTE_DEBUG_RING, "... at attribute change\n");
-                                                attr_stream_truncate_at -= sizeof (attr_change) + hyperlink_length + 2;
-                                        }
-				}
-			}
+                        gsize prev_start_offset;
+                        if (read_attr_change_back (attr_stream_truncate_at, &attr_change, &prev_start_offset)) {
+                                if (records[0].text_start_offset == attr_change.text_end_offset) {
+                                        _vte_debug_print (VTE_DEBUG_RING, "... at attribute change\n");
+                                        attr_stream_truncate_at = prev_start_offset;
+                                }
+                        }
 			/* Reconstruct last_attr from the first record of attr_stream that we cut off,
 			   last_attr_text_start_offset from the last record that we keep. */
-			if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at, (char *) &attr_change, sizeof (attr_change))) {
-                                _attrcpy(&m_last_attr, &attr_change.attr);
+                        if (read_attr_change (attr_stream_truncate_at, &attr_change, &colors, hyperlink_readbuf, nullptr)) {
+                                m_last_attr.attr = attr_change.attr.attr;
+                                m_last_attr.set_colors (colors);
                                 m_last_attr.hyperlink_idx = 0;
-                                if (attr_change.attr.hyperlink_length && _vte_stream_read (m_attr_stream, attr_stream_truncate_at + sizeof (attr_change), (char *) &hyperlink_readbuf, attr_change.attr.hyperlink_length)) {
-                                        hyperlink_readbuf[attr_change.attr.hyperlink_length] = '\0';
+                                if (attr_change.attr.hyperlink_length)
                                         m_last_attr.hyperlink_idx = get_hyperlink_idx(hyperlink_readbuf);
+                                if (read_attr_change_back (attr_stream_truncate_at, &attr_change, &prev_start_offset)) {
+                                        m_last_attr_text_start_offset = attr_change.text_end_offset;
+                                } else {
+                                        m_last_attr_text_start_offset = 0;
                                 }
-                                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
-                                        g_assert_cmpuint (hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
-                                                m_last_attr_text_start_offset = attr_change.text_end_offset;
-                                        } else {
-                                                m_last_attr_text_start_offset = 0;
-                                        }
-				} else {
-					m_last_attr_text_start_offset = 0;
-				}
 			} else {
 				m_last_attr_text_start_offset = 0;
 				m_last_attr = basic_cell.attr;
@@ -573,11 +836,20 @@ Ring::reset_streams(row_t position)
 	_vte_debug_print (VTE_DEBUG_RING, "Reseting streams to %lu.\n", position);
 
 	if (m_has_streams) {
+		/* Anything still staged in the freeze buffers lies before
+		 * @position and becomes unreachable after the reset; just
+		 * drop it unwritten. */
+		g_string_set_size (m_freeze_text_buffer, 0);
+		g_string_set_size (m_freeze_attr_buffer, 0);
+		g_string_set_size (m_freeze_row_buffer, 0);
+
 		_vte_stream_reset(m_row_stream, position * sizeof(RowRecord));
                 _vte_stream_reset(m_text_stream, _vte_stream_head(m_text_stream));
                 _vte_stream_reset(m_attr_stream, _vte_stream_head(m_attr_stream));
 	}
 
+	color_triples_clear ();
+
 	m_last_attr_text_start_offset = 0;
 	m_last_attr = basic_cell.attr;
 }
@@ -589,24 +861,78 @@ Ring::reset()
 
         reset_streams(m_end);
         m_start = m_writable = m_end;
-        m_cached_row_num = (row_t)-1;
+        drop_cached_rows();
 
         return m_end;
 }
 
+void
+Ring::drop_cached_rows()
+{
+	for (unsigned int i = 0; i < VTE_RING_CACHED_ROWS; i++)
+		m_cached_row_num[i] = (row_t)-1;
+}
+
+/* Return the least recently used cache slot, invalidated; the caller may
+ * thaw into it without the result becoming discoverable via index(). */
+VteRowData*
+Ring::oldest_cached_row()
+{
+	unsigned int i, oldest = 0;
+
+	for (i = 1; i < VTE_RING_CACHED_ROWS; i++)
+		if (m_cached_row_stamp[i] < m_cached_row_stamp[oldest])
+			oldest = i;
+
+	m_cached_row_num[oldest] = (row_t)-1;
+	return &m_cached_row[oldest];
+}
+
 VteRowData const*
 Ring::index(row_t position)
 {
+	unsigned int i;
+	VteRowData* row;
+
 	if (G_LIKELY (position >= m_writable))
 		return get_writable_index(position);
 
-	if (m_cached_row_num != position) {
-		_vte_debug_print(VTE_DEBUG_RING, "Caching row %lu.\n", position);
-                thaw_row(position, &m_cached_row, false, -1, nullptr);
-		m_cached_row_num = position;
+	for (i = 0; i < VTE_RING_CACHED_ROWS; i++) {
+		if (m_cached_row_num[i] == position) {
+			m_cached_row_stamp[i] = ++m_cached_row_clock;
+			return &m_cached_row[i];
+		}
 	}
 
-	return &m_cached_row;
+	_vte_debug_print(VTE_DEBUG_RING, "Caching row %lu.\n", position);
+	row = oldest_cached_row();
+	thaw_row(position, row, false, -1, nullptr);
+	m_cached_row_num[row - m_cached_row] = position;
+	m_cached_row_stamp[row - m_cached_row] = ++m_cached_row_clock;
+
+	return row;
+}
+
+/*
+ * Ring::prefetch:
+ *
+ * Warm the thaw cache with the frozen rows in [@start, @end), so that a
+ * scroll about to bring them on screen finds them already thawed. Rows
+ * already cached are only touched on the LRU clock; everything else is
+ * thawed through index(). Capped at the cache size so prefetching can
+ * never evict what it just brought in.
+ */
+void
+Ring::prefetch(row_t start, row_t end)
+{
+	row_t position;
+
+	start = MAX(start, m_start);
+	end = MIN(end, m_writable);
+	end = MIN(end, start + VTE_RING_CACHED_ROWS);
+
+	for (position = start; position < end; position++)
+		index(position);
 }
 
 bool
@@ -625,11 +951,39 @@ Ring::is_soft_wrapped(row_t position)
 
         /* The row is scrolled out to the stream. Save work by not reading the actual row.
          * The requested information is readily available in row_stream, too. */
+        freeze_flush();
         if (G_UNLIKELY (!read_row_record(&record, position)))
                 return false;
         return record.soft_wrapped;
 }
 
+/*
+ * Whether any of the rows in [start, end) might contain one of the bytes in
+ * @byteset (a bitmap with bit (1 << (byte & 63)) set for each byte), judged
+ * from the coarse per-row bitmaps collected in freeze_row(). May err towards
+ * TRUE: writable or unreadable rows are always possible matches, and distinct
+ * bytes can share a bit. Never returns FALSE for a row that contains one of
+ * the bytes, so search can safely skip such rows without thawing them.
+ */
+bool
+Ring::rows_maybe_match(row_t start, row_t end, guint64 byteset)
+{
+	RowRecord record;
+	row_t i;
+
+	freeze_flush();
+
+	for (i = start; i < end; i++) {
+		if (i >= m_writable || i < m_start)
+			return true;
+		if (G_UNLIKELY (!read_row_record(&record, i)))
+			return true;
+		if (record.byteset & byteset)
+			return true;
+	}
+	return false;
+}
+
 /*
  * Returns the hyperlink idx at the given position.
  *
@@ -658,7 +1012,7 @@ Ring::get_hyperlink_at_position(row_t position,
 
         if (update_hover_idx) {
                 /* Invalidate the cache because new hover idx might result in new idxs to report. */
-                m_cached_row_num = (row_t)-1;
+                drop_cached_rows();
         }
 
         if (G_UNLIKELY (!contains(position) || col < 0)) {
@@ -674,10 +1028,11 @@ Ring::get_hyperlink_at_position(row_t position,
                                 m_hyperlink_hover_idx = 0;
                         return 0;
                 }
+                _vte_row_data_materialize(row);
                 *hyperlink = hyperlink_get(row->cells[col].attr.hyperlink_idx)->str;
                 idx = row->cells[col].attr.hyperlink_idx;
         } else {
-                thaw_row(position, &m_cached_row, false, col, hyperlink);
+                thaw_row(position, oldest_cached_row(), false, col, hyperlink);
                 /* Note: Intentionally don't set cached_row_num. We're about to update
                  * m_hyperlink_hover_idx which makes some idxs no longer valid. */
                 idx = get_hyperlink_idx_no_update_current(*hyperlink);
@@ -721,8 +1076,9 @@ Ring::thaw_one_row()
 
 	m_writable--;
 
-	if (m_writable == m_cached_row_num)
-		m_cached_row_num = (row_t)-1; /* Invalidate cached row */
+	for (unsigned int i = 0; i < VTE_RING_CACHED_ROWS; i++)
+		if (m_cached_row_num[i] == m_writable)
+			m_cached_row_num[i] = (row_t)-1; /* Invalidate cached row */
 
 	row = get_writable_index(m_writable);
         thaw_row(m_writable, row, true, -1, nullptr);
@@ -736,6 +1092,7 @@ Ring::discard_one_row()
 		reset_streams(m_writable);
 	} else if (m_start < m_writable) {
 		RowRecord record;
+		freeze_flush();
 		_vte_stream_advance_tail(m_row_stream, m_start * sizeof (record));
 		if (G_LIKELY(read_row_record(&record, m_start))) {
 			_vte_stream_advance_tail(m_text_stream, record.text_start_offset);
@@ -935,6 +1292,79 @@ Ring::remove(row_t position)
         validate();
 }
 
+/**
+ * Ring::rotate:
+ * @position: the first row of the region
+ * @end_position: the last row of the region (inclusive)
+ * @count: the number of rows to rotate by; positive rotates towards
+ *   higher positions (scroll down), negative towards lower (scroll up)
+ *
+ * Rotates the rows in [@position, @end_position] by @count, recycling
+ * the rows that wrap around as new, empty rows with @bidi_flags.  This
+ * is equivalent to @count iterations of remove() at one end of the
+ * region and insert() at the other, but swaps each row struct only once
+ * instead of shuffling the whole writable window per iteration.
+ *
+ * The region must already be filled, i.e. @end_position < next().
+ */
+void
+Ring::rotate(row_t position, row_t end_position, long count, guint8 bidi_flags)
+{
+	row_t i, n, shift;
+
+	_vte_debug_print(VTE_DEBUG_RING, "Rotating rows %lu..%lu by %ld.\n",
+			 position, end_position, count);
+	validate();
+
+	g_assert_cmpuint (position, <=, end_position);
+
+	ensure_writable(position);
+
+	g_assert_cmpuint (position, >=, m_writable);
+	g_assert_cmpuint (end_position, <, m_end);
+
+	n = end_position - position + 1;
+	shift = count > 0 ? count : -count;
+	if (G_LIKELY (shift < n)) {
+		/* Classic three-reversal rotation, on the circular array. */
+		auto reverse = [this](row_t a, row_t b) {
+			VteRowData tmp;
+			while (a < b) {
+				tmp = *get_writable_index(a);
+				*get_writable_index(a) = *get_writable_index(b);
+				*get_writable_index(b) = tmp;
+				a++, b--;
+			}
+		};
+		row_t head = count > 0 ? shift : n - shift;
+		reverse(position, end_position);
+		reverse(position, position + head - 1);
+		reverse(position + head, end_position);
+	} else {
+		/* Rotating by at least the region's height replaces all
+		 * of its contents; don't let the rotation wrap old rows
+		 * back into view. */
+		shift = n;
+	}
+
+	/* Clear the recycled rows. */
+	if (count > 0) {
+		for (i = position; i < position + shift; i++) {
+			VteRowData* row = get_writable_index(i);
+			_vte_row_data_clear (row);
+			row->attr.bidi_flags = bidi_flags;
+		}
+	} else {
+		for (i = end_position - shift + 1; i <= end_position; i++) {
+			VteRowData* row = get_writable_index(i);
+			_vte_row_data_clear (row);
+			row->attr.bidi_flags = bidi_flags;
+		}
+	}
+
+	validate();
+}
+
 
 /**
  * Ring::append:
@@ -968,6 +1398,42 @@ Ring::drop_scrollback(row_t position)
         reset_streams(position);
 }
 
+/**
+ * Ring::drop_oldest:
+ * @n: how many rows to drop
+ *
+ * Drops up to @n of the oldest frozen scrollback rows and advances the
+ * stream tails accordingly, reclaiming their storage.  Rows in the
+ * writable (on-screen) region are never dropped.  This is the eviction
+ * primitive of the process-wide scrollback budget; see
+ * Terminal::enforce_scrollback_budget().
+ */
+void
+Ring::drop_oldest(row_t n)
+{
+	while (n-- > 0 && m_start < m_writable)
+		discard_one_row();
+
+	validate();
+}
+
+/**
+ * Ring::storage_size:
+ *
+ * Returns: the number of bytes the ring currently occupies in its backing
+ * streams, i.e. the scrollback's share of memory and tmpfs.
+ */
+gsize
+Ring::storage_size() const
+{
+	if (!m_has_streams)
+		return 0;
+
+	return (_vte_stream_head(m_text_stream) - _vte_stream_tail(m_text_stream)) +
+	       (_vte_stream_head(m_row_stream) - _vte_stream_tail(m_row_stream)) +
+	       (_vte_stream_head(m_attr_stream) - _vte_stream_tail(m_attr_stream));
+}
+
 /**
  * Ring::set_visible_rows:
  * @rows: the number of visible rows
@@ -983,6 +1449,39 @@ Ring::set_visible_rows(row_t rows)
 }
 
 
+/*
+ * Ring::text_offset_to_row:
+ *
+ * Find the frozen row whose text span contains @text_offset.
+ *
+ * Each RowRecord stores its row's cumulative starting offset in the
+ * text stream, and the row stream is directly addressable by row
+ * number, so it doubles as a dense offset index: the containing row is
+ * found by binary search over [m_start, m_writable).
+ *
+ * Returns: %FALSE on a stream read error
+ */
+bool
+Ring::text_offset_to_row(gsize text_offset,
+                         row_t* row)
+{
+	RowRecord record;
+	row_t lo = m_start, hi = m_writable;
+
+	while (hi - lo > 1) {
+		row_t mid = lo + (hi - lo) / 2;
+		if (!read_row_record(&record, mid))
+			return false;
+		if (record.text_start_offset <= text_offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	*row = lo;
+	return true;
+}
+
+
 /* Convert a (row,col) into a CellTextOffset.
  * Requires the row to be frozen, or be outsize the range covered by the ring.
  */
@@ -997,6 +1496,8 @@ Ring::frozen_row_column_to_text_offset(row_t position,
 	VteRowData const* row;
 	unsigned int i, num_chars, off;
 
+	freeze_flush();
+
 	if (position >= m_end) {
 		offset->text_offset = _vte_stream_head(m_text_stream) + position - m_end;
 		offset->fragment_cells = 0;
@@ -1029,6 +1530,7 @@ Ring::frozen_row_column_to_text_offset(row_t position,
 		buffer->len--;
 
 	row = index(position);
+	_vte_row_data_materialize (row);
 
 	/* row and buffer now contain the same text, in different representation */
 
@@ -1075,6 +1577,8 @@ Ring::frozen_row_text_offset_to_column(row_t position,
 	VteRowData const* row;
 	unsigned int i, off, num_chars, nc;
 
+	freeze_flush();
+
 	if (position >= m_end) {
 		*column = offset->eol_cells;
 		return true;
@@ -1107,6 +1611,7 @@ Ring::frozen_row_text_offset_to_column(row_t position,
 		buffer->len--;
 
 	row = index(position);
+	_vte_row_data_materialize (row);
 
 	/* row and buffer now contain the same text, in different representation */
 
@@ -1162,6 +1667,7 @@ Ring::rewrap(column_t columns,
 	gsize paragraph_end_text_offset;
 	gsize paragraph_len;  /* excluding trailing '\n' */
 	gsize attr_offset;
+	gsize attr_next_offset = 0;
 	gsize old_ring_end;
 
 	if (G_UNLIKELY(length() == 0))
@@ -1174,6 +1680,7 @@ Ring::rewrap(column_t columns,
 	   duplicate the code for frozen and thawed rows. */
 	while (m_writable < m_end)
 		freeze_one_row();
+	freeze_flush();
 
 	/* For markers given as (row,col) pairs find their offsets in the text stream.
 	   This code requires that the rows are already frozen. */
@@ -1185,7 +1692,6 @@ Ring::rewrap(column_t columns,
 		/* Convert visual column into byte offset */
 		if (!frozen_row_column_to_text_offset(markers[i]->row, markers[i]->col, &marker_text_offsets[i]))
 			goto err;
-		new_markers[i].row = new_markers[i].col = -1;
 		_vte_debug_print(VTE_DEBUG_RING,
 				"Marker #%d old coords:  row %ld  col %ld  ->  text_offset %" G_GSIZE_FORMAT " fragment_cells %d  eol_cells %d\n",
 				i, markers[i]->row, markers[i]->col, marker_text_offsets[i].text_offset,
@@ -1200,8 +1706,9 @@ Ring::rewrap(column_t columns,
 	new_row_index = 0;
 
 	attr_offset = old_record.attr_start_offset;
-	if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
-                _attrcpy(&attr_change.attr, &m_last_attr);
+	if (!read_attr_change(attr_offset, &attr_change, nullptr, nullptr, &attr_next_offset)) {
+                attr_change.attr.attr = m_last_attr.attr;
+                attr_change.attr.colors_idx = 0;
                 attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
 		attr_change.text_end_offset = _vte_stream_head(m_text_stream);
 	}
@@ -1211,6 +1718,7 @@ Ring::rewrap(column_t columns,
 		/* Find the boundaries of the next paragraph */
 		gboolean prev_record_was_soft_wrapped = FALSE;
 		gboolean paragraph_is_ascii = TRUE;
+		guint64 paragraph_byteset = 0;
                 guint8 paragraph_bidi_flags = old_record.bidi_flags;
 		gsize text_offset = paragraph_start_text_offset;
 		RowRecord new_record;
@@ -1223,6 +1731,7 @@ Ring::rewrap(column_t columns,
 		while (old_row_index <= m_end) {
 			prev_record_was_soft_wrapped = old_record.soft_wrapped;
 			paragraph_is_ascii = paragraph_is_ascii && old_record.is_ascii;
+			paragraph_byteset |= old_record.byteset;
 			if (G_LIKELY (old_row_index < m_end)) {
 				if (!read_row_record(&old_record, old_row_index))
 					goto err;
@@ -1248,9 +1757,10 @@ Ring::rewrap(column_t columns,
 		/* Wrap the paragraph */
 		if (attr_change.text_end_offset <= text_offset) {
 			/* Attr change at paragraph boundary, advance to next attr. */
-                        attr_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
-			if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
-                                _attrcpy(&attr_change.attr, &m_last_attr);
+                        attr_offset = attr_next_offset;
+			if (!read_attr_change(attr_offset, &attr_change, nullptr, nullptr, &attr_next_offset)) {
+                                attr_change.attr.attr = m_last_attr.attr;
+                                attr_change.attr.colors_idx = 0;
                                 attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
 				attr_change.text_end_offset = _vte_stream_head(m_text_stream);
 			}
@@ -1259,6 +1769,8 @@ Ring::rewrap(column_t columns,
 		new_record.text_start_offset = text_offset;
 		new_record.attr_start_offset = attr_offset;
 		new_record.is_ascii = paragraph_is_ascii;
+		/* Each new row gets the whole paragraph's byteset; a superset is fine. */
+		new_record.byteset = paragraph_byteset;
                 new_record.bidi_flags = paragraph_bidi_flags;
 
 		while (paragraph_len > 0) {
@@ -1266,9 +1778,10 @@ Ring::rewrap(column_t columns,
 			gsize runlength;  /* number of bytes we process in one run: identical attributes, within paragraph */
 			if (attr_change.text_end_offset <= text_offset) {
 				/* Attr change at line boundary, advance to next attr. */
-                                attr_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
-				if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
-                                        _attrcpy(&attr_change.attr, &m_last_attr);
+                                attr_offset = attr_next_offset;
+				if (!read_attr_change(attr_offset, &attr_change, nullptr, nullptr, &attr_next_offset)) {
+                                        attr_change.attr.attr = m_last_attr.attr;
+                                        attr_change.attr.colors_idx = 0;
                                         attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
 					attr_change.text_end_offset = _vte_stream_head(m_text_stream);
 				}
@@ -1289,14 +1802,6 @@ Ring::rewrap(column_t columns,
 								"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "  soft_wrapped\n",
 								new_row_index,
 								new_record.text_start_offset, new_record.attr_start_offset);
-						for (i = 0; i < num_markers; i++) {
-							if (G_UNLIKELY (marker_text_offsets[i].text_offset >= new_record.text_start_offset &&
-									marker_text_offsets[i].text_offset < text_offset)) {
-								new_markers[i].row = new_row_index;
-								_vte_debug_print(VTE_DEBUG_RING,
-										"      Marker #%d will be here in row %lu\n", i, new_row_index);
-							}
-						}
 						new_row_index++;
 						new_record.text_start_offset = text_offset;
 						new_record.attr_start_offset = attr_offset;
@@ -1336,14 +1841,6 @@ Ring::rewrap(column_t columns,
 				"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "\n",
 				new_row_index,
 				new_record.text_start_offset, new_record.attr_start_offset);
-		for (i = 0; i < num_markers; i++) {
-			if (G_UNLIKELY (marker_text_offsets[i].text_offset >= new_record.text_start_offset &&
-					marker_text_offsets[i].text_offset < paragraph_end_text_offset)) {
-				new_markers[i].row = new_row_index;
-				_vte_debug_print(VTE_DEBUG_RING,
-						"      Marker #%d will be here in row %lu\n", i, new_row_index);
-			}
-		}
 		new_row_index++;
 		paragraph_start_text_offset = paragraph_end_text_offset;
 	}
@@ -1356,13 +1853,15 @@ Ring::rewrap(column_t columns,
 	m_start = 0;
 	if (m_end > m_max)
 		m_start = m_end - m_max;
-	m_cached_row_num = (row_t) -1;
+	drop_cached_rows();
 
 	/* Find the markers. This requires that the ring is already updated. */
 	for (i = 0; i < num_markers; i++) {
-		/* Compute the row for markers beyond the ring */
-		if (new_markers[i].row == -1)
+		if (marker_text_offsets[i].text_offset >= _vte_stream_head(m_text_stream)) {
+			/* Marker beyond the frozen rows; compute its row directly */
 			new_markers[i].row = markers[i]->row - old_ring_end + m_end;
+		} else if (!text_offset_to_row(marker_text_offsets[i].text_offset, &new_markers[i].row))
+			goto err;
 		/* Convert byte offset into visual column */
 		if (!frozen_row_text_offset_to_column(new_markers[i].row, &marker_text_offsets[i], &new_markers[i].col))
 			goto err;
@@ -1392,27 +1891,37 @@ err:
 }
 
 
-bool
-Ring::write_row(GOutputStream* stream,
-                VteRowData* row,
-                VteWriteFlags flags,
-                GCancellable* cancellable,
-                GError** error)
+/* Append @row's text to @buffer the way it would appear in the text stream. */
+void
+Ring::serialize_row(VteRowData* row,
+                    GString* buffer)
 {
 	VteCell *cell;
-	GString *buffer = m_utf8_buffer;
 	int i;
-	gsize bytes_written;
 
 	/* Simple version of the loop in freeze_row().
 	 * TODO Should unify one day */
-	g_string_set_size (buffer, 0);
+	_vte_row_data_materialize (row);
 	for (i = 0, cell = row->cells; i < row->len; i++, cell++) {
 		if (G_LIKELY (!cell->attr.fragment()))
 			_vte_unistr_append_to_string (cell->c, buffer);
 	}
 	if (!row->attr.soft_wrapped)
 		g_string_append_c (buffer, '\n');
+}
+
+bool
+Ring::write_row(GOutputStream* stream,
+                VteRowData* row,
+                VteWriteFlags flags,
+                GCancellable* cancellable,
+                GError** error)
+{
+	GString *buffer = m_utf8_buffer;
+	gsize bytes_written;
+
+	g_string_set_size (buffer, 0);
+	serialize_row (row, buffer);
 
 	return g_output_stream_write_all (stream, buffer->str, buffer->len, &bytes_written, cancellable, error);
 }
@@ -1438,6 +1947,8 @@ Ring::write_contents(GOutputStream* stream,
 
 	_vte_debug_print(VTE_DEBUG_RING, "Writing contents to GOutputStream.\n");
 
+	freeze_flush();
+
 	if (m_start < m_writable)
 	{
 		RowRecord record;
@@ -1479,3 +1990,345 @@ Ring::write_contents(GOutputStream* stream,
 
 	return true;
 }
+
+/*
+ * Ring::write_contents_begin:
+ *
+ * Set up an incremental contents write. The writable region is at most a
+ * screenful, so it is serialized into a buffer up front; the frozen bulk
+ * is only recorded as a pair of text stream offsets, which stay valid
+ * while rows keep freezing since that stream is append-only.
+ *
+ * Return: %TRUE on success, %FALSE if the ring is corrupt
+ */
+bool
+Ring::write_contents_begin(WriteContentsState* state,
+                           VteWriteFlags flags)
+{
+	row_t i;
+
+	_vte_debug_print(VTE_DEBUG_RING, "Starting incremental contents write.\n");
+
+	freeze_flush();
+
+	state->text_offset = 0;
+	state->text_end = 0;
+	state->writable_text = g_string_new(nullptr);
+	state->writable_offset = 0;
+
+	if (m_start < m_writable)
+	{
+		RowRecord record;
+
+		if (!read_row_record(&record, m_start))
+                        //FIXMEchpe g_set_error!!
+			return false;
+
+		state->text_offset = record.text_start_offset;
+		state->text_end = _vte_stream_head(m_text_stream);
+	}
+
+	for (i = m_writable; i < m_end; i++)
+		serialize_row(get_writable_index(i), state->writable_text);
+
+	return true;
+}
+
+/*
+ * Ring::write_contents_step:
+ *
+ * Write at most @max_bytes of the pending contents to @stream.
+ *
+ * Return: -1 on error, 0 if there is more to write, 1 when done
+ */
+int
+Ring::write_contents_step(WriteContentsState* state,
+                          GOutputStream* stream,
+                          gsize max_bytes,
+                          GCancellable* cancellable,
+                          GError** error)
+{
+	char buf[4096];
+	gsize bytes_written;
+
+	while (max_bytes > 0 && state->text_offset < state->text_end)
+	{
+		gsize len = MIN (G_N_ELEMENTS (buf), state->text_end - state->text_offset);
+		len = MIN (len, max_bytes);
+
+		if (!_vte_stream_read (m_text_stream, state->text_offset, buf, len))
+		{
+			/* The scrollback scrolled past this offset while we
+			 * were writing. */
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+					     "Scrollback contents evicted during write");
+			return -1;
+		}
+
+		if (!g_output_stream_write_all (stream, buf, len, &bytes_written,
+						cancellable, error))
+			return -1;
+
+		state->text_offset += len;
+		max_bytes -= len;
+	}
+
+	if (state->text_offset < state->text_end)
+		return 0;
+
+	while (max_bytes > 0 && state->writable_offset < state->writable_text->len)
+	{
+		gsize len = MIN (state->writable_text->len - state->writable_offset, max_bytes);
+
+		if (!g_output_stream_write_all (stream,
+						state->writable_text->str + state->writable_offset,
+						len, &bytes_written, cancellable, error))
+			return -1;
+
+		state->writable_offset += len;
+		max_bytes -= len;
+	}
+
+	return state->writable_offset == state->writable_text->len ? 1 : 0;
+}
+
+void
+Ring::write_contents_end(WriteContentsState* state)
+{
+	if (state->writable_text != nullptr)
+	{
+		g_string_free (state->writable_text, TRUE);
+		state->writable_text = nullptr;
+	}
+}
+
+/* The snapshot format: a fixed header followed by the raw contents of the
+ * row, text and attr streams. It deliberately reuses the in-memory record
+ * layouts, so it is versioned by the magic but not portable across
+ * architectures or vte versions; the reader rejects anything else. */
+#define VTE_SNAPSHOT_MAGIC G_GUINT64_CONSTANT(0x33504e4153455456)  /* "VTESNAP3" */
+
+typedef struct _VteSnapshotHeader {
+	guint64 magic;
+	guint64 start, end;
+	guint64 last_attr_text_start_offset;
+	VteCellAttr last_attr;
+	guint64 stream_tail[3];
+	guint64 stream_head[3];
+	guint64 n_color_triples;
+} VteSnapshotHeader;
+
+/*
+ * Ring::snapshot_write:
+ *
+ * Serialize the entire ring to @stream so that snapshot_restore() can bring
+ * it back after a restart. The writable rows are frozen for the duration so
+ * that the three streams cover all contents, and thawed back afterwards.
+ *
+ * Return: %TRUE on success, %FALSE with @error set otherwise
+ */
+bool
+Ring::snapshot_write(GOutputStream* stream,
+                     GCancellable* cancellable,
+                     GError** error)
+{
+	VteSnapshotHeader header;
+	VteStream *streams[3];
+	char buf[4096];
+	gsize bytes_written, offset, len;
+	row_t old_writable = m_writable;
+	unsigned int i;
+	bool ret = false;
+
+	if (!m_has_streams)
+	{
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Terminal has no scrollback streams");
+		return false;
+	}
+
+	_vte_debug_print(VTE_DEBUG_RING, "Writing snapshot of %lu rows.\n", length());
+
+	while (m_writable < m_end)
+		freeze_one_row();
+	freeze_flush();
+
+	streams[0] = m_row_stream;
+	streams[1] = m_text_stream;
+	streams[2] = m_attr_stream;
+
+	memset(&header, 0, sizeof (header));
+	header.magic = VTE_SNAPSHOT_MAGIC;
+	header.start = m_start;
+	header.end = m_end;
+	header.last_attr_text_start_offset = m_last_attr_text_start_offset;
+	header.last_attr = m_last_attr;
+	/* The hyperlink pool is not part of the snapshot; the restored ring
+	 * must not reference it. */
+	header.last_attr.hyperlink_idx = 0;
+	for (i = 0; i < 3; i++)
+	{
+		header.stream_tail[i] = _vte_stream_tail(streams[i]);
+		header.stream_head[i] = _vte_stream_head(streams[i]);
+	}
+	header.n_color_triples = m_color_triples->len;
+
+	if (!g_output_stream_write_all (stream, &header, sizeof (header),
+					&bytes_written, cancellable, error))
+		goto out;
+
+	/* The color triple table, which the attr stream's records index. */
+	for (i = 0; i < m_color_triples->len; i++)
+	{
+		guint64 triple = color_triple_get (i);
+
+		if (!g_output_stream_write_all (stream, &triple, sizeof (triple),
+						&bytes_written, cancellable, error))
+			goto out;
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		offset = header.stream_tail[i];
+		while (offset < header.stream_head[i])
+		{
+			len = MIN (G_N_ELEMENTS (buf), header.stream_head[i] - offset);
+
+			if (!_vte_stream_read (streams[i], offset, buf, len))
+			{
+                                //FIXMEchpe g_set_error!!
+				goto out;
+			}
+
+			if (!g_output_stream_write_all (stream, buf, len,
+							&bytes_written, cancellable, error))
+				goto out;
+
+			offset += len;
+		}
+	}
+
+	ret = true;
+
+out:
+	ensure_writable(old_writable);
+	return ret;
+}
+
+/*
+ * Ring::snapshot_restore:
+ *
+ * Replace the ring's contents with a snapshot previously written by
+ * snapshot_write(). The restored rows stay frozen in the streams and are
+ * thawed lazily as they are accessed, so the cost of restoring is one bulk
+ * copy of the stream bytes, independent of how they eventually thaw.
+ * Rows beyond the ring's scrollback limit are discarded, oldest first.
+ *
+ * On failure the ring's contents are undefined; the caller should reset().
+ *
+ * Return: %TRUE on success, %FALSE with @error set otherwise
+ */
+bool
+Ring::snapshot_restore(GInputStream* stream,
+                       GCancellable* cancellable,
+                       GError** error)
+{
+	VteSnapshotHeader header;
+	VteStream *streams[3];
+	char buf[4096];
+	gsize bytes_read, offset, len;
+	unsigned int i;
+
+	if (!m_has_streams)
+	{
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Terminal has no scrollback streams");
+		return false;
+	}
+
+	if (!g_input_stream_read_all (stream, &header, sizeof (header),
+				      &bytes_read, cancellable, error))
+		return false;
+
+	if (bytes_read != sizeof (header) ||
+	    header.magic != VTE_SNAPSHOT_MAGIC ||
+	    header.start > header.end ||
+	    header.stream_tail[0] != header.start * sizeof (RowRecord) ||
+	    header.stream_head[0] != header.end * sizeof (RowRecord) ||
+	    header.stream_tail[1] > header.stream_head[1] ||
+	    header.stream_tail[2] > header.stream_head[2] ||
+	    header.n_color_triples >= VTE_COLOR_TRIPLE_IDX_INLINE)
+	{
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Not a valid terminal snapshot");
+		return false;
+	}
+
+	/* Re-intern the snapshot's color triple table, preserving the
+	 * indices the attr stream's records refer to. */
+	color_triples_clear ();
+	for (i = 0; i < header.n_color_triples; i++)
+	{
+		guint64 triple;
+
+		if (!g_input_stream_read_all (stream, &triple, sizeof (triple),
+					      &bytes_read, cancellable, error))
+			return false;
+		if (bytes_read != sizeof (triple))
+		{
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Truncated terminal snapshot");
+			return false;
+		}
+		get_color_triple_idx (triple);
+	}
+
+	_vte_debug_print(VTE_DEBUG_RING, "Restoring snapshot of %" G_GUINT64_FORMAT " rows.\n",
+			 header.end - header.start);
+
+	streams[0] = m_row_stream;
+	streams[1] = m_text_stream;
+	streams[2] = m_attr_stream;
+
+	g_string_set_size (m_freeze_text_buffer, 0);
+	g_string_set_size (m_freeze_attr_buffer, 0);
+	g_string_set_size (m_freeze_row_buffer, 0);
+
+	for (i = 0; i < 3; i++)
+	{
+		_vte_stream_reset(streams[i], header.stream_tail[i]);
+
+		offset = header.stream_tail[i];
+		while (offset < header.stream_head[i])
+		{
+			len = MIN (G_N_ELEMENTS (buf), header.stream_head[i] - offset);
+
+			if (!g_input_stream_read_all (stream, buf, len,
+						      &bytes_read, cancellable, error))
+				return false;
+
+			if (bytes_read != len)
+			{
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+						     "Truncated terminal snapshot");
+				return false;
+			}
+
+			_vte_stream_append(streams[i], buf, len);
+			offset += len;
+		}
+	}
+
+	/* Like reset(), the old writable rows are simply abandoned; their
+	 * array slots are reinitialized when the positions are reused. */
+	m_start = header.start;
+	m_writable = m_end = header.end;
+	m_last_attr_text_start_offset = header.last_attr_text_start_offset;
+	m_last_attr = header.last_attr;
+	drop_cached_rows();
+
+	while (length() > m_max)
+		discard_one_row();
+
+	return true;
+}
@@ -69,12 +69,14 @@ public:
         inline row_t delta() const { return m_start; }
         inline row_t length() const { return m_end - m_start; }
         inline row_t next() const { return m_end; }
+        inline row_t writable() const { return m_writable; }
 
         //FIXMEchpe rename this to at()
         //FIXMEchpe use references not pointers
         VteRowData const* index(row_t position); /* const? */
         VteRowData* index_writable(row_t position);
         bool is_soft_wrapped(row_t position);
+        bool rows_maybe_match(row_t start, row_t end, guint64 byteset);
 
         void hyperlink_maybe_gc(row_t increment);
         hyperlink_idx_t get_hyperlink_idx(char const* hyperlink);
@@ -89,7 +91,10 @@ public:
         VteRowData* insert(row_t position, guint8 bidi_flags);
         VteRowData* append(guint8 bidi_flags);
         void remove(row_t position);
+        void rotate(row_t position, row_t end_position, long count, guint8 bidi_flags);
         void drop_scrollback(row_t position);
+        void drop_oldest(row_t n);
+        gsize storage_size() const;
         void set_visible_rows(row_t rows);
         void rewrap(column_t columns,
                     VteVisualPosition** markers);
@@ -98,6 +103,34 @@ public:
                             GCancellable* cancellable,
                             GError** error);
 
+        /* Incremental interface behind write_contents(), for callers that
+         * must not block the main loop on a large scrollback. begin()
+         * snapshots the dump cheaply, then each step() call pushes at most
+         * max_bytes to the target stream. */
+        struct WriteContentsState {
+                gsize text_offset;      /* next frozen text byte to write */
+                gsize text_end;         /* snapshot of the frozen text head */
+                GString* writable_text; /* the writable rows, pre-serialized */
+                gsize writable_offset;
+        };
+        bool snapshot_write(GOutputStream* stream,
+                            GCancellable* cancellable,
+                            GError** error);
+        bool snapshot_restore(GInputStream* stream,
+                              GCancellable* cancellable,
+                              GError** error);
+
+        void prefetch(row_t start, row_t end);
+
+        bool write_contents_begin(WriteContentsState* state,
+                                  VteWriteFlags flags);
+        int write_contents_step(WriteContentsState* state,
+                                GOutputStream* stream,
+                                gsize max_bytes,
+                                GCancellable* cancellable,
+                                GError** error);
+        void write_contents_end(WriteContentsState* state);
+
 private:
 
         #ifdef VTE_DEBUG
@@ -111,6 +144,13 @@ private:
         void hyperlink_gc();
         hyperlink_idx_t get_hyperlink_idx_no_update_current(char const* hyperlink);
 
+        guint16 get_color_triple_idx(guint64 colors);
+        inline guint64 color_triple_get(guint16 idx) const { return *(guint64 const*)g_ptr_array_index(m_color_triples, idx); }
+        void color_triples_clear();
+
+        /* The decoded, in-memory form of an attr stream record; the
+         * on-stream layout is varint-encoded, see ring.cc above
+         * Ring::append_attr_change(). */
         typedef struct _CellAttrChange {
                 gsize text_end_offset;  /* offset of first character no longer using this attr */
                 VteStreamCellAttr attr;
@@ -119,6 +159,7 @@ private:
         typedef struct _RowRecord {
                 size_t text_start_offset;  /* offset where text of this row begins */
                 size_t attr_start_offset;  /* offset of the first character's attributes */
+                guint64 byteset;          /* coarse bitmap of the bytes occurring in the row's text (bit = byte & 63), lets search skip rows; see rows_maybe_match() */
                 int soft_wrapped: 1;      /* end of line is not '\n' */
                 int is_ascii: 1;          /* for rewrapping speedup: guarantees that line contains 32..126 bytes only. Can be 0 even when ascii only. */
                 guint8 bidi_flags: 4;
@@ -126,6 +167,17 @@ private:
 
         static_assert(std::is_pod<RowRecord>::value, "Ring::RowRecord is not POD");
 
+        gsize append_attr_change(VteCellAttr const& attr,
+                                 gsize text_end_offset);
+        bool read_attr_change(gsize offset,
+                              CellAttrChange* chg,
+                              guint64* colors,
+                              char* hyperlink_readbuf,
+                              gsize* next_offset);
+        bool read_attr_change_back(gsize end_offset,
+                                   CellAttrChange* chg,
+                                   gsize* start_offset);
+
         /* Represents a cell position, see ../doc/rewrap.txt */
         typedef struct _CellTextOffset {
                 size_t text_offset;    /* byte offset in text_stream (or perhaps beyond) */
@@ -144,14 +196,8 @@ private:
                                         sizeof(*record));
         }
 
-        inline void append_row_record(RowRecord const* record,
-                                      row_t position)
-        {
-                _vte_stream_append(m_row_stream,
-                                   (char const*)record,
-                                   sizeof(*record));
-        }
-
+        bool text_offset_to_row(gsize text_offset,
+                                row_t* row);
         bool frozen_row_column_to_text_offset(row_t position,
                                               column_t column,
                                               CellTextOffset* offset);
@@ -159,6 +205,8 @@ private:
                                               CellTextOffset const* offset,
                                               column_t* column);
 
+        void serialize_row(VteRowData* row,
+                           GString* buffer);
         bool write_row(GOutputStream* stream,
                        VteRowData* row,
                        VteWriteFlags flags,
@@ -176,6 +224,7 @@ private:
 
         void freeze_row(row_t position,
                         VteRowData const* row);
+        void freeze_flush();
         void thaw_row(row_t position,
                       VteRowData* row,
                       bool do_truncate,
@@ -183,6 +232,9 @@ private:
                       char const** hyperlink);
         void reset_streams(row_t position);
 
+        void drop_cached_rows();
+        VteRowData* oldest_cached_row();
+
 	row_t m_max;
 	row_t m_start{0};
         row_t m_end{0};
@@ -199,12 +251,11 @@ private:
          *
          * text_stream is the text in UTF-8.
          *
-         * attr_stream contains entries that consist of:
-         *  - a VteCellAttrChange.
-         *  - a string of attr.hyperlink_length length containing the (typically empty) hyperlink data.
-         *    As far as the ring is concerned, this hyperlink data is opaque. Only the caller cares that
-         *    if nonempty, it actually contains the ID and URI separated with a semicolon. Not NUL terminated.
-         *  - 2 bytes repeating attr.hyperlink_length so that we can walk backwards.
+         * attr_stream contains variable-length, varint-encoded attr change
+         * records; see the format description above append_attr_change()
+         * in ring.cc. Rows enter it at arbitrary record boundaries through
+         * their attr_start_offset, and truncation walks it backwards via
+         * each record's trailing length.
          */
 	bool m_has_streams;
 	VteStream *m_attr_stream, *m_text_stream, *m_row_stream;
@@ -212,13 +263,35 @@ private:
 	VteCellAttr m_last_attr;
 	GString *m_utf8_buffer;
 
-	VteRowData m_cached_row;
-	row_t m_cached_row_num{(row_t)-1};
+	/* Staging areas for freeze_row(): rows are serialized into these and
+	 * only hit the streams in batches; see freeze_flush(). */
+	GString *m_freeze_text_buffer;
+	GString *m_freeze_attr_buffer;
+	GString *m_freeze_row_buffer;
+
+	/* An LRU cache of recently thawed rows so that scrolling up and down
+	 * through the same region doesn't re-thaw (and re-read) each row on
+	 * every visit; see index(). */
+	VteRowData m_cached_row[VTE_RING_CACHED_ROWS];
+	row_t m_cached_row_num[VTE_RING_CACHED_ROWS];
+	guint64 m_cached_row_stamp[VTE_RING_CACHED_ROWS];
+	guint64 m_cached_row_clock{0};
 
         row_t m_visible_rows{0};  /* to keep at least a screenful of lines in memory, bug 646098 comment 12 */
 
+        /* The interned color triple table. attr_stream records refer to
+         * their fg/bg/deco triple via a 16-bit index into this table, so
+         * truecolor-heavy scrollback doesn't repeat the same 8-byte
+         * triple in every attr change. The table only grows (entries
+         * stay valid for the lifetime of the streams) and is emptied
+         * with them in reset_streams(); see get_color_triple_idx(). */
+        GPtrArray *m_color_triples;       /* guint64* items, idx -> triple */
+        GHashTable *m_color_triple_index; /* Maps the pooled triples (keys owned by m_color_triples) to their idx. */
+
         GPtrArray *m_hyperlinks;  /* The hyperlink pool. Contains GString* items.
                                    [0] points to an empty GString, [1] to [VTE_HYPERLINK_COUNT_MAX] contain the id;uri pairs. */
+        GHashTable *m_hyperlink_index;  /* Maps the pooled id;uri strings (keys owned by m_hyperlinks) to their idx. */
+        guint m_hyperlink_len_at_gc{1};  /* The pool's size after the last GC, to rate limit GCs triggered by pool growth. */
         char m_hyperlink_buf[VTE_HYPERLINK_TOTAL_LENGTH_MAX + 1];  /* One more hyperlink buffer to get the value if it's not placed in the pool. */
         hyperlink_idx_t m_hyperlink_highest_used_idx{0};  /* 0 if no hyperlinks at all in the pool. */
         hyperlink_idx_t m_hyperlink_current_idx{0};  /* The hyperlink idx used for newly created cells.
@@ -239,9 +312,11 @@ G_BEGIN_DECLS
 typedef vte::base::Ring VteRing;
 
 static inline bool _vte_ring_contains(VteRing *ring, gulong position) { return ring->contains(position); }
+static inline bool _vte_ring_rows_maybe_match(VteRing *ring, gulong start, gulong end, guint64 byteset) { return ring->rows_maybe_match(start, end, byteset); }
 static inline glong _vte_ring_delta(VteRing *ring) { return ring->delta(); }
 static inline glong _vte_ring_length(VteRing *ring) { return ring->length(); }
 static inline glong _vte_ring_next(VteRing *ring) { return ring->next(); }
+static inline glong _vte_ring_writable(VteRing *ring) { return ring->writable(); }
 static inline const VteRowData *_vte_ring_index (VteRing *ring, gulong position) { return ring->index(position); }
 static inline VteRowData *_vte_ring_index_writable (VteRing *ring, gulong position) { return ring->index_writable(position); }
 static inline void _vte_ring_hyperlink_maybe_gc (VteRing *ring, gulong increment) { ring->hyperlink_maybe_gc(increment); }
@@ -253,7 +328,10 @@ static inline void _vte_ring_shrink (VteRing *ring, gulong max_len) { ring->shri
 static inline VteRowData *_vte_ring_insert (VteRing *ring, gulong position, guint8 bidi_flags) { return ring->insert(position, bidi_flags); }
 static inline VteRowData *_vte_ring_append (VteRing *ring, guint8 bidi_flags) { return ring->append(bidi_flags); }
 static inline void _vte_ring_remove (VteRing *ring, gulong position) { ring->remove(position); }
+static inline void _vte_ring_rotate (VteRing *ring, gulong position, gulong end_position, glong count, guint8 bidi_flags) { ring->rotate(position, end_position, count, bidi_flags); }
 static inline void _vte_ring_drop_scrollback (VteRing *ring, gulong position) { ring->drop_scrollback(position); }
+static inline void _vte_ring_drop_oldest (VteRing *ring, gulong n) { ring->drop_oldest(n); }
+static inline gsize _vte_ring_storage_size (VteRing *ring) { return ring->storage_size(); }
 static inline void _vte_ring_set_visible_rows (VteRing *ring, gulong rows) { ring->set_visible_rows(rows); }
 static inline void _vte_ring_rewrap (VteRing *ring, glong columns, VteVisualPosition **markers) { ring->rewrap(columns, markers); }
 static inline gboolean _vte_ring_write_contents (VteRing *ring,
@@ -261,5 +339,25 @@ static inline gboolean _vte_ring_write_contents (VteRing *ring,
                                                  VteWriteFlags flags,
                                                  GCancellable *cancellable,
                                                  GError **error) { return ring->write_contents(stream, flags, cancellable, error); }
+static inline gboolean _vte_ring_write_contents_begin (VteRing *ring,
+                                                       VteRing::WriteContentsState *state,
+                                                       VteWriteFlags flags) { return ring->write_contents_begin(state, flags); }
+static inline int _vte_ring_write_contents_step (VteRing *ring,
+                                                 VteRing::WriteContentsState *state,
+                                                 GOutputStream *stream,
+                                                 gsize max_bytes,
+                                                 GCancellable *cancellable,
+                                                 GError **error) { return ring->write_contents_step(state, stream, max_bytes, cancellable, error); }
+static inline void _vte_ring_write_contents_end (VteRing *ring,
+                                                 VteRing::WriteContentsState *state) { ring->write_contents_end(state); }
+static inline void _vte_ring_prefetch (VteRing *ring, gulong start, gulong end) { ring->prefetch(start, end); }
+static inline gboolean _vte_ring_snapshot_write (VteRing *ring,
+                                                 GOutputStream *stream,
+                                                 GCancellable *cancellable,
+                                                 GError **error) { return ring->snapshot_write(stream, cancellable, error); }
+static inline gboolean _vte_ring_snapshot_restore (VteRing *ring,
+                                                   GInputStream *stream,
+                                                   GCancellable *cancellable,
+                                                   GError **error) { return ring->snapshot_restore(stream, cancellable, error); }
 
 G_END_DECLS
@@ -18,6 +18,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include "bidi.hh"
 #include "debug.h"
 #include "vtedefines.hh"
@@ -67,7 +69,9 @@ RingView::pause()
         g_free (m_bidirows);
         m_bidirows_alloc_len = 0;
 
-        m_invalid = true;
+        m_bidirunner->pause();
+
+        invalidate();
         m_paused = true;
 }
 
@@ -110,7 +114,7 @@ RingView::set_ring(Ring *ring)
                 return;
 
         m_ring = ring;
-        m_invalid = true;
+        invalidate();
 }
 
 void
@@ -120,7 +124,7 @@ RingView::set_width(vte::grid::column_t width)
                 return;
 
         m_width = width;
-        m_invalid = true;
+        invalidate();
 }
 
 void
@@ -176,7 +180,7 @@ RingView::set_enable_bidi(bool enable_bidi)
                 return;
 
         m_enable_bidi = enable_bidi;
-        m_invalid = true;
+        invalidate();
 }
 
 void
@@ -186,7 +190,35 @@ RingView::set_enable_shaping(bool enable_shaping)
                 return;
 
         m_enable_shaping = enable_shaping;
-        m_invalid = true;
+        invalidate();
+}
+
+/* Rotate @array of @len pointers in place so that the entry currently at
+ * index @delta (modulo @len) ends up at index 0, keeping every entry around.
+ * Used by update() for sliding the window; @delta is typically ±1. */
+static void
+ptr_array_rotate (void **array, long len, long delta)
+{
+        void **scratch;
+
+        delta %= len;
+        if (delta < 0)
+                delta += len;
+        if (delta == 0)
+                return;
+
+        if (delta <= len - delta) {
+                scratch = g_new (void *, delta);
+                memcpy (scratch, array, sizeof (void *) * delta);
+                memmove (array, array + delta, sizeof (void *) * (len - delta));
+                memcpy (array + (len - delta), scratch, sizeof (void *) * delta);
+        } else {
+                scratch = g_new (void *, len - delta);
+                memcpy (scratch, array + delta, sizeof (void *) * (len - delta));
+                memmove (array + (len - delta), array, sizeof (void *) * delta);
+                memcpy (array, scratch, sizeof (void *) * (len - delta));
+        }
+        g_free (scratch);
 }
 
 void
@@ -217,6 +249,33 @@ RingView::update()
                 row--;
         }
 
+        /* Slide the window: if only the viewport moved since the last update
+         * (set_rows() without an invalidate() in between, i.e. scrolling)
+         * then the rows extracted and the BiDi mappings computed back then
+         * are still correct. Rotate them to their new indices and remember
+         * which spans they cover; the loops below then only process the
+         * newly exposed rows. Entries that wrap around to the other end of
+         * an array carry stale data, but they always land outside the spans
+         * remembered here and thus get recomputed. */
+        vte::grid::row_t keep_start = row, keep_end = row;
+        vte::grid::row_t keep_view_start = m_start, keep_view_end = m_start;
+        if (!m_dirty) {
+                auto delta = row - m_top;
+                if (delta > -m_rows_alloc_len && delta < m_rows_alloc_len) {
+                        ptr_array_rotate ((void **) m_rows, m_rows_alloc_len, delta);
+                        keep_start = MAX (row, m_top);
+                        keep_end = MAX (keep_start, MIN (m_top + m_rows_len, row + m_rows_alloc_len));
+                }
+                delta = m_start - m_prev_start;
+                if (delta > -m_bidirows_alloc_len && delta < m_bidirows_alloc_len) {
+                        ptr_array_rotate ((void **) m_bidirows, m_bidirows_alloc_len, delta);
+                        keep_view_start = MAX (m_start, m_prev_start);
+                        keep_view_end = MAX (keep_view_start, MIN (m_start + m_len, m_prev_start + m_prev_len));
+                }
+                _vte_debug_print (VTE_DEBUG_RINGVIEW, "Ringview: sliding window, keeping rows [%ld..%ld], bidirows [%ld..%ld].\n",
+                                                      keep_start, keep_end - 1, keep_view_start, keep_view_end - 1);
+        }
+
         /* Extract the data beginning at the found row.
          *
          * Extract at most VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX rows
@@ -240,6 +299,18 @@ RingView::update()
                         }
                 }
 
+                if (row >= keep_start && row < keep_end) {
+                        /* Sliding window: this row was extracted by the previous
+                         * update(), skip the Ring (and possibly the streams). */
+                        row_data = m_rows[m_rows_len];
+                        m_rows_len++;
+                        row++;
+
+                        if (row >= m_start + m_len && !row_data->attr.soft_wrapped)
+                                break;
+                        continue;
+                }
+
                 row_data = _vte_ring_contains(m_ring, row) ? m_ring->index(row) : nullptr;
                 if (G_LIKELY (row_data != nullptr)) {
                         _vte_row_data_copy (row_data, m_rows[m_rows_len]);
@@ -280,9 +351,15 @@ RingView::update()
                 if (!row_data->attr.soft_wrapped || row == m_top + m_rows_len - 1) {
                         /* Found a paragraph from @top to @row, inclusive. */
 
-                        /* Run the BiDi algorithm. */
-                        m_bidirunner->paragraph(top, row + 1,
-                                                m_enable_bidi, m_enable_shaping);
+                        if (MAX (top, m_start) < keep_view_start ||
+                            MIN (row + 1, m_start + m_len) > keep_view_end) {
+                                /* Some of the rows it covers within the viewport
+                                 * weren't seen by the previous update().
+                                 *
+                                 * Run the BiDi algorithm. */
+                                m_bidirunner->paragraph(top, row + 1,
+                                                        m_enable_bidi, m_enable_shaping);
+                        }
 
                         /* Doing syntax highlighting etc. come here in the future. */
 
@@ -291,6 +368,9 @@ RingView::update()
                 row++;
         }
 
+        m_prev_start = m_start;
+        m_prev_len = m_len;
+        m_dirty = false;
         m_invalid = false;
 }
 
@@ -74,7 +74,10 @@ public:
         void set_enable_bidi(bool enable_bidi);
         void set_enable_shaping(bool enable_shaping);
 
-        inline void invalidate() { m_invalid = true; }
+        /* To be called when the Ring's contents change. A plain viewport
+         * movement (set_rows()) doesn't require this; update() then slides
+         * the window, reusing the data of the still visible rows. */
+        inline void invalidate() { m_invalid = true; m_dirty = true; }
         inline constexpr bool is_updated() const noexcept { return !m_invalid; }
         void update();
         void pause();
@@ -103,7 +106,12 @@ private:
         vte::grid::row_t m_len{0};
         vte::grid::column_t m_width{0};
 
+        /* The view of the previous update(), for sliding the window. */
+        vte::grid::row_t m_prev_start{0};
+        vte::grid::row_t m_prev_len{0};
+
         bool m_invalid{true};
+        bool m_dirty{true};  /* whether update() may slide, or has to recompute everything */
         bool m_paused{true};
 
         void resume();
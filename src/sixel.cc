@@ -0,0 +1,359 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "debug.h"
+#include "sixel.hh"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vte {
+
+namespace sixel {
+
+#define OPAQUE_RGB(r, g, b) (0xff000000u | ((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | (uint32_t)(b))
+
+/* Scale a percentage (0..100) to 0..255 */
+static inline uint32_t
+pct(int v)
+{
+        return std::min(v, 100) * 255 / 100;
+}
+
+/* The VT340 default color map, in percent RGB */
+static int const default_map[16][3] = {
+        {  0,  0,  0 }, { 20, 20, 80 }, { 80, 13, 13 }, { 20, 80, 20 },
+        { 80, 20, 80 }, { 20, 80, 80 }, { 80, 80, 20 }, { 53, 53, 53 },
+        { 26, 26, 26 }, { 33, 33, 60 }, { 60, 26, 26 }, { 33, 60, 33 },
+        { 60, 33, 60 }, { 33, 60, 60 }, { 60, 60, 33 }, { 80, 80, 80 },
+};
+
+/* HLS as used by SIXEL: hue in degrees with blue at 0°, lightness and
+ * saturation in percent.
+ */
+static uint32_t
+hls_to_rgb(int h,
+           int l,
+           int s)
+{
+        auto const lf = std::min(l, 100) / 100.;
+        auto const sf = std::min(s, 100) / 100.;
+
+        auto const c = (1. - std::abs(2. * lf - 1.)) * sf;
+        auto const hf = ((h + 240) % 360) / 60.;
+        auto const x = c * (1. - std::abs(std::fmod(hf, 2.) - 1.));
+        auto const m = lf - c / 2.;
+
+        double r, g, b;
+        switch ((int)hf) {
+        case 0:  r = c; g = x; b = 0; break;
+        case 1:  r = x; g = c; b = 0; break;
+        case 2:  r = 0; g = c; b = x; break;
+        case 3:  r = 0; g = x; b = c; break;
+        case 4:  r = x; g = 0; b = c; break;
+        default: r = c; g = 0; b = x; break;
+        }
+
+        return OPAQUE_RGB((uint32_t)((r + m) * 255 + .5),
+                          (uint32_t)((g + m) * 255 + .5),
+                          (uint32_t)((b + m) * 255 + .5));
+}
+
+Context::~Context()
+{
+}
+
+void
+Context::start(bool transparent_bg)
+{
+        m_active = true;
+        m_transparent_bg = transparent_bg;
+
+        m_pending = Pending::NONE;
+        m_n_params = 0;
+        m_param_started = false;
+
+        m_x = 0;
+        m_band_top = 0;
+        m_width = 0;
+        m_height = 0;
+        m_repeat = 1;
+
+        /* Clearing keeps the capacity, so back-to-back images (e.g. a
+         * redrawn sparkline) don't reallocate; the resize in
+         * ensure_pixels() zero-fills anew. */
+        m_pixels.clear();
+        m_stride = 0;
+        m_rows = 0;
+
+        for (unsigned int i = 0; i < G_N_ELEMENTS (m_palette); ++i) {
+                auto const* c = default_map[i & 0xf];
+                m_palette[i] = OPAQUE_RGB(pct(c[0]), pct(c[1]), pct(c[2]));
+        }
+        m_color = m_palette[3]; /* VT340 default foreground */
+}
+
+/*
+ * Grow the pixel buffer to cover at least @right columns and @bottom
+ * rows. Returns %false when the request exceeds the size limits; the
+ * caller clips.
+ */
+bool
+Context::ensure_pixels(int right,
+                       int bottom)
+{
+        if (right > k_max_width || bottom > k_max_height)
+                return false;
+
+        if (G_UNLIKELY (right > m_stride)) {
+                auto new_stride = MAX(m_stride, 64);
+                while (new_stride < right)
+                        new_stride *= 2;
+                new_stride = MIN(new_stride, (int)k_max_width);
+
+                /* Re-lay out the committed rows for the wider stride,
+                 * last row first so this works in place. */
+                m_pixels.resize((gsize)new_stride * MAX(m_rows, bottom), 0);
+                for (int row = m_rows - 1; row > 0; row--)
+                        memmove(m_pixels.data() + (gsize)row * new_stride,
+                                m_pixels.data() + (gsize)row * m_stride,
+                                m_stride * sizeof(uint32_t));
+                /* Zero the stale bytes the relayout left in each row's tail */
+                for (int row = 0; row < m_rows; row++)
+                        memset(m_pixels.data() + (gsize)row * new_stride + m_stride, 0,
+                               (new_stride - m_stride) * sizeof(uint32_t));
+
+                m_stride = new_stride;
+                m_rows = MAX(m_rows, bottom);
+        } else if (bottom > m_rows) {
+                m_pixels.resize((gsize)m_stride * bottom, 0);
+                m_rows = bottom;
+        }
+
+        return true;
+}
+
+void
+Context::begin_params(Pending pending) noexcept
+{
+        m_pending = pending;
+        m_n_params = 0;
+        m_param_started = false;
+        m_params[0] = 0;
+}
+
+void
+Context::set_color() noexcept
+{
+        auto const reg = m_params[0] & 0xff;
+
+        if (m_n_params >= 5) {
+                switch (m_params[1]) {
+                case 1: /* HLS */
+                        m_palette[reg] = hls_to_rgb(m_params[2], m_params[3], m_params[4]);
+                        break;
+                case 2: /* RGB, in percent */
+                        m_palette[reg] = OPAQUE_RGB(pct(m_params[2]),
+                                                    pct(m_params[3]),
+                                                    pct(m_params[4]));
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        m_color = m_palette[reg];
+}
+
+void
+Context::apply_params() noexcept
+{
+        if (m_pending == Pending::NONE)
+                return;
+
+        if (m_param_started && m_n_params < k_max_params)
+                ++m_n_params;
+
+        switch (m_pending) {
+        case Pending::REPEAT:
+                m_repeat = CLAMP(m_n_params >= 1 ? m_params[0] : 1, 1, k_max_width);
+                break;
+        case Pending::COLOR:
+                if (m_n_params >= 1)
+                        set_color();
+                break;
+        case Pending::RASTER:
+                /* "Pan;Pad;Ph;Pv — the aspect ratio is not supported;
+                 * Ph/Pv are a size hint, worth a single preallocation. */
+                if (m_n_params >= 4)
+                        ensure_pixels(MIN(m_params[2], (int)k_max_width),
+                                      MIN(m_params[3], (int)k_max_height));
+                break;
+        default:
+                break;
+        }
+
+        m_pending = Pending::NONE;
+}
+
+void
+Context::put(uint32_t bits) noexcept
+{
+        auto const repeat = m_repeat;
+        m_repeat = 1;
+
+        if (G_UNLIKELY (m_x >= k_max_width))
+                return;
+
+        auto const right = MIN(m_x + repeat, (int)k_max_width);
+
+        if (bits == 0) {
+                /* Background advance; extends the raster but writes
+                 * nothing (transparent), or is filled in finish(). */
+                m_x = right;
+                m_width = MAX(m_width, right);
+                return;
+        }
+
+        if (G_UNLIKELY (!ensure_pixels(right, m_band_top + 6))) {
+                m_x = right;
+                return;
+        }
+
+        for (unsigned int i = 0; i < 6; i++) {
+                if (!(bits & (1u << i)))
+                        continue;
+
+                auto* p = m_pixels.data() + (gsize)(m_band_top + i) * m_stride;
+                for (int x = m_x; x < right; x++)
+                        p[x] = m_color;
+        }
+
+        m_x = right;
+        m_width = MAX(m_width, right);
+        m_height = MAX(m_height, m_band_top + 6);
+}
+
+void
+Context::feed(uint32_t raw) noexcept
+{
+        if (G_UNLIKELY (!m_active))
+                return;
+
+        /* Parameters of ", # and ! are interleaved with the data */
+        if (m_pending != Pending::NONE) {
+                if (raw >= '0' && raw <= '9') {
+                        if (!m_param_started) {
+                                m_param_started = true;
+                                if (m_n_params < k_max_params)
+                                        m_params[m_n_params] = 0;
+                        }
+                        if (m_n_params < k_max_params)
+                                m_params[m_n_params] = MIN(m_params[m_n_params] * 10 + (int)(raw - '0'),
+                                                           0xffff);
+                        return;
+                }
+                if (raw == ';') {
+                        if (!m_param_started && m_n_params < k_max_params)
+                                m_params[m_n_params] = 0;
+                        if (m_n_params < k_max_params)
+                                ++m_n_params;
+                        m_param_started = false;
+                        return;
+                }
+
+                apply_params();
+        }
+
+        switch (raw) {
+        case 0x3f ... 0x7e: /* data */
+                put(raw - 0x3f);
+                break;
+        case '$': /* graphics carriage return */
+                m_x = 0;
+                break;
+        case '-': /* graphics new line: next band */
+                m_x = 0;
+                if (G_LIKELY (m_band_top <= k_max_height))
+                        m_band_top += 6;
+                break;
+        case '"': /* raster attributes */
+                begin_params(Pending::RASTER);
+                break;
+        case '#': /* color introducer */
+                begin_params(Pending::COLOR);
+                break;
+        case '!': /* repeat introducer */
+                begin_params(Pending::REPEAT);
+                break;
+        default:
+                /* Ignore; CR/LF etc. routinely appear in sixel streams */
+                break;
+        }
+}
+
+/*
+ * Finish the image: returns a ready-to-blit image surface of the
+ * decoded bands and deactivates the decoder, or %nullptr if no pixels
+ * were produced.
+ */
+cairo_surface_t*
+Context::finish(int* width,
+                int* height)
+{
+        apply_params();
+        m_active = false;
+
+        if (m_width <= 0 || m_height <= 0)
+                return nullptr;
+
+        auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, m_width, m_height);
+        if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+                cairo_surface_destroy(surface);
+                return nullptr;
+        }
+
+        auto const bg = m_transparent_bg ? 0u : m_palette[0];
+        auto const stride = cairo_image_surface_get_stride(surface) / sizeof(uint32_t);
+        auto* data = reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(surface));
+
+        cairo_surface_flush(surface);
+        for (int row = 0; row < m_height; row++) {
+                auto const* src = m_pixels.data() + (gsize)row * m_stride;
+                auto* dst = data + (gsize)row * stride;
+
+                if (bg == 0) {
+                        memcpy(dst, src, m_width * sizeof(uint32_t));
+                } else {
+                        for (int x = 0; x < m_width; x++)
+                                dst[x] = src[x] != 0 ? src[x] : bg;
+                }
+        }
+        cairo_surface_mark_dirty(surface);
+
+        *width = m_width;
+        *height = m_height;
+        return surface;
+}
+
+} // namespace sixel
+
+} // namespace vte
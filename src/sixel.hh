@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glib.h>
+#include <cairo.h>
+
+namespace vte {
+
+namespace sixel {
+
+/*
+ * Image:
+ *
+ * A decoded SIXEL image, anchored to the ring rows it was printed onto.
+ * The surface is ready to blit; the cell geometry is fixed at insertion
+ * time, so the image scrolls with its rows and is dropped when they
+ * leave the ring (see Terminal::prune_images()).
+ */
+class Image {
+public:
+        Image(cairo_surface_t* surface, /* adopted */
+              int width,
+              int height)
+                : m_surface{surface},
+                  m_width{width},
+                  m_height{height}
+        {
+        }
+
+        ~Image()
+        {
+                cairo_surface_destroy(m_surface);
+        }
+
+        Image(Image const&) = delete;
+        Image(Image&&) = delete;
+        Image& operator= (Image const&) = delete;
+        Image& operator= (Image&&) = delete;
+
+        inline cairo_surface_t* surface() const noexcept { return m_surface; }
+        inline int width() const noexcept { return m_width; }
+        inline int height() const noexcept { return m_height; }
+        inline gsize size_bytes() const noexcept { return gsize(m_width) * m_height * 4; }
+
+        /* Grid anchoring, filled in by the terminal */
+        long top_row{0};      /* absolute ring row */
+        long left_column{0};
+        long rows{0};
+        long columns{0};
+        void const* screen{nullptr};  /* the VteScreen it was printed onto */
+
+private:
+        cairo_surface_t* m_surface;
+        int m_width;
+        int m_height;
+
+}; // class Image
+
+/*
+ * Context:
+ *
+ * An incremental SIXEL decoder. The parser streams the DCS data
+ * characters to the host one by one (see parser_dcs_collect()), and the
+ * decoder consumes each in O(1), writing pixels band by band into a
+ * growing buffer; huge images therefore never buffer up in the parser
+ * or decode in one big stall at dispatch. finish() hands over the
+ * completed bands as a ready-to-blit cairo surface.
+ */
+class Context {
+public:
+        Context() = default;
+        ~Context();
+
+        Context(Context const&) = delete;
+        Context(Context&&) = delete;
+        Context& operator= (Context const&) = delete;
+        Context& operator= (Context&&) = delete;
+
+        /* Largest image accepted; data beyond is silently clipped */
+        static int const k_max_width = 4096;
+        static int const k_max_height = 4096;
+
+        void start(bool transparent_bg);
+        void feed(uint32_t raw) noexcept;
+        cairo_surface_t* finish(int* width,
+                                int* height);
+
+        inline bool active() const noexcept { return m_active; }
+
+private:
+        enum class Pending : uint8_t {
+                NONE,
+                RASTER,  /* " */
+                COLOR,   /* # */
+                REPEAT,  /* ! */
+        };
+
+        static unsigned int const k_max_params = 8;
+
+        void begin_params(Pending pending) noexcept;
+        void apply_params() noexcept;
+        void set_color(void) noexcept;
+        void put(uint32_t bits) noexcept;
+        bool ensure_pixels(int right,
+                           int bottom);
+
+        bool m_active{false};
+        bool m_transparent_bg{true};
+
+        Pending m_pending{Pending::NONE};
+        unsigned int m_n_params{0};
+        bool m_param_started{false};
+        int m_params[k_max_params];
+
+        int m_x{0};
+        int m_band_top{0};
+        int m_width{0};
+        int m_height{0};
+        int m_repeat{1};
+
+        uint32_t m_color{0};
+        uint32_t m_palette[256];
+
+        /* The pixel buffer; rows of m_stride pixels, of which the
+         * leading m_width are meaningful. The stride grows in powers
+         * of two, so width growth re-lays the buffer out only a few
+         * times per image. */
+        int m_stride{0};
+        int m_rows{0};
+        std::vector<uint32_t> m_pixels;
+
+}; // class Context
+
+} // namespace sixel
+
+} // namespace vte
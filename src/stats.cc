@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "stats.hh"
+
+#include <glib.h>
+
+namespace vte {
+
+namespace stats {
+
+Counters counters;
+
+static unsigned int
+time_bucket(uint64_t usec)
+{
+        unsigned int bucket = 0;
+
+        while (usec > 1 && bucket < Counters::k_n_time_buckets - 1) {
+                usec >>= 1;
+                bucket++;
+        }
+
+        return bucket;
+}
+
+void
+add_process_time(uint64_t usec)
+{
+        add(counters.process_time_hist[time_bucket(usec)]);
+}
+
+void
+add_latency(uint64_t usec)
+{
+        add(counters.latency_hist[time_bucket(usec)]);
+}
+
+static gboolean
+dump_cb(gpointer data G_GNUC_UNUSED)
+{
+        auto const bytes_in = counters.stream_bytes_in.load(std::memory_order_relaxed);
+        auto const bytes_out = counters.stream_bytes_out.load(std::memory_order_relaxed);
+
+        g_printerr("vte stats: parsed %" G_GUINT64_FORMAT " bytes in %" G_GUINT64_FORMAT " chunks, "
+                   "froze %" G_GUINT64_FORMAT " rows, thawed %" G_GUINT64_FORMAT ", "
+                   "stream %" G_GUINT64_FORMAT " -> %" G_GUINT64_FORMAT " bytes (%.0f%%), "
+                   "%" G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT " invalidations\n",
+                   counters.bytes_parsed.load(std::memory_order_relaxed),
+                   counters.chunks_processed.load(std::memory_order_relaxed),
+                   counters.rows_frozen.load(std::memory_order_relaxed),
+                   counters.rows_thawed.load(std::memory_order_relaxed),
+                   bytes_in,
+                   bytes_out,
+                   bytes_in != 0 ? 100. * bytes_out / bytes_in : 0.,
+                   counters.frames_painted.load(std::memory_order_relaxed),
+                   counters.invalidations.load(std::memory_order_relaxed));
+
+        g_printerr("vte stats: process_incoming µs histogram:");
+        for (unsigned int i = 0; i < Counters::k_n_time_buckets; i++) {
+                auto const count = counters.process_time_hist[i].load(std::memory_order_relaxed);
+                if (count != 0)
+                        g_printerr(" [<%u]=%" G_GUINT64_FORMAT, 2u << i, count);
+        }
+        g_printerr("\n");
+
+        g_printerr("vte stats: input-to-paint µs histogram:");
+        for (unsigned int i = 0; i < Counters::k_n_time_buckets; i++) {
+                auto const count = counters.latency_hist[i].load(std::memory_order_relaxed);
+                if (count != 0)
+                        g_printerr(" [<%u]=%" G_GUINT64_FORMAT, 2u << i, count);
+        }
+        g_printerr("\n");
+
+        return G_SOURCE_CONTINUE;
+}
+
+void
+schedule_dump()
+{
+        static bool scheduled = false;
+
+        if (scheduled)
+                return;
+        scheduled = true;
+
+        auto const env = g_getenv("VTE_STATS");
+        if (env == nullptr)
+                return;
+
+        auto interval = (unsigned int)g_ascii_strtoull(env, nullptr, 10);
+        if (interval == 0)
+                interval = 30;
+
+        g_timeout_add_seconds(interval, dump_cb, nullptr);
+}
+
+} // namespace stats
+
+} // namespace vte
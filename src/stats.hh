@@ -0,0 +1,71 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace vte {
+
+namespace stats {
+
+/*
+ * Process-wide performance counters, maintained unconditionally with
+ * relaxed atomic increments so the hot paths stay cheap in release
+ * builds. Set the VTE_STATS environment variable to a number of seconds
+ * to have them dumped to stderr periodically; this is how throughput
+ * regressions can be diagnosed in production without a rebuild.
+ */
+struct Counters {
+        std::atomic<uint64_t> bytes_parsed{0};      /* bytes applied to the screen model */
+        std::atomic<uint64_t> chunks_processed{0};  /* chunks/batches applied */
+        std::atomic<uint64_t> rows_frozen{0};       /* rows written to the scrollback streams */
+        std::atomic<uint64_t> rows_thawed{0};       /* rows read back from the streams */
+        std::atomic<uint64_t> stream_bytes_in{0};   /* bytes handed to the stream compressor */
+        std::atomic<uint64_t> stream_bytes_out{0};  /* bytes after compression */
+        std::atomic<uint64_t> frames_painted{0};    /* widget_draw() invocations */
+        std::atomic<uint64_t> invalidations{0};     /* row range invalidations issued */
+
+        static unsigned int const k_n_time_buckets = 16;
+        /* process_incoming() wall time; bucket i counts cycles that took
+         * [2^i, 2^(i+1)) µs. */
+        std::atomic<uint64_t> process_time_hist[k_n_time_buckets];
+        /* Input-to-paint latency: time from a byte arriving off the pty to
+         * the end of the next widget_draw() after it was applied; same
+         * bucketing. */
+        std::atomic<uint64_t> latency_hist[k_n_time_buckets];
+};
+
+extern Counters counters;
+
+inline void
+add(std::atomic<uint64_t>& counter,
+    uint64_t n = 1)
+{
+        counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+void add_process_time(uint64_t usec);
+void add_latency(uint64_t usec);
+
+/* Starts the periodic dump if VTE_STATS is set; idempotent. */
+void schedule_dump();
+
+} // namespace stats
+
+} // namespace vte
@@ -48,6 +48,37 @@ test_utf8_decoder_decode(void)
         }
 }
 
+static void
+test_utf8_decoder_skip_ascii(void)
+{
+        decoder.reset();
+
+        /* Runs of every length up to well past the vector width, with
+         * the first non-ASCII byte at every position in the run.
+         */
+        uint8_t buf[64];
+        for (size_t len = 0; len <= sizeof(buf); ++len) {
+                memset(buf, 'a', sizeof(buf));
+                g_assert_true(decoder.skip_ascii(buf, buf + len) == buf + len);
+
+                for (size_t pos = 0; pos < len; ++pos) {
+                        memset(buf, 'a', sizeof(buf));
+                        buf[pos] = 0xc3;
+                        g_assert_true(decoder.skip_ascii(buf, buf + len) == buf + pos);
+                        buf[pos] = 0x80;
+                        g_assert_true(decoder.skip_ascii(buf, buf + len) == buf + pos);
+                        buf[pos] = 0xff;
+                        g_assert_true(decoder.skip_ascii(buf, buf + len) == buf + pos);
+                }
+        }
+
+        /* No fast path while the decoder is mid-sequence. */
+        memset(buf, 'a', sizeof(buf));
+        decoder.decode(0xc3);
+        g_assert_true(decoder.skip_ascii(buf, buf + sizeof(buf)) == buf);
+        decoder.reset();
+}
+
 static void
 decode(uint8_t const* in,
        size_t len,
@@ -305,6 +336,7 @@ main(int argc,
         g_test_init(&argc, &argv, nullptr);
 
         g_test_add_func("/vte/utf8/decoder/decode", test_utf8_decoder_decode);
+        g_test_add_func("/vte/utf8/decoder/skip-ascii", test_utf8_decoder_skip_ascii);
         g_test_add_func("/vte/utf8/decoder/replacement", test_utf8_decoder_replacement);
 
         return g_test_run();
@@ -25,6 +25,50 @@
 
 #include "utf8.hh"
 
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+uint8_t const*
+vte::base::UTF8Decoder::find_nonascii(uint8_t const* iptr,
+                                      uint8_t const* iend) noexcept
+{
+#if defined(__SSE2__)
+        for ( ; iptr + 16 <= iend; iptr += 16) {
+                auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(iptr));
+                auto const mask = _mm_movemask_epi8(v);
+                if (mask != 0)
+                        return iptr + __builtin_ctz(unsigned(mask));
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        for ( ; iptr + 16 <= iend; iptr += 16) {
+                if (vmaxvq_u8(vld1q_u8(iptr)) & 0x80u)
+                        break;
+        }
+#endif
+
+        /* Word-at-a-time scan for the remainder, and as the generic
+         * fallback on targets without vector support.
+         */
+        while (iptr + sizeof(uint64_t) <= iend) {
+                uint64_t w;
+                memcpy(&w, iptr, sizeof(w));
+                if (w & UINT64_C(0x8080808080808080))
+                        break;
+                iptr += sizeof(w);
+        }
+
+        while (iptr < iend && *iptr < 0x80u)
+                ++iptr;
+
+        return iptr;
+}
+
 #define RJ vte::base::UTF8Decoder::REJECT
 #define RW vte::base::UTF8Decoder::REJECT_REWIND
 
@@ -67,7 +67,28 @@ public:
                 m_codepoint = 0xfffdU;
         }
 
+        /* Returns a pointer to the first byte in [iptr, iend) that the
+         * ASCII fast path cannot handle: either the decoder is in the
+         * middle of a multibyte sequence, or the byte has the high bit
+         * set. Each byte in [iptr, rv) is a complete character whose
+         * codepoint is the byte value itself, so the caller may consume
+         * the whole run without calling decode().
+         */
+        inline uint8_t const* skip_ascii(uint8_t const* iptr,
+                                         uint8_t const* iend) const noexcept {
+                if (m_state != ACCEPT)
+                        return iptr;
+                return find_nonascii(iptr, iend);
+        }
+
 private:
+        /* Returns a pointer to the first byte in [iptr, iend) with the
+         * high bit set, or @iend if there is none. Vectorised where the
+         * target supports it.
+         */
+        static uint8_t const* find_nonascii(uint8_t const* iptr,
+                                            uint8_t const* iend) noexcept;
+
         uint32_t m_state{ACCEPT};
         uint32_t m_codepoint{0};
 
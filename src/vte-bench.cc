@@ -0,0 +1,427 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This programme is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This programme is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * vte-bench: ingest-throughput benchmark for the lower layers of vte.
+ *
+ * Drives each layer of the input pipeline separately over a corpus of
+ * files (e.g. the ones in perf/) and reports MB/s per stage, optionally
+ * as JSON for regression tracking:
+ *
+ *   decoder  — vte::base::UTF8Decoder only
+ *   parser   — decoder + vte_parser_feed()/vte_parser_feed_span()
+ *   screen   — decoder + parser + VteRowData cell writes of an
+ *              80-column screen model
+ *
+ * Higher layers (Ring, Terminal, vteseq) are exercised by vte-headless,
+ * which drives a full unrealized terminal through the public API.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <locale.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <glib.h>
+
+#include "debug.h"
+#include "parser.hh"
+#include "utf8.hh"
+#include "vterowdata.hh"
+
+/* The per-stage consumers. Each is fed whole buffers of raw bytes and
+ * must accumulate some state the optimiser cannot discard.
+ */
+
+class DecoderStage {
+public:
+        static constexpr char const* name = "decoder";
+
+        void process(uint8_t const* buf,
+                     size_t len)
+        {
+                auto const* ip = buf;
+                auto const* iend = buf + len;
+
+                while (ip < iend) {
+                        auto const* run = m_decoder.skip_ascii(ip, iend);
+                        m_codepoints += run - ip;
+                        ip = run;
+                        if (ip == iend)
+                                break;
+
+                        switch (m_decoder.decode(*ip)) {
+                        case vte::base::UTF8Decoder::REJECT_REWIND:
+                                --ip;
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::REJECT:
+                                m_decoder.reset();
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::ACCEPT:
+                                m_sink += m_decoder.codepoint();
+                                ++m_codepoints;
+                                break;
+                        }
+                        ++ip;
+                }
+        }
+
+        uint64_t m_codepoints{0};
+        uint64_t m_sink{0};
+
+protected:
+        vte::base::UTF8Decoder m_decoder{};
+};
+
+class ParserStage : public DecoderStage {
+public:
+        static constexpr char const* name = "parser";
+
+        ParserStage()
+        {
+                vte_parser_init(&m_parser);
+        }
+
+        ~ParserStage()
+        {
+                vte_parser_deinit(&m_parser);
+        }
+
+        void process(uint8_t const* buf,
+                     size_t len)
+        {
+                auto const* ip = buf;
+                auto const* iend = buf + len;
+
+                while (ip < iend) {
+                        auto const* run = m_decoder.skip_ascii(ip, iend);
+                        while (ip < run) {
+                                if (*ip >= 0x20 && *ip < 0x7f) {
+                                        uint32_t chbuf[128];
+                                        int n = 0;
+                                        while (ip + n < run && n < int(G_N_ELEMENTS(chbuf)) &&
+                                               ip[n] >= 0x20 && ip[n] < 0x7f) {
+                                                chbuf[n] = ip[n];
+                                                ++n;
+                                        }
+
+                                        auto consumed = vte_parser_feed_span(&m_parser, chbuf, n);
+                                        if (G_LIKELY(consumed > 0)) {
+                                                graphic_run(chbuf, consumed);
+                                                ip += consumed;
+                                                continue;
+                                        }
+                                }
+                                feed(*ip);
+                                ++ip;
+                        }
+                        if (ip == iend)
+                                break;
+
+                        switch (m_decoder.decode(*ip)) {
+                        case vte::base::UTF8Decoder::REJECT_REWIND:
+                                --ip;
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::REJECT:
+                                m_decoder.reset();
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::ACCEPT:
+                                feed(m_decoder.codepoint());
+                                break;
+                        }
+                        ++ip;
+                }
+        }
+
+        uint64_t m_dispatches{0};
+
+protected:
+        virtual void graphic(uint32_t codepoint)
+        {
+                m_sink += codepoint;
+        }
+
+        virtual void graphic_run(uint32_t const* chars,
+                                 size_t len)
+        {
+                for (size_t i = 0; i < len; ++i)
+                        m_sink += chars[i];
+        }
+
+        virtual void control(int status)
+        {
+        }
+
+        void feed(uint32_t codepoint)
+        {
+                auto rv = vte_parser_feed(&m_parser, codepoint);
+                if (G_UNLIKELY(rv < 0))
+                        return;
+                if (rv == VTE_SEQ_NONE || rv == VTE_SEQ_IGNORE)
+                        return;
+
+                ++m_dispatches;
+                if (rv == VTE_SEQ_GRAPHIC)
+                        graphic(m_parser.seq.terminator);
+                else
+                        control(rv);
+        }
+
+        vte_parser_t m_parser;
+};
+
+/* An 80-column screen model writing real VteCells, without the Ring or
+ * widget machinery above it.
+ */
+class ScreenStage : public ParserStage {
+public:
+        static constexpr char const* name = "screen";
+
+        static long const k_columns = 80;
+
+        ScreenStage()
+        {
+                _vte_row_data_init(&m_row);
+        }
+
+        ~ScreenStage()
+        {
+                _vte_row_data_fini(&m_row);
+        }
+
+        uint64_t m_rows{0};
+
+protected:
+        void graphic(uint32_t codepoint) override
+        {
+                VteCell cell = basic_cell;
+                cell.c = codepoint;
+                cell.attr.set_columns(1);
+
+                if (m_col >= k_columns)
+                        newline();
+                _vte_row_data_fill(&m_row, &basic_cell, m_col);
+                _vte_row_data_append(&m_row, &cell);
+                ++m_col;
+        }
+
+        void graphic_run(uint32_t const* chars,
+                         size_t len) override
+        {
+                for (size_t i = 0; i < len; ++i)
+                        graphic(chars[i]);
+        }
+
+        void control(int status) override
+        {
+                /* Any control starts a fresh line; enough to keep the
+                 * cell writes honest without a full Terminal. */
+                newline();
+        }
+
+private:
+        void newline()
+        {
+                _vte_row_data_clear(&m_row);
+                m_col = 0;
+                ++m_rows;
+        }
+
+        VteRowData m_row;
+        long m_col{0};
+};
+
+struct Corpus {
+        std::string filename;
+        std::vector<uint8_t> bytes;
+};
+
+struct Result {
+        char const* stage;
+        uint64_t bytes;
+        int64_t best_us;
+        int64_t total_us;
+        int runs;
+};
+
+static bool
+load_corpus(char const* const* filenames,
+            std::vector<Corpus>& corpus)
+{
+        for (auto i = 0; filenames[i] != nullptr; i++) {
+                char* contents = nullptr;
+                gsize len = 0;
+                GError* error = nullptr;
+                if (!g_file_get_contents(filenames[i], &contents, &len, &error)) {
+                        g_printerr("Error reading file %s: %s\n",
+                                   filenames[i], error->message);
+                        g_error_free(error);
+                        return false;
+                }
+
+                Corpus c;
+                c.filename = filenames[i];
+                c.bytes.assign((uint8_t const*)contents, (uint8_t const*)contents + len);
+                corpus.emplace_back(std::move(c));
+                g_free(contents);
+        }
+
+        return true;
+}
+
+template<class Stage>
+static Result
+run_stage(std::vector<Corpus> const& corpus,
+          int repeat)
+{
+        Result result{Stage::name, 0, G_MAXINT64, 0, repeat};
+
+        for (auto const& c : corpus)
+                result.bytes += c.bytes.size();
+
+        for (auto i = 0; i < repeat; ++i) {
+                Stage stage{};
+
+                auto const start_time = g_get_monotonic_time();
+                for (auto const& c : corpus)
+                        stage.process(c.bytes.data(), c.bytes.size());
+                auto const time_spent = g_get_monotonic_time() - start_time;
+
+                result.best_us = MIN(result.best_us, time_spent);
+                result.total_us += time_spent;
+        }
+
+        return result;
+}
+
+static double
+mb_per_s(uint64_t bytes,
+         int64_t us)
+{
+        if (us <= 0)
+                return 0.;
+        return double(bytes) / (1024. * 1024.) * G_USEC_PER_SEC / double(us);
+}
+
+static void
+print_results(std::vector<Result> const& results,
+              bool json)
+{
+        if (json) {
+                g_print("[");
+                for (size_t i = 0; i < results.size(); ++i) {
+                        auto const& r = results[i];
+                        g_print("%s\n"
+                                "  {\"stage\": \"%s\", \"bytes\": %" G_GUINT64_FORMAT ", "
+                                "\"runs\": %d, "
+                                "\"best_us\": %" G_GINT64_FORMAT ", "
+                                "\"avg_us\": %" G_GINT64_FORMAT ", "
+                                "\"mb_per_s\": %.2f}",
+                                i == 0 ? "" : ",",
+                                r.stage, r.bytes, r.runs,
+                                r.best_us, r.total_us / r.runs,
+                                mb_per_s(r.bytes, r.best_us));
+                }
+                g_print("\n]\n");
+                return;
+        }
+
+        g_print("%-8s %12s %6s %12s %12s %10s\n",
+                "stage", "bytes", "runs", "best µs", "avg µs", "MB/s");
+        for (auto const& r : results) {
+                g_print("%-8s %12" G_GUINT64_FORMAT " %6d %12" G_GINT64_FORMAT
+                        " %12" G_GINT64_FORMAT " %10.2f\n",
+                        r.stage, r.bytes, r.runs,
+                        r.best_us, r.total_us / r.runs,
+                        mb_per_s(r.bytes, r.best_us));
+        }
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        setlocale(LC_ALL, "");
+        _vte_debug_init();
+
+        gboolean json = false;
+        int repeat = 5;
+        char* stage = nullptr;
+        char** filenames = nullptr;
+        GOptionEntry const entries[] = {
+                { "json", 'j', 0, G_OPTION_ARG_NONE, &json,
+                  "Output results as JSON", nullptr },
+                { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+                  "Run each stage COUNT times (default 5)", "COUNT" },
+                { "stage", 's', 0, G_OPTION_ARG_STRING, &stage,
+                  "Only run STAGE (decoder, parser, screen)", "STAGE" },
+                { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames,
+                  nullptr, nullptr },
+                { nullptr },
+        };
+
+        auto context = g_option_context_new("FILE… — ingest benchmark");
+        g_option_context_set_help_enabled(context, true);
+        g_option_context_add_main_entries(context, entries, nullptr);
+
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("Failed to parse arguments: %s\n", error->message);
+                g_error_free(error);
+                g_option_context_free(context);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        if (filenames == nullptr || filenames[0] == nullptr) {
+                g_printerr("Need at least one input file; try the corpus in perf/\n");
+                return EXIT_FAILURE;
+        }
+
+        std::vector<Corpus> corpus;
+        if (!load_corpus(filenames, corpus)) {
+                g_strfreev(filenames);
+                return EXIT_FAILURE;
+        }
+        g_strfreev(filenames);
+
+        std::vector<Result> results;
+        if (stage == nullptr || g_str_equal(stage, DecoderStage::name))
+                results.push_back(run_stage<DecoderStage>(corpus, repeat));
+        if (stage == nullptr || g_str_equal(stage, ParserStage::name))
+                results.push_back(run_stage<ParserStage>(corpus, repeat));
+        if (stage == nullptr || g_str_equal(stage, ScreenStage::name))
+                results.push_back(run_stage<ScreenStage>(corpus, repeat));
+        g_free(stage);
+
+        if (results.empty()) {
+                g_printerr("Unknown stage\n");
+                return EXIT_FAILURE;
+        }
+
+        print_results(results, json);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This programme is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This programme is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * vte-headless: drive a full VteTerminal without a display.
+ *
+ * Creates an unrealized terminal (no window, no GdkDisplay needed), feeds
+ * it the given files (or stdin) through the regular input pipeline —
+ * parser, vteseq semantics, ring, scrollback — and prints the resulting
+ * screen text.  With --search, additionally walks the whole history with
+ * the search machinery and reports the number of matches.
+ *
+ * This is the driver for server-side replay, and the "terminal" stage
+ * that vte-bench can't provide: everything except rendering runs for
+ * real.  Rendering and input paths bail out via widget_realized(), and
+ * cell metrics stay at their 1x1 stubs since no font is ever loaded.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <locale.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "vte/vte.h"
+#include "vtepcre2.h"
+
+static int opt_columns = 80;
+static int opt_rows = 24;
+static int opt_scrollback = 10000;
+static char* opt_search = nullptr;
+static gboolean opt_quiet = FALSE;
+
+static GOptionEntry const entries[] = {
+        { "columns", 'c', 0, G_OPTION_ARG_INT, &opt_columns,
+          "Terminal width (default: 80)", "COLS" },
+        { "rows", 'r', 0, G_OPTION_ARG_INT, &opt_rows,
+          "Terminal height (default: 24)", "ROWS" },
+        { "scrollback", 'n', 0, G_OPTION_ARG_INT, &opt_scrollback,
+          "Scrollback lines (default: 10000)", "LINES" },
+        { "search", 's', 0, G_OPTION_ARG_STRING, &opt_search,
+          "Count the matches of this PCRE2 regex in the history", "REGEX" },
+        { "quiet", 'q', 0, G_OPTION_ARG_NONE, &opt_quiet,
+          "Don't print the screen text", nullptr },
+        { nullptr }
+};
+
+/* The terminal processes its input from timeouts on the default main
+ * context (there being no frame clock to drive it).  Quiescence is
+ * detected with a debounce: quit once nothing has changed for a while.
+ */
+
+static GMainLoop* loop;
+static guint quiet_tag;
+
+static gboolean
+quiesced_cb(gpointer data)
+{
+        quiet_tag = 0;
+        g_main_loop_quit(loop);
+        return G_SOURCE_REMOVE;
+}
+
+static void
+bump_quiesce_timeout(void)
+{
+        if (quiet_tag != 0)
+                g_source_remove(quiet_tag);
+        quiet_tag = g_timeout_add(50, quiesced_cb, nullptr);
+}
+
+static void
+contents_changed_cb(VteTerminal* terminal,
+                    gpointer data)
+{
+        bump_quiesce_timeout();
+}
+
+static gboolean
+feed_fd(VteTerminal* terminal,
+        int fd)
+{
+        char buf[65536];
+        gssize len;
+
+        for (;;) {
+                do {
+                        len = read(fd, buf, sizeof(buf));
+                } while (len == -1 && errno == EINTR);
+                if (len == -1)
+                        return FALSE;
+                if (len == 0)
+                        return TRUE;
+
+                vte_terminal_feed(terminal, buf, len);
+
+                /* Let the terminal catch up so the unprocessed input
+                 * doesn't grow without bound on huge files. */
+                while (g_main_context_iteration(nullptr, FALSE))
+                        ;
+        }
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        setlocale(LC_ALL, "");
+
+        GError* error = nullptr;
+        auto context = g_option_context_new("[FILE…] — drive a headless terminal");
+        g_option_context_add_main_entries(context, entries, nullptr);
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("Failed to parse arguments: %s\n", error->message);
+                g_error_free(error);
+                return 1;
+        }
+        g_option_context_free(context);
+
+        /* This is expected to fail when there's no display; widget
+         * creation only needs the type system, which it set up anyway. */
+        gtk_init_check(&argc, &argv);
+
+        auto terminal = VTE_TERMINAL(vte_terminal_new());
+        g_object_ref_sink(terminal);
+        vte_terminal_set_size(terminal, opt_columns, opt_rows);
+        vte_terminal_set_scrollback_lines(terminal, opt_scrollback);
+        g_signal_connect(terminal, "contents-changed",
+                         G_CALLBACK(contents_changed_cb), nullptr);
+
+        if (argc <= 1) {
+                if (!feed_fd(terminal, STDIN_FILENO)) {
+                        g_printerr("Failed to read stdin: %s\n", g_strerror(errno));
+                        return 1;
+                }
+        } else {
+                for (auto i = 1; i < argc; i++) {
+                        auto fd = open(argv[i], O_RDONLY);
+                        if (fd == -1 || !feed_fd(terminal, fd)) {
+                                g_printerr("Failed to read %s: %s\n", argv[i], g_strerror(errno));
+                                return 1;
+                        }
+                        close(fd);
+                }
+        }
+
+        /* Drain whatever is still queued. */
+        loop = g_main_loop_new(nullptr, FALSE);
+        bump_quiesce_timeout();
+        g_main_loop_run(loop);
+        g_main_loop_unref(loop);
+
+        if (!opt_quiet) {
+                auto text = vte_terminal_get_text(terminal, nullptr, nullptr, nullptr);
+                if (text != nullptr) {
+                        g_print("%s", text);
+                        g_free(text);
+                }
+        }
+
+        if (opt_search != nullptr) {
+                auto regex = vte_regex_new_for_search(opt_search, strlen(opt_search),
+                                                      PCRE2_MULTILINE | PCRE2_UTF | PCRE2_NO_UTF_CHECK,
+                                                      &error);
+                if (regex == nullptr) {
+                        g_printerr("Failed to compile regex: %s\n", error->message);
+                        g_error_free(error);
+                        return 1;
+                }
+                vte_terminal_search_set_regex(terminal, regex, 0);
+                vte_terminal_search_set_wrap_around(terminal, FALSE);
+                vte_regex_unref(regex);
+
+                /* Walk backwards from the bottom through the entire history. */
+                auto matches = 0;
+                while (vte_terminal_search_find_previous(terminal))
+                        matches++;
+                g_print("%d matches\n", matches);
+        }
+
+        g_object_unref(terminal);
+        return 0;
+}
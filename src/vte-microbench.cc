@@ -0,0 +1,287 @@
+/*
+ * Copyright © 2019 the VTE contributors
+ *
+ * This programme is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This programme is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * vte-microbench: unit-level microbenchmarks for vte's data structures.
+ *
+ * Times tight loops over one layer at a time — Ring append/freeze/thaw,
+ * vteunistr interning, VteRowData cell writes, Tabstops lookups — and
+ * summarizes the runs statistically.  The end-to-end numbers from
+ * vte-bench and parser-cat tell you *that* ingest regressed; these tell
+ * you *which* layer did.  Registered as meson benchmarks, so
+ * `meson test --benchmark` runs them per-commit.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <cmath>
+#include <cstdint>
+
+#include <vector>
+
+#include <glib.h>
+
+#include "debug.h"
+#include "ring.hh"
+#include "tabstops.hh"
+#include "vterowdata.hh"
+#include "vteunistr.h"
+
+/* Accumulator the optimiser cannot discard. */
+static volatile uint64_t g_sink;
+
+/*
+ * Ring: append rows until well past the writable window so that rows
+ * freeze onto the streams, then read back with a stride that defeats
+ * the thawed-row cache, so thaws are real.
+ */
+static uint64_t
+bench_ring(void)
+{
+        auto constexpr k_rows = uint64_t{100000};
+
+        vte::base::Ring ring{2500, true};
+        ring.set_visible_rows(24);
+
+        for (uint64_t i = 0; i < k_rows; ++i) {
+                auto row = ring.append(0);
+                _vte_row_data_fill(row, &basic_cell, 79);
+
+                VteCell cell = basic_cell;
+                cell.c = 'A' + (i % 26);
+                cell.attr.set_columns(1);
+                _vte_row_data_append(row, &cell);
+        }
+
+        uint64_t reads = 0;
+        uint64_t sink = 0;
+        for (auto pos = ring.delta(); pos < ring.next(); pos += 37) {
+                auto const* row = ring.index(pos);
+                sink += row != nullptr ? _vte_row_data_length(row) : 0;
+                ++reads;
+        }
+        g_sink += sink;
+
+        return k_rows + reads;
+}
+
+/*
+ * vteunistr: intern base-plus-combining sequences.  The pool is global
+ * and survives across runs, so after the first run this times the
+ * lookup (cache-hit) path, which is also the hot path in a real
+ * terminal.
+ */
+static uint64_t
+bench_unistr(void)
+{
+        auto constexpr k_iterations = uint64_t{500000};
+
+        uint64_t sink = 0;
+        for (uint64_t i = 0; i < k_iterations; ++i) {
+                vteunistr s = 'a' + (i % 26);
+                s = _vte_unistr_append_unichar(s, 0x0300 + (i % 16));
+                s = _vte_unistr_append_unichar(s, 0x0301);
+                sink += s;
+        }
+        g_sink += sink;
+
+        return 2 * k_iterations;
+}
+
+/*
+ * VteRowData: clear and refill an 80-column row, so every append goes
+ * through the capacity check and the arena behind it.
+ */
+static uint64_t
+bench_rowdata(void)
+{
+        auto constexpr k_rows = uint64_t{50000};
+        auto constexpr k_columns = gulong{80};
+
+        VteRowData row;
+        _vte_row_data_init(&row);
+
+        VteCell cell = basic_cell;
+        cell.c = 'x';
+        cell.attr.set_columns(1);
+
+        for (uint64_t i = 0; i < k_rows; ++i) {
+                _vte_row_data_clear(&row);
+                for (gulong col = 0; col < k_columns; ++col)
+                        _vte_row_data_append(&row, &cell);
+        }
+
+        _vte_row_data_fini(&row);
+
+        return k_rows * k_columns;
+}
+
+/*
+ * Tabstops: get_next() from every column of a wide grid with default
+ * tabstops, the lookup done for each HT.
+ */
+static uint64_t
+bench_tabstops(void)
+{
+        auto constexpr k_iterations = uint64_t{2000000};
+
+        vte::terminal::Tabstops tabstops{512, true, 8};
+
+        uint64_t sink = 0;
+        for (uint64_t i = 0; i < k_iterations; ++i)
+                sink += tabstops.get_next(i % 511);
+        g_sink += sink;
+
+        return k_iterations;
+}
+
+struct Bench {
+        char const* name;
+        uint64_t (*run)(void);
+};
+
+static Bench const benches[] = {
+        { "ring", bench_ring },
+        { "unistr", bench_unistr },
+        { "rowdata", bench_rowdata },
+        { "tabstops", bench_tabstops },
+};
+
+struct Result {
+        char const* name;
+        uint64_t ops;
+        int runs;
+        double best_ns;   /* per op */
+        double avg_ns;
+        double stddev_ns;
+};
+
+static Result
+run_bench(Bench const& bench,
+          int repeat)
+{
+        Result result{bench.name, 0, repeat, 0., 0., 0.};
+
+        /* Warm up caches, pools and lazily created streams. */
+        result.ops = bench.run();
+
+        std::vector<double> samples;
+        for (auto i = 0; i < repeat; ++i) {
+                auto const start_time = g_get_monotonic_time();
+                auto const ops = bench.run();
+                auto const time_spent = g_get_monotonic_time() - start_time;
+
+                samples.push_back(double(time_spent) * 1000. / double(ops));
+        }
+
+        result.best_ns = samples[0];
+        for (auto const sample : samples) {
+                result.best_ns = MIN(result.best_ns, sample);
+                result.avg_ns += sample;
+        }
+        result.avg_ns /= samples.size();
+
+        for (auto const sample : samples)
+                result.stddev_ns += (sample - result.avg_ns) * (sample - result.avg_ns);
+        result.stddev_ns = std::sqrt(result.stddev_ns / samples.size());
+
+        return result;
+}
+
+static void
+print_results(std::vector<Result> const& results,
+              bool json)
+{
+        if (json) {
+                g_print("[");
+                for (size_t i = 0; i < results.size(); ++i) {
+                        auto const& r = results[i];
+                        g_print("%s\n"
+                                "  {\"bench\": \"%s\", \"ops\": %" G_GUINT64_FORMAT ", "
+                                "\"runs\": %d, "
+                                "\"best_ns_per_op\": %.2f, "
+                                "\"avg_ns_per_op\": %.2f, "
+                                "\"stddev_ns_per_op\": %.2f}",
+                                i == 0 ? "" : ",",
+                                r.name, r.ops, r.runs,
+                                r.best_ns, r.avg_ns, r.stddev_ns);
+                }
+                g_print("\n]\n");
+                return;
+        }
+
+        g_print("%-10s %12s %6s %12s %12s %10s\n",
+                "bench", "ops/run", "runs", "best ns/op", "avg ns/op", "σ ns/op");
+        for (auto const& r : results) {
+                g_print("%-10s %12" G_GUINT64_FORMAT " %6d %12.2f %12.2f %10.2f\n",
+                        r.name, r.ops, r.runs,
+                        r.best_ns, r.avg_ns, r.stddev_ns);
+        }
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        setlocale(LC_ALL, "");
+        _vte_debug_init();
+
+        gboolean json = false;
+        int repeat = 10;
+        char* bench = nullptr;
+        GOptionEntry const entries[] = {
+                { "bench", 'b', 0, G_OPTION_ARG_STRING, &bench,
+                  "Only run BENCH (ring, unistr, rowdata, tabstops)", "BENCH" },
+                { "json", 'j', 0, G_OPTION_ARG_NONE, &json,
+                  "Output results as JSON", nullptr },
+                { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+                  "Run each benchmark COUNT times (default 10)", "COUNT" },
+                { nullptr },
+        };
+
+        auto context = g_option_context_new("— data structure microbenchmarks");
+        g_option_context_set_help_enabled(context, true);
+        g_option_context_add_main_entries(context, entries, nullptr);
+
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("Failed to parse arguments: %s\n", error->message);
+                g_error_free(error);
+                g_option_context_free(context);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        std::vector<Result> results;
+        for (auto const& b : benches) {
+                if (bench != nullptr && !g_str_equal(bench, b.name))
+                        continue;
+                results.push_back(run_bench(b, repeat));
+        }
+        g_free(bench);
+
+        if (results.empty()) {
+                g_printerr("Unknown benchmark\n");
+                return EXIT_FAILURE;
+        }
+
+        print_results(results, json);
+
+        return EXIT_SUCCESS;
+}
@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <zlib.h>
 #include <errno.h>
 #include <fcntl.h>
 #ifdef HAVE_SYS_TERMIOS_H
@@ -31,6 +33,7 @@
 #endif
 
 #include <glib.h>
+#include <glib-unix.h>
 #include <glib/gi18n-lib.h>
 
 #include <vte/vte.h>
@@ -44,6 +47,8 @@
 #include "ringview.hh"
 #include "caps.hh"
 #include "widget.hh"
+#include "widthtable.hh"
+#include "stats.hh"
 
 #ifdef HAVE_WCHAR_H
 #include <wchar.h>
@@ -66,6 +71,7 @@
 #include "vtepty-private.h"
 #include "vtegtk.hh"
 
+#include <algorithm>
 #include <new> /* placement new */
 
 #ifndef HAVE_ROUND
@@ -107,15 +113,23 @@ _vte_unichar_width(gunichar c, int utf8_ambiguous_width)
 {
         if (G_LIKELY (c < 0x80))
                 return 1;
-        if (G_UNLIKELY (g_unichar_iszerowidth (c)))
+        if (G_UNLIKELY (c >= 0x110000))
+                return 1;
+
+        /* O(1) two-level table lookup instead of the binary searches of
+         * g_unichar_iszerowidth() / g_unichar_iswide() / g_unichar_iswide_cjk();
+         * see widthtable-generate.py. */
+        auto const page = width_table_pages[width_table_index[c >> 8]];
+        switch ((page[(c >> 2) & 0x3f] >> (2 * (c & 3))) & 3) {
+        case VTE_WIDTH_ZEROWIDTH:
                 return 0;
-        if (G_UNLIKELY (g_unichar_iswide (c)))
+        case VTE_WIDTH_WIDE:
                 return 2;
-        if (G_LIKELY (utf8_ambiguous_width == 1))
+        case VTE_WIDTH_AMBIGUOUS:
+                return utf8_ambiguous_width;
+        default:
                 return 1;
-        if (G_UNLIKELY (g_unichar_iswide_cjk (c)))
-                return 2;
-        return 1;
+        }
 }
 
 static void
@@ -164,6 +178,35 @@ Terminal::ring_remove(vte::grid::row_t position)
 	_vte_ring_remove(m_screen->row_data, position);
 }
 
+/* Rotate the rows in [start, end] by amount (positive: down, negative: up),
+ * recycling the rows that wrap around as new, empty rows.  Equivalent to
+ * |amount| paired ring_remove()/ring_insert() calls, without the repeated
+ * shuffling of the writable window. */
+void
+Terminal::ring_rotate(vte::grid::row_t start,
+                      vte::grid::row_t end,
+                      vte::grid::row_t amount,
+                      bool fill)
+{
+	VteRing *ring = m_screen->row_data;
+
+        /* Make sure the region is filled, the rotation requires it. */
+        while (G_UNLIKELY (_vte_ring_next(ring) <= end))
+                ring_append(false);
+
+        _vte_ring_rotate(ring, start, end, amount, get_bidi_flags());
+
+        if (fill && m_color_defaults.attr.back() != VTE_DEFAULT_BG) {
+                /* Fill the recycled rows for bce, as ring_insert() would. */
+                auto const n = end - start + 1;
+                auto blank = amount > 0 ? MIN(amount, n) : MIN(-amount, n);
+                auto row = amount > 0 ? start : end - blank + 1;
+                for (; blank--; row++)
+                        _vte_row_data_fill (_vte_ring_index_writable(ring, row),
+                                            &m_color_defaults, m_column_count);
+        }
+}
+
 /* Reset defaults for character insertion. */
 void
 Terminal::reset_default_attributes(bool reset_hyperlink)
@@ -267,6 +310,7 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
 	_vte_debug_print (VTE_DEBUG_UPDATES,
                           "Invalidating rows %ld..%ld.\n",
                           row_start, row_end);
+        vte::stats::add(vte::stats::counters.invalidations);
 	_vte_debug_print (VTE_DEBUG_WORK, "?");
 
         /* Scrolled back, visible parts didn't change. */
@@ -299,7 +343,28 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
 			"Invalidating pixels at (%d,%d)x(%d,%d).\n",
 			rect.x, rect.y, rect.width, rect.height);
 
+        frame_cache_mark_dirty(&rect);
+
 	if (m_active_terminals_link != nullptr) {
+                /* Merge equally wide rects with overlapping or touching
+                 * y ranges in place, keeping the per-frame damage a minimal
+                 * set of disjoint spans. SGR-heavy TUIs invalidate the same
+                 * rows over and over within one frame; without this the
+                 * array grows by one rect per call and the final region
+                 * union gets quadratic. */
+                guint i = 0;
+                while (i < m_update_rects->len) {
+                        cairo_rectangle_int_t *r = &g_array_index(m_update_rects, cairo_rectangle_int_t, i);
+                        if (r->x == rect.x && r->width == rect.width &&
+                            r->y <= yend && rect.y <= r->y + r->height) {
+                                rect.y = MIN(rect.y, r->y);
+                                yend = MAX(yend, r->y + r->height);
+                                rect.height = yend - rect.y;
+                                g_array_remove_index_fast(m_update_rects, i);
+                        } else {
+                                i++;
+                        }
+                }
                 g_array_append_val(m_update_rects, rect);
 		/* Wait a bit before doing any invalidation, just in
 		 * case updates are coming in really soon. */
@@ -325,10 +390,32 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
  * Note that row_end is inclusive. This is not as nice as end-exclusive,
  * but saves us from a +1 almost everywhere where this method is called.
  */
+/* Record that the contents of the given absolute rows (inclusive) may have
+ * changed, for the "contents-modified" signal. Unlike the invalidation
+ * methods this is about the data, not the rendering, so it accumulates
+ * even while unrealized or scrolled back. */
+void
+Terminal::contents_damaged(vte::grid::row_t row_start,
+                           vte::grid::row_t row_end)
+{
+        if (G_UNLIKELY (row_end < row_start))
+                return;
+
+        if (m_contents_damage_start == -1) {
+                m_contents_damage_start = row_start;
+                m_contents_damage_end = row_end;
+        } else {
+                m_contents_damage_start = MIN(m_contents_damage_start, row_start);
+                m_contents_damage_end = MAX(m_contents_damage_end, row_end);
+        }
+}
+
 void
 Terminal::invalidate_rows_and_context(vte::grid::row_t row_start,
                                       vte::grid::row_t row_end /* inclusive */)
 {
+        contents_damaged(row_start, row_end);
+
         if (G_UNLIKELY (!widget_realized()))
                 return;
 
@@ -377,6 +464,62 @@ Terminal::invalidate_rows_and_context(vte::grid::row_t row_start,
         invalidate_rows(row_start, row_end);
 }
 
+/* Invalidate just the cells the cursor is drawn over. This is only for
+ * rendering-only changes (blinking, focus), where the underlying data is
+ * intact and so the BiDi layout of the row can't change; data changes must
+ * go through invalidate_rows_and_context(). Falls back to the entire row
+ * when the cursor's visual position isn't cheaply available.
+ */
+void
+Terminal::invalidate_cursor_cells()
+{
+        auto row = m_screen->cursor.row;
+        auto col = std::min(m_screen->cursor.col, m_column_count - 1);
+
+        if (G_UNLIKELY (!widget_realized()))
+                return;
+
+        if (m_invalidated_all)
+                return;
+
+        /* The visual column requires the BiDi mapping from the ringview.
+         * If that's not up to date, don't update it just for this (it would
+         * cost far more than it saves), invalidate the whole row instead. */
+        if (!m_ringview.is_updated() ||
+            row < first_displayed_row() || row > last_displayed_row()) {
+                invalidate_row(row);
+                return;
+        }
+
+        auto vcol = m_ringview.get_bidirow(row)->log2vis(col);
+
+        _vte_debug_print (VTE_DEBUG_UPDATES,
+                          "Invalidating cursor cells in row %ld at visual column %ld.\n",
+                          row, vcol);
+
+        cairo_rectangle_int_t rect;
+        /* Two extra columns on each side cover the other half of a wide
+         * character whichever way it lies visually, glyph overhang, and the
+         * block cursor's outline. */
+        rect.x = (vcol - 2) * m_cell_width - 1;
+        rect.width = 5 * m_cell_width + 2;
+        rect.y = row_to_pixel(row) - std::max(cell_overflow_top(), VTE_LINE_WIDTH);
+        int yend = row_to_pixel(row + 1) + std::max(cell_overflow_bottom(), VTE_LINE_WIDTH);
+        rect.height = yend - rect.y;
+
+	if (m_active_terminals_link != nullptr) {
+                g_array_append_val(m_update_rects, rect);
+		add_update_timeout(this);
+	} else {
+                auto allocation = get_allocated_rect();
+                rect.x += allocation.x + m_padding.left;
+                rect.y += allocation.y + m_padding.top;
+                cairo_region_t *region = cairo_region_create_rectangle(&rect);
+		gtk_widget_queue_draw_region(m_widget, region);
+                cairo_region_destroy(region);
+	}
+}
+
 /* Convenience methods */
 void
 Terminal::invalidate_row(vte::grid::row_t row)
@@ -442,6 +585,7 @@ Terminal::invalidate_all()
 	/* replace invalid regions with one covering the whole terminal */
 	reset_update_rects();
 	m_invalidated_all = TRUE;
+        frame_cache_mark_all_dirty();
 
         if (m_active_terminals_link != nullptr) {
                 auto allocation = get_allocated_rect();
@@ -663,24 +807,152 @@ Terminal::invalidate_cursor_once(bool periodic)
 	}
 
 	if (m_modes_private.DEC_TEXT_CURSOR()) {
-                auto row = m_screen->cursor.row;
-
 		_vte_debug_print(VTE_DEBUG_UPDATES,
                                  "Invalidating cursor in row %ld.\n",
-                                 row);
-                invalidate_row(row);
+                                 m_screen->cursor.row);
+                invalidate_cursor_cells();
 	}
 }
 
-/* Invalidate the cursor repeatedly. */
-// FIXMEchpe this continually adds and removes the blink timeout. Find a better solution
+/* Process-wide blink ticker.
+ *
+ * Instead of every terminal running its own cursor and text blink
+ * timeouts, all blink timers in the process are multiplexed onto a
+ * single timeout source armed for the earliest deadline. Timers due
+ * within the same wakeup are dispatched together, so terminals blinking
+ * at the same cycle quickly converge onto one wakeup per half-cycle.
+ * The source only exists while at least one timer is registered. */
+
+enum {
+        BLINK_TIMER_CURSOR,
+        BLINK_TIMER_TEXT
+};
+
+struct blink_timer {
+        vte::terminal::Terminal *terminal;
+        int which;
+        gint64 deadline;  /* g_get_monotonic_time() */
+};
+
+static GList *g_blink_timers;
+static guint g_blink_ticker_tag;
+static gint64 g_blink_ticker_deadline;
+
+static gboolean blink_ticker_cb(gpointer data);
+
+/* Make sure the ticker source fires no later than the earliest
+ * registered deadline, or not at all if no timers are left. */
+static void
+blink_ticker_arm(gint64 now)
+{
+        gint64 deadline = G_MAXINT64;
+        GList *l;
+
+        if (g_blink_timers == NULL) {
+                if (g_blink_ticker_tag != 0) {
+                        g_source_remove(g_blink_ticker_tag);
+                        g_blink_ticker_tag = 0;
+                }
+                return;
+        }
+
+        for (l = g_blink_timers; l != NULL; l = l->next)
+                deadline = MIN(deadline, ((struct blink_timer *)l->data)->deadline);
+
+        if (g_blink_ticker_tag != 0) {
+                if (deadline >= g_blink_ticker_deadline)
+                        return;
+                g_source_remove(g_blink_ticker_tag);
+        }
+
+        g_blink_ticker_deadline = deadline;
+        g_blink_ticker_tag = g_timeout_add_full(G_PRIORITY_LOW,
+                                                MAX((deadline - now) / 1000, 0),
+                                                blink_ticker_cb,
+                                                NULL,
+                                                NULL);
+}
+
+static void
+blink_ticker_add(vte::terminal::Terminal *terminal,
+                 int which,
+                 gint timeout_ms)
+{
+        gint64 const now = g_get_monotonic_time();
+        struct blink_timer *timer;
+
+        timer = g_slice_new(struct blink_timer);
+        timer->terminal = terminal;
+        timer->which = which;
+        timer->deadline = now + (gint64)timeout_ms * 1000;
+        g_blink_timers = g_list_prepend(g_blink_timers, timer);
+
+        blink_ticker_arm(now);
+}
+
+static void
+blink_ticker_remove(vte::terminal::Terminal *terminal,
+                    int which)
+{
+        GList *l = g_blink_timers;
+
+        while (l != NULL) {
+                GList *next = l->next;
+                struct blink_timer *timer = (struct blink_timer *)l->data;
+
+                if (timer->terminal == terminal && timer->which == which) {
+                        g_blink_timers = g_list_delete_link(g_blink_timers, l);
+                        g_slice_free(struct blink_timer, timer);
+                }
+
+                l = next;
+        }
+
+        if (g_blink_timers == NULL && g_blink_ticker_tag != 0) {
+                g_source_remove(g_blink_ticker_tag);
+                g_blink_ticker_tag = 0;
+        }
+}
+
 static gboolean
-invalidate_cursor_periodic_cb(vte::terminal::Terminal* that)
+blink_ticker_cb(gpointer data)
 {
-        that->invalidate_cursor_periodic();
+        gint64 const now = g_get_monotonic_time();
+        GList *l = g_blink_timers;
+
+        g_blink_ticker_tag = 0;
+
+        /* Dispatch everything due within a millisecond, coalescing
+         * same-cycle timers into this wakeup. Dispatching may register
+         * new timers; g_list_prepend() leaves the rest of the walk
+         * untouched. */
+        while (l != NULL) {
+                GList *next = l->next;
+                struct blink_timer *timer = (struct blink_timer *)l->data;
+
+                if (timer->deadline <= now + 1000) {
+                        auto that = timer->terminal;
+                        auto const which = timer->which;
+
+                        g_blink_timers = g_list_delete_link(g_blink_timers, l);
+                        g_slice_free(struct blink_timer, timer);
+
+                        if (which == BLINK_TIMER_CURSOR) {
+                                that->invalidate_cursor_periodic();
+                        } else {
+                                that->m_text_blink_tag = 0;
+                                that->invalidate_all();
+                        }
+                }
+
+                l = next;
+        }
+
+        blink_ticker_arm(now);
         return G_SOURCE_REMOVE;
 }
 
+/* Invalidate the cursor repeatedly. */
 void
 Terminal::invalidate_cursor_periodic()
 {
@@ -698,11 +970,8 @@ Terminal::invalidate_cursor_periodic()
 		return;
         }
 
-	m_cursor_blink_tag = g_timeout_add_full(G_PRIORITY_LOW,
-                                                m_cursor_blink_cycle,
-                                                (GSourceFunc)invalidate_cursor_periodic_cb,
-                                                this,
-                                                NULL);
+	m_cursor_blink_tag = 1;
+	blink_ticker_add(this, BLINK_TIMER_CURSOR, m_cursor_blink_cycle);
 }
 
 /* Emit a "selection_changed" signal. */
@@ -746,7 +1015,7 @@ Terminal::queue_contents_changed()
 {
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Queueing `contents-changed'.\n");
-	m_contents_changed_pending = true;
+	m_pending_changes |= VTE_PENDING_CONTENTS_CHANGED;
 }
 
 //FIXMEchpe this has only one caller
@@ -755,7 +1024,7 @@ Terminal::queue_cursor_moved()
 {
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Queueing `cursor-moved'.\n");
-	m_cursor_moved_pending = true;
+	m_pending_changes |= VTE_PENDING_CURSOR_MOVED;
 }
 
 static gboolean
@@ -873,6 +1142,20 @@ Terminal::emit_text_scrolled(long delta)
 	g_signal_emit(m_terminal, signals[SIGNAL_TEXT_SCROLLED], 0, (int)delta);
 }
 
+/* Emit an "output-activity-changed" signal. */
+void
+Terminal::emit_output_activity_changed(bool active)
+{
+        if (G_UNLIKELY (m_in_destruction))
+                return;
+
+	_vte_debug_print(VTE_DEBUG_SIGNALS,
+			"Emitting `output-activity-changed' (%s).\n",
+                         active ? "active" : "quiescent");
+	g_signal_emit(m_terminal, signals[SIGNAL_OUTPUT_ACTIVITY_CHANGED], 0,
+                      (gboolean)active);
+}
+
 void
 Terminal::emit_copy_clipboard()
 {
@@ -906,6 +1189,13 @@ Terminal::deselect_all()
 		_vte_debug_print(VTE_DEBUG_SELECTION,
 				"Deselecting all text.\n");
 
+                /* The coordinates are about to go away; build any deferred
+                 * selection text now while they are still valid. */
+                for (auto sel = 0; sel < LAST_VTE_SELECTION; sel++) {
+                        if (m_selection_owned[sel])
+                                materialize_selection(VteSelection(sel));
+                }
+
                 m_selection_origin = m_selection_last = { -1, -1, 1 };
                 resolve_selection();
 
@@ -929,6 +1219,22 @@ Terminal::match_contents_clear()
 		g_array_free(m_match_attributes, TRUE);
 		m_match_attributes = nullptr;
 	}
+        match_span_cache_clear();
+        hyperlink_check_cache_clear();
+}
+
+/* Drop the cached per-line dingu match spans. */
+void
+Terminal::match_span_cache_clear()
+{
+        if (m_match_line_cache != nullptr) {
+                g_array_free(m_match_line_cache, TRUE);
+                m_match_line_cache = nullptr;
+        }
+        if (m_match_span_cache != nullptr) {
+                g_array_free(m_match_span_cache, TRUE);
+                m_match_span_cache = nullptr;
+        }
 }
 
 void
@@ -1032,6 +1338,7 @@ Terminal::regex_match_remove_all()
 	}
 	g_array_set_size(m_match_regexes, 0);
 
+        match_span_cache_clear();
 	match_hilite_clear();
 }
 
@@ -1052,6 +1359,7 @@ Terminal::regex_match_remove(int tag)
 		/* Remove this item and leave a hole in its place. */
                 regex_match_clear (regex);
 	}
+        match_span_cache_clear();
 	match_hilite_clear();
 }
 
@@ -1072,6 +1380,13 @@ Terminal::regex_match_add(struct vte_match_regex *new_regex_match)
                 }
         }
 
+        /* JIT the regex up front (no-op if PCRE2 lacks JIT support);
+         * hover matching scans every visible line with it.  All our scans
+         * pass PCRE2_PARTIAL_SOFT, so compile for that mode too. */
+        vte_regex_jit(new_regex_match->regex.regex,
+                      PCRE2_JIT_COMPLETE | PCRE2_JIT_PARTIAL_SOFT,
+                      nullptr);
+
         /* Set the tag to the insertion point. */
         new_regex_match->tag = ret;
 
@@ -1087,6 +1402,8 @@ Terminal::regex_match_add(struct vte_match_regex *new_regex_match)
 
         /* FIXMEchpe: match_hilite_clear() so we can redo the highlighting with the new regex added? */
 
+        match_span_cache_clear();
+
         return ret;
 }
 
@@ -1286,6 +1603,29 @@ Terminal::create_match_context()
         return match_context;
 }
 
+/*
+ * Returns this terminal's reusable match context, creating it and the
+ * accompanying match data and JIT stack on first use.  Hover matching
+ * runs on pointer motion and synchronous search on every keystroke of a
+ * search entry; recreating these objects around each scan is measurable.
+ * The JIT stack is assigned to the context so JITed regexes don't have
+ * to make do with the small machine-stack allowance.
+ */
+pcre2_match_context_8 *
+Terminal::ensure_match_context()
+{
+        if (G_LIKELY (m_match_context != nullptr))
+                return m_match_context;
+
+        m_match_context = create_match_context();
+        m_match_data = pcre2_match_data_create_8(256 /* should be plenty */, nullptr /* general context */);
+        m_jit_stack = pcre2_jit_stack_create_8(64 << 10, 256 << 10, nullptr /* general context */);
+        if (m_jit_stack != nullptr)
+                pcre2_jit_stack_assign_8(m_match_context, nullptr, m_jit_stack);
+
+        return m_match_context;
+}
+
 bool
 Terminal::match_check_pcre(
                  pcre2_match_data_8 *match_data,
@@ -1405,6 +1745,118 @@ Terminal::match_check_pcre(
         return false;
 }
 
+/* Collect all the matches of one dingu over a line of m_match_contents
+ * (from @sattr to @eattr), appending them to m_match_span_cache.
+ * The match loop mirrors match_check_pcre(), minus the cursor offset logic. */
+void
+Terminal::match_scan_pcre(
+                 pcre2_match_data_8 *match_data,
+                 pcre2_match_context_8 *match_context,
+                 VteRegex *regex,
+                 guint32 match_flags,
+                 gsize sattr,
+                 gsize eattr,
+                 int tag)
+{
+        int (* match_fn) (const pcre2_code_8 *,
+                          PCRE2_SPTR8, PCRE2_SIZE, PCRE2_SIZE, uint32_t,
+                          pcre2_match_data_8 *, pcre2_match_context_8 *);
+        gsize position, line_length;
+        const char *line;
+        int r = 0;
+
+        if (_vte_regex_get_jited(regex))
+                match_fn = pcre2_jit_match_8;
+        else
+                match_fn = pcre2_match_8;
+
+        line = m_match_contents;
+        line_length = eattr;
+
+        pcre2_set_offset_limit_8(match_context, eattr);
+        position = sattr;
+        while (position < eattr &&
+               ((r = match_fn(_vte_regex_get_pcre(regex),
+                              (PCRE2_SPTR8)line, line_length, /* subject, length */
+                              position, /* start offset */
+                              match_flags |
+                              PCRE2_NO_UTF_CHECK | PCRE2_NOTEMPTY | PCRE2_PARTIAL_SOFT /* FIXME: HARD? */,
+                              match_data,
+                              match_context)) >= 0 || r == PCRE2_ERROR_PARTIAL)) {
+                gsize rm_so, rm_eo;
+                gsize *ovector;
+
+                ovector = pcre2_get_ovector_pointer_8(match_data);
+                rm_so = ovector[0];
+                rm_eo = ovector[1];
+                if (G_UNLIKELY(rm_so == PCRE2_UNSET || rm_eo == PCRE2_UNSET))
+                        break;
+
+                /* The offsets should be "sane". We set NOTEMPTY, but check anyway */
+                if (G_UNLIKELY(position == rm_eo)) {
+                        /* rm_eo is before the end of subject string's length, so this is safe */
+                        position = g_utf8_next_char(line + rm_eo) - line;
+                        continue;
+                }
+
+                /* advance position */
+                position = rm_eo;
+
+                /* FIXME: do handle newline / partial matches at end of line/start of next line */
+                if (r == PCRE2_ERROR_PARTIAL)
+                        continue;
+
+                struct dingu_span span = { rm_so, rm_eo, tag };
+                g_array_append_val(m_match_span_cache, span);
+        }
+
+        if (G_UNLIKELY(r < PCRE2_ERROR_PARTIAL))
+                _vte_debug_print(VTE_DEBUG_REGEX, "Unexpected pcre2_match error code: %d\n", r);
+}
+
+/* Scan one line of m_match_contents with every dingu, in a single pass,
+ * recording all the match spans in registration order. */
+void
+Terminal::match_scan_line(gsize sattr,
+                          gsize eattr)
+{
+        struct vte_match_regex *regex;
+        struct dingu_scanned_line line;
+        pcre2_match_data_8 *match_data;
+        pcre2_match_context_8 *match_context;
+        guint i;
+
+	_vte_debug_print(VTE_DEBUG_REGEX,
+                         "Scanning line %" G_GSIZE_FORMAT "..%" G_GSIZE_FORMAT " for dingu matches.\n",
+                         sattr, eattr);
+
+        line.sattr = sattr;
+        line.eattr = eattr;
+        line.spans_offset = m_match_span_cache->len;
+
+        match_context = ensure_match_context();
+        match_data = m_match_data;
+
+	for (i = 0; i < m_match_regexes->len; i++) {
+		regex = &g_array_index(m_match_regexes,
+				       struct vte_match_regex,
+				       i);
+		/* Skip holes. */
+		if (regex->tag < 0) {
+			continue;
+		}
+
+                match_scan_pcre(match_data, match_context,
+                                regex->regex.regex,
+                                regex->regex.match_flags,
+                                sattr, eattr,
+                                regex->tag);
+	}
+
+        line.n_spans = m_match_span_cache->len - line.spans_offset;
+        g_array_append_val(m_match_line_cache, line);
+}
+
 char *
 Terminal::match_check_internal_pcre(vte::grid::column_t column,
                                               vte::grid::row_t row,
@@ -1412,12 +1864,9 @@ Terminal::match_check_internal_pcre(vte::grid::column_t column,
                                               gsize *start,
                                               gsize *end)
 {
-        struct vte_match_regex *regex;
-        guint i;
+        struct dingu_scanned_line const *line = nullptr;
 	gsize offset, sattr, eattr, start_blank, end_blank;
-        pcre2_match_data_8 *match_data;
-        pcre2_match_context_8 *match_context;
-        char *dingu_match = nullptr;
+        guint i;
 
 	_vte_debug_print(VTE_DEBUG_REGEX,
                          "Checking for pcre match at (%ld,%ld).\n", row, column);
@@ -1426,69 +1875,79 @@ Terminal::match_check_internal_pcre(vte::grid::column_t column,
                                     &offset, &sattr, &eattr))
                 return nullptr;
 
-	start_blank = sattr;
-	end_blank = eattr;
+        if (m_match_line_cache == nullptr) {
+                m_match_line_cache = g_array_new(FALSE, FALSE, sizeof(struct dingu_scanned_line));
+                m_match_span_cache = g_array_new(FALSE, FALSE, sizeof(struct dingu_span));
+        }
 
-        match_context = create_match_context();
-        match_data = pcre2_match_data_create_8(256 /* should be plenty */, NULL /* general context */);
+        /* Scan the whole line with every dingu once; until the contents or
+         * the set of dingus change, further checks on this line are mere
+         * lookups in the recorded spans. */
+        for (i = 0; i < m_match_line_cache->len; i++) {
+                auto const *l = &g_array_index(m_match_line_cache,
+                                               struct dingu_scanned_line,
+                                               i);
+                if (l->sattr == sattr) {
+                        line = l;
+                        break;
+                }
+        }
+        if (line == nullptr) {
+                match_scan_line(sattr, eattr);
+                line = &g_array_index(m_match_line_cache,
+                                      struct dingu_scanned_line,
+                                      m_match_line_cache->len - 1);
+        }
 
-	/* Now iterate over each regex we need to match against. */
-	for (i = 0; i < m_match_regexes->len; i++) {
-                gsize sblank, eblank;
+	start_blank = sattr;
+	end_blank = eattr;
 
-		regex = &g_array_index(m_match_regexes,
-				       struct vte_match_regex,
-				       i);
-		/* Skip holes. */
-		if (regex->tag < 0) {
-			continue;
-		}
+        /* The spans are grouped by dingu in registration order, so the first
+         * span containing the offset is the same one the old per-dingu match
+         * loop would have returned. */
+        for (i = 0; i < line->n_spans; i++) {
+                auto const *span = &g_array_index(m_match_span_cache,
+                                                  struct dingu_span,
+                                                  line->spans_offset + i);
 
-                if (match_check_pcre(match_data, match_context,
-                                     regex->regex.regex,
-                                     regex->regex.match_flags,
-                                     sattr, eattr, offset,
-                                     &dingu_match,
-                                     start, end,
-                                     &sblank, &eblank)) {
-                        _vte_debug_print(VTE_DEBUG_REGEX, "Matched dingu with tag %d\n", regex->tag);
-                        *tag = regex->tag;
-                        break;
+                /* If the pointer is in this substring, then we're done. */
+                if (offset >= span->start && offset < span->end) {
+                        _vte_debug_print(VTE_DEBUG_REGEX, "Matched dingu with tag %d\n", span->tag);
+                        *tag = span->tag;
+                        *start = span->start;
+                        *end = span->end - 1;
+                        return g_strndup(m_match_contents + span->start,
+                                         span->end - span->start);
                 }
 
-                if (sblank > start_blank) {
-                        start_blank = sblank;
+                if (offset >= span->end && span->end > start_blank) {
+                        start_blank = span->end;
                 }
-                if (eblank < end_blank) {
-                        end_blank = eblank;
+                if (offset < span->start && span->start < end_blank) {
+                        end_blank = span->start;
                 }
 	}
 
-        if (dingu_match == nullptr) {
-                /* If we get here, there was no dingu match.
-                 * Record smallest span where none of the dingus match.
-                 */
-                *start = start_blank;
-                *end = end_blank - 1;
+        /* If we get here, there was no dingu match.
+         * Record smallest span where none of the dingus match.
+         */
+        *start = start_blank;
+        *end = end_blank - 1;
 
-                _VTE_DEBUG_IF(VTE_DEBUG_REGEX) {
-                        struct _VteCharAttributes *_sattr, *_eattr;
-                        _sattr = &g_array_index(m_match_attributes,
-                                                struct _VteCharAttributes,
-                                                start_blank);
-                        _eattr = &g_array_index(m_match_attributes,
-                                                struct _VteCharAttributes,
-                                                end_blank - 1);
-                        g_printerr("No-match region from %" G_GSIZE_FORMAT "(%ld,%ld) to %" G_GSIZE_FORMAT "(%ld,%ld)\n",
-                                   start_blank, _sattr->column, _sattr->row,
-                                   end_blank - 1, _eattr->column, _eattr->row);
-                }
+        _VTE_DEBUG_IF(VTE_DEBUG_REGEX) {
+                struct _VteCharAttributes *_sattr, *_eattr;
+                _sattr = &g_array_index(m_match_attributes,
+                                        struct _VteCharAttributes,
+                                        start_blank);
+                _eattr = &g_array_index(m_match_attributes,
+                                        struct _VteCharAttributes,
+                                        end_blank - 1);
+                g_printerr("No-match region from %" G_GSIZE_FORMAT "(%ld,%ld) to %" G_GSIZE_FORMAT "(%ld,%ld)\n",
+                           start_blank, _sattr->column, _sattr->row,
+                           end_blank - 1, _eattr->column, _eattr->row);
         }
 
-        pcre2_match_data_free_8(match_data);
-        pcre2_match_context_free_8(match_context);
-
-	return dingu_match;
+	return nullptr;
 }
 
 /*
@@ -1828,6 +2287,16 @@ Terminal::rowcol_from_event(GdkEvent *event,
         return true;
 }
 
+/* Drop the cached hyperlink_check() resolution. */
+void
+Terminal::hyperlink_check_cache_clear()
+{
+        m_hyperlink_check_row = -1;
+        m_hyperlink_check_col = -1;
+        g_free(m_hyperlink_check_uri);
+        m_hyperlink_check_uri = nullptr;
+}
+
 char *
 Terminal::hyperlink_check(GdkEvent *event)
 {
@@ -1844,6 +2313,13 @@ Terminal::hyperlink_check(GdkEvent *event)
         if (!rowcol_from_event(event, &col, &row))
                 return NULL;
 
+        if (row == m_hyperlink_check_row && col == m_hyperlink_check_col) {
+                _vte_debug_print (VTE_DEBUG_HYPERLINK,
+                                  "hyperlink_check (cached): \"%s\"\n",
+                                  m_hyperlink_check_uri);
+                return g_strdup(m_hyperlink_check_uri);
+        }
+
         _vte_ring_get_hyperlink_at_position(m_screen->row_data, row, col, false, &hyperlink);
 
         if (hyperlink != NULL) {
@@ -1857,6 +2333,11 @@ Terminal::hyperlink_check(GdkEvent *event)
                           "hyperlink_check: \"%s\"\n",
                           hyperlink);
 
+        g_free(m_hyperlink_check_uri);
+        m_hyperlink_check_row = row;
+        m_hyperlink_check_col = col;
+        m_hyperlink_check_uri = g_strdup(hyperlink);
+
         return g_strdup(hyperlink);
 }
 
@@ -2025,9 +2506,39 @@ Terminal::emit_adjustment_changed()
 			m_screen->scroll_delta = v;
 			gtk_adjustment_set_value(m_vadjustment, delta);
 		}
+
+		prefetch_scrollback();
 	}
 }
 
+/* Warm the ring's thaw cache with the screenful the current scroll
+ * direction is about to reveal, so that the next scroll step paints from
+ * cached rows instead of re-parsing the frozen streams. Costs nothing
+ * when not scrolled into history: rows at or above the writable region
+ * are skipped by the ring. */
+void
+Terminal::prefetch_scrollback()
+{
+	long start, end;
+	auto const row = (long)ceil(m_screen->scroll_delta);
+	auto const delta = (long)_vte_ring_delta(m_screen->row_data);
+
+	if (m_scroll_direction < 0) {
+		start = row - m_row_count;
+		end = row;
+	} else if (m_scroll_direction > 0) {
+		start = row + m_row_count;
+		end = row + 2 * m_row_count;
+	} else
+		return;
+
+	start = MAX(start, delta);
+	if (start >= end)
+		return;
+
+	_vte_ring_prefetch(m_screen->row_data, start, end);
+}
+
 /* Queue an adjustment-changed signal to be delivered when convenient. */
 // FIXMEchpe this has just one caller, fold it into the call site
 void
@@ -2044,6 +2555,7 @@ Terminal::queue_adjustment_value_changed(double v)
                 _vte_debug_print(VTE_DEBUG_ADJ,
                                  "Adjustment value changed to %f\n",
                                  v);
+		m_scroll_direction = v < m_screen->scroll_delta ? -1 : 1;
 		m_screen->scroll_delta = v;
 		m_adjustment_value_changed_pending = true;
 		add_update_timeout(this);
@@ -2181,14 +2693,24 @@ Terminal::set_encoding(char const* codeset)
                 m_encoding = g_intern_string(codeset);
 
                 /* Convert any buffered output bytes. */
-                if ((_vte_byte_array_length(m_outgoing) > 0) &&
+                if (!m_outgoing_queue.empty() &&
                     (old_codeset != nullptr)) {
                         char *obuf1, *obuf2;
                         gsize bytes_written;
 
+                        /* Gather the pending segments into one buffer. */
+                        GString *pending = g_string_new(nullptr);
+                        gsize start = m_outgoing_start;
+                        for (auto const& chunk : m_outgoing_queue) {
+                                g_string_append_len(pending,
+                                                    (char const*)chunk->data + start,
+                                                    chunk->len - start);
+                                start = 0;
+                        }
+
                         /* Convert back to UTF-8. */
-                        obuf1 = g_convert((char *)m_outgoing->data,
-                                          _vte_byte_array_length(m_outgoing),
+                        obuf1 = g_convert(pending->str,
+                                          pending->len,
                                           "UTF-8",
                                           old_codeset,
                                           NULL,
@@ -2204,13 +2726,15 @@ Terminal::set_encoding(char const* codeset)
                                                   &bytes_written,
                                                   NULL);
                                 if (obuf2 != NULL) {
-                                        _vte_byte_array_clear(m_outgoing);
-                                        _vte_byte_array_append(m_outgoing,
-                                                               obuf2, bytes_written);
+                                        m_outgoing_queue.clear();
+                                        m_outgoing_start = 0;
+                                        outgoing_queue_append((guint8 const*)obuf2,
+                                                              bytes_written);
                                         g_free(obuf2);
                                 }
                                 g_free(obuf1);
                         }
+                        g_string_free(pending, TRUE);
                 }
         }
 
@@ -2408,6 +2932,7 @@ Terminal::set_color(int entry,
         }
         palette_color->sources[source].is_set = TRUE;
         palette_color->sources[source].color = proposed;
+        m_color_generation++;
 
 	/* If we're not realized yet, there's nothing else to do. */
 	if (!widget_realized())
@@ -2437,6 +2962,7 @@ Terminal::reset_color(int entry,
                 return;
         }
         palette_color->sources[source].is_set = FALSE;
+        m_color_generation++;
 
 	/* If we're not realized yet, there's nothing else to do. */
 	if (!widget_realized())
@@ -2886,9 +3412,8 @@ Terminal::cursor_down(bool explicit_sequence)
                                  * we're about to tear apart the contents. */
                                 set_hard_wrapped(start - 1);
                                 set_hard_wrapped(end);
-                                /* Scroll by removing a line and inserting a new one. */
-				ring_remove(start);
-				ring_insert(end, true);
+                                /* Scroll by rotating the region up one row. */
+                                ring_rotate(start, end, -1, true);
                                 /* Repaint the affected lines. No need to extend,
                                  * set_hard_wrapped() took care of invalidating
                                  * the context lines if necessary. */
@@ -2942,6 +3467,7 @@ Terminal::restore_cursor(VteScreen *screen__)
 
         m_modes_private.set_DEC_REVERSE_IMAGE(screen__->saved.reverse_mode);
         m_modes_private.set_DEC_ORIGIN(screen__->saved.origin_mode);
+        update_addressing_context();
 
         m_defaults = screen__->saved.defaults;
         m_color_defaults = screen__->saved.color_defaults;
@@ -2969,6 +3495,81 @@ Terminal::save_cursor(VteScreen *screen__)
         screen__->saved.character_replacement = m_character_replacement;
 }
 
+/* DEC Special Character and Line Drawing Set.  VT100 and higher (per XTerm docs). */
+static gunichar const line_drawing_map[31] = {
+        0x25c6,  /* ` => diamond */
+        0x2592,  /* a => checkerboard */
+        0x2409,  /* b => HT symbol */
+        0x240c,  /* c => FF symbol */
+        0x240d,  /* d => CR symbol */
+        0x240a,  /* e => LF symbol */
+        0x00b0,  /* f => degree */
+        0x00b1,  /* g => plus/minus */
+        0x2424,  /* h => NL symbol */
+        0x240b,  /* i => VT symbol */
+        0x2518,  /* j => downright corner */
+        0x2510,  /* k => upright corner */
+        0x250c,  /* l => upleft corner */
+        0x2514,  /* m => downleft corner */
+        0x253c,  /* n => cross */
+        0x23ba,  /* o => scan line 1/9 */
+        0x23bb,  /* p => scan line 3/9 */
+        0x2500,  /* q => horizontal line (also scan line 5/9) */
+        0x23bc,  /* r => scan line 7/9 */
+        0x23bd,  /* s => scan line 9/9 */
+        0x251c,  /* t => left t */
+        0x2524,  /* u => right t */
+        0x2534,  /* v => bottom t */
+        0x252c,  /* w => top t */
+        0x2502,  /* x => vertical line */
+        0x2264,  /* y => <= */
+        0x2265,  /* z => >= */
+        0x03c0,  /* { => pi */
+        0x2260,  /* | => not equal */
+        0x00a3,  /* } => pound currency sign */
+        0x00b7,  /* ~ => bullet */
+};
+
+/* Map a single character through the active charset; identity unless a
+ * 94/96-charset replacement is in effect. */
+static inline gunichar
+charset_map_char(VteCharacterReplacement replacement,
+                 gunichar c)
+{
+        if (replacement == VTE_CHARACTER_REPLACEMENT_LINE_DRAWING) {
+                if (c >= 96 && c <= 126)
+                        return line_drawing_map[c - 96];
+        } else if (replacement == VTE_CHARACTER_REPLACEMENT_BRITISH) {
+                if (G_UNLIKELY (c == '#'))
+                        return 0x00a3;  /* pound sign */
+        }
+        return c;
+}
+
+/* Whether cells [col, col + columns) of @row already hold character @c
+ * with attributes @attr (head cell) plus its wide-char fragments; the
+ * structs are packed, so bytewise comparison is exact. */
+static bool
+row_cells_equal(VteRowData const* row,
+                long col,
+                gunichar c,
+                VteCellAttr const& attr,
+                int columns)
+{
+        VteCell cmp;
+        cmp.c = c;
+        cmp.attr = attr;
+        if (memcmp(&row->cells[col], &cmp, sizeof(cmp)) != 0)
+                return false;
+
+        cmp.attr.set_fragment(true);
+        for (int i = 1; i < columns; i++)
+                if (memcmp(&row->cells[col + i], &cmp, sizeof(cmp)) != 0)
+                        return false;
+
+        return true;
+}
+
 /* Insert a single character into the stored data array. */
 void
 Terminal::insert_char(gunichar c,
@@ -2982,52 +3583,14 @@ Terminal::insert_char(gunichar c,
 	bool line_wrapped = false; /* cursor moved before char inserted */
         gunichar c_unmapped = c;
 
-        /* DEC Special Character and Line Drawing Set.  VT100 and higher (per XTerm docs). */
-        static const gunichar line_drawing_map[31] = {
-                0x25c6,  /* ` => diamond */
-                0x2592,  /* a => checkerboard */
-                0x2409,  /* b => HT symbol */
-                0x240c,  /* c => FF symbol */
-                0x240d,  /* d => CR symbol */
-                0x240a,  /* e => LF symbol */
-                0x00b0,  /* f => degree */
-                0x00b1,  /* g => plus/minus */
-                0x2424,  /* h => NL symbol */
-                0x240b,  /* i => VT symbol */
-                0x2518,  /* j => downright corner */
-                0x2510,  /* k => upright corner */
-                0x250c,  /* l => upleft corner */
-                0x2514,  /* m => downleft corner */
-                0x253c,  /* n => cross */
-                0x23ba,  /* o => scan line 1/9 */
-                0x23bb,  /* p => scan line 3/9 */
-                0x2500,  /* q => horizontal line (also scan line 5/9) */
-                0x23bc,  /* r => scan line 7/9 */
-                0x23bd,  /* s => scan line 9/9 */
-                0x251c,  /* t => left t */
-                0x2524,  /* u => right t */
-                0x2534,  /* v => bottom t */
-                0x252c,  /* w => top t */
-                0x2502,  /* x => vertical line */
-                0x2264,  /* y => <= */
-                0x2265,  /* z => >= */
-                0x03c0,  /* { => pi */
-                0x2260,  /* | => not equal */
-                0x00a3,  /* } => pound currency sign */
-                0x00b7,  /* ~ => bullet */
-        };
+        m_text_changed = false;
 
         insert |= m_modes_ecma.IRM();
 
 	/* If we've enabled the special drawing set, map the characters to
 	 * Unicode. */
-        if (G_UNLIKELY (*m_character_replacement == VTE_CHARACTER_REPLACEMENT_LINE_DRAWING)) {
-                if (c >= 96 && c <= 126)
-                        c = line_drawing_map[c - 96];
-        } else if (G_UNLIKELY (*m_character_replacement == VTE_CHARACTER_REPLACEMENT_BRITISH)) {
-                if (G_UNLIKELY (c == '#'))
-                        c = 0x00a3;  /* pound sign */
-        }
+        if (G_UNLIKELY (*m_character_replacement != VTE_CHARACTER_REPLACEMENT_NONE))
+                c = charset_map_char(*m_character_replacement, c);
 
 	/* Figure out how many columns this character should occupy. */
         columns = _vte_unichar_width(c, m_utf8_ambiguous_width);
@@ -3132,17 +3695,29 @@ Terminal::insert_char(gunichar c,
 	row = ensure_cursor();
 	g_assert(row != NULL);
 
+        attr = m_defaults.attr;
+	attr.set_columns(columns);
+
 	if (insert) {
                 cleanup_fragments(col, col);
-		for (i = 0; i < columns; i++)
-                        _vte_row_data_insert (row, col + i, &basic_cell);
+                _vte_row_data_insert_cells (row, col, &basic_cell, columns);
 	} else {
+                /* If the row already holds exactly these cells, skip the
+                 * write and report no change; full-screen applications
+                 * rewrite mostly-unchanged cells at their refresh rate. */
+                if (!line_wrapped &&
+                    !row->fill_pending &&
+                    col + columns <= (long)_vte_row_data_length (row) &&
+                    row_cells_equal(row, col, c, attr, columns)) {
+                        m_screen->cursor.col = col + columns;
+                        goto not_inserted;
+                }
+
                 cleanup_fragments(col, col + columns);
 		_vte_row_data_fill (row, &basic_cell, col + columns);
 	}
 
-        attr = m_defaults.attr;
-	attr.set_columns(columns);
+        row->attr.blink_maybe |= attr.blink();
 
 	{
 		VteCell *pcell = _vte_row_data_get_writable (row, col);
@@ -3166,13 +3741,15 @@ Terminal::insert_char(gunichar c,
         m_screen->cursor.col = col;
 
 done:
+        m_text_changed = true;
+
         /* Signal that this part of the window needs drawing. */
         if (G_UNLIKELY (invalidate_now)) {
                 invalidate_row_and_context(m_screen->cursor.row);
         }
 
 	/* We added text, so make a note of it. */
-	m_text_inserted_flag = TRUE;
+	m_pending_changes |= VTE_PENDING_TEXT_INSERTED;
 
 not_inserted:
 	_vte_debug_print(VTE_DEBUG_ADJ|VTE_DEBUG_PARSER,
@@ -3182,6 +3759,153 @@ not_inserted:
         m_line_wrapped = line_wrapped;
 }
 
+/* Insert a run of width-1, non-combining, non-NUL characters into the
+ * stored data array. The checks that insert_char() performs per character
+ * but that are invariant across such a run (insert mode, character
+ * replacement) are hoisted out, and autowrap, row lookup and fragment
+ * cleanup are done once per row segment instead of once per character.
+ *
+ * The caller is responsible for ensuring that every character in the run
+ * has _vte_unichar_width() == 1; in particular, printable ASCII always
+ * qualifies.
+ */
+void
+Terminal::insert_text_run(gunichar const* chars,
+                          int n_chars)
+{
+        if (G_UNLIKELY(n_chars == 0))
+                return;
+
+        /* Insert mode changes the cell layout per character; take the
+         * generic path. */
+        if (G_UNLIKELY(m_modes_ecma.IRM())) {
+                auto changed = false;
+                for (int i = 0; i < n_chars; i++) {
+                        insert_char(chars[i], false, false);
+                        changed = changed || m_text_changed;
+                }
+                m_text_changed = changed;
+                return;
+        }
+
+        /* The active charset is invariant across the run; translate each
+         * span through it below instead of dropping to per-character
+         * dispatch.  All its mappings are width-1, so the run stays
+         * eligible for this path. */
+        auto const replacement = *m_character_replacement;
+
+        bool line_wrapped = false;
+        bool text_changed = false;
+
+        _vte_debug_print(VTE_DEBUG_PARSER,
+                         "Inserting run of %d chars (%ld, %ld), delta = %ld; ",
+                         n_chars, m_screen->cursor.col, (long)m_screen->cursor.row,
+                         (long)m_screen->insert_delta);
+
+        m_last_graphic_character = charset_map_char(replacement, chars[n_chars - 1]);
+
+        while (n_chars > 0) {
+                long col = m_screen->cursor.col;
+
+                /* If we're autowrapping here, do it; once per row segment. */
+                if (G_UNLIKELY(col + 1 > m_column_count)) {
+                        if (m_modes_private.DEC_AUTOWRAP()) {
+                                _vte_debug_print(VTE_DEBUG_ADJ,
+                                                 "Autowrapping before run segment\n");
+                                col = m_screen->cursor.col = 0;
+                                /* Mark this line as soft-wrapped. */
+                                auto prev_row = ensure_row();
+                                set_soft_wrapped(m_screen->cursor.row);
+                                cursor_down(false);
+                                ensure_row();
+                                apply_bidi_attributes(m_screen->cursor.row, prev_row->attr.bidi_flags, VTE_BIDI_FLAG_ALL);
+                                /* The soft-wrap flag changed the previous row */
+                                text_changed = true;
+                        } else {
+                                /* Don't wrap, stay at the rightmost column.
+                                 * Only the last character of the run remains
+                                 * visible there. */
+                                col = m_screen->cursor.col = m_column_count - 1;
+                        }
+                        line_wrapped = true;
+                }
+
+                int const len = MIN((long)n_chars, m_column_count - col);
+
+                /* Make sure we have enough rows to hold this data. */
+                VteRowData *row = ensure_cursor();
+                g_assert(row != NULL);
+
+                VteCellAttr attr = m_defaults.attr;
+                attr.set_columns(1);
+
+                /* If the span already holds exactly these cells, skip the
+                 * write; the damage tracking in process_incoming() then
+                 * skips the repaint too. */
+                if (!row->fill_pending &&
+                    col + len <= (long)_vte_row_data_length (row)) {
+                        int i;
+                        for (i = 0; i < len; i++) {
+                                auto const cc = G_LIKELY(replacement == VTE_CHARACTER_REPLACEMENT_NONE)
+                                                        ? chars[i]
+                                                        : charset_map_char(replacement, chars[i]);
+                                VteCell const* pcell = &row->cells[col + i];
+                                if (pcell->c != cc ||
+                                    memcmp(&pcell->attr, &attr, sizeof(attr)) != 0)
+                                        break;
+                        }
+                        if (i == len) {
+                                m_screen->cursor.col = col + len;
+                                chars += len;
+                                n_chars -= len;
+                                continue;
+                        }
+                }
+
+                cleanup_fragments(col, col + len);
+                _vte_row_data_fill (row, &basic_cell, col + len);
+
+                row->attr.blink_maybe |= attr.blink();
+                text_changed = true;
+
+                if (G_LIKELY(replacement == VTE_CHARACTER_REPLACEMENT_NONE)) {
+                        for (int i = 0; i < len; i++) {
+                                VteCell *pcell = _vte_row_data_get_writable (row, col + i);
+                                pcell->c = chars[i];
+                                pcell->attr = attr;
+                        }
+                } else {
+                        /* Translate the span through the active charset. */
+                        for (int i = 0; i < len; i++) {
+                                VteCell *pcell = _vte_row_data_get_writable (row, col + i);
+                                pcell->c = charset_map_char(replacement, chars[i]);
+                                pcell->attr = attr;
+                        }
+                }
+
+                if (_vte_row_data_length (row) > m_column_count)
+                        cleanup_fragments(m_column_count, _vte_row_data_length (row));
+                _vte_row_data_shrink (row, m_column_count);
+
+                m_screen->cursor.col = col + len;
+
+                chars += len;
+                n_chars -= len;
+        }
+
+        if (text_changed) {
+                /* We added text, so make a note of it. */
+                m_pending_changes |= VTE_PENDING_TEXT_INSERTED;
+        }
+        m_text_changed = text_changed;
+
+        _vte_debug_print(VTE_DEBUG_ADJ|VTE_DEBUG_PARSER,
+                         "insertion delta => %ld.\n",
+                         (long)m_screen->insert_delta);
+
+        m_line_wrapped = line_wrapped;
+}
+
 guint8
 Terminal::get_bidi_flags() const noexcept
 {
@@ -3331,28 +4055,36 @@ mark_input_source_invalid_cb(vte::terminal::Terminal* that)
 
 /* Read and handle data from the child. */
 static gboolean
-io_read_cb(GIOChannel *channel,
+io_read_cb(int fd,
            GIOCondition condition,
            vte::terminal::Terminal* that)
 {
-        return that->pty_io_read(channel, condition);
+        return that->pty_io_read(condition);
 }
 
 void
 Terminal::connect_pty_read()
 {
-	if (m_pty_channel == NULL)
+	if (m_pty_fd == -1)
 		return;
 
+        /* Flow control: don't resume reading while the backlog is being
+         * drained, process() reconnects when it has fallen low enough. */
+        if (m_input_paused)
+                return;
+
 	if (m_pty_input_source == 0) {
 		_vte_debug_print (VTE_DEBUG_IO, "polling vte_terminal_io_read\n");
+                /* Poll the raw fd; a GIOChannel watch would take the channel
+                 * lock and recheck the channel flags on every read, and
+                 * can't scatter one read into several chunks. */
 		m_pty_input_source =
-			g_io_add_watch_full(m_pty_channel,
-					    VTE_CHILD_INPUT_PRIORITY,
-					    (GIOCondition)(G_IO_IN | G_IO_PRI | G_IO_HUP),
-					    (GIOFunc)io_read_cb,
-					    this,
-					    (GDestroyNotify)mark_input_source_invalid_cb);
+			g_unix_fd_add_full(VTE_CHILD_INPUT_PRIORITY,
+					   m_pty_fd,
+					   (GIOCondition)(G_IO_IN | G_IO_PRI | G_IO_HUP),
+					   (GUnixFDSourceFunc)io_read_cb,
+					   this,
+					   (GDestroyNotify)mark_input_source_invalid_cb);
 	}
 }
 
@@ -3365,11 +4097,11 @@ mark_output_source_invalid_cb(vte::terminal::Terminal* that)
 
 /* Send locally-encoded characters to the child. */
 static gboolean
-io_write_cb(GIOChannel *channel,
+io_write_cb(int fd,
             GIOCondition condition,
             vte::terminal::Terminal* that)
 {
-        return that->pty_io_write(channel, condition);
+        return that->pty_io_write(condition);
 }
 
 void
@@ -3378,22 +4110,25 @@ Terminal::connect_pty_write()
         g_assert(m_pty != nullptr);
         g_warn_if_fail(m_input_enabled);
 
-	if (m_pty_channel == nullptr) {
-		m_pty_channel =
-			g_io_channel_unix_new(vte_pty_get_fd(m_pty));
-	}
+        /* While processing input, defer the flush: the replies to a burst
+         * of query sequences then go out in a single write at the end of
+         * the pass; see process_incoming(). */
+        if (m_outgoing_defer) {
+                m_outgoing_deferred = true;
+                return;
+        }
 
 	if (m_pty_output_source == 0) {
-		if (pty_io_write (m_pty_channel, G_IO_OUT))
+		if (pty_io_write (G_IO_OUT))
 		{
 			_vte_debug_print (VTE_DEBUG_IO, "polling vte_terminal_io_write\n");
 			m_pty_output_source =
-				g_io_add_watch_full(m_pty_channel,
-						    VTE_CHILD_OUTPUT_PRIORITY,
-						    G_IO_OUT,
-						    (GIOFunc)io_write_cb,
-						    this,
-						    (GDestroyNotify)mark_output_source_invalid_cb);
+				g_unix_fd_add_full(VTE_CHILD_OUTPUT_PRIORITY,
+						   m_pty_fd,
+						   G_IO_OUT,
+						   (GUnixFDSourceFunc)io_write_cb,
+						   this,
+						   (GDestroyNotify)mark_output_source_invalid_cb);
 		}
 	}
 }
@@ -3681,7 +4416,8 @@ Terminal::convert_incoming() noexcept
         _vte_byte_array_clear(m_incoming_leftover);
         while (!m_incoming_queue.empty()) {
                 auto chunk = m_incoming_queue.front().get();
-                _vte_byte_array_append(buf, chunk->data, chunk->len);
+                note_input_arrival(chunk);
+                _vte_byte_array_append(buf, chunk->begin_reading(), chunk->len);
                 m_incoming_queue.pop();
         }
 
@@ -3785,6 +4521,10 @@ Terminal::process_incoming()
                          m_input_bytes,
                          m_incoming_queue.size());
 	_vte_debug_print (VTE_DEBUG_WORK, "(");
+        _vte_trace(process_start);
+
+        /* Batch any replies we generate into one flush at the end. */
+        m_outgoing_defer = true;
 
         auto previous_screen = m_screen;
 
@@ -3800,7 +4540,8 @@ Terminal::process_incoming()
             && (m_screen->cursor.row <= (m_screen->insert_delta + m_scrolling_region.end));
 
 	/* We should only be called when there's data to process. */
-	g_assert(!m_incoming_queue.empty());
+	g_assert(!m_incoming_queue.empty() ||
+                 (m_parser_thread && m_parser_thread->has_work()));
 
 #ifdef WITH_ICONV
         /* If we're using a legacy encoding for I/O, we need to
@@ -3822,147 +4563,310 @@ Terminal::process_incoming()
 
         size_t bytes_processed = 0;
 
-        while (!m_incoming_queue.empty()) {
-                auto chunk = std::move(m_incoming_queue.front());
-                m_incoming_queue.pop();
-
-                g_assert_nonnull(chunk.get());
+        auto const process_result = [&](int rv) {
+#ifdef VTE_DEBUG
+                if (rv != VTE_SEQ_NONE)
+                        g_assert((bool)seq);
+#endif
 
-                _VTE_DEBUG_IF(VTE_DEBUG_IO) {
-                        _vte_debug_hexdump("Incoming buffer", chunk->data, chunk->len);
+                _VTE_DEBUG_IF(VTE_DEBUG_PARSER) {
+                        if (rv != VTE_SEQ_NONE) {
+                                seq.print();
+                        }
                 }
 
-                bytes_processed += chunk->len;
+                // FIXMEchpe this assumes that the only handler inserting
+                // a character is GRAPHIC, which isn't true (at least ICH, REP, SUB
+                // also do, and invalidate directly for now)...
 
-                auto const* ip = chunk->data;
-                auto const* iend = chunk->data + chunk->len;
+                switch (rv) {
+                case VTE_SEQ_GRAPHIC: {
 
-                for ( ; ip < iend; ++ip) {
+                        auto const row_before = m_screen->cursor.row;
 
-                        switch (m_utf8_decoder.decode(*ip)) {
-                        case vte::base::UTF8Decoder::REJECT_REWIND:
-                                /* Rewind the stream.
-                                 * Note that this will never lead to a loop, since in the
-                                 * next round this byte *will* be consumed.
-                                 */
-                                --ip;
-                                [[fallthrough]];
-                        case vte::base::UTF8Decoder::REJECT:
-                                m_utf8_decoder.reset();
-                                /* Fall through to insert the U+FFFD replacement character. */
-                                [[fallthrough]];
-                        case vte::base::UTF8Decoder::ACCEPT: {
-                                auto rv = m_parser.feed(m_utf8_decoder.codepoint());
-                                if (G_UNLIKELY(rv < 0)) {
-                                        uint32_t c = m_utf8_decoder.codepoint();
-                                        char c_buf[7];
-                                        g_snprintf(c_buf, sizeof(c_buf), "%lc", c);
-                                        char const* wp_str = g_unichar_isprint(c) ? c_buf : _vte_debug_sequence_to_string(c_buf, -1);
-                                        _vte_debug_print(VTE_DEBUG_PARSER, "Parser error on U+%04X [%s]!\n",
-                                                         c, wp_str);
-                                        break;
-                                }
+                        // does insert_char(c, false, false)
+                        GRAPHIC(seq);
+                        _vte_debug_print(VTE_DEBUG_PARSER,
+                                         "Last graphic is now U+%04X %lc\n",
+                                         m_last_graphic_character,
+                                         g_unichar_isprint(m_last_graphic_character) ? m_last_graphic_character : 0xfffd);
 
-#ifdef VTE_DEBUG
-                                if (rv != VTE_SEQ_NONE)
-                                        g_assert((bool)seq);
-#endif
+                        /* Identical overwrite; nothing to track or repaint */
+                        if (!m_text_changed) {
+                                m_line_wrapped = false;
+                                break;
+                        }
 
-                                _VTE_DEBUG_IF(VTE_DEBUG_PARSER) {
-                                        if (rv != VTE_SEQ_NONE) {
-                                                seq.print();
-                                        }
+                        bbox_top = std::min(bbox_top, row_before);
+
+                        if (m_line_wrapped) {
+                                m_line_wrapped = false;
+                                /* line wrapped, correct bbox */
+                                if (invalidated_text &&
+                                    (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
+                                     m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK)) {
+                                        invalidate_rows_and_context(bbox_top, bbox_bottom);
+                                        bbox_bottom = -G_MAXINT;
+                                        bbox_top = G_MAXINT;
                                 }
+                                bbox_top = std::min(bbox_top,
+                                                    m_screen->cursor.row);
+                        }
+                        /* Add the cells over which we have moved to the region
+                         * which we need to refresh for the user. */
+                        bbox_bottom = std::max(bbox_bottom,
+                                               m_screen->cursor.row);
+                        invalidated_text = TRUE;
 
-                                // FIXMEchpe this assumes that the only handler inserting
-                                // a character is GRAPHIC, which isn't true (at least ICH, REP, SUB
-                                // also do, and invalidate directly for now)...
+                        /* We *don't* emit flush pending signals here. */
+                        modified = TRUE;
+
+                        break;
+                }
 
-                                switch (rv) {
-                                case VTE_SEQ_GRAPHIC: {
+                case VTE_SEQ_NONE:
+                case VTE_SEQ_IGNORE:
+                        break;
 
-                                        bbox_top = std::min(bbox_top,
-                                                            m_screen->cursor.row);
+                case VTE_SEQ_SIXEL_START:
+                        sixel_start(seq);
+                        break;
 
-                                        // does insert_char(c, false, false)
-                                        GRAPHIC(seq);
-                                        _vte_debug_print(VTE_DEBUG_PARSER,
-                                                         "Last graphic is now U+%04X %lc\n",
-                                                         m_last_graphic_character,
-                                                         g_unichar_isprint(m_last_graphic_character) ? m_last_graphic_character : 0xfffd);
+                case VTE_SEQ_SIXEL_DATA:
+                        /* O(1) per character; the image is committed by
+                         * the DECSIXEL dispatch at the string terminator. */
+                        if (G_LIKELY (m_sixel_context != nullptr))
+                                m_sixel_context->feed(seq.terminator());
+                        break;
 
-                                        if (m_line_wrapped) {
-                                                m_line_wrapped = false;
-                                                /* line wrapped, correct bbox */
-                                                if (invalidated_text &&
-                                                    (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
-                                                     m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK)) {
-                                                        invalidate_rows_and_context(bbox_top, bbox_bottom);
-                                                        bbox_bottom = -G_MAXINT;
-                                                        bbox_top = G_MAXINT;
-                                                }
+                default: {
+                        /* Dispatch table indexed by the command, generated from
+                         * the same X-macros as the VTE_CMD_* enum so the entries
+                         * line up. The NOP commands get a null entry, just like
+                         * they had no case in the switch this table replaces. */
+                        static constexpr void (Terminal::* const dispatch[VTE_CMD_N])(vte::parser::Sequence const&) = {
+#define _VTE_CMD(cmd)   &Terminal::cmd,
+#define _VTE_NOP(cmd)   nullptr,
+#include "parser-cmd.hh"
+#undef _VTE_CMD
+#undef _VTE_NOP
+                        };
+
+                        auto const command = seq.command();
+                        if (G_LIKELY (command < G_N_ELEMENTS (dispatch) && dispatch[command] != nullptr)) {
+                                (this->*dispatch[command])(seq);
+                        } else {
+                                _vte_debug_print(VTE_DEBUG_PARSER,
+                                                 "Unknown parser command %d\n", seq.command());
+                        }
+
+                        m_last_graphic_character = 0;
+
+                        modified = TRUE;
+
+                        // FIXME m_screen may be != previous_screen, check for that!
+
+                        gboolean new_in_scroll_region = m_scrolling_restricted
+                                && (m_screen->cursor.row >= (m_screen->insert_delta + m_scrolling_region.start))
+                                && (m_screen->cursor.row <= (m_screen->insert_delta + m_scrolling_region.end));
+
+                        /* if we have moved greatly during the sequence handler, or moved
+                         * into a scroll_region from outside it, restart the bbox.
+                         */
+                        if (invalidated_text &&
+                            ((new_in_scroll_region && !in_scroll_region) ||
+                             (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
+                              m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK))) {
+                                invalidate_rows_and_context(bbox_top, bbox_bottom);
+                                invalidated_text = FALSE;
+                                bbox_bottom = -G_MAXINT;
+                                bbox_top = G_MAXINT;
+                        }
+
+                        in_scroll_region = new_in_scroll_region;
+
+                        break;
+                }
+                }
+        };
+
+        auto const process_codepoint = [&](uint32_t codepoint) {
+                auto rv = m_parser.feed(codepoint);
+                if (G_UNLIKELY(rv < 0)) {
+                        char c_buf[7];
+                        g_snprintf(c_buf, sizeof(c_buf), "%lc", codepoint);
+                        char const* wp_str = g_unichar_isprint(codepoint) ? c_buf : _vte_debug_sequence_to_string(c_buf, -1);
+                        _vte_debug_print(VTE_DEBUG_PARSER, "Parser error on U+%04X [%s]!\n",
+                                         codepoint, wp_str);
+                        return;
+                }
+
+                process_result(rv);
+        };
+
+        if (G_UNLIKELY(m_parser_thread && m_using_utf8)) {
+                /* Parsing happens on the parser thread. Hand over anything
+                 * that was fed in directly (e.g. vte_terminal_feed()), then
+                 * apply whatever pre-parsed batches are ready to the screen
+                 * model; further batches are picked up on a later pass.
+                 */
+                while (!m_incoming_queue.empty()) {
+                        note_input_arrival(m_incoming_queue.front().get());
+                        m_parser_thread->push_chunk(std::move(m_incoming_queue.front()));
+                        m_incoming_queue.pop();
+                }
+
+                vte_seq_t graphic_seq;
+                memset(&graphic_seq, 0, sizeof(graphic_seq));
+                graphic_seq.type = VTE_SEQ_GRAPHIC;
+
+                auto batches = m_parser_thread->take_batches();
+                while (!batches.empty()) {
+                        auto batch = std::move(batches.front());
+                        batches.pop();
+
+                        bytes_processed += batch->n_bytes;
+                        vte::stats::add(vte::stats::counters.chunks_processed);
+                        _vte_trace1(process_chunk, batch->n_bytes);
+
+                        for (auto const& op : batch->ops()) {
+                                if (op.text_len > 0) {
+                                        /* A printable run consumed with
+                                         * vte_parser_feed_span() on the parser
+                                         * thread; apply it as one batched
+                                         * insertion, as in the fast path
+                                         * below. */
+                                        auto const row_before = m_screen->cursor.row;
+                                        insert_text_run(batch->text(op),
+                                                        int(op.text_len));
+                                        m_line_wrapped = false;
+                                        if (m_text_changed) {
                                                 bbox_top = std::min(bbox_top,
-                                                                    m_screen->cursor.row);
+                                                                    row_before);
+                                                bbox_bottom = std::max(bbox_bottom,
+                                                                       m_screen->cursor.row);
+                                                invalidated_text = TRUE;
+                                                modified = TRUE;
                                         }
-                                        /* Add the cells over which we have moved to the region
-                                         * which we need to refresh for the user. */
-                                        bbox_bottom = std::max(bbox_bottom,
-                                                               m_screen->cursor.row);
-                                        invalidated_text = TRUE;
-
-                                        /* We *don't* emit flush pending signals here. */
-                                        modified = TRUE;
+                                        continue;
+                                }
 
-                                        break;
+                                if (op.seq_idx < 0) {
+                                        graphic_seq.terminator = op.codepoint;
+                                        *seq.seq_ptr() = &graphic_seq;
+                                } else {
+                                        *seq.seq_ptr() = batch->seq(op.seq_idx);
                                 }
+                                process_result(op.status);
+                        }
+                }
+        }
 
-                                case VTE_SEQ_NONE:
-                                case VTE_SEQ_IGNORE:
-                                        break;
+        while (!m_incoming_queue.empty()) {
+                auto chunk = std::move(m_incoming_queue.front());
+                m_incoming_queue.pop();
 
-                                default: {
-                                        switch (seq.command()) {
-#define _VTE_CMD(cmd)   case VTE_CMD_##cmd: cmd(seq); break;
-#define _VTE_NOP(cmd)
-#include "parser-cmd.hh"
-#undef _VTE_CMD
-#undef _VTE_NOP
-                                        default:
-                                                _vte_debug_print(VTE_DEBUG_PARSER,
-                                                                 "Unknown parser command %d\n", seq.command());
-                                                break;
-                                        }
+                g_assert_nonnull(chunk.get());
+                note_input_arrival(chunk.get());
 
-                                        m_last_graphic_character = 0;
+                _VTE_DEBUG_IF(VTE_DEBUG_IO) {
+                        _vte_debug_hexdump("Incoming buffer", chunk->begin_reading(), chunk->len);
+                }
 
-                                        modified = TRUE;
+                bytes_processed += chunk->len;
+                vte::stats::add(vte::stats::counters.chunks_processed);
+                _vte_trace1(process_chunk, chunk->len);
+
+                auto const* ip = chunk->begin_reading();
+                auto const* iend = ip + chunk->len;
+
+                for ( ; ip < iend; ++ip) {
 
-                                        // FIXME m_screen may be != previous_screen, check for that!
-
-                                        gboolean new_in_scroll_region = m_scrolling_restricted
-                                                && (m_screen->cursor.row >= (m_screen->insert_delta + m_scrolling_region.start))
-                                                && (m_screen->cursor.row <= (m_screen->insert_delta + m_scrolling_region.end));
-
-                                        /* if we have moved greatly during the sequence handler, or moved
-                                         * into a scroll_region from outside it, restart the bbox.
-                                         */
-                                        if (invalidated_text &&
-                                            ((new_in_scroll_region && !in_scroll_region) ||
-                                             (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
-                                              m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK))) {
-                                                invalidate_rows_and_context(bbox_top, bbox_bottom);
-                                                invalidated_text = FALSE;
-                                                bbox_bottom = -G_MAXINT;
-                                                bbox_top = G_MAXINT;
+                        /* Fast path for runs of ASCII, which make up the bulk
+                         * of most input. The decoder scans ahead with vector
+                         * instructions; every byte in the run is a complete
+                         * character equal to its byte value, so the DFA is
+                         * bypassed entirely until the first high byte.
+                         */
+                        auto const* run = m_utf8_decoder.skip_ascii(ip, iend);
+                        while (ip < run) {
+                                /* While the parser is in ground state, a
+                                 * printable ASCII character can only dispatch
+                                 * GRAPHIC with itself as terminator; batch
+                                 * maximal such subruns through
+                                 * insert_text_run() instead of going through
+                                 * the parser per character.
+                                 */
+                                if (*ip >= 0x20 && *ip < 0x7f) {
+                                        gunichar chbuf[128];
+                                        int n = 0;
+                                        while (ip + n < run && n < int(G_N_ELEMENTS(chbuf)) &&
+                                               ip[n] >= 0x20 && ip[n] < 0x7f) {
+                                                chbuf[n] = ip[n];
+                                                ++n;
                                         }
 
-                                        in_scroll_region = new_in_scroll_region;
+                                        auto const consumed = m_parser.feed_span(chbuf, n);
+                                        if (G_LIKELY(consumed > 0)) {
+                                                auto const row_before = m_screen->cursor.row;
 
-                                        break;
-                                }
+                                                insert_text_run(chbuf, int(consumed));
+                                                m_line_wrapped = false;
+
+                                                if (m_text_changed) {
+                                                        /* The inserted rows are contiguous,
+                                                         * so the bbox covers them even
+                                                         * across autowraps. */
+                                                        bbox_top = std::min(bbox_top,
+                                                                            row_before);
+                                                        bbox_bottom = std::max(bbox_bottom,
+                                                                               m_screen->cursor.row);
+                                                        invalidated_text = TRUE;
+                                                        modified = TRUE;
+                                                }
+
+                                                ip += consumed;
+                                        } else {
+                                                /* Not in ground state. */
+                                                process_codepoint(*ip);
+                                                ++ip;
+                                        }
+                                } else if (*ip == 0x09 && m_parser.in_ground_state()) {
+                                        /* In ground state a TAB can only
+                                         * dispatch HT; column-aligned output
+                                         * emits them by the thousands, so
+                                         * handle the run directly instead of
+                                         * taking a parser round-trip per
+                                         * tab. */
+                                        do {
+                                                move_cursor_tab_forward();
+                                                ++ip;
+                                        } while (ip < run && *ip == 0x09);
+                                        m_last_graphic_character = 0;
+                                        modified = TRUE;
+                                } else {
+                                        process_codepoint(*ip);
+                                        ++ip;
                                 }
-                                break;
                         }
+                        if (ip == iend)
+                                break;
+
+                        switch (m_utf8_decoder.decode(*ip)) {
+                        case vte::base::UTF8Decoder::REJECT_REWIND:
+                                /* Rewind the stream.
+                                 * Note that this will never lead to a loop, since in the
+                                 * next round this byte *will* be consumed.
+                                 */
+                                --ip;
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::REJECT:
+                                m_utf8_decoder.reset();
+                                /* Fall through to insert the U+FFFD replacement character. */
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::ACCEPT:
+                                process_codepoint(m_utf8_decoder.codepoint());
+                                break;
                         }
                 }
         }
@@ -3987,15 +4891,25 @@ Terminal::process_incoming()
 		/* Deselect the current selection if its contents are changed
 		 * by this insertion. */
                 if (!m_selection_resolved.empty()) {
-                        //FIXMEchpe: this is atrocious
-			auto selection = get_selected_text();
-			if ((selection == nullptr) ||
-			    (m_selection[VTE_SELECTION_PRIMARY] == nullptr) ||
-			    (strcmp(selection->str, m_selection[VTE_SELECTION_PRIMARY]->str) != 0)) {
-				deselect_all();
-			}
-                        if (selection)
-                                g_string_free(selection, TRUE);
+                        if (m_selection_pending[VTE_SELECTION_PRIMARY]) {
+                                /* The text hasn't been materialized, so there's
+                                 * nothing to compare against; deselect if the
+                                 * written region touches the selection. */
+                                if (bbox_top <= m_selection_resolved.last_row() &&
+                                    bbox_bottom >= m_selection_resolved.start_row()) {
+                                        deselect_all();
+                                }
+                        } else {
+                                //FIXMEchpe: this is atrocious
+                                auto selection = get_selected_text();
+                                if ((selection == nullptr) ||
+                                    (m_selection[VTE_SELECTION_PRIMARY] == nullptr) ||
+                                    (strcmp(selection->str, m_selection[VTE_SELECTION_PRIMARY]->str) != 0)) {
+                                        deselect_all();
+                                }
+                                if (selection)
+                                        g_string_free(selection, TRUE);
+                        }
 		}
 	}
 
@@ -4029,9 +4943,26 @@ Terminal::process_incoming()
 	/* Tell the input method where the cursor is. */
         im_update_cursor();
 
+        m_input_backlog -= MIN(m_input_backlog, bytes_processed);
+        vte::stats::add(vte::stats::counters.bytes_parsed, bytes_processed);
+
         /* After processing some data, do a hyperlink GC. The multiplier is totally arbitrary, feel free to fine tune. */
         _vte_ring_hyperlink_maybe_gc(m_screen->row_data, bytes_processed * 8);
 
+        enforce_scrollback_budget();
+
+        if (G_UNLIKELY (!m_images.empty()))
+                prune_images();
+
+        /* Flush the batched replies in one go. */
+        m_outgoing_defer = false;
+        if (m_outgoing_deferred) {
+                m_outgoing_deferred = false;
+                if (m_pty != nullptr && !m_outgoing_queue.empty())
+                        connect_pty_write();
+        }
+
+        _vte_trace1(process_done, bytes_processed);
 	_vte_debug_print (VTE_DEBUG_WORK, ")");
 	_vte_debug_print (VTE_DEBUG_IO,
                           "%" G_GSIZE_FORMAT " bytes in %" G_GSIZE_FORMAT " chunks left to process.\n",
@@ -4039,23 +4970,138 @@ Terminal::process_incoming()
                           m_incoming_queue.size());
 }
 
-bool
-Terminal::pty_io_read(GIOChannel *channel,
-                                GIOCondition condition)
+/*
+ * An opt-in, process-wide cap on scrollback storage, set with
+ * $VTE_SCROLLBACK_BUDGET (in MiB; unset or 0 disables it).  Returns the
+ * budget in bytes, or -1 when there is none.
+ */
+static gint64
+scrollback_budget(void)
+{
+        static gint64 budget = -2;
+
+        if (G_UNLIKELY (budget == -2)) {
+                auto const env = g_getenv("VTE_SCROLLBACK_BUDGET");
+                budget = env != nullptr ? (gint64)g_ascii_strtoull(env, nullptr, 10) * 1024 * 1024 : -1;
+                if (budget == 0)
+                        budget = -1;
+        }
+
+        return budget;
+}
+
+/*
+ * When the backing streams of all terminals in the process together exceed
+ * the scrollback budget, evict the oldest rows from the terminal that was
+ * painted least recently, a screenful at a time, until we're back under.
+ * This way a single runaway tab cannot consume the host's memory or tmpfs,
+ * while the terminals the user is looking at keep their history the
+ * longest.  Called after each processing pass; the common case (no budget
+ * set) is a single branch.
+ */
+void
+Terminal::enforce_scrollback_budget()
+{
+        auto const budget = scrollback_budget();
+        if (G_LIKELY (budget < 0))
+                return;
+
+        gsize total = 0;
+        for (auto l = g_active_terminals; l != nullptr; l = l->next)
+                total += _vte_ring_storage_size(reinterpret_cast<Terminal*>(l->data)->m_normal_screen.row_data);
+
+        while ((gint64)total > budget) {
+                Terminal* victim = nullptr;
+                for (auto l = g_active_terminals; l != nullptr; l = l->next) {
+                        auto that = reinterpret_cast<Terminal*>(l->data);
+                        if (_vte_ring_storage_size(that->m_normal_screen.row_data) == 0)
+                                continue;
+                        if (victim == nullptr || that->m_last_viewed < victim->m_last_viewed)
+                                victim = that;
+                }
+                if (victim == nullptr)
+                        break;
+
+                auto ring = victim->m_normal_screen.row_data;
+                auto const before = _vte_ring_storage_size(ring);
+                _vte_ring_drop_oldest(ring, victim->m_row_count);
+                auto const after = _vte_ring_storage_size(ring);
+                if (after >= before)
+                        break;  /* Reclaim happens at block granularity; don't spin. */
+                total -= before - after;
+
+                if (victim->m_screen == &victim->m_normal_screen) {
+                        victim->queue_adjustment_changed();
+                        victim->queue_adjustment_value_changed_clamped(victim->m_screen->scroll_delta);
+                }
+        }
+}
+
+/*
+ * Session recording for deterministic replay (vteapp's --replay option).
+ *
+ * When $VTE_RECORD names a directory, every byte read from the pty is
+ * appended to a gzip-compressed log there, one file per terminal, framed
+ * as records of
+ *
+ *   guint64 timestamp;  microseconds, g_get_monotonic_time()
+ *   guint32 length;     number of payload bytes that follow
+ *   ...                 the payload
+ *
+ * in native endianness.  Feeding the chunks back on the recorded schedule
+ * reproduces the session bit-exact including its timing, which turns
+ * "scrolling feels slower" reports into reproducible benchmarks.
+ */
+void
+Terminal::pty_record_open()
+{
+        static int count = 0;
+        auto path = g_strdup_printf("%s" G_DIR_SEPARATOR_S "vte-%d-%d.rec",
+                                    g_getenv("VTE_RECORD"), (int)getpid(), count++);
+        m_record_stream = gzopen(path, "wb");
+        if (m_record_stream == nullptr)
+                g_printerr("Could not open session record %s: %s\n",
+                           path, g_strerror(errno));
+        g_free(path);
+}
+
+void
+Terminal::pty_record(guint8 const* data,
+                     gsize length)
+{
+        guint64 timestamp;
+        guint32 record_length;
+
+        if (G_LIKELY (m_record_stream == nullptr))
+                return;
+
+        timestamp = g_get_monotonic_time();
+        record_length = length;
+        if (gzwrite((gzFile)m_record_stream, &timestamp, sizeof (timestamp)) != (int)sizeof (timestamp) ||
+            gzwrite((gzFile)m_record_stream, &record_length, sizeof (record_length)) != (int)sizeof (record_length) ||
+            gzwrite((gzFile)m_record_stream, data, length) != (int)length) {
+                g_printerr("Error writing session record, stopping recording\n");
+                gzclose((gzFile)m_record_stream);
+                m_record_stream = nullptr;
+        }
+}
+
+bool
+Terminal::pty_io_read(GIOCondition condition)
 {
 	int err = 0;
 	gboolean eof, again = TRUE;
+        gssize last_len = 0;
 
 	_vte_debug_print (VTE_DEBUG_WORK, ".");
+        _vte_trace(pty_read_start);
 
 	/* Check for end-of-file. */
 	eof = condition & G_IO_HUP;
 
-	/* Read some data in from this channel. */
+	/* Read some data in from the pty. */
 	if (condition & (G_IO_IN | G_IO_PRI)) {
-		const int fd = g_io_channel_unix_get_fd (channel);
-		guchar *bp;
-		int rem, len;
+		const int fd = m_pty_fd;
 		guint bytes, max_bytes;
 
 		/* Limit the amount read between updates, so as to
@@ -4080,67 +5126,97 @@ Terminal::pty_io_read(GIOChannel *channel,
                 if (!m_incoming_queue.empty())
                         chunk = m_incoming_queue.back().get();
 
+                /* Spare chunks for the scatter list, so that a flooding
+                 * child can fill more than one chunk per readv(). Spares
+                 * that receive data are pushed onto the queue; untouched
+                 * ones go back to the pool at the end of the scope. */
+                vte::base::Chunk::unique_type spares[2];
+
 		do {
-                        /* No chunk, or chunk at least ¾ full? Get a new chunk */
+                        /* No chunk, or (foreign or at least ¾ full) chunk?
+                         * Get a new chunk */
 			if (!chunk ||
-                            chunk->len >= 3 * chunk->capacity() / 4) {
+                            chunk->remaining_capacity() < chunk->capacity() / 4) {
                                 m_incoming_queue.push(vte::base::Chunk::get());
 
                                 chunk = m_incoming_queue.back().get();
 			}
 
-			rem = chunk->remaining_capacity();
-			bp = chunk->data + chunk->len;
-			len = 0;
-			do {
-                                /* We'd like to read (fd, bp, rem); but due to TIOCPKT mode
-                                 * there's an extra input byte returned at the beginning.
-                                 * We need to see what that byte is, but otherwise drop it
-                                 * and write continuously to chunk->data.
+                        /* Due to TIOCPKT mode each read returns one packet
+                         * with an extra input byte at the beginning. We need
+                         * to see what that byte is, so give it an iovec slot
+                         * of its own; the payload lands directly in the
+                         * chunks. */
+                        char pkt_header;
+                        struct iovec iov[2 + G_N_ELEMENTS(spares)];
+                        int n_iov = 0;
+                        iov[n_iov].iov_base = &pkt_header;
+                        iov[n_iov++].iov_len = 1;
+                        iov[n_iov].iov_base = chunk->data + chunk->len;
+                        iov[n_iov++].iov_len = chunk->remaining_capacity();
+                        for (auto& spare : spares) {
+                                if (!spare)
+                                        spare = vte::base::Chunk::get();
+                                iov[n_iov].iov_base = spare->data;
+                                iov[n_iov++].iov_len = spare->capacity();
+                        }
+
+                        auto ret = readv (fd, iov, n_iov);
+                        if (ret == -1) {
+                                err = errno;
+                                break;
+                        }
+                        if (ret == 0) {
+                                eof = TRUE;
+                                break;
+                        }
+
+                        if (pkt_header & TIOCPKT_IOCTL) {
+                                /* We'd like to always be informed when the termios change,
+                                 * so we can e.g. detect when no-echo is en/disabled and
+                                 * change the cursor/input method/etc., but unfortunately
+                                 * the kernel only sends this flag when (old or new) 'local flags'
+                                 * include EXTPROC, which is not used often, and due to its side
+                                 * effects, cannot be enabled by vte by default.
+                                 *
+                                 * FIXME: improve the kernel! see discussion in bug 755371
+                                 * starting at comment 12
                                  */
-                                char pkt_header;
-                                char save = bp[-1];
-                                int ret = read (fd, bp - 1, rem + 1);
-                                pkt_header = bp[-1];
-                                bp[-1] = save;
-				switch (ret){
-					case -1:
-						err = errno;
-						goto out;
-					case 0:
-						eof = TRUE;
-						goto out;
-					default:
-                                                ret--;
-
-                                                if (pkt_header & TIOCPKT_IOCTL) {
-                                                        /* We'd like to always be informed when the termios change,
-                                                         * so we can e.g. detect when no-echo is en/disabled and
-                                                         * change the cursor/input method/etc., but unfortunately
-                                                         * the kernel only sends this flag when (old or new) 'local flags'
-                                                         * include EXTPROC, which is not used often, and due to its side
-                                                         * effects, cannot be enabled by vte by default.
-                                                         *
-                                                         * FIXME: improve the kernel! see discussion in bug 755371
-                                                         * starting at comment 12
-                                                         */
-                                                        pty_termios_changed();
-                                                }
-                                                if (pkt_header & TIOCPKT_STOP) {
-                                                        pty_scroll_lock_changed(true);
-                                                } else if (pkt_header & TIOCPKT_START) {
-                                                        pty_scroll_lock_changed(false);
-                                                }
+                                pty_termios_changed();
+                        }
+                        if (pkt_header & TIOCPKT_STOP) {
+                                pty_scroll_lock_changed(true);
+                        } else if (pkt_header & TIOCPKT_START) {
+                                pty_scroll_lock_changed(false);
+                        }
 
-						bp += ret;
-						rem -= ret;
-						len += ret;
-						break;
-				}
-			} while (rem);
-out:
-			chunk->len += len;
-			bytes += len;
+                        auto len = gsize(ret - 1);
+                        last_len = len;
+                        auto const arrival_time = len > 0 ? g_get_monotonic_time() : 0;
+
+                        auto filled = MIN(len, chunk->remaining_capacity());
+                        if (G_UNLIKELY (m_record_stream != nullptr))
+                                pty_record(chunk->data + chunk->len, filled);
+                        chunk->len += filled;
+                        if (G_UNLIKELY (chunk->arrival_time == 0 && filled > 0))
+                                chunk->arrival_time = arrival_time;
+                        len -= filled;
+                        bytes += filled;
+
+                        /* Overflow into the spares */
+                        for (auto& spare : spares) {
+                                if (len == 0)
+                                        break;
+                                filled = MIN(len, spare->capacity());
+                                if (G_UNLIKELY (m_record_stream != nullptr))
+                                        pty_record(spare->data, filled);
+                                spare->len = filled;
+                                spare->arrival_time = arrival_time;
+                                len -= filled;
+                                bytes += filled;
+                                m_incoming_queue.push(std::move(spare));
+                                chunk = m_incoming_queue.back().get();
+                        }
 		} while (bytes < max_bytes &&
 		         chunk->len == chunk->capacity());
 
@@ -4148,18 +5224,32 @@ out:
                  * that doesn't matter, we'll fill it next time.
                  */
 
+                if (m_parser_thread && m_using_utf8) {
+                        /* Hand the chunks over to the parser thread right
+                         * away, so parsing overlaps with the main loop
+                         * returning to other work.
+                         */
+                        while (!m_incoming_queue.empty()) {
+                                note_input_arrival(m_incoming_queue.front().get());
+                                m_parser_thread->push_chunk(std::move(m_incoming_queue.front()));
+                                m_incoming_queue.pop();
+                        }
+                }
+
 		if (!is_processing()) {
                         G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
 			gdk_threads_enter ();
                         G_GNUC_END_IGNORE_DEPRECATIONS;
 
-			add_process_timeout(this);
+			start_processing();
 
                         G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
 			gdk_threads_leave ();
                         G_GNUC_END_IGNORE_DEPRECATIONS;
 		}
-		m_pty_input_active = len != 0;
+		m_pty_input_active = last_len != 0;
+                _vte_trace1(pty_read_done, bytes - m_input_bytes);
+                m_input_backlog += bytes - m_input_bytes;
 		m_input_bytes = bytes;
 		again = bytes < max_bytes;
 
@@ -4251,6 +5341,8 @@ Terminal::feed(char const* data,
                 auto len = std::min(length, rem);
                 memcpy (chunk->data + chunk->len, data, len);
                 chunk->len += len;
+                if (chunk->arrival_time == 0)
+                        chunk->arrival_time = g_get_monotonic_time();
                 length -= len;
                 if (length == 0)
                         break;
@@ -4266,34 +5358,97 @@ Terminal::feed(char const* data,
                 start_processing();
 }
 
+/*
+ * Terminal::feed_bytes:
+ * @bytes: data in the terminal's current encoding
+ *
+ * Like feed(), but without copying: wraps the caller-owned immutable
+ * data in foreign chunks which reference @bytes until processed.
+ */
+void
+Terminal::feed_bytes(GBytes* bytes)
+{
+        gsize length;
+        (void)g_bytes_get_data(bytes, &length);
+        if (length == 0)
+                return;
+
+        /* A chunk's length field limits how much one foreign chunk can
+         * present; split huge data across chunks sharing the reference. */
+        auto const arrival_time = g_get_monotonic_time();
+        gsize offset = 0;
+        do {
+                auto const len = std::min(length - offset, gsize(G_MAXUINT));
+                auto chunk = vte::base::Chunk::get_foreign(bytes, offset, len);
+                chunk->arrival_time = arrival_time;
+                m_incoming_queue.push(std::move(chunk));
+                offset += len;
+        } while (offset < length);
+
+        start_processing();
+}
+
+/* Append data for the child to the outgoing queue, copying it into
+ * recycled chunks. */
+void
+Terminal::outgoing_queue_append(guint8 const* data,
+                                          gsize length)
+{
+        while (length > 0) {
+                if (m_outgoing_queue.empty() ||
+                    m_outgoing_queue.back()->remaining_capacity() == 0)
+                        m_outgoing_queue.push_back(vte::base::Chunk::get());
+
+                auto& chunk = m_outgoing_queue.back();
+                auto const to_copy = MIN(length, chunk->remaining_capacity());
+                memcpy(chunk->data + chunk->len, data, to_copy);
+                chunk->len += to_copy;
+                data += to_copy;
+                length -= to_copy;
+        }
+}
+
 bool
-Terminal::pty_io_write(GIOChannel *channel,
-                                 GIOCondition condition)
+Terminal::pty_io_write(GIOCondition condition)
 {
 	gssize count;
-	int fd;
-	gboolean leave_open;
-
-	fd = g_io_channel_unix_get_fd(channel);
+	int fd = m_pty_fd;
+
+        /* Gather the front segments; a partial write only bumps
+         * m_outgoing_start instead of memmoving the remaining data. */
+        struct iovec iov[VTE_OUTGOING_WRITEV_MAX];
+        int n_iov = 0;
+        gsize start = m_outgoing_start;
+        for (auto const& chunk : m_outgoing_queue) {
+                if (n_iov == (int)G_N_ELEMENTS(iov))
+                        break;
+                iov[n_iov].iov_base = chunk->data + start;
+                iov[n_iov].iov_len = chunk->len - start;
+                n_iov++;
+                start = 0;
+        }
 
-	count = write(fd, m_outgoing->data,
-		      _vte_byte_array_length(m_outgoing));
+        count = n_iov != 0 ? writev(fd, iov, n_iov) : 0;
 	if (count != -1) {
-		_VTE_DEBUG_IF (VTE_DEBUG_IO) {
-                        _vte_debug_hexdump("Outgoing buffer written",
-                                           (uint8_t const*)m_outgoing->data,
-                                           count);
-		}
-		_vte_byte_array_consume(m_outgoing, count);
-	}
-
-	if (_vte_byte_array_length(m_outgoing) == 0) {
-		leave_open = FALSE;
-	} else {
-		leave_open = TRUE;
+                auto remaining = count;
+                for (int i = 0; i < n_iov && remaining > 0; i++) {
+                        auto const written = MIN((gssize)iov[i].iov_len, remaining);
+                        _VTE_DEBUG_IF (VTE_DEBUG_IO) {
+                                _vte_debug_hexdump("Outgoing buffer written",
+                                                   (uint8_t const*)iov[i].iov_base,
+                                                   written);
+                        }
+                        remaining -= written;
+                        if (written == (gssize)iov[i].iov_len) {
+                                m_outgoing_queue.pop_front();
+                                m_outgoing_start = 0;
+                        } else {
+                                m_outgoing_start += written;
+                        }
+                }
 	}
 
-	return leave_open;
+	return !m_outgoing_queue.empty();
 }
 
 /* Convert some UTF-8 data to send to the child. */
@@ -4369,7 +5524,7 @@ Terminal::send_child(char const* data,
          * outgoing buffer. */
         // FIXMEchpe: shouldn't require m_pty for this
         if ((cooked_length > 0) && (m_pty != NULL)) {
-                _vte_byte_array_append(m_outgoing, cooked, cooked_length);
+                outgoing_queue_append((guint8 const*)cooked, cooked_length);
                 _VTE_DEBUG_IF(VTE_DEBUG_KEYBOARD) {
                         for (i = 0; i < cooked_length; i++) {
                                 if ((((guint8) cooked[i]) < 32) ||
@@ -4440,8 +5595,7 @@ Terminal::feed_child_binary(guint8 const* data,
 		/* If there's a place for it to go, add the data to the
 		 * outgoing buffer. */
 		if (m_pty != NULL) {
-			_vte_byte_array_append(m_outgoing,
-					   data, length);
+			outgoing_queue_append(data, length);
 			/* If we need to start waiting for the child pty to
 			 * become available for writing, set that up here. */
 			connect_pty_write();
@@ -4556,6 +5710,25 @@ Terminal::reply(vte::parser::Sequence const& seq,
         send(seq, builder);
 }
 
+/*
+ * Like reply(), for replies whose bytes are the same every time (DA1 and
+ * friends).  The sequence is formatted only once per process into @cache
+ * and reused; some applications probe dozens of capabilities at startup,
+ * and there's no point rebuilding the constant answers for each of them.
+ * Only for replies where send() would not consult the requesting sequence,
+ * i.e. not for OSC.
+ */
+void
+Terminal::reply_cached(std::string& cache,
+                       unsigned int type,
+                       std::initializer_list<int> params) noexcept
+{
+        if (G_UNLIKELY (cache.empty()))
+                vte::parser::ReplyBuilder{type, params}.to_string(cache, false, -1);
+
+        feed_child(cache.data(), cache.size());
+}
+
 void
 Terminal::im_commit(char const* text)
 {
@@ -4680,11 +5853,8 @@ Terminal::add_cursor_timeout()
 		return; /* already added */
 
 	m_cursor_blink_time = 0;
-	m_cursor_blink_tag = g_timeout_add_full(G_PRIORITY_LOW,
-                                                m_cursor_blink_cycle,
-                                                (GSourceFunc)invalidate_cursor_periodic_cb,
-                                                this,
-                                                NULL);
+	m_cursor_blink_tag = 1;
+	blink_ticker_add(this, BLINK_TIMER_CURSOR, m_cursor_blink_cycle);
 }
 
 void
@@ -4693,7 +5863,7 @@ Terminal::remove_cursor_timeout()
 	if (m_cursor_blink_tag == 0)
 		return; /* already removed */
 
-	g_source_remove(m_cursor_blink_tag);
+	blink_ticker_remove(this, BLINK_TIMER_CURSOR);
 	m_cursor_blink_tag = 0;
         if (!m_cursor_blink_state) {
                 invalidate_cursor_once();
@@ -4719,7 +5889,7 @@ Terminal::remove_text_blink_timeout()
         if (m_text_blink_tag == 0)
                 return;
 
-        g_source_remove (m_text_blink_tag);
+        blink_ticker_remove(this, BLINK_TIMER_TEXT);
         m_text_blink_tag = 0;
 }
 
@@ -5305,15 +6475,17 @@ static const guint8 word_char_by_category[] = {
 };
 
 /*
- * Terminal::is_word_char:
+ * Terminal::is_word_char_slow:
  * @c: a candidate Unicode code point
  *
- * Checks if a particular character is considered to be part of a word or not.
+ * Checks if a particular character is considered to be part of a word or not,
+ * from first principles.  This is the reference implementation that
+ * compile_word_char_bitmap() compiles; use is_word_char() instead.
  *
  * Returns: %TRUE if the character is considered to be part of a word
  */
 bool
-Terminal::is_word_char(gunichar c) const
+Terminal::is_word_char_slow(gunichar c) const
 {
         const guint8 v = word_char_by_category[g_unichar_type(c)];
 
@@ -5328,6 +6500,64 @@ Terminal::is_word_char(gunichar c) const
                        compare_unichar_p) != nullptr;
 }
 
+/*
+ * Terminal::is_word_char:
+ * @c: a candidate Unicode code point
+ *
+ * Checks if a particular character is considered to be part of a word or not.
+ * For the BMP this is two loads into the bitmap compiled when the word char
+ * exceptions were set; selection expansion calls this per cell, where the
+ * category lookup plus exception bsearch of the slow path add up.
+ *
+ * Returns: %TRUE if the character is considered to be part of a word
+ */
+bool
+Terminal::is_word_char(gunichar c) const
+{
+        if (G_LIKELY (c < 0x10000 && !m_word_char_bitmap.empty())) {
+                auto const* page = m_word_char_bitmap.data() +
+                                   32 * m_word_char_pages[c >> 8];
+                return (page[(c >> 3) & 31] >> (c & 7)) & 1;
+        }
+
+        return is_word_char_slow(c);
+}
+
+/*
+ * Compile is_word_char_slow() into a two-level bitmap over the BMP:
+ * m_word_char_pages maps the high byte of a code point to a 32-byte
+ * (256-bit) page in m_word_char_bitmap.  Identical pages are shared;
+ * in practice almost all of them collapse onto common "all word" or
+ * "no word" pages, so the whole table stays within a few cache lines.
+ * Code points outside the BMP keep taking the slow path; they are
+ * vanishingly rare in selection scans.
+ */
+void
+Terminal::compile_word_char_bitmap()
+{
+        m_word_char_bitmap.clear();
+
+        for (unsigned int pageno = 0; pageno < 256; pageno++) {
+                uint8_t bits[32] = {};
+
+                for (unsigned int i = 0; i < 256; i++) {
+                        if (is_word_char_slow((gunichar)(pageno << 8 | i)))
+                                bits[i >> 3] |= 1 << (i & 7);
+                }
+
+                auto const n_pages = (unsigned int)(m_word_char_bitmap.size() / 32);
+                unsigned int slot;
+                for (slot = 0; slot < n_pages; slot++) {
+                        if (memcmp(m_word_char_bitmap.data() + 32 * slot, bits, 32) == 0)
+                                break;
+                }
+                if (slot == n_pages)
+                        m_word_char_bitmap.insert(m_word_char_bitmap.end(),
+                                                  bits, bits + 32);
+                m_word_char_pages[pageno] = slot;
+        }
+}
+
 /* Check if the characters in the two given locations are in the same class
  * (word vs. non-word characters).
  * Note that calling this method may invalidate the return value of
@@ -5368,6 +6598,71 @@ Terminal::is_same_class(vte::grid::column_t acol,
 	return false;
 }
 
+/*
+ * Find how far the run of same-class cells containing @col extends to the
+ * left within @rowdata.  Equivalent to stepping is_same_class(col - 1, row,
+ * col, row) cell by cell, but accesses the row data directly instead of
+ * doing a ring lookup per cell, which is what makes word-mode selection
+ * drag across a many-thousand-column wrapped paragraph instant.
+ * Returns the column of the leftmost cell of the run.
+ */
+vte::grid::column_t
+Terminal::same_class_run_start(VteRowData const* rowdata,
+                               vte::grid::column_t col) const
+{
+        while (col > 0) {
+                auto const* cell = _vte_row_data_get (rowdata, col);
+                if (cell == nullptr)
+                        break;
+                if (cell->attr.fragment()) {
+                        /* Part of the same (multi-cell) character as the cell
+                         * to the left; always grouped together. */
+                        col--;
+                        continue;
+                }
+                /* Non-word characters only group with their own fragments. */
+                if (cell->c == 0 || !is_word_char(_vte_unistr_get_base(cell->c)))
+                        break;
+                auto const* prev = _vte_row_data_get (rowdata, col - 1);
+                if (prev == nullptr || prev->c == 0 ||
+                    !is_word_char(_vte_unistr_get_base(prev->c)))
+                        break;
+                col--;
+        }
+
+        return col;
+}
+
+/*
+ * The mirror image of same_class_run_start(): how far the run extends to
+ * the right, up to @len end-exclusive.  Returns the column of the
+ * rightmost cell of the run.
+ */
+vte::grid::column_t
+Terminal::same_class_run_end(VteRowData const* rowdata,
+                             vte::grid::column_t col,
+                             vte::grid::column_t len) const
+{
+        while (col < len - 1) {
+                auto const* next = _vte_row_data_get (rowdata, col + 1);
+                if (next == nullptr)
+                        break;
+                if (next->attr.fragment()) {
+                        col++;
+                        continue;
+                }
+                auto const* cell = _vte_row_data_get (rowdata, col);
+                if (cell == nullptr || cell->c == 0 ||
+                    !is_word_char(_vte_unistr_get_base(cell->c)))
+                        break;
+                if (next->c == 0 || !is_word_char(_vte_unistr_get_base(next->c)))
+                        break;
+                col++;
+        }
+
+        return col;
+}
+
 /*
  * Convert the mouse click or drag location (left or right half of a cell) into a selection endpoint
  * (a boundary between characters), extending the selection according to the current mode, in the
@@ -5536,11 +6831,9 @@ Terminal::resolve_selection_endpoint(vte::grid::halfcoords const& rowcolhalf, bo
                                  * we look at is of the same class as the current start point. */
                                 while (true) {
                                         /* Back up within the row. */
-                                        for (; col > 0; col--) {
-                                                if (!is_same_class(col - 1, row, col, row)) {
-                                                        break;
-                                                }
-                                        }
+                                        rowdata = find_row_data(row);
+                                        if (rowdata != nullptr)
+                                                col = same_class_run_start(rowdata, col);
                                         if (col > 0) {
                                                 /* We hit a stopping point, so stop. */
                                                 break;
@@ -5574,11 +6867,7 @@ Terminal::resolve_selection_endpoint(vte::grid::halfcoords const& rowcolhalf, bo
                                         len = _vte_row_data_nonempty_length(rowdata);
                                         bool soft_wrapped = rowdata->attr.soft_wrapped;
                                         /* Move forward within the row. */
-                                        for (; col < len - 1; col++) {
-                                                if (!is_same_class(col, row, col + 1, row) /* invalidates rowdata! */) {
-                                                        break;
-                                                }
-                                        }
+                                        col = same_class_run_end(rowdata, col, len);
                                         if (col < len - 1) {
                                                 /* We hit a stopping point, so stop. */
                                                 break;
@@ -5740,42 +7029,83 @@ Terminal::cell_is_selected_vis(vte::grid::column_t vcol,
         return cell_is_selected_log(lcol, row);
 }
 
+/* How many clipboard bytes to convert and queue per main loop iteration,
+ * and the outgoing queue length (in chunks) at which to pause and let
+ * the pty writer catch up instead. */
+#define VTE_PASTE_SLICE_SIZE (128 * 1024)
+#define VTE_PASTE_OUTGOING_LIMIT 64
+
+static gboolean
+paste_slice_cb(vte::terminal::Terminal* that)
+{
+        that->paste_slice();
+        return G_SOURCE_CONTINUE;
+}
+
+/* Cancel a paste that is still streaming, closing the bracketed-paste
+ * sequence if one was opened. */
 void
-Terminal::widget_paste_received(char const* text)
+Terminal::stop_paste()
+{
+        if (m_paste.source != 0) {
+                g_source_remove(m_paste.source);
+                m_paste.source = 0;
+        }
+        if (m_paste.text != nullptr) {
+                if (m_paste.bracketed)
+                        feed_child("\e[201~", -1);
+                g_free(m_paste.text);
+                m_paste.text = nullptr;
+        }
+}
+
+/*
+ * Convert and queue the next slice of an in-flight paste.  Converting
+ * the whole clipboard in one go stalls the main loop on multi-megabyte
+ * pastes and then parks the result in one giant outgoing buffer, so the
+ * work is interleaved with main loop iterations in bounded slices, and
+ * pauses while the pty writer is backed up.
+ */
+void
+Terminal::paste_slice()
 {
 	gchar *paste, *p;
         gsize run;
         unsigned char c;
 
-	if (text == nullptr)
+        if (m_paste.text == nullptr)
                 return;
 
-        gsize len = strlen(text);
-        _vte_debug_print(VTE_DEBUG_SELECTION,
-                         "Pasting %" G_GSIZE_FORMAT " UTF-8 bytes.\n", len);
-        // FIXMEchpe this cannot happen ever
-        if (!g_utf8_validate(text, len, NULL)) {
-                g_warning("Paste not valid UTF-8, dropping.");
+        /* Let the pty writer drain before converting more. */
+        if (m_outgoing_queue.size() > VTE_PASTE_OUTGOING_LIMIT)
                 return;
-        }
+
+        char const* text = m_paste.text + m_paste.offset;
+        gsize const remaining = m_paste.length - m_paste.offset;
+        gsize take = MIN(remaining, (gsize)VTE_PASTE_SLICE_SIZE);
+        /* Don't split the lead byte of a C1 control off from its tail. */
+        if (take < remaining && (guchar)text[take - 1] == 0xC2)
+                take--;
 
         /* Convert newlines to carriage returns, which more software
          * is able to cope with (cough, pico, cough).
          * Filter out control chars except HT, CR (even stricter than xterm).
          * Also filter out C1 controls: U+0080 (0xC2 0x80) - U+009F (0xC2 0x9F). */
-        p = paste = (gchar *) g_malloc(len + 1);
-        while (p != nullptr && text[0] != '\0') {
+        char const* end = text + take;
+        p = paste = (gchar *) g_malloc(take + 1);
+        while (text < end) {
                 run = strcspn(text, "\x01\x02\x03\x04\x05\x06\x07"
                               "\x08\x0A\x0B\x0C\x0E\x0F"
                               "\x10\x11\x12\x13\x14\x15\x16\x17"
                               "\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F"
                               "\x7F\xC2");
+                run = MIN(run, (gsize)(end - text));
                 memcpy(p, text, run);
                 p += run;
                 text += run;
-                switch (text[0]) {
-                case '\x00':
+                if (text == end)
                         break;
+                switch (text[0]) {
                 case '\x0A':
                         *p = '\x0D';
                         p++;
@@ -5800,15 +7130,57 @@ Terminal::widget_paste_received(char const* text)
                 }
         }
 
-        bool const bracketed_paste = m_modes_private.XTERM_READLINE_BRACKETED_PASTE();
-        // FIXMEchpe can we not hardcode C0 controls here?
-        if (bracketed_paste)
-                feed_child("\e[200~", -1);
-        // FIXMEchpe add a way to avoid the extra string copy done here
         feed_child(paste, p - paste);
-        if (bracketed_paste)
-                feed_child("\e[201~", -1);
         g_free(paste);
+
+        m_paste.offset = text - m_paste.text;
+        _vte_debug_print(VTE_DEBUG_SELECTION,
+                         "Paste progress: %" G_GSIZE_FORMAT "/%" G_GSIZE_FORMAT " bytes.\n",
+                         m_paste.offset, m_paste.length);
+
+        if (m_paste.offset >= m_paste.length) {
+                if (m_paste.bracketed)
+                        feed_child("\e[201~", -1);
+                g_free(m_paste.text);
+                m_paste.text = nullptr;
+                if (m_paste.source != 0) {
+                        g_source_remove(m_paste.source);
+                        m_paste.source = 0;
+                }
+        }
+}
+
+void
+Terminal::widget_paste_received(char const* text)
+{
+	if (text == nullptr)
+                return;
+
+        gsize len = strlen(text);
+        _vte_debug_print(VTE_DEBUG_SELECTION,
+                         "Pasting %" G_GSIZE_FORMAT " UTF-8 bytes.\n", len);
+        // FIXMEchpe this cannot happen ever
+        if (!g_utf8_validate(text, len, NULL)) {
+                g_warning("Paste not valid UTF-8, dropping.");
+                return;
+        }
+
+        /* A previous paste still streaming is superseded. */
+        stop_paste();
+
+        m_paste.text = g_strndup(text, len);
+        m_paste.length = len;
+        m_paste.offset = 0;
+        m_paste.bracketed = m_modes_private.XTERM_READLINE_BRACKETED_PASTE();
+
+        // FIXMEchpe can we not hardcode C0 controls here?
+        if (m_paste.bracketed)
+                feed_child("\e[200~", -1);
+
+        /* Small pastes complete in this first, synchronous slice. */
+        paste_slice();
+        if (m_paste.text != nullptr)
+                m_paste.source = g_idle_add((GSourceFunc)paste_slice_cb, this);
 }
 
 bool
@@ -6039,6 +7411,7 @@ Terminal::hyperlink_invalidate_and_get_bbox(vte::base::Ring::hyperlink_idx_t idx
                 rowdata = _vte_ring_index(m_screen->row_data, row);
                 if (rowdata != NULL) {
                         bool do_invalidate_row = false;
+                        _vte_row_data_materialize(rowdata);
                         for (col = 0; col < rowdata->len; col++) {
                                 if (G_UNLIKELY (rowdata->cells[col].attr.hyperlink_idx == idx)) {
                                         do_invalidate_row = true;
@@ -6107,6 +7480,7 @@ Terminal::hyperlink_hilite_update()
                 rowcol = grid_coords_from_view_coords(pos);
                 rowdata = find_row_data(rowcol.row());
                 if (rowdata && rowcol.column() < rowdata->len) {
+                        _vte_row_data_materialize(rowdata);
                         new_hyperlink_hover_idx = rowdata->cells[rowcol.column()].attr.hyperlink_idx;
                 }
         }
@@ -6292,8 +7666,10 @@ Terminal::widget_clipboard_cleared(GtkClipboard *clipboard_)
 			deselect_all();
 		}
                 m_selection_owned[VTE_SELECTION_PRIMARY] = false;
+                m_selection_pending[VTE_SELECTION_PRIMARY] = false;
 	} else if (clipboard_ == m_clipboard[VTE_SELECTION_CLIPBOARD]) {
                 m_selection_owned[VTE_SELECTION_CLIPBOARD] = false;
+                m_selection_pending[VTE_SELECTION_CLIPBOARD] = false;
         }
 }
 
@@ -6329,6 +7705,8 @@ Terminal::widget_clipboard_requested(GtkClipboard *target_clipboard,
                                                guint info)
 {
 	for (auto sel = 0; sel < LAST_VTE_SELECTION; sel++) {
+                if (target_clipboard == m_clipboard[sel])
+                        materialize_selection(VteSelection(sel));
 		if (target_clipboard == m_clipboard[sel] &&
                     m_selection[sel] != nullptr) {
 			_VTE_DEBUG_IF(VTE_DEBUG_SELECTION) {
@@ -6400,6 +7778,11 @@ Terminal::rgb_from_index(guint index,
 	}
 }
 
+/* Extract the given range as UTF-8 text, with per-byte attributes in
+ * @attributes if non-NULL. If @text is non-NULL it is emptied, filled and
+ * returned instead of a freshly allocated string, so that repeated
+ * extraction can reuse one buffer (and one attributes array) without
+ * heap traffic once they have grown to a steady size. */
 GString*
 Terminal::get_text(vte::grid::row_t start_row,
                              vte::grid::column_t start_col,
@@ -6407,7 +7790,8 @@ Terminal::get_text(vte::grid::row_t start_row,
                              vte::grid::column_t end_col,
                              bool block,
                              bool wrap,
-                             GArray *attributes)
+                             GArray *attributes,
+                             GString *text)
 {
 	const VteCell *pcell = NULL;
 	GString *string;
@@ -6420,7 +7804,10 @@ Terminal::get_text(vte::grid::row_t start_row,
 	if (attributes)
 		g_array_set_size (attributes, 0);
 
-	string = g_string_new(NULL);
+        if (text != nullptr)
+                string = g_string_truncate(text, 0);
+        else
+                string = g_string_new(NULL);
 	memset(&attr, 0, sizeof(attr));
 
         if (start_col < 0)
@@ -6597,6 +7984,20 @@ Terminal::get_text_displayed_a11y(bool wrap,
                         attributes);
 }
 
+/* A single row's text (in logical order, trailing empty cells stripped,
+ * no newline appended), intended for iterating over a range row by row
+ * into a reused buffer: continuous extraction does no full-range copy
+ * and, once the buffer has grown, no allocation at all. */
+GString*
+Terminal::get_row_text(vte::grid::row_t row,
+                                 GString *text,
+                                 GArray *attributes)
+{
+        return get_text(row, 0, row, m_column_count,
+                        false /* block */, false /* wrap */,
+                        attributes, text);
+}
+
 GString*
 Terminal::get_selected_text(GArray *attributes)
 {
@@ -6875,29 +8276,28 @@ Terminal::widget_copy(VteSelection sel,
         /* Only put HTML on the CLIPBOARD, not PRIMARY */
         g_assert(sel == VTE_SELECTION_CLIPBOARD || format == VTE_FORMAT_TEXT);
 
-	/* Chuck old selected text and retrieve the newly-selected text. */
-        GArray *attributes = g_array_new(FALSE, TRUE, sizeof(struct _VteCharAttributes));
-        auto selection = get_selected_text(attributes);
+        /* No clipboards to own when running headless. */
+        if (G_UNLIKELY (m_clipboard[sel] == nullptr))
+                return;
 
+	/* Chuck the old selected text. The newly-selected text is only
+         * materialized when a transfer actually asks for it, or when the
+         * selection coordinates are about to go stale, so that selecting
+         * (say) the entire scrollback doesn't thaw and concatenate every
+         * row just to own PRIMARY. See materialize_selection(). */
         if (m_selection[sel]) {
                 g_string_free(m_selection[sel], TRUE);
                 m_selection[sel] = nullptr;
         }
 
-        if (selection == nullptr) {
-                g_array_free(attributes, TRUE);
+        if (m_selection_resolved.empty()) {
+                m_selection_pending[sel] = false;
                 m_selection_owned[sel] = false;
                 return;
         }
 
-        if (format == VTE_FORMAT_HTML) {
-                m_selection[sel] = attributes_to_html(selection, attributes);
-                g_string_free(selection, TRUE);
-        } else {
-                m_selection[sel] = selection;
-        }
-
-	g_array_free (attributes, TRUE);
+        m_selection_format[sel] = format;
+        m_selection_pending[sel] = true;
 
 	/* Place the text on the clipboard. */
         _vte_debug_print(VTE_DEBUG_SELECTION,
@@ -6917,26 +8317,57 @@ Terminal::widget_copy(VteSelection sel,
 
         gtk_clipboard_set_can_store(m_clipboard[sel], nullptr, 0);
         m_selection_owned[sel] = true;
-        m_selection_format[sel] = format;
 }
 
-/* Paste from the given clipboard. */
+/* Build the selected text for @sel from the recorded coordinates.
+ * Deferred from widget_copy() to the moment a transfer requests the text,
+ * or to just before the coordinates become stale. */
 void
-Terminal::widget_paste(GdkAtom board)
+Terminal::materialize_selection(VteSelection sel)
 {
-        if (!m_input_enabled)
+        if (!m_selection_pending[sel])
                 return;
+        m_selection_pending[sel] = false;
 
-	auto clip = gtk_clipboard_get_for_display(gtk_widget_get_display(m_widget), board);
-	if (!clip)
+        GArray *attributes = g_array_new(FALSE, TRUE, sizeof(struct _VteCharAttributes));
+        auto selection = get_selected_text(attributes);
+
+        if (selection == nullptr) {
+                g_array_free(attributes, TRUE);
                 return;
+        }
 
-        _vte_debug_print(VTE_DEBUG_SELECTION, "Requesting clipboard contents.\n");
+        if (m_selection_format[sel] == VTE_FORMAT_HTML) {
+                m_selection[sel] = attributes_to_html(selection, attributes);
+                g_string_free(selection, TRUE);
+        } else {
+                m_selection[sel] = selection;
+        }
 
-        m_paste_request.request_text(clip, &Terminal::widget_paste_received, this);
+	g_array_free (attributes, TRUE);
 }
 
-/* Confine coordinates into the visible area. Padding is already subtracted. */
+/* Paste from the given clipboard. */
+void
+Terminal::widget_paste(GdkAtom board)
+{
+        if (!m_input_enabled)
+                return;
+
+        /* No clipboards to paste from when running headless. */
+        if (G_UNLIKELY (gdk_display_get_default() == nullptr))
+                return;
+
+	auto clip = gtk_clipboard_get_for_display(gtk_widget_get_display(m_widget), board);
+	if (!clip)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_SELECTION, "Requesting clipboard contents.\n");
+
+        m_paste_request.request_text(clip, &Terminal::widget_paste_received, this);
+}
+
+/* Confine coordinates into the visible area. Padding is already subtracted. */
 void
 Terminal::confine_coordinates(long *xp,
                                         long *yp)
@@ -7066,23 +8497,34 @@ Terminal::autoscroll()
 {
 	bool extend = false;
 	long x, y, xmax, ymax;
-	glong adj;
+	glong adj, step;
 
 	/* Provide an immediate effect for mouse wigglers. */
 	if (m_mouse_last_position.y < 0) {
 		if (m_vadjustment) {
-			/* Try to scroll up by one line. */
-			adj = m_screen->scroll_delta - 1;
+			/* Scroll up, faster the further the pointer is
+			 * dragged past the edge, at most a screenful per
+			 * tick. */
+			step = 1 - m_mouse_last_position.y / m_cell_height;
+			step = MIN(step, (glong)m_row_count);
+			adj = m_screen->scroll_delta - step;
 			queue_adjustment_value_changed_clamped(adj);
+			/* Thaw the rows about to scroll into view in one
+			 * stream read, instead of one by one on demand. */
+			_vte_ring_prefetch(m_screen->row_data, adj, adj + step);
 			extend = true;
 		}
 		_vte_debug_print(VTE_DEBUG_EVENTS, "Autoscrolling down.\n");
 	}
 	if (m_mouse_last_position.y >= m_view_usable_extents.height()) {
 		if (m_vadjustment) {
-			/* Try to scroll up by one line. */
-			adj = m_screen->scroll_delta + 1;
+			/* Scroll down likewise. */
+			step = 1 + (m_mouse_last_position.y - m_view_usable_extents.height()) / m_cell_height;
+			step = MIN(step, (glong)m_row_count);
+			adj = m_screen->scroll_delta + step;
 			queue_adjustment_value_changed_clamped(adj);
+			_vte_ring_prefetch(m_screen->row_data,
+					   adj + m_row_count - step, adj + m_row_count);
 			extend = true;
 		}
 		_vte_debug_print(VTE_DEBUG_EVENTS, "Autoscrolling up.\n");
@@ -7121,7 +8563,7 @@ Terminal::start_autoscroll()
 
         m_mouse_autoscroll_tag =
                 g_timeout_add_full(G_PRIORITY_LOW,
-                                   666 / m_row_count, // FIXME WTF?
+                                   VTE_AUTOSCROLL_TIMEOUT,
                                    (GSourceFunc)vte_terminal_autoscroll_cb,
                                    this,
                                    NULL);// FIXME make sure m_mouse_autoscroll_tag is nulled!
@@ -7138,6 +8580,43 @@ Terminal::stop_autoscroll()
         m_mouse_autoscroll_tag = 0;
 }
 
+static gboolean
+hover_update_cb(vte::terminal::Terminal* that)
+{
+        that->hover_update();
+        return G_SOURCE_REMOVE;
+}
+
+/*
+ * Hover state (the hyperlink under the pointer and the dingu match
+ * highlight) is not re-evaluated directly from motion events: GDK
+ * compresses motion to the frame rate, but a high-rate pointer together
+ * with heavy output can still deliver far more events per frame than
+ * it's useful to evaluate.  Handlers note the new position and schedule
+ * one evaluation, which runs once the pending events have drained, so
+ * the hit-test cost is per frame rather than per event.
+ */
+void
+Terminal::queue_hover_update()
+{
+        if (m_hover_update_source != 0)
+                return;
+
+        m_hover_update_source = g_idle_add_full(GDK_PRIORITY_REDRAW - 1,
+                                                (GSourceFunc)hover_update_cb,
+                                                this,
+                                                nullptr);
+}
+
+void
+Terminal::hover_update()
+{
+        m_hover_update_source = 0;
+
+        hyperlink_hilite_update();
+        match_hilite_update();
+}
+
 bool
 Terminal::widget_motion_notify(GdkEventMotion *event)
 {
@@ -7198,8 +8677,7 @@ Terminal::widget_motion_notify(GdkEventMotion *event)
                 m_mouse_last_position = pos;
 
                 set_pointer_autohidden(false);
-                hyperlink_hilite_update();
-                match_hilite_update();
+                queue_hover_update();
         }
 
 	return handled;
@@ -7606,6 +9084,42 @@ Terminal::apply_font_metrics(int cell_width,
 	invalidate_all();
 }
 
+static gboolean
+ensure_font_debounce_cb(vte::terminal::Terminal* that)
+{
+        that->ensure_font_debounce();
+        return G_SOURCE_REMOVE;
+}
+
+#define VTE_FONT_DEBOUNCE_MSEC 40
+
+/*
+ * Terminal::queue_ensure_font:
+ *
+ * Schedule the font rebuild behind a short timeout, so that a burst of
+ * font or scale changes — e.g. every step of a pinch zoom — measures
+ * the font only once, for the settled description. Until then the old
+ * font keeps painting; anything that needs the new metrics right away
+ * (size requests, the cell size getters) flushes the pending rebuild
+ * through ensure_font().
+ */
+void
+Terminal::queue_ensure_font()
+{
+        if (m_ensure_font_source != 0)
+                g_source_remove(m_ensure_font_source);
+        m_ensure_font_source = g_timeout_add(VTE_FONT_DEBOUNCE_MSEC,
+                                             (GSourceFunc)ensure_font_debounce_cb,
+                                             this);
+}
+
+void
+Terminal::ensure_font_debounce()
+{
+        m_ensure_font_source = 0;
+        ensure_font();
+}
+
 void
 Terminal::ensure_font()
 {
@@ -7659,9 +9173,9 @@ Terminal::update_font()
         m_fontdirty = TRUE;
         m_has_fonts = TRUE;
 
-        /* Set the drawing font. */
+        /* Set the drawing font, coalescing bursts of changes. */
         if (widget_realized()) {
-                ensure_font();
+                queue_ensure_font();
         }
 }
 
@@ -7792,6 +9306,7 @@ Terminal::refresh_size()
         m_row_count = rows;
         m_column_count = columns;
         m_tabstops.resize(columns);
+        update_addressing_context();
 }
 
 /* Resize the given screen (normal or alternate) of the terminal. */
@@ -7851,8 +9366,21 @@ Terminal::screen_set_size(VteScreen *screen_,
 
 	old_top_lines = below_current_paragraph.row - screen_->insert_delta;
 
-	if (do_rewrap && old_columns != m_column_count)
-		_vte_ring_rewrap(ring, m_column_count, markers);
+	if (do_rewrap && old_columns != m_column_count) {
+                /* Rewrapping a huge history stalls the UI on every step of an
+                 * interactive resize. Leave the contents as if rewrapping was
+                 * disabled for now, and do a single rewrap once the size has
+                 * settled. old_columns is -1 when we are that deferred pass. */
+                if (screen_ == &m_normal_screen && old_columns != -1 &&
+                    _vte_ring_length(ring) > VTE_REWRAP_DEFER_ROWS) {
+                        defer_rewrap();
+                } else {
+                        stop_deferred_rewrap();
+                        _vte_ring_rewrap(ring, m_column_count, markers);
+                        /* Rewrapping renumbered the rows. */
+                        search_cache_clear();
+                }
+        }
 
 	if (_vte_ring_length(ring) > m_row_count) {
 		/* The content won't fit without scrollbars. Before figuring out the position, we might need to
@@ -7934,6 +9462,112 @@ Terminal::screen_set_size(VteScreen *screen_,
 		screen_->scroll_delta = new_scroll_delta;
 }
 
+static gboolean
+vte_terminal_deferred_rewrap_cb(vte::terminal::Terminal* that)
+{
+        that->deferred_rewrap();
+        return FALSE;
+}
+
+/* (Re)start the debounce timer for rewrapping the normal screen's history. */
+void
+Terminal::defer_rewrap()
+{
+        stop_deferred_rewrap();
+
+        m_deferred_rewrap_tag =
+                g_timeout_add_full(G_PRIORITY_LOW,
+                                   VTE_REWRAP_DEFER_TIMEOUT,
+                                   (GSourceFunc)vte_terminal_deferred_rewrap_cb,
+                                   this,
+                                   NULL);
+}
+
+void
+Terminal::stop_deferred_rewrap()
+{
+        if (m_deferred_rewrap_tag == 0)
+                return;
+
+        g_source_remove(m_deferred_rewrap_tag);
+        m_deferred_rewrap_tag = 0;
+}
+
+/* Perform the rewrap that screen_set_size() postponed. Until now the ring
+ * contents were exactly as if rewrapping was disabled, so re-running the
+ * marker and delta logic of screen_set_size() brings everything up to date
+ * in one go. */
+void
+Terminal::deferred_rewrap()
+{
+        m_deferred_rewrap_tag = 0;
+
+        if (!m_rewrap_on_resize)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_RESIZE, "Performing deferred rewrap.\n");
+
+        /* -1 forces the rewrap although the column count didn't change again. */
+        screen_set_size(&m_normal_screen, -1, m_row_count, true);
+
+        /* Ensure the cursor is valid */
+        m_screen->cursor.row = CLAMP (m_screen->cursor.row,
+                                      _vte_ring_delta (m_screen->row_data),
+                                      MAX (_vte_ring_delta (m_screen->row_data),
+                                           _vte_ring_next (m_screen->row_data) - 1));
+
+        adjust_adjustments_full();
+        invalidate_all();
+        /* Our visible text changed. */
+        emit_text_modified();
+}
+
+static gboolean
+resize_debounce_cb(vte::terminal::Terminal* that)
+{
+        that->resize_debounce();
+        return G_SOURCE_REMOVE;
+}
+
+/*
+ * During an interactive drag-resize, GTK allocates every intermediate
+ * size; applying each one means a TIOCSWINSZ ioctl plus SIGWINCH to the
+ * child and a full screen-matrix rework -- and under a full-screen
+ * application, a complete redraw round trip -- per pointer motion.  The
+ * widget-side allocation is applied immediately so painting follows the
+ * window, but the grid and pty size only follow once the allocation has
+ * been stable for this long.  Programmatic resizes keep calling
+ * set_size() directly.
+ */
+#define VTE_RESIZE_DEBOUNCE_MSEC 40
+
+void
+Terminal::queue_size_update(long columns,
+                            long rows)
+{
+        m_resize_pending_columns = columns;
+        m_resize_pending_rows = rows;
+
+        if (m_resize_debounce_source != 0)
+                g_source_remove(m_resize_debounce_source);
+        m_resize_debounce_source = g_timeout_add(VTE_RESIZE_DEBOUNCE_MSEC,
+                                                 (GSourceFunc)resize_debounce_cb,
+                                                 this);
+}
+
+void
+Terminal::resize_debounce()
+{
+        m_resize_debounce_source = 0;
+
+        if (m_resize_pending_columns == m_column_count &&
+            m_resize_pending_rows == m_row_count)
+                return;
+
+        set_size(m_resize_pending_columns, m_resize_pending_rows);
+        queue_contents_changed();
+}
+
 void
 Terminal::set_size(long columns,
                              long rows)
@@ -7965,6 +9599,7 @@ Terminal::set_size(long columns,
 	}
 	if (old_rows != m_row_count || old_columns != m_column_count) {
                 m_scrolling_restricted = FALSE;
+                update_addressing_context();
 
                 _vte_ring_set_visible_rows(m_normal_screen.row_data, m_row_count);
                 _vte_ring_set_visible_rows(m_alternate_screen.row_data, m_row_count);
@@ -8014,7 +9649,14 @@ Terminal::vadjustment_value_changed()
 	if (!_vte_double_equal(dy, 0)) {
 		_vte_debug_print(VTE_DEBUG_ADJ,
 			    "Scrolling by %f\n", dy);
-                invalidate_all();
+                /* With the frame cache a scroll costs a blit plus the rows
+                 * that scrolled into view; widget_draw() detects the moved
+                 * scroll position itself, so only a full-window draw needs
+                 * queueing. Without a cache fall back to full damage. */
+                if (m_frame_cache != nullptr)
+                        gtk_widget_queue_draw(m_widget);
+                else
+                        invalidate_all();
                 match_contents_clear();
 		emit_text_scrolled(dy);
 		queue_contents_changed();
@@ -8144,13 +9786,19 @@ Terminal::Terminal(vte::platform::Widget* w,
 	for (i = 0; i < VTE_PALETTE_SIZE; i++)
 		m_palette[i].sources[VTE_COLOR_SOURCE_ESCAPE].is_set = FALSE;
 
+        /* Set up the dedicated parser thread, if enabled. */
+        if (vte::base::ParserThread::enabled())
+                m_parser_thread = std::make_unique<vte::base::ParserThread>();
+
+        /* Start the periodic stats dump, if enabled. */
+        vte::stats::schedule_dump();
+
 	/* Set up I/O encodings. */
         g_assert_true(m_using_utf8);
         m_utf8_ambiguous_width = VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH;
 	m_max_input_bytes = VTE_MAX_INPUT_READ;
 	m_cursor_blink_tag = 0;
         m_text_blink_tag = 0;
-	m_outgoing = _vte_byte_array_new();
         m_last_graphic_character = 0;
 
 #ifdef WITH_ICONV
@@ -8161,6 +9809,10 @@ Terminal::Terminal(vte::platform::Widget* w,
 	/* Setting the terminal type and size requires the PTY master to
 	 * be set up properly first. */
         m_pty = nullptr;
+
+        /* Session recorder for deterministic replay; see pty_record(). */
+        if (G_UNLIKELY (g_getenv("VTE_RECORD") != nullptr))
+                pty_record_open();
         set_size(VTE_COLUMNS, VTE_ROWS);
 	m_pty_input_source = 0;
 	m_pty_output_source = 0;
@@ -8170,12 +9822,23 @@ Terminal::Terminal(vte::platform::Widget* w,
         m_scrollback_lines = -1; /* force update in vte_terminal_set_scrollback_lines */
 	set_scrollback_lines(VTE_SCROLLBACK_INIT);
 
-	/* Selection info. */
-	display = gtk_widget_get_display(m_widget);
-	m_clipboard[VTE_SELECTION_PRIMARY] = gtk_clipboard_get_for_display(display, GDK_SELECTION_PRIMARY);
-	m_clipboard[VTE_SELECTION_CLIPBOARD] = gtk_clipboard_get_for_display(display, GDK_SELECTION_CLIPBOARD);
+	/* Selection info.  Headless processes (feeding and reading back an
+	 * unrealized terminal, e.g. for server-side replay; there's no
+	 * display at all) have no clipboards: leave them NULL and
+	 * widget_copy()/widget_paste() turn into no-ops.  Everything that
+	 * needs a window already bails out via widget_realized(). */
+	display = gdk_display_get_default();
+	if (G_LIKELY (display != nullptr)) {
+		m_clipboard[VTE_SELECTION_PRIMARY] = gtk_clipboard_get_for_display(display, GDK_SELECTION_PRIMARY);
+		m_clipboard[VTE_SELECTION_CLIPBOARD] = gtk_clipboard_get_for_display(display, GDK_SELECTION_CLIPBOARD);
+	} else {
+		m_clipboard[VTE_SELECTION_PRIMARY] = nullptr;
+		m_clipboard[VTE_SELECTION_CLIPBOARD] = nullptr;
+	}
         m_selection_owned[VTE_SELECTION_PRIMARY] = false;
         m_selection_owned[VTE_SELECTION_CLIPBOARD] = false;
+        m_selection_pending[VTE_SELECTION_PRIMARY] = false;
+        m_selection_pending[VTE_SELECTION_CLIPBOARD] = false;
 
 	/* Miscellaneous options. */
 	set_backspace_binding(VTE_ERASE_AUTO);
@@ -8363,11 +10026,15 @@ Terminal::widget_size_allocate(GtkAllocation *allocation)
 			|| height != m_row_count
 			|| update_scrollback)
 	{
-		/* Set the size of the pseudo-terminal. */
-		set_size(width, height);
-
-		/* Notify viewers that the contents have changed. */
-		queue_contents_changed();
+                if (m_pty == nullptr) {
+                        /* No child to notify; apply immediately so the very
+                         * first allocation sizes the grid before spawn. */
+                        set_size(width, height);
+                        queue_contents_changed();
+                } else {
+                        /* Debounce; see queue_size_update(). */
+                        queue_size_update(width, height);
+                }
 	}
 
 	if (widget_realized()) {
@@ -8379,10 +10046,48 @@ Terminal::widget_size_allocate(GtkAllocation *allocation)
 	}
 }
 
+void
+Terminal::widget_map()
+{
+        if (!m_widget_unmapped)
+                return;
+        m_widget_unmapped = false;
+
+        /* Catch up at full rate on whatever accumulated while hidden */
+        if (m_background_timer != 0) {
+                _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing background timer\n");
+                g_source_remove(m_background_timer);
+                m_background_timer = 0;
+                start_processing();
+        }
+
+        /* Blinking was suspended while hidden. The cursor timer depends
+         * on focus; text blink re-arms from the draw path. */
+        check_cursor_blink();
+}
+
 void
 Terminal::widget_unmap()
 {
         m_ringview.pause();
+
+        /* Background throttle: a hidden terminal doesn't need to parse
+         * at frame rate, and nothing it draws can be seen. Shift any
+         * pending work onto the slow timer -- the screen model still
+         * advances, which flow control, the scrollback limit and
+         * responses to queries from the child depend on, just in large,
+         * infrequent batches -- and stop the blink timers until the
+         * widget is mapped again. */
+        m_widget_unmapped = true;
+
+        remove_cursor_timeout();
+        remove_text_blink_timeout();
+
+        if (is_processing()) {
+                invalidate_dirty_rects_and_process_updates();
+                stop_processing(this);
+                background_schedule();
+        }
 }
 
 void
@@ -8402,12 +10107,19 @@ Terminal::widget_unrealize()
 	}
 	m_fontdirty = TRUE;
 
+	/* The frame cache is tied to the window's backing surface. */
+	frame_cache_drop();
+
 	/* Unmap the widget if it hasn't been already. */
         // FIXMEchpe this can't happen
 	if (gtk_widget_get_mapped(m_widget)) {
 		gtk_widget_unmap(m_widget);
 	}
 
+	/* The frame clock goes away with the window; fall back to the
+	 * timeout machinery. */
+	disconnect_frame_clock();
+
         /* Remove the cursor blink timeout function. */
 	remove_cursor_timeout();
 
@@ -8418,11 +10130,11 @@ Terminal::widget_unrealize()
 	remove_update_timeout(this);
 
 	/* Cancel any pending signals */
-	m_contents_changed_pending = FALSE;
-	m_cursor_moved_pending = FALSE;
-	m_text_modified_flag = FALSE;
-	m_text_inserted_flag = FALSE;
-	m_text_deleted_flag = FALSE;
+	m_pending_changes &= ~(VTE_PENDING_CONTENTS_CHANGED |
+			       VTE_PENDING_CURSOR_MOVED |
+			       VTE_PENDING_TEXT_MODIFIED |
+			       VTE_PENDING_TEXT_INSERTED |
+			       VTE_PENDING_TEXT_DELETED);
 
 	/* Clear modifiers. */
 	m_modifiers = 0;
@@ -8453,6 +10165,7 @@ Terminal::~Terminal()
 {
         /* Make sure not to change selection while in destruction. See issue vte#89. */
         m_changing_selection = true;
+        m_in_destruction = true;
 
 	struct vte_match_regex *regex;
 	int sel;
@@ -8462,8 +10175,14 @@ Terminal::~Terminal()
         set_pty(nullptr, false /* don't process remaining data */);
         remove_update_timeout(this);
 
+        /* Stop the session recorder. */
+        if (G_UNLIKELY (m_record_stream != nullptr))
+                gzclose((gzFile)m_record_stream);
+
         /* Stop processing input. */
         stop_processing(this);
+        if (m_background_timer != 0)
+                g_source_remove(m_background_timer);
 
 	/* Free the draw structure. */
 	if (m_draw != NULL) {
@@ -8497,13 +10216,48 @@ Terminal::~Terminal()
 		g_array_free(m_match_regexes, TRUE);
 	}
 
+	/* Cancel any in-flight asynchronous search. */
+	stop_search_task();
+
+	/* Cancel any in-flight asynchronous contents write. */
+	stop_write_contents_task();
+
         regex_and_flags_clear(&m_search_regex);
 	if (m_search_attrs)
 		g_array_free (m_search_attrs, TRUE);
+	if (m_search_result_cache)
+		g_hash_table_destroy (m_search_result_cache);
+        if (m_match_data != nullptr)
+                pcre2_match_data_free_8(m_match_data);
+        if (m_match_context != nullptr)
+                pcre2_match_context_free_8(m_match_context);
+        if (m_jit_stack != nullptr)
+                pcre2_jit_stack_free_8(m_jit_stack);
 
 	/* Disconnect from autoscroll requests. */
 	stop_autoscroll();
 
+	/* Cancel a pending hover re-evaluation. */
+	if (m_hover_update_source != 0)
+		g_source_remove(m_hover_update_source);
+
+	/* Cancel a pending debounced resize. */
+	if (m_resize_debounce_source != 0)
+		g_source_remove(m_resize_debounce_source);
+
+	/* Cancel a pending debounced font rebuild. */
+	if (m_ensure_font_source != 0)
+		g_source_remove(m_ensure_font_source);
+
+	/* Cancel a paste still streaming. */
+	stop_paste();
+
+	/* Drop the retained frame. */
+	frame_cache_drop();
+
+	/* Cancel any pending deferred rewrap. */
+	stop_deferred_rewrap();
+
 	/* Cancel pending adjustment change notifications. */
 	m_adjustment_changed_pending = FALSE;
 
@@ -8511,6 +10265,8 @@ Terminal::~Terminal()
 	 * throw the text onto the clipboard without an owner so that it
 	 * doesn't just disappear. */
 	for (sel = VTE_SELECTION_PRIMARY; sel < LAST_VTE_SELECTION; sel++) {
+                if (m_selection_owned[sel])
+                        materialize_selection(VteSelection(sel));
 		if (m_selection[sel] != nullptr) {
 			if (m_selection_owned[sel]) {
                                 // FIXMEchpe we should check m_selection_format[sel]
@@ -8546,8 +10302,7 @@ Terminal::~Terminal()
         }
 
 	/* Discard any pending data. */
-	_vte_byte_array_free(m_outgoing);
-        m_outgoing = nullptr;
+        m_outgoing_queue.clear();
 
 	/* Free public-facing data. */
 	if (m_vadjustment != NULL) {
@@ -8577,6 +10332,9 @@ Terminal::widget_realize()
 	/* Clear modifiers. */
 	m_modifiers = 0;
 
+	/* Drive processing from the compositor's frame clock from now on. */
+	connect_frame_clock();
+
 	ensure_font();
 }
 
@@ -8704,14 +10462,6 @@ Terminal::determine_cursor_colors(VteCell const* cell,
                          fore, back, deco);
 }
 
-static gboolean
-invalidate_text_blink_cb(vte::terminal::Terminal* that)
-{
-        that->m_text_blink_tag = 0;
-        that->invalidate_all();
-        return G_SOURCE_REMOVE;
-}
-
 /* Draw a string of characters with similar attributes. */
 void
 Terminal::draw_cells(struct _vte_draw_text_request *items,
@@ -9222,6 +10972,13 @@ Terminal::draw_rows(VteScreen *screen_,
         auto const column_count = m_column_count;
         uint32_t const attr_mask = m_allow_bold ? ~0 : ~VTE_ATTR_BOLD_MASK;
 
+        /* Don't spend more than roughly this much wall-clock time in a
+         * single expose; see the deadline check in the text loop below. */
+        auto const deadline = g_get_monotonic_time() + VTE_DRAW_BUDGET;
+        auto deferred_row = end_row;
+
+        _vte_trace1(draw_rows_start, end_row - start_row);
+
         /* Need to ensure the ringview is updated. */
         ringview_update();
 
@@ -9271,6 +11028,20 @@ Terminal::draw_rows(VteScreen *screen_,
                         }
                 }
 
+                /* Does the selection touch this row at all?  If not,
+                 * cell_is_selected_vis() is false for the whole row and
+                 * needn't be evaluated per cell. */
+                bool const row_selectable = !m_selection_resolved.empty() &&
+                                            row >= m_selection_resolved.start_row() &&
+                                            row <= m_selection_resolved.last_row();
+
+                /* The attr bits that participate in resolving the back color;
+                 * cells that agree on these, on the colors and on the
+                 * selection state resolve to the same back. */
+                uint32_t const back_flags_mask = VTE_ATTR_BOLD_MASK |
+                                                 VTE_ATTR_DIM_MASK |
+                                                 VTE_ATTR_REVERSE_MASK;
+
                 i = j = 0;
                 /* Walk the line.
                  * Locate runs of identical bg colors within a row, and paint each run as a single rectangle. */
@@ -9278,22 +11049,44 @@ Terminal::draw_rows(VteScreen *screen_,
                         /* Get the first cell's contents. */
                         cell = row_data ? _vte_row_data_get (row_data, bidirow->vis2log(i)) : nullptr;
                         /* Find the colors for this cell. */
-                        selected = cell_is_selected_vis(i, row);
+                        selected = row_selectable && cell_is_selected_vis(i, row);
                         determine_colors(cell, selected, &fore, &back, &deco);
                         rtl = bidirow->vis_is_rtl(i);
 
+                        auto const* cattr = cell ? &cell->attr : &basic_cell.attr;
+                        auto run_colors = cattr->colors();
+                        auto run_flags = cattr->attr & back_flags_mask;
+                        auto run_selected = selected;
+
                         while (++j < column_count) {
                                 /* Retrieve the next cell. */
                                 cell = row_data ? _vte_row_data_get (row_data, bidirow->vis2log(j)) : nullptr;
+                                selected = row_selectable && cell_is_selected_vis(j, row);
+                                nrtl = bidirow->vis_is_rtl(j);
+                                if (G_UNLIKELY (_vte_debug_on (VTE_DEBUG_BIDI) && nrtl != rtl))
+                                        break;
+
+                                /* An unchanged color signature extends the run
+                                 * without a full color resolution. */
+                                auto const* ncattr = cell ? &cell->attr : &basic_cell.attr;
+                                if (G_LIKELY (ncattr->colors() == run_colors &&
+                                              (ncattr->attr & back_flags_mask) == run_flags &&
+                                              selected == run_selected))
+                                        continue;
+
                                 /* Resolve attributes to colors where possible and
                                  * compare visual attributes to the first character
                                  * in this chunk. */
-                                selected = cell_is_selected_vis(j, row);
                                 determine_colors(cell, selected, &nfore, &nback, &ndeco);
-                                nrtl = bidirow->vis_is_rtl(j);
-                                if (nback != back || (_vte_debug_on (VTE_DEBUG_BIDI) && nrtl != rtl)) {
+                                if (nback != back) {
                                         break;
                                 }
+
+                                /* Different attributes resolving to the same
+                                 * back; rebase the signature on this cell. */
+                                run_colors = ncattr->colors();
+                                run_flags = ncattr->attr & back_flags_mask;
+                                run_selected = selected;
                         }
                         if (back != VTE_DEFAULT_BG) {
                                 vte::color::rgb bg;
@@ -9360,6 +11153,7 @@ Terminal::draw_rows(VteScreen *screen_,
                                      rect_width,
                                      row_height + cell_overflow_top() + cell_overflow_bottom()};
 
+        bool painted_any = false;
         for (row = start_row, y = start_y;
              row < end_row;
              row++, y += row_height, rect.y += row_height) {
@@ -9367,6 +11161,16 @@ Terminal::draw_rows(VteScreen *screen_,
                 if (cairo_region_contains_rectangle(region, &rect) == CAIRO_REGION_OVERLAP_OUT)
                         continue;
 
+                /* Out of budget?  Stop here and progressively render the
+                 * rest (which keeps its fresh background, sans glyphs, for
+                 * one frame) from subsequent frames.  Always render at
+                 * least one row so progress is guaranteed. */
+                if (G_UNLIKELY (painted_any && g_get_monotonic_time() > deadline)) {
+                        deferred_row = row;
+                        break;
+                }
+                painted_any = true;
+
                 row_data = find_row_data(row);
                 if (row_data == NULL)
                         continue; /* Skip row. */
@@ -9484,6 +11288,17 @@ Terminal::draw_rows(VteScreen *screen_,
                                    column_width, row_height);
                 }
         }
+
+        if (G_UNLIKELY (deferred_row < end_row)) {
+                /* A huge invalidation (e.g. a full repaint of a maximized
+                 * window) overran the budget; queue the unrendered rows so
+                 * the next frame(s) pick them up.  Clear m_invalidated_all
+                 * first, it would swallow the invalidation. */
+                m_invalidated_all = FALSE;
+                invalidate_rows(deferred_row, end_row - 1);
+        }
+
+        _vte_trace(draw_rows_done);
 }
 
 void
@@ -9751,83 +11566,465 @@ Terminal::paint_im_preedit_string()
 	}
 }
 
+/* Blit the SIXEL images that intersect the visible rows, under the
+ * text. The surfaces were prepared at decode time, so this is one
+ * cairo_paint() per visible image. */
 void
-Terminal::widget_draw(cairo_t *cr)
+Terminal::paint_images(cairo_t* cr)
 {
-        cairo_rectangle_int_t clip_rect;
-        cairo_region_t *region;
-        int allocated_width, allocated_height;
-        int extra_area_for_cursor;
-        bool text_blink_enabled_now;
-        gint64 now = 0;
+        auto const first_row = first_displayed_row();
+        auto const last_row = last_displayed_row();
 
-        if (!gdk_cairo_get_clip_rectangle (cr, &clip_rect))
-                return;
+        for (auto const& image : m_images) {
+                if (image->screen != m_screen)
+                        continue;
+                if (image->top_row > last_row ||
+                    image->top_row + image->rows - 1 < first_row)
+                        continue;
 
-        _vte_debug_print(VTE_DEBUG_LIFECYCLE, "vte_terminal_draw()\n");
-        _vte_debug_print (VTE_DEBUG_WORK, "+");
-        _vte_debug_print (VTE_DEBUG_UPDATES, "Draw (%d,%d)x(%d,%d)\n",
-                          clip_rect.x, clip_rect.y,
-                          clip_rect.width, clip_rect.height);
+                cairo_save(cr);
+                cairo_set_source_surface(cr,
+                                         image->surface(),
+                                         image->left_column * m_cell_width,
+                                         row_to_pixel(image->top_row));
+                cairo_paint(cr);
+                cairo_restore(cr);
+        }
+}
 
-        region = vte_cairo_get_clip_region (cr);
-        if (region == NULL)
-                return;
+/*
+ * Drop images whose rows left the ring, then enforce a per-terminal
+ * byte budget, oldest first. This keeps image memory tied to the
+ * scrollback the images live in; a frozen row is still displayable, so
+ * freezing alone does not evict.
+ */
+void
+Terminal::prune_images()
+{
+        static gsize const k_image_budget = 64 * 1024 * 1024;
 
-        allocated_width = get_allocated_width();
-        allocated_height = get_allocated_height();
+        auto const scrolled_out = [this](std::unique_ptr<vte::sixel::Image> const& image) {
+                auto const* screen = reinterpret_cast<VteScreen const*>(image->screen);
+                return image->top_row + image->rows <= long(_vte_ring_delta(screen->row_data));
+        };
+        m_images.erase(std::remove_if(m_images.begin(), m_images.end(), scrolled_out),
+                       m_images.end());
 
-	/* Designate the start of the drawing operation and clear the area. */
-	_vte_draw_set_cairo(m_draw, cr);
+        gsize total = 0;
+        for (auto const& image : m_images)
+                total += image->size_bytes();
 
-        if (G_LIKELY(m_clear_background)) {
-                _vte_draw_clear (m_draw, 0, 0,
-                                 allocated_width, allocated_height,
-                                 get_color(VTE_DEFAULT_BG), m_background_alpha);
+        auto it = m_images.begin();
+        while (total > k_image_budget && it != m_images.end()) {
+                total -= (*it)->size_bytes();
+                it = m_images.erase(it);
         }
+}
 
-        /* Clip vertically, for the sake of smooth scrolling. We want the top and bottom paddings to be unused.
-         * Don't clip horizontally so that antialiasing can legally overflow to the right padding. */
-        cairo_save(cr);
-        cairo_rectangle(cr, 0, m_padding.top, allocated_width, allocated_height - m_padding.top - m_padding.bottom);
-        cairo_clip(cr);
-
-        cairo_translate(cr, m_padding.left, m_padding.top);
+/*
+ * Frame cache:
+ *
+ * widget_draw() renders the terminal contents (background, images, text)
+ * into a retained offscreen surface and blits that to the window; the
+ * cursor and the IM preedit string are painted over the blit each frame.
+ * Only the rows whose content changed since the last frame are rendered
+ * into the cache, so scrolling the viewport costs one shifted copy of
+ * the surviving pixels plus rendering the rows that scrolled into view,
+ * instead of a full-window repaint.
+ *
+ * The dirty region is kept in buffer-anchored pixel coordinates: view
+ * coordinates shifted down by the scroll origin, round(scroll_delta *
+ * cell_height). In these coordinates a row's rect doesn't depend on when
+ * it was recorded, so damage noted before a scroll and damage noted
+ * after it combine correctly without any translation bookkeeping.
+ *
+ * Set VTE_FRAME_CACHE=0 to render straight to the window as before.
+ */
 
-        /* Transform to view coordinates */
-        cairo_region_translate(region, -m_padding.left, -m_padding.top);
+void
+Terminal::frame_cache_mark_dirty(cairo_rectangle_int_t const* rect)
+{
+        if (m_frame_cache_dirty == nullptr)
+                return;
 
-        /* Whether blinking text should be visible now */
-        m_text_blink_state = true;
-        text_blink_enabled_now = m_text_blink_mode & (m_has_focus ? VTE_TEXT_BLINK_FOCUSED : VTE_TEXT_BLINK_UNFOCUSED);
-        if (text_blink_enabled_now) {
-                now = g_get_monotonic_time() / 1000;
-                if (now % (m_text_blink_cycle * 2) >= m_text_blink_cycle)
-                        m_text_blink_state = false;
+        auto const origin = (glong)round(m_screen->scroll_delta * m_cell_height);
+        if (G_UNLIKELY (origin >= G_MAXINT / 2)) {
+                /* Out of headroom for anchored coordinates */
+                frame_cache_mark_all_dirty();
+                return;
         }
-        /* Painting will flip this if it encounters any cell with blink attribute */
-        m_text_to_blink = false;
 
-        /* and now paint them */
-        auto const first_row = first_displayed_row();
-        draw_rows(m_screen,
-                  region,
-                  first_row,
-                  last_displayed_row() + 1,
-                  row_to_pixel(first_row),
-                  m_cell_width,
-                  m_cell_height);
+        auto r = *rect;
+        r.y += (int)origin;
+        cairo_region_union_rectangle(m_frame_cache_dirty, &r);
+}
 
-	paint_im_preedit_string();
+void
+Terminal::frame_cache_mark_all_dirty()
+{
+        if (m_frame_cache_dirty == nullptr)
+                return;
 
-        cairo_restore(cr);
+        /* Cover every scroll position, not just the current viewport;
+         * the render pass intersects with the viewport anyway. */
+        auto const all = cairo_rectangle_int_t{G_MININT / 2, G_MININT / 2,
+                                               G_MAXINT, G_MAXINT};
+        cairo_region_union_rectangle(m_frame_cache_dirty, &all);
+}
 
-        /* Re-clip, allowing VTE_LINE_WIDTH more pixel rows for the outline cursor. */
-        /* TODOegmont: It's really ugly to do it here. */
-        cairo_save(cr);
-        extra_area_for_cursor = (decscusr_cursor_shape() == VTE_CURSOR_SHAPE_BLOCK && !m_has_focus) ? VTE_LINE_WIDTH : 0;
-        cairo_rectangle(cr, 0, m_padding.top - extra_area_for_cursor, allocated_width, allocated_height - m_padding.top - m_padding.bottom + 2 * extra_area_for_cursor);
-        cairo_clip(cr);
+void
+Terminal::frame_cache_drop()
+{
+        if (m_frame_cache != nullptr) {
+                cairo_surface_destroy(m_frame_cache);
+                m_frame_cache = nullptr;
+        }
+        if (m_frame_cache_scratch != nullptr) {
+                cairo_surface_destroy(m_frame_cache_scratch);
+                m_frame_cache_scratch = nullptr;
+        }
+        if (m_frame_cache_dirty != nullptr) {
+                cairo_region_destroy(m_frame_cache_dirty);
+                m_frame_cache_dirty = nullptr;
+        }
+        m_frame_cache_width = m_frame_cache_height = 0;
+        m_frame_cache_screen = nullptr;
+}
+
+/* Make sure the cache matches the allocation and the scroll position.
+ * Returns false when the cache is unavailable and the caller must render
+ * directly to the window. */
+bool
+Terminal::frame_cache_prepare(cairo_t* cr,
+                              int allocated_width,
+                              int allocated_height)
+{
+        static int enabled = -1;
+        if (G_UNLIKELY (enabled == -1)) {
+                auto const* env = g_getenv("VTE_FRAME_CACHE");
+                enabled = env == nullptr || !g_str_equal(env, "0");
+        }
+        if (!enabled)
+                return false;
+
+        auto const origin = (glong)round(m_screen->scroll_delta * m_cell_height);
+        if (G_UNLIKELY (origin >= G_MAXINT / 2))
+                return false;
+
+        if (m_frame_cache != nullptr &&
+            (m_frame_cache_width != allocated_width ||
+             m_frame_cache_height != allocated_height))
+                frame_cache_drop();
+
+        if (m_frame_cache == nullptr) {
+                m_frame_cache = cairo_surface_create_similar(cairo_get_target(cr),
+                                                             CAIRO_CONTENT_COLOR_ALPHA,
+                                                             allocated_width,
+                                                             allocated_height);
+                if (cairo_surface_status(m_frame_cache) != CAIRO_STATUS_SUCCESS) {
+                        frame_cache_drop();
+                        return false;
+                }
+                m_frame_cache_width = allocated_width;
+                m_frame_cache_height = allocated_height;
+                m_frame_cache_dirty = cairo_region_create();
+                m_frame_cache_screen = nullptr;
+                frame_cache_mark_all_dirty();
+        }
+
+        /* Screen switches and font changes come with an invalidate_all();
+         * the cached pixels can only be shifted while they still describe
+         * this screen at this cell size, with these colors. */
+        if (m_frame_cache_screen != m_screen ||
+            m_frame_cache_cell_height != m_cell_height ||
+            m_frame_cache_color_generation != m_color_generation)
+                frame_cache_mark_all_dirty();
+        else if (origin != m_frame_cache_origin)
+                frame_cache_shift(origin);
+
+        return true;
+}
+
+/* The viewport scrolled: shift the cached content area by the scroll
+ * origin difference and mark the band that scrolled into view dirty. */
+void
+Terminal::frame_cache_shift(long origin)
+{
+        auto const content_height = m_frame_cache_height - m_padding.top - m_padding.bottom;
+        auto const dy = origin - m_frame_cache_origin;
+        auto const magnitude = dy < 0 ? -dy : dy;
+
+        if (magnitude >= content_height) {
+                frame_cache_mark_all_dirty();
+                m_frame_cache_origin = origin;
+                return;
+        }
+
+        if (m_frame_cache_scratch == nullptr) {
+                m_frame_cache_scratch = cairo_surface_create_similar(m_frame_cache,
+                                                                     CAIRO_CONTENT_COLOR_ALPHA,
+                                                                     m_frame_cache_width,
+                                                                     m_frame_cache_height);
+                if (cairo_surface_status(m_frame_cache_scratch) != CAIRO_STATUS_SUCCESS) {
+                        cairo_surface_destroy(m_frame_cache_scratch);
+                        m_frame_cache_scratch = nullptr;
+                        frame_cache_mark_all_dirty();
+                        m_frame_cache_origin = origin;
+                        return;
+                }
+        }
+
+        /* Copy the frame with the content area shifted, the paddings as
+         * they are. Source pixels from outside the old frame come out
+         * transparent and sit in the entering band marked dirty below. */
+        auto shift_cr = cairo_create(m_frame_cache_scratch);
+        cairo_set_operator(shift_cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(shift_cr, m_frame_cache, 0, 0);
+        cairo_paint(shift_cr);
+        cairo_rectangle(shift_cr, 0, m_padding.top, m_frame_cache_width, content_height);
+        cairo_clip(shift_cr);
+        cairo_set_source_surface(shift_cr, m_frame_cache, 0, (double)-dy);
+        cairo_paint(shift_cr);
+        cairo_destroy(shift_cr);
+        std::swap(m_frame_cache, m_frame_cache_scratch);
+
+        /* The rows that scrolled into view were never rendered */
+        auto band = cairo_rectangle_int_t{};
+        band.x = G_MININT / 2;
+        band.width = G_MAXINT;
+        band.y = (int)(dy > 0 ? origin + content_height - dy : origin);
+        band.height = (int)magnitude;
+        cairo_region_union_rectangle(m_frame_cache_dirty, &band);
+
+        m_frame_cache_origin = origin;
+}
+
+/* Render the dirty part of the viewport into the cached frame and stamp
+ * the state the pixels now describe. */
+void
+Terminal::frame_cache_render(int allocated_width,
+                             int allocated_height)
+{
+        auto const origin = (glong)round(m_screen->scroll_delta * m_cell_height);
+
+        /* The viewport, in the anchored coordinates of the dirty region */
+        auto const view = cairo_rectangle_int_t{-m_padding.left,
+                                                (int)(origin - m_padding.top),
+                                                allocated_width,
+                                                allocated_height};
+
+        auto to_render = cairo_region_copy(m_frame_cache_dirty);
+        cairo_region_intersect_rectangle(to_render, &view);
+
+        /* Damage outside the viewport isn't cached either way: whatever
+         * scrolls into view later is marked dirty again by the shift. */
+        cairo_region_destroy(m_frame_cache_dirty);
+        m_frame_cache_dirty = cairo_region_create();
+
+        m_frame_cache_origin = origin;
+        m_frame_cache_cell_height = m_cell_height;
+        m_frame_cache_screen = m_screen;
+        m_frame_cache_color_generation = m_color_generation;
+
+        if (cairo_region_is_empty(to_render)) {
+                cairo_region_destroy(to_render);
+                return;
+        }
+
+        auto cache_cr = cairo_create(m_frame_cache);
+
+        /* To widget coordinates; restrict all rendering to the damage */
+        cairo_region_translate(to_render, m_padding.left, (int)(m_padding.top - origin));
+        gdk_cairo_region(cache_cr, to_render);
+        cairo_clip(cache_cr);
+
+        _vte_draw_set_cairo(m_draw, cache_cr);
+
+        if (G_LIKELY(m_clear_background)) {
+                _vte_draw_clear (m_draw, 0, 0,
+                                 allocated_width, allocated_height,
+                                 get_color(VTE_DEFAULT_BG), m_background_alpha);
+        } else {
+                /* The window below shows through; just clear the damage */
+                cairo_set_operator(cache_cr, CAIRO_OPERATOR_CLEAR);
+                cairo_paint(cache_cr);
+                cairo_set_operator(cache_cr, CAIRO_OPERATOR_OVER);
+        }
+
+        /* Clip and translate exactly like the direct path below */
+        cairo_rectangle(cache_cr, 0, m_padding.top, allocated_width, allocated_height - m_padding.top - m_padding.bottom);
+        cairo_clip(cache_cr);
+        cairo_translate(cache_cr, m_padding.left, m_padding.top);
+
+        cairo_region_translate(to_render, -m_padding.left, -m_padding.top);
+
+        /* Paint sixel images under the text */
+        if (G_UNLIKELY (!m_images.empty()))
+                paint_images(cache_cr);
+
+        auto const first_row = first_displayed_row();
+        draw_rows(m_screen,
+                  to_render,
+                  first_row,
+                  last_displayed_row() + 1,
+                  row_to_pixel(first_row),
+                  m_cell_width,
+                  m_cell_height);
+
+        _vte_draw_set_cairo(m_draw, NULL);
+        cairo_destroy(cache_cr);
+        cairo_region_destroy(to_render);
+}
+
+/* Whether any visible row may contain cells with the blink attribute,
+ * from the per-row summary bits, so the common no-blink case never scans
+ * cells. A flagged writable row is verified cell by cell and healed when
+ * the blinking text has been overwritten, so a row that once blinked
+ * doesn't keep the timer (and its periodic repaints) alive forever;
+ * scrollback rows are immutable and their summary is exact. */
+bool
+Terminal::text_to_blink_in_viewport()
+{
+        auto const last = last_displayed_row();
+        for (auto row = first_displayed_row(); row <= last; row++) {
+                auto const* row_data = find_row_data(row);
+                if (row_data == nullptr || !row_data->attr.blink_maybe)
+                        continue;
+
+                if (row < _vte_ring_writable(m_screen->row_data))
+                        return true;
+
+                auto* writable_row = find_row_data_writable(row);
+                if (writable_row == nullptr)
+                        return true;
+
+                _vte_row_data_materialize(writable_row);
+                bool found = false;
+                for (guint16 col = 0; col < writable_row->len; col++) {
+                        if (writable_row->cells[col].attr.blink()) {
+                                found = true;
+                                break;
+                        }
+                }
+                if (found)
+                        return true;
+                writable_row->attr.blink_maybe = 0;
+        }
+
+        return false;
+}
+
+void
+Terminal::widget_draw(cairo_t *cr)
+{
+        cairo_rectangle_int_t clip_rect;
+        cairo_region_t *region;
+        int allocated_width, allocated_height;
+        int extra_area_for_cursor;
+        bool text_blink_enabled_now;
+        gint64 now = 0;
+
+        if (!gdk_cairo_get_clip_rectangle (cr, &clip_rect))
+                return;
+
+        m_last_viewed = g_get_monotonic_time();
+
+        _vte_debug_print(VTE_DEBUG_LIFECYCLE, "vte_terminal_draw()\n");
+        _vte_debug_print (VTE_DEBUG_WORK, "+");
+        vte::stats::add(vte::stats::counters.frames_painted);
+        _vte_debug_print (VTE_DEBUG_UPDATES, "Draw (%d,%d)x(%d,%d)\n",
+                          clip_rect.x, clip_rect.y,
+                          clip_rect.width, clip_rect.height);
+
+        region = vte_cairo_get_clip_region (cr);
+        if (region == NULL)
+                return;
+
+        allocated_width = get_allocated_width();
+        allocated_height = get_allocated_height();
+
+        /* Whether blinking text should be visible now */
+        m_text_blink_state = true;
+        text_blink_enabled_now = m_text_blink_mode & (m_has_focus ? VTE_TEXT_BLINK_FOCUSED : VTE_TEXT_BLINK_UNFOCUSED);
+        if (text_blink_enabled_now) {
+                now = g_get_monotonic_time() / 1000;
+                if (now % (m_text_blink_cycle * 2) >= m_text_blink_cycle)
+                        m_text_blink_state = false;
+        }
+        /* Painting will flip this if it encounters any cell with blink attribute */
+        m_text_to_blink = false;
+
+        /* Render the changed rows into the retained frame, to be blitted
+         * below; the cursor and the preedit are painted over the blit, so
+         * their movement never dirties the cached frame. */
+        bool const use_frame_cache = frame_cache_prepare(cr, allocated_width, allocated_height);
+        if (use_frame_cache)
+                frame_cache_render(allocated_width, allocated_height);
+
+	/* Designate the start of the drawing operation and clear the area. */
+	_vte_draw_set_cairo(m_draw, cr);
+
+        if (use_frame_cache) {
+                cairo_save(cr);
+                gdk_cairo_region(cr, region);
+                cairo_clip(cr);
+                cairo_set_source_surface(cr, m_frame_cache, 0, 0);
+                /* With a (possibly translucent) background the cache holds
+                 * the final pixels; without one, composite over the window. */
+                cairo_set_operator(cr, m_clear_background ? CAIRO_OPERATOR_SOURCE
+                                                          : CAIRO_OPERATOR_OVER);
+                cairo_paint(cr);
+                cairo_restore(cr);
+        } else {
+                if (G_LIKELY(m_clear_background)) {
+                        _vte_draw_clear (m_draw, 0, 0,
+                                         allocated_width, allocated_height,
+                                         get_color(VTE_DEFAULT_BG), m_background_alpha);
+                }
+
+                /* Clip vertically, for the sake of smooth scrolling. We want the top and bottom paddings to be unused.
+                 * Don't clip horizontally so that antialiasing can legally overflow to the right padding. */
+                cairo_save(cr);
+                cairo_rectangle(cr, 0, m_padding.top, allocated_width, allocated_height - m_padding.top - m_padding.bottom);
+                cairo_clip(cr);
+
+                cairo_translate(cr, m_padding.left, m_padding.top);
+
+                /* Transform to view coordinates */
+                cairo_region_translate(region, -m_padding.left, -m_padding.top);
+
+                /* Paint sixel images under the text */
+                if (G_UNLIKELY (!m_images.empty()))
+                        paint_images(cr);
+
+                /* and now paint them */
+                auto const first_row = first_displayed_row();
+                draw_rows(m_screen,
+                          region,
+                          first_row,
+                          last_displayed_row() + 1,
+                          row_to_pixel(first_row),
+                          m_cell_width,
+                          m_cell_height);
+
+                cairo_restore(cr);
+        }
+
+        /* The preedit string, over the blit (or the directly drawn text),
+         * clipped and translated the same way the text was. */
+        cairo_save(cr);
+        cairo_rectangle(cr, 0, m_padding.top, allocated_width, allocated_height - m_padding.top - m_padding.bottom);
+        cairo_clip(cr);
+        cairo_translate(cr, m_padding.left, m_padding.top);
+	paint_im_preedit_string();
+        cairo_restore(cr);
+
+        /* Re-clip, allowing VTE_LINE_WIDTH more pixel rows for the outline cursor. */
+        /* TODOegmont: It's really ugly to do it here. */
+        cairo_save(cr);
+        extra_area_for_cursor = (decscusr_cursor_shape() == VTE_CURSOR_SHAPE_BLOCK && !m_has_focus) ? VTE_LINE_WIDTH : 0;
+        cairo_rectangle(cr, 0, m_padding.top - extra_area_for_cursor, allocated_width, allocated_height - m_padding.top - m_padding.bottom + 2 * extra_area_for_cursor);
+        cairo_clip(cr);
 
         cairo_translate(cr, m_padding.left, m_padding.top);
 
@@ -9835,6 +12032,35 @@ Terminal::widget_draw(cairo_t *cr)
 
 	cairo_restore(cr);
 
+        /* Input-to-paint latency: account the oldest input applied to the
+         * screen model whose damage this frame (approximately: a partial
+         * expose may miss it, but those are rare under load) just rendered. */
+        if (G_UNLIKELY (m_input_latency_mark != 0)) {
+                m_input_latency_last = g_get_monotonic_time() - m_input_latency_mark;
+                m_input_latency_mark = 0;
+                vte::stats::add_latency(m_input_latency_last);
+        }
+
+        _VTE_DEBUG_IF (VTE_DEBUG_LATENCY) {
+                /* Overlay the last measured latency in the top right corner. */
+                cairo_text_extents_t extents;
+                char buf[32];
+
+                g_snprintf(buf, sizeof(buf), "%.1f ms", m_input_latency_last / 1000.);
+                cairo_save(cr);
+                cairo_select_font_face(cr, "monospace",
+                                       CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+                cairo_set_font_size(cr, 12.);
+                cairo_text_extents(cr, buf, &extents);
+                cairo_set_source_rgba(cr, 0., 0., 0., 0.6);
+                cairo_rectangle(cr, allocated_width - extents.width - 8, 0, extents.width + 8, 16);
+                cairo_fill(cr);
+                cairo_set_source_rgb(cr, 1., 1., 0.);
+                cairo_move_to(cr, allocated_width - extents.width - 4, 12);
+                cairo_show_text(cr, buf);
+                cairo_restore(cr);
+        }
+
 	/* Done with various structures. */
 	_vte_draw_set_cairo(m_draw, NULL);
 
@@ -9846,12 +12072,12 @@ Terminal::widget_draw(cairo_t *cr)
          * for an explicit step to stop the timer when blinking cells are no longer present, this happens
          * implicitly by the timer not getting reinstalled anymore (often after a final unnecessary but
          * harmless repaint). */
-        if (G_UNLIKELY (m_text_to_blink && text_blink_enabled_now && m_text_blink_tag == 0))
-                m_text_blink_tag = g_timeout_add_full(G_PRIORITY_LOW,
-                                                      m_text_blink_cycle - now % m_text_blink_cycle,
-                                                      (GSourceFunc)invalidate_text_blink_cb,
-                                                      this,
-                                                      NULL);
+        if (G_UNLIKELY (text_blink_enabled_now && m_text_blink_tag == 0 &&
+                        (m_text_to_blink || text_to_blink_in_viewport()))) {
+                m_text_blink_tag = 1;
+                blink_ticker_add(this, BLINK_TIMER_TEXT,
+                                 m_text_blink_cycle - now % m_text_blink_cycle);
+        }
 
         m_invalidated_all = FALSE;
 }
@@ -10128,6 +12354,8 @@ Terminal::set_rewrap_on_resize(bool rewrap)
                 return false;
 
         m_rewrap_on_resize = rewrap;
+        if (!rewrap)
+                stop_deferred_rewrap();
         return true;
 }
 
@@ -10368,10 +12596,11 @@ Terminal::reset(bool clear_tabstops,
         GObject *object = G_OBJECT(m_terminal);
         g_object_freeze_notify(object);
 
-        m_bell_pending = false;
+        m_pending_changes &= ~VTE_PENDING_BELL;
 
 	/* Clear the output buffer. */
-	_vte_byte_array_clear(m_outgoing);
+        m_outgoing_queue.clear();
+        m_outgoing_start = 0;
 	/* Reset charset substitution state. */
 
         m_utf8_decoder.reset();
@@ -10386,8 +12615,15 @@ Terminal::reset(bool clear_tabstops,
 
         /* Reset parser */
         m_parser.reset();
+        if (m_parser_thread)
+                m_parser_thread->reset();
         m_last_graphic_character = 0;
 
+        /* Drop any half-decoded image */
+        m_sixel_context.reset();
+        if (clear_history)
+                m_images.clear();
+
         /* Reset modes */
         m_modes_ecma.reset();
         m_modes_private.clear_saved();
@@ -10417,6 +12653,7 @@ Terminal::reset(bool clear_tabstops,
         m_character_replacement = &m_character_replacements[0];
 	/* Clear the scrollback buffers and reset the cursors. Switch to normal screen. */
 	if (clear_history) {
+                search_cache_clear();
                 m_screen = &m_normal_screen;
                 m_normal_screen.scroll_delta = m_normal_screen.insert_delta =
                         _vte_ring_reset(m_normal_screen.row_data);
@@ -10438,6 +12675,7 @@ Terminal::reset(bool clear_tabstops,
 	/* Reset restricted scrolling regions, leave insert mode, make
 	 * the cursor visible again. */
         m_scrolling_restricted = FALSE;
+        update_addressing_context();
         /* Reset the visual bits of selection on hard reset, see bug 789954. */
         if (clear_history) {
                 deselect_all();
@@ -10477,27 +12715,31 @@ Terminal::set_pty(VtePty *new_pty,
                 disconnect_pty_read();
                 disconnect_pty_write();
 
-                if (m_pty_channel != nullptr) {
-                        g_io_channel_unref (m_pty_channel);
-                        m_pty_channel = nullptr;
-                }
+                m_pty_fd = -1;
 
 		/* Take one last shot at processing whatever data is pending,
 		 * then flush the buffers in case we're about to run a new
 		 * command, disconnecting the timeout. */
-		if (!m_incoming_queue.empty() && process_remaining) {
+		if ((!m_incoming_queue.empty() ||
+                     (m_parser_thread && m_parser_thread->has_work())) &&
+                    process_remaining) {
 			process_incoming();
                         while (!m_incoming_queue.empty())
                                 m_incoming_queue.pop();
+                        if (m_parser_thread)
+                                m_parser_thread->reset();
 
 			m_input_bytes = 0;
 		}
+                m_input_backlog = 0;
+                m_input_paused = false;
 		stop_processing(this);
 
                 m_utf8_decoder.reset(); // FIXMEchpe necessary here?
 
 		/* Clear the outgoing buffer as well. */
-		_vte_byte_array_clear(m_outgoing);
+                m_outgoing_queue.clear();
+                m_outgoing_start = 0;
 
                 g_object_unref(m_pty);
                 m_pty = nullptr;
@@ -10515,8 +12757,7 @@ Terminal::set_pty(VtePty *new_pty,
         int flags = fcntl(pty_master, F_GETFL);
         g_warn_if_fail(flags >= 0 && (flags & O_NONBLOCK) == O_NONBLOCK);
 
-        m_pty_channel = g_io_channel_unix_new(pty_master);
-        g_io_channel_set_close_on_unref(m_pty_channel, FALSE);
+        m_pty_fd = pty_master;
 
         set_size(m_column_count, m_row_count);
 
@@ -10597,6 +12838,9 @@ remove_process_timeout_source(void)
 static void
 add_update_timeout(vte::terminal::Terminal* that)
 {
+	if (that->frame_clock_schedule())
+		return;
+
 	if (update_timeout_tag == 0) {
 		_vte_debug_print (VTE_DEBUG_TIMEOUT,
 				"Starting update timeout\n");
@@ -10614,6 +12858,7 @@ add_update_timeout(vte::terminal::Terminal* that)
 				"Adding terminal to active list\n");
 		that->m_active_terminals_link = g_active_terminals =
 			g_list_prepend(g_active_terminals, that);
+                that->emit_output_activity_changed(true);
 	}
 }
 
@@ -10634,12 +12879,15 @@ remove_from_active_list(vte::terminal::Terminal* that)
         _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing terminal from active list\n");
         g_active_terminals = g_list_delete_link(g_active_terminals, that->m_active_terminals_link);
         that->m_active_terminals_link = nullptr;
+        that->emit_output_activity_changed(false);
         return true;
 }
 
 static void
 stop_processing(vte::terminal::Terminal* that)
 {
+        that->frame_clock_unschedule();
+
         if (!remove_from_active_list(that))
                 return;
 
@@ -10671,6 +12919,7 @@ add_process_timeout(vte::terminal::Terminal* that)
 			"Adding terminal to active list\n");
 	that->m_active_terminals_link = g_active_terminals =
 		g_list_prepend(g_active_terminals, that);
+        that->emit_output_activity_changed(true);
 	if (update_timeout_tag == 0 &&
 			process_timeout_tag == 0) {
 		_vte_debug_print(VTE_DEBUG_TIMEOUT,
@@ -10684,19 +12933,178 @@ add_process_timeout(vte::terminal::Terminal* that)
 void
 Terminal::start_processing()
 {
-	if (!is_processing())
-		add_process_timeout(this);
+	if (is_processing())
+		return;
+
+        /* While unmapped, batch the work on the slow background timer
+         * instead of parsing at frame rate; see widget_unmap(). */
+        if (m_widget_unmapped) {
+                background_schedule();
+                return;
+        }
+
+	/* When realized, align processing with the compositor instead of
+	 * the global timeouts: each "update" phase parses (at most) one
+	 * frame's worth of data, whose damage is painted in that same
+	 * frame.
+	 */
+	if (frame_clock_schedule())
+		return;
+
+	add_process_timeout(this);
+}
+
+static gboolean
+background_timer_cb(gpointer data)
+{
+	auto that = reinterpret_cast<vte::terminal::Terminal*>(data);
+	return that->background_process();
+}
+
+void
+Terminal::background_schedule()
+{
+	if (m_background_timer != 0)
+		return;
+
+	_vte_debug_print(VTE_DEBUG_TIMEOUT, "Starting background timer\n");
+	m_background_timer = g_timeout_add_full(G_PRIORITY_LOW,
+						VTE_BACKGROUND_TIMEOUT,
+						background_timer_cb, this, nullptr);
+}
+
+/* One batch of the background throttle; see widget_unmap(). */
+bool
+Terminal::background_process()
+{
+	auto const active = process(true);
+
+	/* Push the damage through now; the window is hidden, so this
+	 * only keeps the rect list from growing. */
+	invalidate_dirty_rects_and_process_updates();
+
+	if (!active) {
+		_vte_debug_print(VTE_DEBUG_TIMEOUT, "Background timer going idle\n");
+		m_background_timer = 0;
+		return false;
+	}
+	return true;
+}
+
+static void
+frame_clock_update_cb(GdkFrameClock* clock,
+                      gpointer data)
+{
+	auto that = reinterpret_cast<vte::terminal::Terminal*>(data);
+	that->frame_clock_update();
+}
+
+void
+Terminal::connect_frame_clock()
+{
+	m_frame_clock = gtk_widget_get_frame_clock(m_widget);
+	if (m_frame_clock == nullptr)
+		return;
+
+	m_frame_clock_update_id = g_signal_connect(m_frame_clock, "update",
+						   G_CALLBACK(frame_clock_update_cb),
+						   this);
+}
+
+void
+Terminal::disconnect_frame_clock()
+{
+	if (m_frame_clock == nullptr)
+		return;
+
+	frame_clock_unschedule();
+	g_signal_handler_disconnect(m_frame_clock, m_frame_clock_update_id);
+	m_frame_clock_update_id = 0;
+	m_frame_clock = nullptr;
+
+	/* Any work still queued falls back to the timeout machinery. */
+	if (!m_incoming_queue.empty() ||
+	    (m_parser_thread && m_parser_thread->has_work()))
+		start_processing();
+}
+
+/* Returns %true if processing is (now) driven by the frame clock, in
+ * which case no timeout must be scheduled.
+ */
+bool
+Terminal::frame_clock_schedule()
+{
+	if (m_frame_clock == nullptr)
+		return false;
+
+	if (!m_frame_clock_updating) {
+		_vte_debug_print(VTE_DEBUG_TIMEOUT,
+				"Beginning frame clock updates\n");
+		m_frame_clock_updating = true;
+		gdk_frame_clock_begin_updating(m_frame_clock);
+	}
+
+	return true;
+}
+
+void
+Terminal::frame_clock_unschedule()
+{
+	if (!m_frame_clock_updating)
+		return;
+
+	_vte_debug_print(VTE_DEBUG_TIMEOUT,
+			"Ending frame clock updates\n");
+	m_frame_clock_updating = false;
+	gdk_frame_clock_end_updating(m_frame_clock);
+}
+
+/* The "update" phase of the frame clock: runs once per output frame,
+ * right before the layout and paint phases, for as long as we called
+ * gdk_frame_clock_begin_updating().
+ */
+void
+Terminal::frame_clock_update()
+{
+	if (!m_frame_clock_updating)
+		return;
+
+	_vte_debug_print(VTE_DEBUG_WORK, "^");
+
+	auto const active = process(true);
+	invalidate_dirty_rects_and_process_updates();
+
+	if (!active)
+		frame_clock_unschedule();
 }
 
 void
 Terminal::emit_pending_signals()
 {
+        /* Nothing queued since the last flush?  Skip the freeze/thaw
+         * round-trip entirely; this is the common case when the child
+         * produces plain output without moving the cursor or touching
+         * any properties. */
+        if (m_pending_changes == 0 &&
+            !m_adjustment_changed_pending &&
+            !m_adjustment_value_changed_pending)
+                return;
+
 	GObject *object = G_OBJECT(m_terminal);
         g_object_freeze_notify(object);
 
-	emit_adjustment_changed();
+        /* Adjustment changes are batched to one emission per frame tick
+         * with final-value semantics: during a flood, every processing
+         * pass grows the upper bound, and pushing each step into the
+         * GtkAdjustment makes the embedder relayout its scrollbar far
+         * more often than the display updates.  When a tick is going to
+         * flush them (see process()), leave them pending. */
+        if (!m_frame_clock_updating &&
+            !in_update_timeout &&
+            !(in_process_timeout && update_timeout_tag != 0))
+                emit_adjustment_changed();
 
-	if (m_window_title_changed) {
+	if (m_pending_changes & VTE_PENDING_WINDOW_TITLE) {
                 if (m_window_title != m_window_title_pending) {
                         m_window_title.swap(m_window_title_pending);
 
@@ -10707,10 +13115,9 @@ Terminal::emit_pending_signals()
                 }
 
                 m_window_title_pending.clear();
-                m_window_title_changed = false;
 	}
 
-	if (m_current_directory_uri_changed) {
+	if (m_pending_changes & VTE_PENDING_CURRENT_DIRECTORY_URI) {
                 if (m_current_directory_uri != m_current_directory_uri_pending) {
                         m_current_directory_uri.swap(m_current_directory_uri_pending);
 
@@ -10721,10 +13128,9 @@ Terminal::emit_pending_signals()
                 }
 
                 m_current_directory_uri_pending.clear();
-                m_current_directory_uri_changed = false;
         }
 
-        if (m_current_file_uri_changed) {
+        if (m_pending_changes & VTE_PENDING_CURRENT_FILE_URI) {
                 if (m_current_file_uri != m_current_file_uri_pending) {
                         m_current_file_uri.swap(m_current_file_uri_pending);
 
@@ -10735,49 +13141,58 @@ Terminal::emit_pending_signals()
                 }
 
                 m_current_file_uri_pending.clear();
-                m_current_file_uri_changed = false;
         }
 
 	/* Flush any pending "inserted" signals. */
 
-        if (m_cursor_moved_pending) {
+        if (m_pending_changes & VTE_PENDING_CURSOR_MOVED) {
                 _vte_debug_print(VTE_DEBUG_SIGNALS,
                                  "Emitting `cursor-moved'.\n");
                 g_signal_emit(object, signals[SIGNAL_CURSOR_MOVED], 0);
-                m_cursor_moved_pending = false;
         }
-        if (m_text_modified_flag) {
+        if (m_pending_changes & VTE_PENDING_TEXT_MODIFIED) {
                 _vte_debug_print(VTE_DEBUG_SIGNALS,
                                  "Emitting buffered `text-modified'.\n");
                 emit_text_modified();
-                m_text_modified_flag = false;
         }
-        if (m_text_inserted_flag) {
+        if (m_pending_changes & VTE_PENDING_TEXT_INSERTED) {
                 _vte_debug_print(VTE_DEBUG_SIGNALS,
                                  "Emitting buffered `text-inserted'\n");
                 emit_text_inserted();
-                m_text_inserted_flag = false;
         }
-        if (m_text_deleted_flag) {
+        if (m_pending_changes & VTE_PENDING_TEXT_DELETED) {
                 _vte_debug_print(VTE_DEBUG_SIGNALS,
                                  "Emitting buffered `text-deleted'\n");
                 emit_text_deleted();
-                m_text_deleted_flag = false;
 	}
-	if (m_contents_changed_pending) {
+	if (m_pending_changes & VTE_PENDING_CONTENTS_CHANGED) {
                 /* Update hyperlink and dingus match set. */
 		match_contents_clear();
 		if (m_mouse_cursor_over_widget) {
-                        hyperlink_hilite_update();
-                        match_hilite_update();
+                        queue_hover_update();
 		}
 
 		_vte_debug_print(VTE_DEBUG_SIGNALS,
 				"Emitting `contents-changed'.\n");
 		g_signal_emit(m_terminal, signals[SIGNAL_CONTENTS_CHANGED], 0);
-		m_contents_changed_pending = false;
+
+                /* Report the damaged row range. Paths that went through
+                 * invalidate_rows_and_context() recorded a tight range; for
+                 * anything else (reset, alternate screen, rewrap, scrolling)
+                 * fall back to the whole ring, which is what listeners had
+                 * to assume on every contents-changed anyway. */
+                auto damage_start = m_contents_damage_start;
+                auto damage_end = m_contents_damage_end;
+                if (damage_start == -1) {
+                        damage_start = _vte_ring_delta(m_screen->row_data);
+                        damage_end = _vte_ring_next(m_screen->row_data) - 1;
+                }
+                m_contents_damage_start = m_contents_damage_end = -1;
+                g_signal_emit(m_terminal, signals[SIGNAL_CONTENTS_MODIFIED], 0,
+                              (glong)damage_start, (glong)damage_end,
+                              (guint64)++m_contents_generation);
 	}
-        if (m_bell_pending) {
+        if (m_pending_changes & VTE_PENDING_BELL) {
                 auto const timestamp = g_get_monotonic_time();
                 if ((timestamp - m_bell_timestamp) >= VTE_BELL_MINIMUM_TIME_DIFFERENCE) {
                         beep();
@@ -10785,38 +13200,104 @@ Terminal::emit_pending_signals()
 
                         m_bell_timestamp = timestamp;
                  }
-
-                m_bell_pending = false;
         }
 
+        m_pending_changes = 0;
+
         g_object_thaw_notify(object);
 }
 
+/* The time budget for one processing pass, in ms. When driven by the
+ * frame clock this is half of the output device's refresh interval
+ * (leaving the other half for layout and paint), so that a parsing pass
+ * never pushes the frame it damages past the vsync deadline; with the
+ * timeout fallback it is the historical VTE_MAX_PROCESS_TIME.
+ */
+double
+Terminal::max_process_time() const
+{
+	if (m_frame_clock != nullptr) {
+		gint64 refresh_interval;
+		gdk_frame_clock_get_refresh_info(m_frame_clock, 0,
+						 &refresh_interval, nullptr);
+		if (refresh_interval > 0)
+			return refresh_interval / 2000.; /* µs → ms, halved */
+	}
+
+	return VTE_MAX_PROCESS_TIME;
+}
+
 void
 Terminal::time_process_incoming()
 {
 	g_timer_reset(process_timer);
 	process_incoming();
 	auto elapsed = g_timer_elapsed(process_timer, NULL) * 1000;
-	gssize target = VTE_MAX_PROCESS_TIME / elapsed * m_input_bytes;
+        vte::stats::add_process_time((uint64_t)(elapsed * 1000.));
+	gssize target = max_process_time() / elapsed * m_input_bytes;
+        /* The raw estimate jumps around wildly when a cycle happens to
+         * process very little or very much; keep it within sane bounds so
+         * the averaged value below doesn't oscillate. */
+        target = CLAMP (target,
+                        (gssize)VTE_MAX_INPUT_READ,
+                        (gssize)(VTE_INPUT_BACKLOG_HIGH_WATER / 2));
 	m_max_input_bytes = (m_max_input_bytes + target) / 2;
 }
 
+/* The backlog size at which to stop draining the pty, overridable with
+ * the VTE_INPUT_BACKLOG environment variable (in bytes). */
+static size_t
+input_backlog_high_water(void)
+{
+        static size_t high_water = 0;
+
+        if (G_UNLIKELY (high_water == 0)) {
+                auto const env = g_getenv("VTE_INPUT_BACKLOG");
+                if (env != nullptr)
+                        high_water = g_ascii_strtoull(env, nullptr, 10);
+                if (high_water == 0)
+                        high_water = VTE_INPUT_BACKLOG_HIGH_WATER;
+        }
+
+        return high_water;
+}
+
 bool
 Terminal::process(bool emit_adj_changed)
 {
-        if (m_pty_channel) {
-                if (m_pty_input_active ||
-                    m_pty_input_source == 0) {
-                        m_pty_input_active = false;
-                        pty_io_read(m_pty_channel, G_IO_IN);
+        if (m_pty_fd != -1) {
+                /* Flow control: when more data has been read than can be
+                 * applied to the screen model in a few cycles, stop draining
+                 * the pty altogether, letting the kernel's pty buffer fill up
+                 * and block the flooding child. Resume only when the backlog
+                 * has fallen well below the pause threshold; the hysteresis
+                 * keeps the read watch from being torn down and recreated on
+                 * every cycle, which made the input latency oscillate. */
+                if (m_input_paused) {
+                        if (m_input_backlog <= input_backlog_high_water() / 4) {
+                                _vte_debug_print (VTE_DEBUG_IO,
+                                                  "Backlog down to %" G_GSIZE_FORMAT " bytes, resuming reads\n",
+                                                  m_input_backlog);
+                                m_input_paused = false;
+                                connect_pty_read();
+                        }
+                } else if (m_input_backlog >= input_backlog_high_water()) {
+                        _vte_debug_print (VTE_DEBUG_IO,
+                                          "Backlog at %" G_GSIZE_FORMAT " bytes, pausing reads\n",
+                                          m_input_backlog);
+                        m_input_paused = true;
+                        disconnect_pty_read();
+                } else {
+                        if (m_pty_input_active ||
+                            m_pty_input_source == 0) {
+                                m_pty_input_active = false;
+                                pty_io_read(G_IO_IN);
+                        }
+                        connect_pty_read();
                 }
-                connect_pty_read();
         }
-        if (emit_adj_changed)
-                emit_adjustment_changed();
-
-        bool is_active = !m_incoming_queue.empty();
+        bool is_active = !m_incoming_queue.empty() ||
+                         (m_parser_thread && m_parser_thread->has_work());
         if (is_active) {
                 if (VTE_MAX_PROCESS_TIME) {
                         time_process_incoming();
@@ -10827,6 +13308,11 @@ Terminal::process(bool emit_adj_changed)
         } else
                 emit_pending_signals();
 
+        /* Emit after the pass, so the embedder sees only the final
+         * adjustment value for this tick. */
+        if (emit_adj_changed)
+                emit_adjustment_changed();
+
         return is_active;
 }
 
@@ -11058,17 +13544,213 @@ Terminal::write_contents_sync (GOutputStream *stream,
                                          GCancellable *cancellable,
                                          GError **error)
 {
+        stop_write_contents_task();
+
 	return _vte_ring_write_contents (m_screen->row_data,
 					 stream, flags,
 					 cancellable, error);
 }
 
+bool
+Terminal::write_snapshot_sync(GOutputStream* stream,
+                              GCancellable* cancellable,
+                              GError** error)
+{
+        /* Always the normal screen: the alternate screen has no scrollback
+         * and its contents belong to the (gone) fullscreen application. */
+        return _vte_ring_snapshot_write(m_normal_screen.row_data,
+                                        stream, cancellable, error);
+}
+
+bool
+Terminal::read_snapshot_sync(GInputStream* stream,
+                             GCancellable* cancellable,
+                             GError** error)
+{
+        auto ring = m_normal_screen.row_data;
+        auto const ok = _vte_ring_snapshot_restore(ring, stream, cancellable, error);
+
+        /* The ring's contents were replaced wholesale. */
+        search_cache_clear();
+
+        if (!ok) {
+                /* The ring may be partially overwritten; drop it. */
+                _vte_ring_reset(ring);
+        }
+
+        /* The restored rows all become scrollback; the screen below them
+         * starts out blank with the cursor at its home position, where the
+         * child to be spawned will draw its first prompt. */
+        m_normal_screen.insert_delta = _vte_ring_next(ring);
+        m_normal_screen.scroll_delta = m_normal_screen.insert_delta;
+        m_normal_screen.cursor.row = m_normal_screen.insert_delta;
+        m_normal_screen.cursor.col = 0;
+
+        if (m_screen == &m_normal_screen) {
+                m_ringview.invalidate();
+                match_contents_clear();
+                adjust_adjustments_full();
+                invalidate_all();
+        }
+
+        return ok;
+}
+
+static gboolean
+vte_terminal_write_contents_async_cb(vte::terminal::Terminal* that)
+{
+        return that->write_contents_tick();
+}
+
+/*
+ * Terminal::write_contents_async:
+ *
+ * Asynchronous counterpart of write_contents_sync(): pushes the ring's
+ * contents to @stream a bounded number of bytes per main loop iteration so
+ * that dumping a large scrollback doesn't stall the UI. Only one async
+ * write can be in flight at a time; starting another one cancels it.
+ */
+void
+Terminal::write_contents_async(GOutputStream* stream,
+                               VteWriteFlags flags,
+                               GCancellable* cancellable,
+                               GAsyncReadyCallback callback,
+                               void* user_data)
+{
+        stop_write_contents_task();
+
+        auto task = g_task_new(m_terminal, cancellable, callback, user_data);
+
+        m_write_contents_ring = m_screen->row_data;
+        if (!_vte_ring_write_contents_begin(m_write_contents_ring,
+                                            &m_write_contents_state,
+                                            flags)) {
+                g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                        "Failed to read scrollback contents");
+                g_object_unref(task);
+                m_write_contents_ring = nullptr;
+                return;
+        }
+
+        m_write_contents_task = task;
+        m_write_contents_stream = (GOutputStream*)g_object_ref(stream);
+
+        m_write_contents_task_tag = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                                    (GSourceFunc)vte_terminal_write_contents_async_cb,
+                                                    this,
+                                                    NULL);
+}
+
+/*
+ * Write a batch of the pending async contents dump. Returns true to keep
+ * the idle source, false once the write has terminated one way or another.
+ */
+bool
+Terminal::write_contents_tick()
+{
+        GCancellable *cancellable = g_task_get_cancellable(m_write_contents_task);
+        GError *error = nullptr;
+
+        if (cancellable != nullptr && g_cancellable_is_cancelled(cancellable)) {
+                m_write_contents_task_tag = 0;
+                finish_write_contents_task(nullptr, true);
+                return false;
+        }
+
+        auto const status = m_write_contents_ring->write_contents_step(&m_write_contents_state,
+                                                                       m_write_contents_stream,
+                                                                       VTE_WRITE_CONTENTS_ASYNC_BATCH_BYTES,
+                                                                       cancellable,
+                                                                       &error);
+        if (status == 0)
+                return true;
+
+        m_write_contents_task_tag = 0;
+        finish_write_contents_task(error, false);
+        return false;
+}
+
+/*
+ * Complete the pending async contents write, reporting success, @error, or,
+ * if @cancelled, %G_IO_ERROR_CANCELLED. The GTask invokes the caller's
+ * callback from the main loop, not from here.
+ */
+void
+Terminal::finish_write_contents_task(GError* error,
+                                     bool cancelled)
+{
+        auto task = m_write_contents_task;
+
+        m_write_contents_task = nullptr;
+        _vte_ring_write_contents_end(m_write_contents_ring, &m_write_contents_state);
+        m_write_contents_ring = nullptr;
+        g_object_unref(m_write_contents_stream);
+        m_write_contents_stream = nullptr;
+
+        if (cancelled)
+                g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                        "Operation was cancelled");
+        else if (error != nullptr)
+                g_task_return_error(task, error);
+        else
+                g_task_return_boolean(task, true);
+        g_object_unref(task);
+}
+
+void
+Terminal::stop_write_contents_task()
+{
+        if (m_write_contents_task == nullptr)
+                return;
+
+        if (m_write_contents_task_tag != 0) {
+                g_source_remove(m_write_contents_task_tag);
+                m_write_contents_task_tag = 0;
+        }
+        finish_write_contents_task(nullptr, true);
+}
+
 /*
  * Buffer search
  */
 
 /* TODO Add properties & signals */
 
+/* Whether every string matched by @new_regex is also matched by
+ * @old_regex, judged conservatively: both patterns must be plain
+ * literals (no regex metacharacters) compiled with the same flags, and
+ * the old pattern must occur verbatim in the new one.  This is the
+ * common case for search-as-you-type, where each keystroke appends to
+ * the previous pattern. */
+static bool
+search_regex_refines(VteRegex const* old_regex,
+                     VteRegex const* new_regex)
+{
+        auto const* old_pattern = _vte_regex_get_pattern(old_regex);
+        auto const* new_pattern = _vte_regex_get_pattern(new_regex);
+        if (old_pattern == nullptr || new_pattern == nullptr)
+                return false;
+
+        auto const compile_flags = _vte_regex_get_compile_flags(old_regex);
+        if (compile_flags != _vte_regex_get_compile_flags(new_regex))
+                return false;
+
+        if (strpbrk(old_pattern, "\\^$.[]|()?*+{") != nullptr ||
+            strpbrk(new_pattern, "\\^$.[]|()?*+{") != nullptr)
+                return false;
+
+        if (compile_flags & PCRE2_CASELESS) {
+                auto old_down = g_utf8_strdown(old_pattern, -1);
+                auto new_down = g_utf8_strdown(new_pattern, -1);
+                auto const found = strstr(new_down, old_down) != nullptr;
+                g_free(old_down);
+                g_free(new_down);
+                return found;
+        }
+
+        return strstr(new_pattern, old_pattern) != nullptr;
+}
+
 /*
  * Terminal::search_set_regex:
  * @regex: (allow-none): a #VteRegex, or %nullptr
@@ -11088,11 +13770,31 @@ Terminal::search_set_regex (VteRegex *regex,
             rx->match_flags == flags)
                 return false;
 
+        /* A pending async search still matches against the old regex;
+         * cancel it rather than let it look it up mid-flight. */
+        stop_search_task();
+
+        /* If the new pattern provably narrows the old one, rows that
+         * didn't match before still can't match, so the no-match cache
+         * stays valid and search-as-you-type only re-examines the rows
+         * that matched so far. */
+        bool const keep_cache = regex != nullptr &&
+                                rx->regex != nullptr &&
+                                rx->match_flags == flags &&
+                                search_regex_refines(rx->regex, regex);
+
         regex_and_flags_clear(rx);
+        if (!keep_cache)
+                search_cache_clear();
 
         if (regex != nullptr) {
                 rx->regex = vte_regex_ref(regex);
                 rx->match_flags = flags;
+                /* JIT by default; interpreted matching over a large
+                 * scrollback is where search spends its time. */
+                vte_regex_jit(rx->regex,
+                              PCRE2_JIT_COMPLETE | PCRE2_JIT_PARTIAL_SOFT,
+                              nullptr);
         }
 
 	invalidate_all();
@@ -11204,6 +13906,96 @@ Terminal::search_rows(pcre2_match_context_8 *match_context,
 	return true;
 }
 
+/*
+ * Build a coarse bitmap (bit = 1 << (byte & 63)) of the code units a match
+ * for the search regex can possibly start with, mirroring the per-row
+ * bitmaps that the ring collects when freezing rows. Frozen rows whose
+ * bitmap doesn't intersect this can't contain a match start, so search can
+ * skip them without thawing and regex-scanning them. Returns all ones when
+ * PCRE2 can't predict the first code unit.
+ */
+guint64
+Terminal::search_pattern_byteset()
+{
+        const pcre2_code_8 *code = _vte_regex_get_pcre(m_search_regex.regex);
+        guint32 firstcodetype = 0;
+
+        pcre2_pattern_info_8(code, PCRE2_INFO_FIRSTCODETYPE, &firstcodetype);
+        if (firstcodetype == 1) {
+                /* The first code unit is known exactly. */
+                guint32 first = 0;
+                guint64 byteset;
+
+                pcre2_pattern_info_8(code, PCRE2_INFO_FIRSTCODEUNIT, &first);
+                byteset = G_GUINT64_CONSTANT(1) << (first & 63);
+                /* Play it safe with caseless matching. */
+                if (g_ascii_isalpha(first))
+                        byteset |= G_GUINT64_CONSTANT(1) << ((first ^ 0x20) & 63);
+                return byteset;
+        }
+
+        if (firstcodetype == 0) {
+                /* Maybe a bitmap of possible first code units. */
+                const guint8 *bitmap = nullptr;
+
+                pcre2_pattern_info_8(code, PCRE2_INFO_FIRSTBITMAP, &bitmap);
+                if (bitmap != nullptr) {
+                        guint64 byteset = 0;
+                        unsigned int b;
+
+                        for (b = 0; b < 256; b++)
+                                if (bitmap[b / 8] & (1 << (b % 8)))
+                                        byteset |= G_GUINT64_CONSTANT(1) << (b & 63);
+                        return byteset;
+                }
+        }
+
+        /* Anchored pattern or no usable information. */
+        return ~G_GUINT64_CONSTANT(0);
+}
+
+/*
+ * A cache of search results, owned by the search state: the start rows of
+ * paragraphs that are known not to match m_search_regex.  Frozen rows are
+ * immutable and paragraphs are identified by absolute row numbers, so the
+ * verdict stays valid until the rows are renumbered (rewrap, reset, screen
+ * switch) or the regex changes; repeatedly searching across a mostly
+ * unchanged scrollback then skips the text extraction and matching for
+ * all previously visited paragraphs.  Matching paragraphs are not cached:
+ * they terminate the search anyway, and their spans' staleness would be
+ * harder to reason about.
+ */
+bool
+Terminal::search_cache_lookup_nomatch(vte::grid::row_t row)
+{
+        return m_search_result_cache != nullptr &&
+               g_hash_table_contains(m_search_result_cache, GSIZE_TO_POINTER(row));
+}
+
+void
+Terminal::search_cache_store_nomatch(vte::grid::row_t start_row,
+                                     vte::grid::row_t end_row)
+{
+        /* Rows at or above the ring's writable boundary can still change. */
+        if (end_row > (vte::grid::row_t)_vte_ring_writable(m_screen->row_data))
+                return;
+
+        if (m_search_result_cache == nullptr)
+                m_search_result_cache = g_hash_table_new(nullptr, nullptr);
+        /* Entries for rows scrolled off the tail are never looked up again;
+         * rather than prune them, cap the total and start over. */
+        if (G_UNLIKELY (g_hash_table_size(m_search_result_cache) >= VTE_SEARCH_CACHE_MAX_ROWS))
+                g_hash_table_remove_all(m_search_result_cache);
+        g_hash_table_add(m_search_result_cache, GSIZE_TO_POINTER(start_row));
+}
+
+void
+Terminal::search_cache_clear()
+{
+        if (m_search_result_cache != nullptr)
+                g_hash_table_remove_all(m_search_result_cache);
+}
+
 bool
 Terminal::search_rows_iter(pcre2_match_context_8 *match_context,
                                      pcre2_match_data_8 *match_data,
@@ -11211,22 +14003,29 @@ Terminal::search_rows_iter(pcre2_match_context_8 *match_context,
                                      vte::grid::row_t end_row,
                                      bool backward)
 {
-	const VteRowData *row;
 	long iter_start_row, iter_end_row;
+        bool wrapped;
+        guint64 byteset = search_pattern_byteset();
+        VteRing *ring = m_screen->row_data;
 
 	if (backward) {
 		iter_start_row = end_row;
 		while (iter_start_row > start_row) {
 			iter_end_row = iter_start_row;
 
+                        /* is_soft_wrapped() only looks at the row records,
+                         * so walking the paragraphs doesn't thaw any row. */
 			do {
 				iter_start_row--;
-				row = find_row_data(iter_start_row);
-			} while (row && row->attr.soft_wrapped);
+			} while (ring->is_soft_wrapped(iter_start_row));
 
-			if (search_rows(match_context, match_data,
+			if (search_cache_lookup_nomatch(iter_start_row))
+				continue;
+			if (_vte_ring_rows_maybe_match(ring, iter_start_row, iter_end_row, byteset) &&
+			    search_rows(match_context, match_data,
                                         iter_start_row, iter_end_row, backward))
 				return true;
+			search_cache_store_nomatch(iter_start_row, iter_end_row);
 		}
 	} else {
 		iter_end_row = start_row;
@@ -11234,13 +14033,17 @@ Terminal::search_rows_iter(pcre2_match_context_8 *match_context,
 			iter_start_row = iter_end_row;
 
 			do {
-				row = find_row_data(iter_end_row);
+				wrapped = ring->is_soft_wrapped(iter_end_row);
 				iter_end_row++;
-			} while (row && row->attr.soft_wrapped);
+			} while (wrapped);
 
-			if (search_rows(match_context, match_data,
+			if (search_cache_lookup_nomatch(iter_start_row))
+				continue;
+			if (_vte_ring_rows_maybe_match(ring, iter_start_row, iter_end_row, byteset) &&
+			    search_rows(match_context, match_data,
                                         iter_start_row, iter_end_row, backward))
 				return true;
+			search_cache_store_nomatch(iter_start_row, iter_end_row);
 		}
 	}
 
@@ -11254,6 +14057,9 @@ Terminal::search_find (bool backward)
         vte::grid::row_t last_start_row, last_end_row;
         bool match_found = true;
 
+        /* A synchronous search supersedes a pending asynchronous one. */
+        stop_search_task();
+
         if (m_search_regex.regex == nullptr)
                 return false;
 
@@ -11262,8 +14068,8 @@ Terminal::search_find (bool backward)
 	 * Moreover, the whole search thing is implemented very inefficiently.
 	 */
 
-        auto match_context = create_match_context();
-        auto match_data = pcre2_match_data_create_8(256 /* should be plenty */, nullptr /* general context */);
+        auto match_context = ensure_match_context();
+        auto match_data = m_match_data;
 
 	buffer_start_row = _vte_ring_delta (m_screen->row_data);
 	buffer_end_row = _vte_ring_next (m_screen->row_data);
@@ -11314,12 +14120,215 @@ Terminal::search_find (bool backward)
 
  found:
 
-        pcre2_match_data_free_8(match_data);
-        pcre2_match_context_free_8(match_context);
-
 	return match_found;
 }
 
+static gboolean
+vte_terminal_search_async_cb(vte::terminal::Terminal* that)
+{
+        return that->search_async_tick();
+}
+
+/*
+ * Terminal::search_find_async:
+ *
+ * Asynchronous counterpart of search_find(): scans the same two ranges in
+ * the same order, but only a bounded number of rows per main loop iteration
+ * so that searching a large scrollback doesn't stall the UI. Only one async
+ * search can be in flight at a time; starting another one (or a synchronous
+ * search) cancels it.
+ */
+void
+Terminal::search_find_async(bool backward,
+                            GCancellable* cancellable,
+                            GAsyncReadyCallback callback,
+                            void* user_data)
+{
+        vte::grid::row_t buffer_start_row, buffer_end_row;
+        vte::grid::row_t last_start_row, last_end_row;
+
+        stop_search_task();
+
+        auto task = g_task_new(m_terminal, cancellable, callback, user_data);
+
+        if (m_search_regex.regex == nullptr) {
+                g_task_return_boolean(task, FALSE);
+                g_object_unref(task);
+                return;
+        }
+
+	buffer_start_row = _vte_ring_delta (m_screen->row_data);
+	buffer_end_row = _vte_ring_next (m_screen->row_data);
+
+        if (!m_selection_resolved.empty()) {
+                last_start_row = m_selection_resolved.start_row();
+                last_end_row = m_selection_resolved.end_row() + 1;
+	} else {
+		last_start_row = m_screen->scroll_delta + m_row_count;
+		last_end_row = m_screen->scroll_delta;
+	}
+	last_start_row = MAX (buffer_start_row, last_start_row);
+	last_end_row = MIN (buffer_end_row, last_end_row);
+
+        m_search_task = task;
+        m_search_task_backward = backward;
+        m_search_task_wrapped = false;
+        m_search_task_byteset = search_pattern_byteset();
+        m_search_task_match_context = create_match_context();
+        m_search_task_match_data = pcre2_match_data_create_8(256 /* should be plenty */, nullptr /* general context */);
+        ensure_match_context();
+        if (m_jit_stack != nullptr)
+                pcre2_jit_stack_assign_8(m_search_task_match_context, nullptr, m_jit_stack);
+
+        if (backward) {
+                m_search_task_row = last_start_row;
+                m_search_task_limit = buffer_start_row;
+                m_search_task_wrap_row = buffer_end_row;
+                m_search_task_wrap_limit = last_end_row;
+        } else {
+                m_search_task_row = last_end_row;
+                m_search_task_limit = buffer_end_row;
+                m_search_task_wrap_row = buffer_start_row;
+                m_search_task_wrap_limit = last_start_row;
+        }
+
+        m_search_task_tag = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                            (GSourceFunc)vte_terminal_search_async_cb,
+                                            this,
+                                            NULL);
+}
+
+/*
+ * Process a batch of rows of the pending async search. Returns true to keep
+ * the idle source, false once the search has terminated one way or another.
+ */
+bool
+Terminal::search_async_tick()
+{
+        vte::grid::row_t buffer_start_row, buffer_end_row;
+        vte::grid::row_t iter_start_row, iter_end_row;
+        bool wrapped;
+        long budget = VTE_SEARCH_ASYNC_BATCH_ROWS;
+        VteRing *ring = m_screen->row_data;
+        GCancellable *cancellable = g_task_get_cancellable(m_search_task);
+
+        if (cancellable != nullptr && g_cancellable_is_cancelled(cancellable)) {
+                m_search_task_tag = 0;
+                finish_search_task(false, true);
+                return false;
+        }
+
+        while (budget > 0) {
+                /* The ring may have scrolled or shrunk since the last
+                 * iteration; stay within it. */
+                buffer_start_row = _vte_ring_delta (ring);
+                buffer_end_row = _vte_ring_next (ring);
+                m_search_task_row = CLAMP (m_search_task_row, buffer_start_row, buffer_end_row);
+                m_search_task_limit = CLAMP (m_search_task_limit, buffer_start_row, buffer_end_row);
+
+                if (m_search_task_backward ? m_search_task_row <= m_search_task_limit
+                                           : m_search_task_row >= m_search_task_limit) {
+                        if (!m_search_task_wrapped && m_search_wrap_around) {
+                                m_search_task_wrapped = true;
+                                m_search_task_row = m_search_task_wrap_row;
+                                m_search_task_limit = m_search_task_wrap_limit;
+                                continue;
+                        }
+
+                        /* No match; mirror search_find()'s empty selection at
+                         * the last searched position. */
+                        if (!m_selection_resolved.empty()) {
+                                if (m_search_wrap_around) {
+                                        if (m_search_task_backward)
+                                                select_empty(m_selection_resolved.start_column(), m_selection_resolved.start_row());
+                                        else
+                                                select_empty(m_selection_resolved.end_column(), m_selection_resolved.end_row());
+                                } else {
+                                        if (m_search_task_backward)
+                                                select_empty(-1, buffer_start_row - 1);
+                                        else
+                                                select_empty(0, buffer_end_row);
+                                }
+                        }
+                        m_search_task_tag = 0;
+                        finish_search_task(false, false);
+                        return false;
+                }
+
+                /* Advance over one paragraph, just like search_rows_iter(). */
+                if (m_search_task_backward) {
+                        iter_end_row = m_search_task_row;
+                        do {
+                                m_search_task_row--;
+                        } while (ring->is_soft_wrapped(m_search_task_row));
+                        iter_start_row = m_search_task_row;
+                } else {
+                        iter_start_row = m_search_task_row;
+                        do {
+                                wrapped = ring->is_soft_wrapped(m_search_task_row);
+                                m_search_task_row++;
+                        } while (wrapped);
+                        iter_end_row = m_search_task_row;
+                }
+                budget -= iter_end_row - iter_start_row;
+
+                if (search_cache_lookup_nomatch(iter_start_row))
+                        continue;
+                if (_vte_ring_rows_maybe_match(ring, iter_start_row, iter_end_row, m_search_task_byteset) &&
+                    search_rows(m_search_task_match_context, m_search_task_match_data,
+                                iter_start_row, iter_end_row, m_search_task_backward)) {
+                        m_search_task_tag = 0;
+                        finish_search_task(true, false);
+                        return false;
+                }
+                search_cache_store_nomatch(iter_start_row, iter_end_row);
+        }
+
+        return true;
+}
+
+/*
+ * Complete the pending async search, reporting @found or, if @cancelled,
+ * %G_IO_ERROR_CANCELLED. The GTask invokes the caller's callback from the
+ * main loop, not from here.
+ */
+void
+Terminal::finish_search_task(bool found,
+                             bool cancelled)
+{
+        auto task = m_search_task;
+
+        m_search_task = nullptr;
+        if (m_search_task_match_data != nullptr) {
+                pcre2_match_data_free_8(m_search_task_match_data);
+                m_search_task_match_data = nullptr;
+        }
+        if (m_search_task_match_context != nullptr) {
+                pcre2_match_context_free_8(m_search_task_match_context);
+                m_search_task_match_context = nullptr;
+        }
+
+        if (cancelled)
+                g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                        "Operation was cancelled");
+        else
+                g_task_return_boolean(task, found);
+        g_object_unref(task);
+}
+
+void
+Terminal::stop_search_task()
+{
+        if (m_search_task == nullptr)
+                return;
+
+        if (m_search_task_tag != 0) {
+                g_source_remove(m_search_task_tag);
+                m_search_task_tag = 0;
+        }
+        finish_search_task(false, true);
+}
+
 /*
  * Terminal::set_input_enabled:
  * @enabled: whether to enable user input
@@ -11353,7 +14362,8 @@ Terminal::set_input_enabled (bool enabled)
                         m_real_widget->im_focus_out();
 
                 disconnect_pty_write();
-                _vte_byte_array_clear(m_outgoing);
+                m_outgoing_queue.clear();
+                m_outgoing_start = 0;
 
                 gtk_style_context_add_class (context, GTK_STYLE_CLASS_READ_ONLY);
         }
@@ -11447,6 +14457,7 @@ Terminal::set_word_char_exceptions(char const* exceptions)
 
         m_word_char_exceptions_string = exceptions ? exceptions : "";
         m_word_char_exceptions.swap(array);
+        compile_word_char_bitmap();
 
         return true;
 }
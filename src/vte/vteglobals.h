@@ -31,6 +31,12 @@ char *vte_get_user_shell(void);
 _VTE_PUBLIC
 const char *vte_get_features (void);
 
+_VTE_PUBLIC
+void vte_set_scrollback_encryption(gboolean enabled);
+
+_VTE_PUBLIC
+gboolean vte_get_scrollback_encryption(void);
+
 #define VTE_TEST_FLAGS_NONE (G_GUINT64_CONSTANT(0))
 #define VTE_TEST_FLAGS_ALL (~G_GUINT64_CONSTANT(0))
 
@@ -86,6 +86,14 @@ gboolean vte_pty_set_size (VtePty *pty,
                            int columns,
                            GError **error) _VTE_GNUC_NONNULL(1);
 
+_VTE_PUBLIC
+void vte_pty_set_size_coalescing (VtePty *pty,
+                                  gboolean enable) _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+gboolean vte_pty_flush_size (VtePty *pty,
+                             GError **error) _VTE_GNUC_NONNULL(1);
+
 _VTE_PUBLIC
 gboolean vte_pty_set_utf8 (VtePty *pty,
                            gboolean utf8,
@@ -167,6 +167,9 @@ void vte_terminal_feed(VteTerminal *terminal,
                        const char *data,
                        gssize length) _VTE_GNUC_NONNULL(1);
 _VTE_PUBLIC
+void vte_terminal_feed_bytes(VteTerminal *terminal,
+                             GBytes *bytes) _VTE_GNUC_NONNULL(1) _VTE_GNUC_NONNULL(2);
+_VTE_PUBLIC
 void vte_terminal_feed_child(VteTerminal *terminal,
                              const char *text,
                              gssize length) _VTE_GNUC_NONNULL(1);
@@ -432,6 +435,20 @@ _VTE_PUBLIC
 gboolean  vte_terminal_search_find_previous   (VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
 _VTE_PUBLIC
 gboolean  vte_terminal_search_find_next       (VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+void      vte_terminal_search_find_previous_async (VteTerminal *terminal,
+                                                   GCancellable *cancellable,
+                                                   GAsyncReadyCallback callback,
+                                                   gpointer user_data) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+void      vte_terminal_search_find_next_async (VteTerminal *terminal,
+                                               GCancellable *cancellable,
+                                               GAsyncReadyCallback callback,
+                                               gpointer user_data) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+gboolean  vte_terminal_search_find_finish     (VteTerminal *terminal,
+                                               GAsyncResult *result,
+                                               GError **error) _VTE_GNUC_NONNULL(1) _VTE_GNUC_NONNULL(2);
 
 
 /* CJK compatibility setting */
@@ -485,6 +502,29 @@ gboolean vte_terminal_write_contents_sync (VteTerminal *terminal,
                                            VteWriteFlags flags,
                                            GCancellable *cancellable,
                                            GError **error) _VTE_GNUC_NONNULL(1) _VTE_GNUC_NONNULL(2);
+_VTE_PUBLIC
+void     vte_terminal_write_contents_async (VteTerminal *terminal,
+                                            GOutputStream *stream,
+                                            VteWriteFlags flags,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data) _VTE_GNUC_NONNULL(1) _VTE_GNUC_NONNULL(2);
+_VTE_PUBLIC
+gboolean vte_terminal_write_contents_finish (VteTerminal *terminal,
+                                             GAsyncResult *result,
+                                             GError **error) _VTE_GNUC_NONNULL(1) _VTE_GNUC_NONNULL(2);
+
+/* Scrollback snapshots */
+_VTE_PUBLIC
+gboolean vte_terminal_write_snapshot_sync (VteTerminal *terminal,
+                                           GOutputStream *stream,
+                                           GCancellable *cancellable,
+                                           GError **error) _VTE_GNUC_NONNULL(1) _VTE_GNUC_NONNULL(2);
+_VTE_PUBLIC
+gboolean vte_terminal_read_snapshot_sync (VteTerminal *terminal,
+                                          GInputStream *stream,
+                                          GCancellable *cancellable,
+                                          GError **error) _VTE_GNUC_NONNULL(1) _VTE_GNUC_NONNULL(2);
 
 #if GLIB_CHECK_VERSION(2, 44, 0)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(VteTerminal, g_object_unref)
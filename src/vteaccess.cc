@@ -60,6 +60,8 @@ typedef struct _VteTerminalAccessiblePrivate {
 	GArray *snapshot_linebreaks;	/* Offsets to line breaks. */
 	gint snapshot_caret;       /* Location of the cursor (in characters). */
         gboolean text_caret_moved_pending;
+        gboolean text_in_use;      /* An AT has actually queried our text. */
+        guint update_source;       /* Coalesced update, see text_modified. */
 
 	char *action_descriptions[LAST_ACTION];
 } VteTerminalAccessiblePrivate;
@@ -375,11 +377,11 @@ vte_terminal_accessible_maybe_emit_text_caret_moved(VteTerminalAccessible *acces
         }
 }
 
-/* A signal handler to catch "text-inserted/deleted/modified" signals. */
+/* Refresh the snapshot and emit "text-changed" signals describing the
+ * difference against the previous one. */
 static void
-vte_terminal_accessible_text_modified(VteTerminal *terminal, gpointer data)
+vte_terminal_accessible_emit_text_changes(VteTerminalAccessible *accessible)
 {
-        VteTerminalAccessible *accessible = (VteTerminalAccessible *)data;
 	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
         GString *old_text;
         GArray *old_characters;
@@ -387,8 +389,14 @@ vte_terminal_accessible_text_modified(VteTerminal *terminal, gpointer data)
 	glong offset, caret_offset, olen, clen;
 	gint old_snapshot_caret;
 
+	if (!priv->snapshot_contents_invalid) {
+                /* A query already refreshed the snapshot; the diff below
+                 * would come up empty. */
+                vte_terminal_accessible_maybe_emit_text_caret_moved(accessible);
+		return;
+	}
+
 	old_snapshot_caret = priv->snapshot_caret;
-	priv->snapshot_contents_invalid = TRUE;
 	vte_terminal_accessible_update_private_data_if_needed(accessible,
                                                               &old_text,
                                                               &old_characters);
@@ -488,6 +496,70 @@ vte_terminal_accessible_text_modified(VteTerminal *terminal, gpointer data)
         g_array_free(old_characters, TRUE);
 }
 
+static gboolean
+vte_terminal_accessible_update_idle(gpointer data)
+{
+        VteTerminalAccessible *accessible = (VteTerminalAccessible *)data;
+	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
+
+        priv->update_source = 0;
+        vte_terminal_accessible_emit_text_changes(accessible);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Run the coalesced update now, ahead of work that needs the snapshot
+ * to be in sync with the emitted signals. */
+static void
+vte_terminal_accessible_flush_pending_update(VteTerminalAccessible *accessible)
+{
+	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
+
+        if (priv->update_source != 0) {
+                g_source_remove(priv->update_source);
+                priv->update_source = 0;
+                vte_terminal_accessible_emit_text_changes(accessible);
+        }
+}
+
+/* Called from the AtkText methods: note that an AT is actually reading us,
+ * and bring the snapshot up to date. Until the first query arrives the
+ * signal handlers below only mark the snapshot stale, so a terminal that
+ * no AT ever looks at doesn't pay for rebuilding it on every output burst. */
+static void
+vte_terminal_accessible_update_for_query(VteTerminalAccessible *accessible)
+{
+	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
+
+        priv->text_in_use = TRUE;
+        vte_terminal_accessible_flush_pending_update(accessible);
+	vte_terminal_accessible_update_private_data_if_needed(accessible,
+							      NULL, NULL);
+}
+
+/* A signal handler to catch "text-inserted/deleted/modified" signals. */
+static void
+vte_terminal_accessible_text_modified(VteTerminal *terminal, gpointer data)
+{
+        VteTerminalAccessible *accessible = (VteTerminalAccessible *)data;
+	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
+
+	priv->snapshot_contents_invalid = TRUE;
+
+        /* Nobody is reading us: the snapshot will be rebuilt lazily if a
+         * query ever arrives. */
+        if (!priv->text_in_use)
+                return;
+
+        /* Coalesce bursts of output into a single snapshot rebuild and
+         * diff, emitted from an idle at redraw priority. */
+        if (priv->update_source == 0)
+                priv->update_source = g_idle_add_full(GDK_PRIORITY_REDRAW + 10,
+                                                      vte_terminal_accessible_update_idle,
+                                                      accessible,
+                                                      NULL);
+}
+
 /* A signal handler to catch "text-scrolled" signals. */
 static void
 vte_terminal_accessible_text_scrolled(VteTerminal *terminal,
@@ -504,6 +576,14 @@ vte_terminal_accessible_text_scrolled(VteTerminal *terminal,
         /* g_assert(howmuch != 0); */
         if (howmuch == 0) return;
 
+        if (!priv->text_in_use) {
+                priv->snapshot_contents_invalid = TRUE;
+                return;
+        }
+
+        /* The diffs below run against the current snapshot. */
+        vte_terminal_accessible_flush_pending_update(accessible);
+
         row_count = vte_terminal_get_row_count(terminal);
 	if (((howmuch < 0) && (howmuch <= -row_count)) ||
 	    ((howmuch > 0) && (howmuch >= row_count))) {
@@ -645,6 +725,12 @@ vte_terminal_accessible_invalidate_cursor(VteTerminal *terminal, gpointer data)
 	_vte_debug_print(VTE_DEBUG_ALLY,
 			"Invalidating accessibility cursor.\n");
 	priv->snapshot_caret_invalid = TRUE;
+
+        if (!priv->text_in_use)
+                return;
+
+        /* Emit any pending text changes before the caret move. */
+        vte_terminal_accessible_flush_pending_update(accessible);
 	vte_terminal_accessible_update_private_data_if_needed(accessible,
 							      NULL, NULL);
         vte_terminal_accessible_maybe_emit_text_caret_moved(accessible);
@@ -766,6 +852,8 @@ _vte_terminal_accessible_init (VteTerminalAccessible *accessible)
 	priv->snapshot_contents_invalid = TRUE;
 	priv->snapshot_caret_invalid = TRUE;
         priv->text_caret_moved_pending = FALSE;
+        priv->text_in_use = FALSE;
+        priv->update_source = 0;
 }
 
 static void
@@ -778,6 +866,11 @@ vte_terminal_accessible_finalize(GObject *object)
 
 	_vte_debug_print(VTE_DEBUG_ALLY, "Finalizing accessible peer.\n");
 
+        if (priv->update_source != 0) {
+                g_source_remove(priv->update_source);
+                priv->update_source = 0;
+        }
+
         widget = gtk_accessible_get_widget (GTK_ACCESSIBLE(accessible));
 
 	if (widget != NULL) {
@@ -849,8 +942,7 @@ vte_terminal_accessible_get_text(AtkText *text,
 
 	g_assert((start_offset >= 0) && (end_offset >= -1));
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 
 	_vte_debug_print(VTE_DEBUG_ALLY,
 			"Getting text from %d to %d of %d.\n",
@@ -899,8 +991,7 @@ vte_terminal_accessible_get_text_somewhere(AtkText *text,
 	gunichar current, prev, next;
 	guint start, end, line;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 
         auto impl = IMPL_FROM_ACCESSIBLE(text);
 
@@ -1144,8 +1235,7 @@ vte_terminal_accessible_get_text_before_offset(AtkText *text, gint offset,
 {
         VteTerminalAccessible *accessible = VTE_TERMINAL_ACCESSIBLE(text);
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	return vte_terminal_accessible_get_text_somewhere(text,
 							  offset,
 							  boundary_type,
@@ -1162,8 +1252,7 @@ vte_terminal_accessible_get_text_after_offset(AtkText *text, gint offset,
 {
         VteTerminalAccessible *accessible = VTE_TERMINAL_ACCESSIBLE(text);
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	return vte_terminal_accessible_get_text_somewhere(text,
 							  offset,
 							  boundary_type,
@@ -1180,8 +1269,7 @@ vte_terminal_accessible_get_text_at_offset(AtkText *text, gint offset,
 {
         VteTerminalAccessible *accessible = VTE_TERMINAL_ACCESSIBLE(text);
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	return vte_terminal_accessible_get_text_somewhere(text,
 							  offset,
 							  boundary_type,
@@ -1198,8 +1286,7 @@ vte_terminal_accessible_get_character_at_offset(AtkText *text, gint offset)
 	char *unichar;
 	gunichar ret;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 
 	g_assert(offset < (int) priv->snapshot_characters->len);
 
@@ -1216,8 +1303,7 @@ vte_terminal_accessible_get_caret_offset(AtkText *text)
         VteTerminalAccessible *accessible = VTE_TERMINAL_ACCESSIBLE(text);
 	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 
 	return priv->snapshot_caret;
 }
@@ -1274,8 +1360,7 @@ vte_terminal_accessible_get_run_attributes(AtkText *text, gint offset,
 	struct _VteCharAttributes cur_attr;
 	struct _VteCharAttributes attr;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 
 	attr = g_array_index (priv->snapshot_attributes,
 			      struct _VteCharAttributes,
@@ -1328,8 +1413,7 @@ vte_terminal_accessible_get_character_extents(AtkText *text, gint offset,
 	glong cell_width, cell_height;
 	gint base_x, base_y, w, h;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	terminal = VTE_TERMINAL (gtk_accessible_get_widget (GTK_ACCESSIBLE (text)));
 
 	atk_component_get_extents (ATK_COMPONENT (text), &base_x, &base_y, &w, &h, coords);
@@ -1350,8 +1434,7 @@ vte_terminal_accessible_get_character_count(AtkText *text)
         VteTerminalAccessible *accessible = VTE_TERMINAL_ACCESSIBLE(text);
 	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 
 	return priv->snapshot_attributes->len;
 }
@@ -1367,8 +1450,7 @@ vte_terminal_accessible_get_offset_at_point(AtkText *text,
 	glong cell_width, cell_height;
 	gint base_x, base_y, w, h;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	terminal = VTE_TERMINAL (gtk_accessible_get_widget (GTK_ACCESSIBLE (text)));
 
 	atk_component_get_extents (ATK_COMPONENT (text), &base_x, &base_y, &w, &h, coords);
@@ -1388,8 +1470,7 @@ vte_terminal_accessible_get_n_selections(AtkText *text)
 	GtkWidget *widget;
 	VteTerminal *terminal;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	widget = gtk_accessible_get_widget (GTK_ACCESSIBLE(text));
 	if (widget == NULL) {
 		/* State is defunct */
@@ -1411,8 +1492,7 @@ vte_terminal_accessible_get_selection(AtkText *text, gint selection_number,
 	if (selection_number != 0)
 		return NULL;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	widget = gtk_accessible_get_widget (GTK_ACCESSIBLE(text));
 	if (widget == NULL) {
 		/* State is defunct */
@@ -1438,8 +1518,7 @@ vte_terminal_accessible_add_selection(AtkText *text,
 	VteTerminalAccessiblePrivate *priv = (VteTerminalAccessiblePrivate *)_vte_terminal_accessible_get_instance_private(accessible);
 	GtkWidget *widget;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	widget = gtk_accessible_get_widget (GTK_ACCESSIBLE(text));
 	if (widget == NULL) {
 		/* State is defunct */
@@ -1461,8 +1540,7 @@ vte_terminal_accessible_remove_selection(AtkText *text,
 	GtkWidget *widget;
 	VteTerminal *terminal;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	widget = gtk_accessible_get_widget (GTK_ACCESSIBLE(text));
 	if (widget == NULL) {
 		/* State is defunct */
@@ -1487,8 +1565,7 @@ vte_terminal_accessible_set_selection(AtkText *text, gint selection_number,
 	GtkWidget *widget;
 	VteTerminal *terminal;
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	widget = gtk_accessible_get_widget (GTK_ACCESSIBLE(text));
 	if (widget == NULL) {
 		/* State is defunct */
@@ -1512,8 +1589,7 @@ vte_terminal_accessible_set_caret_offset(AtkText *text, gint offset)
 {
         VteTerminalAccessible *accessible = VTE_TERMINAL_ACCESSIBLE(text);
 
-	vte_terminal_accessible_update_private_data_if_needed(accessible,
-							      NULL, NULL);
+	vte_terminal_accessible_update_for_query(accessible);
 	/* Whoa, very not allowed. */
 	return FALSE;
 }
@@ -75,6 +75,15 @@
 #define VTE_PALETTE_SIZE		263
 
 #define VTE_SCROLLBACK_INIT		512
+#define VTE_RING_CACHED_ROWS		128
+#define VTE_REWRAP_DEFER_ROWS		10000
+#define VTE_REWRAP_DEFER_TIMEOUT	150
+#define VTE_SEARCH_ASYNC_BATCH_ROWS	1024
+#define VTE_WRITE_CONTENTS_ASYNC_BATCH_BYTES	(64 * 1024)
+#define VTE_OUTGOING_WRITEV_MAX		16
+#define VTE_INPUT_BACKLOG_HIGH_WATER	(1024 * 1024)
+#define VTE_SGR_CACHE_SIZE		16
+#define VTE_SGR_CACHE_MAX_PARAMS	8
 #define VTE_DEFAULT_CURSOR		GDK_XTERM
 #define VTE_MOUSING_CURSOR		GDK_LEFT_PTR
 #define VTE_HYPERLINK_CURSOR		GDK_HAND2
@@ -85,7 +94,11 @@
 #define VTE_DISPLAY_TIMEOUT		10
 #define VTE_UPDATE_TIMEOUT		15
 #define VTE_UPDATE_REPEAT_TIMEOUT	30
+#define VTE_BACKGROUND_TIMEOUT		250 /* processing cadence while unmapped, ms */
+#define VTE_AUTOSCROLL_TIMEOUT		40 /* selection drag autoscroll tick, ms */
 #define VTE_MAX_PROCESS_TIME		100
+#define VTE_DRAW_BUDGET			6000 /* µs; see Terminal::draw_rows() */
+#define VTE_SEARCH_CACHE_MAX_ROWS	(1 << 17)
 #define VTE_CELL_BBOX_SLACK		1
 #define VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH 1
 
@@ -178,11 +178,23 @@ union unistr_font_info {
 	} using_cairo_glyph;
 };
 
+enum glyph_mask_state {
+	GLYPH_MASK_UNKNOWN = 0,	/* haven't tried to build a mask yet */
+	GLYPH_MASK_USE,		/* mask_surface is usable (NULL if there's nothing to draw) */
+	GLYPH_MASK_DONT		/* uncacheable (e.g. a color glyph); draw through pango_cairo */
+};
+
 struct unistr_info {
 	guchar coverage;
 	guchar has_unknown_chars;
+	guchar mask_state;
 	guint16 width;
 	union unistr_font_info ufi;
+	/* Cached rendering of the character as an alpha mask, so the pango
+	 * coverage cases don't rasterize through pango_cairo on every single
+	 * cell; see _vte_draw_ensure_glyph_mask(). */
+	cairo_surface_t *mask_surface;
+	int mask_left, mask_top;	/* mask position relative to the (baseline) drawing origin */
 };
 
 static struct unistr_info *
@@ -196,6 +208,12 @@ unistr_info_finish (struct unistr_info *uinfo)
 {
 	union unistr_font_info *ufi = &uinfo->ufi;
 
+	if (uinfo->mask_surface) {
+		cairo_surface_destroy (uinfo->mask_surface);
+		uinfo->mask_surface = NULL;
+	}
+	uinfo->mask_state = GLYPH_MASK_UNKNOWN;
+
 	switch (uinfo->coverage) {
 	default:
 	case COVERAGE_UNKNOWN:
@@ -240,6 +258,14 @@ struct font_info {
 	struct unistr_info ascii_unistr_info[128];
 	GHashTable *other_unistr_info;
 
+	/* whether rendered glyph masks may be cached; false with subpixel
+	 * antialiasing, which an alpha-only mask can't represent */
+	gboolean cache_glyph_masks;
+
+	/* whether the metrics came from the on-disk cache and still await
+	 * revalidation, see metrics_cache_revalidate() */
+	gboolean metrics_from_cache;
+
         /* cell metrics as taken from the font, not yet scaled by cell_{width,height}_scale */
 	gint width, height, ascent;
 
@@ -382,6 +408,51 @@ font_info_measure_font (struct font_info *info)
 {
 	PangoRectangle logical;
 
+        int max_width{1};
+        int max_height{1};
+
+        /* Shape all of printable ASCII in one pass and take the widest
+         * cluster. For a monospace font covering ASCII with a single run
+         * of simple one-glyph clusters — the overwhelmingly common case —
+         * this is equivalent to measuring each character individually, at
+         * a fraction of the cost; an interactive font size change
+         * re-measures on every step, so this is hot. */
+        char ascii[0x7f - 0x21];
+        for (unsigned int i = 0; i < G_N_ELEMENTS (ascii); ++i)
+                ascii[i] = 0x21 + i;
+        pango_layout_set_text (info->layout, ascii, G_N_ELEMENTS (ascii));
+
+        gboolean measured = FALSE;
+        PangoLayoutLine *line = pango_layout_get_line_readonly (info->layout, 0);
+        if (pango_layout_get_unknown_glyphs_count (info->layout) == 0 &&
+            line != NULL && line->runs != NULL && line->runs->next == NULL) {
+                PangoGlyphItem *glyph_item = (PangoGlyphItem *)line->runs->data;
+                const char *text = pango_layout_get_text (info->layout);
+                PangoGlyphItemIter iter;
+                gboolean more;
+
+                measured = TRUE;
+                for (more = pango_glyph_item_iter_init_start (&iter, glyph_item, text);
+                     more;
+                     more = pango_glyph_item_iter_next_cluster (&iter)) {
+                        /* A non-simple cluster — e.g. a programming font
+                         * fusing "<=" into a ligature — makes cluster widths
+                         * unrepresentative; measure the slow way instead. */
+                        if (iter.start_char + 1 != iter.end_char ||
+                            iter.start_glyph + 1 != iter.end_glyph) {
+                                measured = FALSE;
+                                break;
+                        }
+
+                        max_width = std::max (max_width,
+                                              PANGO_PIXELS_CEIL (glyph_item->glyphs->glyphs[iter.start_glyph].geometry.width));
+                }
+                if (measured) {
+                        pango_layout_get_extents (info->layout, NULL, &logical);
+                        max_height = std::max (max_height, PANGO_PIXELS_CEIL (logical.height));
+                }
+        }
+
         /* Measure U+0021..U+007E individually instead of all together and then
          * averaging. For monospace fonts, the results should be the same, but
          * if the user (by design, or trough mis-configuration) uses a proportional
@@ -389,13 +460,14 @@ font_info_measure_font (struct font_info *info)
          * leading to unreadable, overlapping characters.
          * https://gitlab.gnome.org/GNOME/vte/issues/138
          */
-        int max_width{1};
-        int max_height{1};
-        for (char c = 0x21; c < 0x7f; ++c) {
-                pango_layout_set_text(info->layout, &c, 1);
-                pango_layout_get_extents (info->layout, NULL, &logical);
-                max_width = std::max(max_width, PANGO_PIXELS_CEIL(logical.width));
-                max_height = std::max(max_height, PANGO_PIXELS_CEIL(logical.height));
+        if (!measured) {
+                max_width = max_height = 1;
+                for (char c = 0x21; c < 0x7f; ++c) {
+                        pango_layout_set_text(info->layout, &c, 1);
+                        pango_layout_get_extents (info->layout, NULL, &logical);
+                        max_width = std::max(max_width, PANGO_PIXELS_CEIL(logical.width));
+                        max_height = std::max(max_height, PANGO_PIXELS_CEIL(logical.height));
+                }
         }
 
         /* Use the sample text to get the baseline */
@@ -424,6 +496,149 @@ font_info_measure_font (struct font_info *info)
 			  info, info->width, info->height, info->ascent);
 }
 
+static void font_info_destroy (struct font_info *info);
+static struct font_info *font_info_reference (struct font_info *info);
+static guint vte_pango_context_get_fontconfig_timestamp (PangoContext *context);
+
+/* On-disk cell metrics cache.
+ *
+ * Measuring a font costs tens of milliseconds of Pango/fontconfig work
+ * on a cold start, for cell geometry that is the same every time for a
+ * given font+DPI. Persist the measured metrics to the XDG cache dir so
+ * the first frame of the first terminal of a new process can render
+ * without synchronous measurement. Entries are keyed by font
+ * description, resolution and language, and guarded by the fontconfig
+ * timestamp and the Pango version; a hit is additionally revalidated
+ * from a low priority idle, see metrics_cache_revalidate().
+ *
+ * Set VTE_METRICS_CACHE=0 to disable.
+ */
+
+static char *
+metrics_cache_filename (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "vte", "metrics.cache", NULL);
+}
+
+static GKeyFile *
+metrics_cache_open (void)
+{
+	static GKeyFile *key_file;
+	static gboolean tried;
+
+	if (!tried) {
+		tried = TRUE;
+
+		if (g_getenv ("VTE_METRICS_CACHE") != NULL &&
+		    g_ascii_strtoll (g_getenv ("VTE_METRICS_CACHE"), NULL, 10) == 0)
+			return NULL;
+
+		key_file = g_key_file_new ();
+		char *filename = metrics_cache_filename ();
+		/* Missing or malformed just means a cold cache */
+		g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+		g_free (filename);
+	}
+
+	return key_file;
+}
+
+static char *
+metrics_cache_group (PangoContext *context)
+{
+	char *desc_str = pango_font_description_to_string (pango_context_get_font_description (context));
+	char *group = g_strdup_printf ("%s|%.2f|%s",
+				       desc_str,
+				       pango_cairo_context_get_resolution (context),
+				       pango_language_to_string (pango_context_get_language (context)));
+	g_free (desc_str);
+	return group;
+}
+
+static gboolean
+metrics_cache_lookup (PangoContext *context,
+		      gint         *width,
+		      gint         *height,
+		      gint         *ascent)
+{
+	GKeyFile *key_file = metrics_cache_open ();
+	if (key_file == NULL)
+		return FALSE;
+
+	char *group = metrics_cache_group (context);
+	gboolean hit = FALSE;
+
+	if (g_key_file_has_group (key_file, group) &&
+	    g_key_file_get_integer (key_file, group, "fontconfig-timestamp", NULL) ==
+	    (gint) vte_pango_context_get_fontconfig_timestamp (context) &&
+	    g_key_file_get_integer (key_file, group, "pango-version", NULL) == pango_version ()) {
+		*width = g_key_file_get_integer (key_file, group, "width", NULL);
+		*height = g_key_file_get_integer (key_file, group, "height", NULL);
+		*ascent = g_key_file_get_integer (key_file, group, "ascent", NULL);
+		hit = *width > 0 && *height > 0;
+	}
+
+	g_free (group);
+	return hit;
+}
+
+static void
+metrics_cache_store (PangoContext *context,
+		     gint          width,
+		     gint          height,
+		     gint          ascent)
+{
+	GKeyFile *key_file = metrics_cache_open ();
+	if (key_file == NULL)
+		return;
+
+	char *group = metrics_cache_group (context);
+	g_key_file_set_integer (key_file, group, "fontconfig-timestamp",
+				(gint) vte_pango_context_get_fontconfig_timestamp (context));
+	g_key_file_set_integer (key_file, group, "pango-version", pango_version ());
+	g_key_file_set_integer (key_file, group, "width", width);
+	g_key_file_set_integer (key_file, group, "height", height);
+	g_key_file_set_integer (key_file, group, "ascent", ascent);
+	g_free (group);
+
+	char *filename = metrics_cache_filename ();
+	char *dir = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dir, 0700);
+	/* Best effort; the cache regenerates itself anyway */
+	g_key_file_save_to_file (key_file, filename, NULL);
+	g_free (dir);
+	g_free (filename);
+}
+
+/* Re-measure a font whose metrics came from the on-disk cache, off the
+ * critical path. This both warms the ASCII glyph cache and catches a
+ * stale cache entry (e.g. a font file replaced in place under the same
+ * description), rewriting it for the next process. A terminal that
+ * already sized itself from the stale metrics keeps them until the next
+ * font change; that's the price of skipping synchronous measurement. */
+static gboolean
+metrics_cache_revalidate (struct font_info *info)
+{
+	gint width = info->width;
+	gint height = info->height;
+	gint ascent = info->ascent;
+
+	font_info_measure_font (info);
+
+	if (width != info->width || height != info->height || ascent != info->ascent) {
+		_vte_debug_print (VTE_DEBUG_PANGOCAIRO,
+				  "vtepangocairo: %p stale cached metrics (%dx%d (%d) -> %dx%d (%d))\n",
+				  info,
+				  width, height, ascent,
+				  info->width, info->height, info->ascent);
+		metrics_cache_store (pango_layout_get_context (info->layout),
+				     info->width, info->height, info->ascent);
+	}
+
+	font_info_destroy (info);
+	return FALSE;
+}
+
 static struct font_info *
 font_info_allocate (PangoContext *context)
 {
@@ -443,7 +658,31 @@ font_info_allocate (PangoContext *context)
 
 	info->string = g_string_sized_new (VTE_UTF8_BPC+1);
 
-	font_info_measure_font (info);
+	{
+		const cairo_font_options_t *font_options =
+			pango_cairo_context_get_font_options (context);
+
+		info->cache_glyph_masks =
+			g_getenv ("VTE_GLYPH_CACHE") == NULL ||
+			g_ascii_strtoll (g_getenv ("VTE_GLYPH_CACHE"), NULL, 10) != 0;
+		if (font_options != NULL &&
+		    cairo_font_options_get_antialias (font_options) == CAIRO_ANTIALIAS_SUBPIXEL)
+			info->cache_glyph_masks = FALSE;
+	}
+
+	/* Cold start: reuse the cell geometry an earlier process measured
+	 * for the same font+DPI, and defer the measurement to an idle. */
+	if (metrics_cache_lookup (context, &info->width, &info->height, &info->ascent)) {
+		_vte_debug_print (VTE_DEBUG_PANGOCAIRO,
+				  "vtepangocairo: %p using cached metrics = %dx%d (%d)\n",
+				  info, info->width, info->height, info->ascent);
+		/* The caller still owns the initial reference; it schedules
+		 * the revalidation once that is in place. */
+		info->metrics_from_cache = TRUE;
+	} else {
+		font_info_measure_font (info);
+		metrics_cache_store (context, info->width, info->height, info->ascent);
+	}
 
 	return info;
 }
@@ -610,6 +849,14 @@ font_info_find_for_context (PangoContext *context)
 		info = font_info_allocate (context);
 		info->ref_count = 1;
 		font_info_register (info);
+
+		if (info->metrics_from_cache) {
+			info->metrics_from_cache = FALSE;
+			gdk_threads_add_idle_full (G_PRIORITY_LOW,
+						   (GSourceFunc) metrics_cache_revalidate,
+						   font_info_reference (info),
+						   NULL);
+		}
 	}
 
 	g_object_unref (context);
@@ -617,12 +864,14 @@ font_info_find_for_context (PangoContext *context)
 	return info;
 }
 
-/* assumes ownership/reference of context */
-static struct font_info *
-font_info_create_for_context (PangoContext               *context,
-			      const PangoFontDescription *desc,
-			      PangoLanguage              *language,
-			      guint                       fontconfig_timestamp)
+/* assumes ownership/reference of context; returns a context normalized so
+ * that equal terminal configurations hash and compare alike, see
+ * context_hash() and context_equal() */
+static PangoContext *
+font_context_setup (PangoContext               *context,
+		    const PangoFontDescription *desc,
+		    PangoLanguage              *language,
+		    guint                       fontconfig_timestamp)
 {
 	if (!PANGO_IS_CAIRO_FONT_MAP (pango_context_get_font_map (context))) {
 		/* Ouch, Gtk+ switched over to some drawing system?
@@ -652,7 +901,18 @@ font_info_create_for_context (PangoContext               *context,
                 cairo_font_options_destroy (font_options);
         }
 
-	return font_info_find_for_context (context);
+	return context;
+}
+
+/* assumes ownership/reference of context */
+static struct font_info *
+font_info_create_for_context (PangoContext               *context,
+			      const PangoFontDescription *desc,
+			      PangoLanguage              *language,
+			      guint                       fontconfig_timestamp)
+{
+	return font_info_find_for_context (font_context_setup (context, desc, language,
+							       fontconfig_timestamp));
 }
 
 static struct font_info *
@@ -677,6 +937,23 @@ font_info_create_for_widget (GtkWidget                  *widget,
 	return font_info_create_for_screen (screen, desc, language);
 }
 
+/* Like font_info_create_for_widget(), but only sets up the PangoContext
+ * identifying the font in the font_info cache; measuring the font is left
+ * for font_info_find_for_context() whenever someone actually needs it. */
+static PangoContext *
+font_context_create_for_widget (GtkWidget                  *widget,
+				const PangoFontDescription *desc)
+{
+	GdkScreen *screen = gtk_widget_get_screen (widget);
+	PangoLanguage *language = pango_context_get_language (gtk_widget_get_pango_context (widget));
+	GtkSettings *settings = gtk_settings_get_for_screen (screen);
+	int fontconfig_timestamp;
+
+	g_object_get (settings, "gtk-fontconfig-timestamp", &fontconfig_timestamp, nullptr);
+	return font_context_setup (gdk_pango_context_get_for_screen (screen),
+				   desc, language, fontconfig_timestamp);
+}
+
 static struct unistr_info *
 font_info_get_unistr_info (struct font_info *info,
 			   vteunistr c)
@@ -766,6 +1043,9 @@ guint _vte_draw_get_style(gboolean bold, gboolean italic) {
 
 struct _vte_draw {
 	struct font_info *fonts[4];
+	/* Set-up PangoContexts for the styles whose font_info hasn't been
+	 * needed yet; see _vte_draw_get_font(). */
+	PangoContext *font_contexts[4];
         /* cell metrics, already adjusted by cell_{width,height}_scale */
         int cell_width, cell_height;
         GtkBorder char_spacing;
@@ -774,6 +1054,12 @@ struct _vte_draw {
 
         /* Cache the undercurl's rendered look. */
         cairo_surface_t *undercurl_surface;
+
+        /* Cache the shapes of locally drawn graphic characters (box
+         * drawing and block elements) as alpha masks, keyed on
+         * (character, columns, font width); see
+         * _vte_draw_terminal_draw_graphic(). */
+        GHashTable *graphic_surfaces;
 };
 
 struct _vte_draw *
@@ -802,6 +1088,10 @@ _vte_draw_free (struct _vte_draw *draw)
 			font_info_destroy (draw->fonts[style]);
 			draw->fonts[style] = NULL;
 		}
+		if (draw->font_contexts[style] != NULL) {
+			g_object_unref (draw->font_contexts[style]);
+			draw->font_contexts[style] = NULL;
+		}
 	}
 
         if (draw->undercurl_surface != NULL) {
@@ -809,6 +1099,11 @@ _vte_draw_free (struct _vte_draw *draw)
                 draw->undercurl_surface = NULL;
         }
 
+        if (draw->graphic_surfaces != NULL) {
+                g_hash_table_destroy (draw->graphic_surfaces);
+                draw->graphic_surfaces = NULL;
+        }
+
 	g_slice_free (struct _vte_draw, draw);
 }
 
@@ -880,7 +1175,7 @@ _vte_draw_set_text_font (struct _vte_draw *draw,
 	PangoFontDescription *bolddesc   = NULL;
 	PangoFontDescription *italicdesc = NULL;
 	PangoFontDescription *bolditalicdesc = NULL;
-	gint style, normal, bold, ratio;
+	gint style;
 
 	_vte_debug_print (VTE_DEBUG_DRAW, "draw_set_text_font\n");
 
@@ -891,6 +1186,10 @@ _vte_draw_set_text_font (struct _vte_draw *draw,
 			font_info_destroy (draw->fonts[style]);
 			draw->fonts[style] = NULL;
 		}
+		if (draw->font_contexts[style] != NULL) {
+			g_object_unref (draw->font_contexts[style]);
+			draw->font_contexts[style] = NULL;
+		}
 	}
 
 	/* calculate bold font desc */
@@ -905,37 +1204,20 @@ _vte_draw_set_text_font (struct _vte_draw *draw,
 	bolditalicdesc = pango_font_description_copy (bolddesc);
 	pango_font_description_set_style (bolditalicdesc, PANGO_STYLE_ITALIC);
 
+	/* Measuring a font on a cold font_info cache is expensive. Only the
+	 * normal style is needed right away, for the cell metrics; the other
+	 * styles get their font_info on the first cell actually drawn with
+	 * them, which for many terminals is never. Just prepare the
+	 * PangoContexts that identify them in the cache. */
 	draw->fonts[VTE_DRAW_NORMAL]  = font_info_create_for_widget (widget, fontdesc);
-	draw->fonts[VTE_DRAW_BOLD]    = font_info_create_for_widget (widget, bolddesc);
-	draw->fonts[VTE_DRAW_ITALIC]  = font_info_create_for_widget (widget, italicdesc);
-	draw->fonts[VTE_DRAW_ITALIC | VTE_DRAW_BOLD] =
-                font_info_create_for_widget (widget, bolditalicdesc);
+	draw->font_contexts[VTE_DRAW_BOLD]   = font_context_create_for_widget (widget, bolddesc);
+	draw->font_contexts[VTE_DRAW_ITALIC] = font_context_create_for_widget (widget, italicdesc);
+	draw->font_contexts[VTE_DRAW_ITALIC | VTE_DRAW_BOLD] =
+                font_context_create_for_widget (widget, bolditalicdesc);
 	pango_font_description_free (bolddesc);
 	pango_font_description_free (italicdesc);
 	pango_font_description_free (bolditalicdesc);
 
-	/* Decide if we should keep this bold font face, per bug 54926:
-	 *  - reject bold font if it is not within 10% of normal font width
-	 */
-	normal = VTE_DRAW_NORMAL;
-	bold   = normal | VTE_DRAW_BOLD;
-	ratio = draw->fonts[bold]->width * 100 / draw->fonts[normal]->width;
-	if (abs(ratio - 100) > 10) {
-		_vte_debug_print (VTE_DEBUG_DRAW,
-			"Rejecting bold font (%i%%).\n", ratio);
-		font_info_destroy (draw->fonts[bold]);
-		draw->fonts[bold] = draw->fonts[normal];
-	}
-	normal = VTE_DRAW_ITALIC;
-	bold   = normal | VTE_DRAW_BOLD;
-	ratio = draw->fonts[bold]->width * 100 / draw->fonts[normal]->width;
-	if (abs(ratio - 100) > 10) {
-		_vte_debug_print (VTE_DEBUG_DRAW,
-			"Rejecting italic bold font (%i%%).\n", ratio);
-		font_info_destroy (draw->fonts[bold]);
-		draw->fonts[bold] = draw->fonts[normal];
-	}
-
         /* Apply letter spacing and line spacing. */
         draw->cell_width = draw->fonts[VTE_DRAW_NORMAL]->width * cell_width_scale;
         draw->char_spacing.left = (draw->cell_width - draw->fonts[VTE_DRAW_NORMAL]->width) / 2;
@@ -949,6 +1231,51 @@ _vte_draw_set_text_font (struct _vte_draw *draw,
                 cairo_surface_destroy (draw->undercurl_surface);
                 draw->undercurl_surface = NULL;
         }
+
+        /* Ditto for the graphic character shapes, whose geometry depends
+         * on the cell metrics. */
+        if (draw->graphic_surfaces != NULL) {
+                g_hash_table_destroy (draw->graphic_surfaces);
+                draw->graphic_surfaces = NULL;
+        }
+}
+
+/*
+ * Get the font_info for @style, creating it from the context prepared in
+ * _vte_draw_set_text_font() on first use.
+ */
+static struct font_info *
+_vte_draw_get_font (struct _vte_draw *draw,
+		    guint style)
+{
+	struct font_info *info;
+	gint normal, ratio;
+
+	info = draw->fonts[style];
+	if (G_LIKELY (info != NULL))
+		return info;
+
+	g_assert (draw->font_contexts[style] != NULL);
+	info = font_info_find_for_context (draw->font_contexts[style]);
+	draw->font_contexts[style] = NULL;  /* the reference was consumed */
+
+	/* Decide if we should keep this bold font face, per bug 54926:
+	 *  - reject bold font if it is not within 10% of normal font width
+	 */
+	if (style & VTE_DRAW_BOLD) {
+		normal = style & ~VTE_DRAW_BOLD;
+		ratio = info->width * 100 / _vte_draw_get_font (draw, normal)->width;
+		if (abs(ratio - 100) > 10) {
+			_vte_debug_print (VTE_DEBUG_DRAW,
+					  "Rejecting %sbold font (%i%%).\n",
+					  style & VTE_DRAW_ITALIC ? "italic " : "", ratio);
+			font_info_destroy (info);
+			info = draw->fonts[normal];
+		}
+	}
+
+	draw->fonts[style] = info;
+	return info;
 }
 
 void
@@ -987,7 +1314,7 @@ _vte_draw_get_char_edges (struct _vte_draw *draw, vteunistr c, int columns, guin
                 return;
         }
 
-        w = font_info_get_unistr_info (draw->fonts[style], c)->width;
+        w = font_info_get_unistr_info (_vte_draw_get_font (draw, style), c)->width;
         normal_width = draw->fonts[VTE_DRAW_NORMAL]->width * columns;
         fits_width = draw->cell_width * columns;
 
@@ -1021,18 +1348,19 @@ _vte_draw_unichar_is_local_graphic(vteunistr c)
 
 #include "box_drawing.h"
 
-/* Draw the graphic representation of a line-drawing or special graphics
- * character. */
+/* Draw the shape of a line-drawing or special graphics character as an
+ * alpha coverage onto @cr, with the cell's top left corner at (x, y).
+ * The fill is inherited from the current source, except for the shade
+ * characters which use a fraction of its alpha. */
 static void
-_vte_draw_terminal_draw_graphic(struct _vte_draw *draw, vteunistr c, vte::color::rgb const* fg,
-                                gint x, gint y,
-                                gint font_width, gint columns, gint font_height)
+_vte_draw_terminal_draw_graphic_shape(struct _vte_draw *draw, cairo_t *cr, vteunistr c,
+                                      gint x, gint y,
+                                      gint font_width, gint columns, gint font_height)
 {
         gint width, height, xcenter, xright, ycenter, ybottom;
         int upper_half, lower_half, left_half, right_half;
         int light_line_width, heavy_line_width;
         double adjust;
-        cairo_t *cr = draw->cr;
 
         cairo_save (cr);
 
@@ -1389,10 +1717,7 @@ _vte_draw_terminal_draw_graphic(struct _vte_draw *draw, vteunistr c, vte::color:
         case 0x2591: /* light shade */
         case 0x2592: /* medium shade */
         case 0x2593: /* dark shade */
-                cairo_set_source_rgba (cr,
-                                       fg->red / 65535.,
-                                       fg->green / 65535.,
-                                       fg->blue / 65535.,
+                cairo_set_source_rgba (cr, 0., 0., 0.,
                                        (c - 0x2590) / 4.);
                 cairo_rectangle(cr, x, y, width, height);
                 cairo_fill (cr);
@@ -1483,6 +1808,171 @@ _vte_draw_terminal_draw_graphic(struct _vte_draw *draw, vteunistr c, vte::color:
         cairo_restore(cr);
 }
 
+/* Overflow margin for the cached graphic shapes: strokes are centered on
+ * pixel boundaries and may bleed slightly past the cell. */
+#define VTE_DRAW_GRAPHIC_PADDING 2
+
+/* Draw the graphic representation of a line-drawing or special graphics
+ * character. The rendered shape is cached as an alpha mask and composited
+ * with the current source on subsequent frames, so redrawing pane borders
+ * and progress bars costs a mask blit per cell instead of rebuilding and
+ * rasterizing cairo paths. */
+static void
+_vte_draw_terminal_draw_graphic(struct _vte_draw *draw, vteunistr c,
+                                gint x, gint y,
+                                gint font_width, gint columns, gint font_height)
+{
+        cairo_surface_t *surface;
+        gpointer key;
+
+        g_assert(draw->cr);
+
+        /* The shape only depends on the character, the columns it spans
+         * and the line widths derived from the font width; the color is
+         * applied by the mask composite below. */
+        key = GUINT_TO_POINTER (((guint)c << 12) |
+                                ((guint)columns << 10) |
+                                ((guint)font_width & 0x3ff));
+
+        if (G_UNLIKELY (draw->graphic_surfaces == NULL))
+                draw->graphic_surfaces = g_hash_table_new_full (NULL, NULL,
+                                                                NULL,
+                                                                (GDestroyNotify) cairo_surface_destroy);
+
+        surface = (cairo_surface_t *) g_hash_table_lookup (draw->graphic_surfaces, key);
+        if (G_UNLIKELY (surface == NULL)) {
+                cairo_t *graphic_cr;
+
+                _vte_debug_print (VTE_DEBUG_DRAW,
+                                  "caching graphic shape of U+%04X\n", c);
+
+                surface = cairo_surface_create_similar (cairo_get_target (draw->cr),
+                                                        CAIRO_CONTENT_ALPHA,
+                                                        draw->cell_width * columns + 2 * VTE_DRAW_GRAPHIC_PADDING,
+                                                        draw->cell_height + 2 * VTE_DRAW_GRAPHIC_PADDING);
+                graphic_cr = cairo_create (surface);
+                cairo_set_source_rgba (graphic_cr, 0., 0., 0., 1.);
+                _vte_draw_terminal_draw_graphic_shape (draw, graphic_cr, c,
+                                                       VTE_DRAW_GRAPHIC_PADDING,
+                                                       VTE_DRAW_GRAPHIC_PADDING,
+                                                       font_width, columns, font_height);
+                cairo_destroy (graphic_cr);
+                g_hash_table_insert (draw->graphic_surfaces, key, surface);
+        }
+
+        /* The caller set up the source color and operator already. */
+        cairo_mask_surface (draw->cr, surface,
+                            x - VTE_DRAW_GRAPHIC_PADDING,
+                            y - VTE_DRAW_GRAPHIC_PADDING);
+}
+
+/*
+ * Build (once) and cache the rendered look of @uinfo as an alpha mask on a
+ * surface similar to the draw target, so that repainting the character is a
+ * single composite (kept on the rendering backend's side where possible)
+ * instead of a pango_cairo rasterization per cell. Returns true if the
+ * cached mask (or nothing at all, for ink-less characters) should be used,
+ * false to keep drawing through pango_cairo, e.g. for color glyphs which an
+ * alpha mask can't represent.
+ */
+static gboolean
+_vte_draw_ensure_glyph_mask (struct _vte_draw *draw,
+			     struct font_info *font,
+			     struct unistr_info *uinfo)
+{
+	PangoRectangle ink;
+	cairo_surface_t *image, *mask;
+	cairo_t *cr;
+	unsigned char *data;
+	int width, height, stride, row, col;
+	gboolean color_glyph;
+
+	if (G_LIKELY (uinfo->mask_state != GLYPH_MASK_UNKNOWN))
+		return uinfo->mask_state == GLYPH_MASK_USE;
+
+	if (!font->cache_glyph_masks) {
+		uinfo->mask_state = GLYPH_MASK_DONT;
+		return FALSE;
+	}
+
+	switch (uinfo->coverage) {
+	case COVERAGE_USE_PANGO_LAYOUT_LINE:
+		pango_layout_line_get_extents (uinfo->ufi.using_pango_layout_line.line,
+					       &ink, NULL);
+		break;
+	case COVERAGE_USE_PANGO_GLYPH_STRING:
+		pango_glyph_string_extents (uinfo->ufi.using_pango_glyph_string.glyph_string,
+					    uinfo->ufi.using_pango_glyph_string.font,
+					    &ink, NULL);
+		break;
+	default:
+		g_assert_not_reached ();
+		break;
+	}
+
+	uinfo->mask_left = PANGO_PIXELS_FLOOR (ink.x);
+	uinfo->mask_top = PANGO_PIXELS_FLOOR (ink.y);
+	width = PANGO_PIXELS_CEIL (ink.x + ink.width) - uinfo->mask_left;
+	height = PANGO_PIXELS_CEIL (ink.y + ink.height) - uinfo->mask_top;
+
+	if (width <= 0 || height <= 0) {
+		/* No ink, nothing to draw. */
+		uinfo->mask_state = GLYPH_MASK_USE;
+		return TRUE;
+	}
+
+	/* Render once to an image to find out what the character looks like.
+	 * With the default black source an ordinary glyph only produces
+	 * (premultiplied) black pixels; anything else is a color glyph. */
+	image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+	cr = cairo_create (image);
+	cairo_move_to (cr, -uinfo->mask_left, -uinfo->mask_top);
+	switch (uinfo->coverage) {
+	case COVERAGE_USE_PANGO_LAYOUT_LINE:
+		pango_cairo_show_layout_line (cr, uinfo->ufi.using_pango_layout_line.line);
+		break;
+	case COVERAGE_USE_PANGO_GLYPH_STRING:
+		pango_cairo_show_glyph_string (cr, uinfo->ufi.using_pango_glyph_string.font,
+					       uinfo->ufi.using_pango_glyph_string.glyph_string);
+		break;
+	}
+	cairo_destroy (cr);
+
+	cairo_surface_flush (image);
+	color_glyph = FALSE;
+	data = cairo_image_surface_get_data (image);
+	stride = cairo_image_surface_get_stride (image);
+	for (row = 0; row < height && !color_glyph; row++) {
+		guint32 *pixel = (guint32 *) (data + row * stride);
+		for (col = 0; col < width; col++) {
+			if (pixel[col] & 0x00ffffff) {
+				color_glyph = TRUE;
+				break;
+			}
+		}
+	}
+
+	if (color_glyph) {
+		cairo_surface_destroy (image);
+		uinfo->mask_state = GLYPH_MASK_DONT;
+		return FALSE;
+	}
+
+	/* Keep the mask on a surface similar to the target so that
+	 * compositing it doesn't have to pull it through the CPU. */
+	mask = cairo_surface_create_similar (cairo_get_target (draw->cr),
+					     CAIRO_CONTENT_ALPHA, width, height);
+	cr = cairo_create (mask);
+	cairo_set_source_surface (cr, image, 0, 0);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+	cairo_surface_destroy (image);
+
+	uinfo->mask_surface = mask;
+	uinfo->mask_state = GLYPH_MASK_USE;
+	return TRUE;
+}
+
 static void
 _vte_draw_text_internal (struct _vte_draw *draw,
 			 struct _vte_draw_text_request *requests, gsize n_requests,
@@ -1492,7 +1982,7 @@ _vte_draw_text_internal (struct _vte_draw *draw,
 	cairo_scaled_font_t *last_scaled_font = NULL;
 	int n_cr_glyphs = 0;
 	cairo_glyph_t cr_glyphs[MAX_RUN_LENGTH];
-	struct font_info *font = draw->fonts[style];
+	struct font_info *font = _vte_draw_get_font (draw, style);
 
 	g_return_if_fail (font != NULL);
 
@@ -1518,7 +2008,7 @@ _vte_draw_text_internal (struct _vte_draw *draw,
                 y = requests[i].y + draw->char_spacing.top + draw->fonts[VTE_DRAW_NORMAL]->ascent;
 
                 if (_vte_draw_unichar_is_local_graphic(c)) {
-                        _vte_draw_terminal_draw_graphic(draw, c, color,
+                        _vte_draw_terminal_draw_graphic(draw, c,
                                                         requests[i].x, requests[i].y,
                                                         font->width, requests[i].columns, font->height);
                         continue;
@@ -1530,11 +2020,23 @@ _vte_draw_text_internal (struct _vte_draw *draw,
 			g_assert_not_reached ();
 			break;
 		case COVERAGE_USE_PANGO_LAYOUT_LINE:
+			if (_vte_draw_ensure_glyph_mask (draw, font, uinfo)) {
+				if (uinfo->mask_surface)
+					cairo_mask_surface (draw->cr, uinfo->mask_surface,
+							    x + uinfo->mask_left, y + uinfo->mask_top);
+				break;
+			}
 			cairo_move_to (draw->cr, x, y);
 			pango_cairo_show_layout_line (draw->cr,
 						      ufi->using_pango_layout_line.line);
 			break;
 		case COVERAGE_USE_PANGO_GLYPH_STRING:
+			if (_vte_draw_ensure_glyph_mask (draw, font, uinfo)) {
+				if (uinfo->mask_surface)
+					cairo_mask_surface (draw->cr, uinfo->mask_surface,
+							    x + uinfo->mask_left, y + uinfo->mask_top);
+				break;
+			}
 			cairo_move_to (draw->cr, x, y);
 			pango_cairo_show_glyph_string (draw->cr,
 						       ufi->using_pango_glyph_string.font,
@@ -1606,7 +2108,7 @@ _vte_draw_has_char (struct _vte_draw *draw, vteunistr c, guint style)
 
 	g_return_val_if_fail (draw->fonts[VTE_DRAW_NORMAL] != NULL, FALSE);
 
-	uinfo = font_info_get_unistr_info (draw->fonts[style], c);
+	uinfo = font_info_get_unistr_info (_vte_draw_get_font (draw, style), c);
 	return !uinfo->has_unknown_chars;
 }
 
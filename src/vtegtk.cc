@@ -1033,6 +1033,37 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                    G_OBJECT_CLASS_TYPE(klass),
                                    g_cclosure_marshal_VOID__VOIDv);
 
+        /**
+         * VteTerminal::contents-modified:
+         * @vteterminal: the object which received the signal
+         * @start_row: the first modified row
+         * @end_row: the last modified row (inclusive)
+         * @generation: the content generation after this change
+         *
+         * Emitted right after #VteTerminal::contents-changed, carrying the
+         * range of rows whose contents may have changed since the previous
+         * emission, in the same absolute coordinates that
+         * vte_terminal_get_text_range() takes. The range errs on the side
+         * of inclusion: rows outside it are guaranteed unchanged, rows
+         * inside it may or may not be. @generation increases by one with
+         * every emission, so a consumer mirroring the contents can detect
+         * missed emissions and resynchronize.
+         *
+         * Since: 0.60
+         */
+        signals[SIGNAL_CONTENTS_MODIFIED] =
+                g_signal_new(I_("contents-modified"),
+                             G_OBJECT_CLASS_TYPE(klass),
+                             G_SIGNAL_RUN_LAST,
+                             0,
+                             NULL,
+                             NULL,
+                             _vte_marshal_VOID__LONG_LONG_UINT64,
+                             G_TYPE_NONE, 3, G_TYPE_LONG, G_TYPE_LONG, G_TYPE_UINT64);
+        g_signal_set_va_marshaller(signals[SIGNAL_CONTENTS_MODIFIED],
+                                   G_OBJECT_CLASS_TYPE(klass),
+                                   _vte_marshal_VOID__LONG_LONG_UINT64v);
+
         /**
          * VteTerminal::cursor-moved:
          * @vteterminal: the object which received the signal
@@ -1351,6 +1382,32 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                    G_OBJECT_CLASS_TYPE(klass),
                                    g_cclosure_marshal_VOID__INTv);
 
+        /**
+         * VteTerminal::output-activity-changed:
+         * @vteterminal: the object which received the signal
+         * @active: %TRUE when sustained output processing begins, %FALSE when it ends
+         *
+         * Emitted when the terminal starts or stops actively processing
+         * child output.  While @active is %TRUE the scrollback bounds keep
+         * growing and the adjustment is updated once per frame; embedders
+         * may want to defer expensive reactions such as scrollbar
+         * animations until the %FALSE emission.
+         *
+         * Since: 0.60
+         */
+        signals[SIGNAL_OUTPUT_ACTIVITY_CHANGED] =
+                g_signal_new(I_("output-activity-changed"),
+                             G_OBJECT_CLASS_TYPE(klass),
+                             G_SIGNAL_RUN_LAST,
+                             0,
+                             NULL,
+                             NULL,
+                             g_cclosure_marshal_VOID__BOOLEAN,
+                             G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+        g_signal_set_va_marshaller(signals[SIGNAL_OUTPUT_ACTIVITY_CHANGED],
+                                   G_OBJECT_CLASS_TYPE(klass),
+                                   g_cclosure_marshal_VOID__BOOLEANv);
+
         /**
          * VteTerminal::copy-clipboard:
          * @vteterminal: the object which received the signal
@@ -1914,6 +1971,41 @@ vte_get_user_shell (void)
         return NULL;
 }
 
+/**
+ * vte_set_scrollback_encryption:
+ * @enabled: whether to encrypt scrollback files
+ *
+ * Controls whether the scrollback streams that vte spills to disk are
+ * encrypted and authenticated. This is on by default; it may be turned
+ * off where the cipher cost matters and the spill files are already
+ * protected by other means, for example on an encrypted or memory-backed
+ * filesystem.
+ *
+ * The setting is sampled when a terminal creates its streams, so it
+ * should be set up front; terminals that already exist are unaffected.
+ *
+ * Since: 0.60
+ */
+void
+vte_set_scrollback_encryption(gboolean enabled)
+{
+        _vte_scrollback_encryption_enabled = enabled != FALSE;
+}
+
+/**
+ * vte_get_scrollback_encryption:
+ *
+ * Returns: %TRUE if newly created terminals encrypt their scrollback
+ *   files; see vte_set_scrollback_encryption()
+ *
+ * Since: 0.60
+ */
+gboolean
+vte_get_scrollback_encryption(void)
+{
+        return _vte_scrollback_encryption_enabled;
+}
+
 /**
  * vte_set_test_flags: (skip):
  * @flags: flags
@@ -2384,6 +2476,84 @@ vte_terminal_search_find_next (VteTerminal *terminal)
 	return IMPL(terminal)->search_find(false);
 }
 
+/**
+ * vte_terminal_search_find_previous_async:
+ * @terminal: a #VteTerminal
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the search terminates
+ * @user_data: user data to pass to @callback
+ *
+ * Like vte_terminal_search_find_previous(), but searches incrementally
+ * from the main loop instead of blocking until the whole scrollback has
+ * been scanned. Starting another search, synchronous or asynchronous,
+ * or changing the search regex, cancels a search still in flight.
+ *
+ * Get the result with vte_terminal_search_find_finish().
+ *
+ * Since: 0.60
+ */
+void
+vte_terminal_search_find_previous_async (VteTerminal *terminal,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(cancellable == nullptr || G_IS_CANCELLABLE(cancellable));
+        IMPL(terminal)->search_find_async(true, cancellable, callback, user_data);
+}
+
+/**
+ * vte_terminal_search_find_next_async:
+ * @terminal: a #VteTerminal
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the search terminates
+ * @user_data: user data to pass to @callback
+ *
+ * Like vte_terminal_search_find_next(), but searches incrementally
+ * from the main loop instead of blocking until the whole scrollback has
+ * been scanned. Starting another search, synchronous or asynchronous,
+ * or changing the search regex, cancels a search still in flight.
+ *
+ * Get the result with vte_terminal_search_find_finish().
+ *
+ * Since: 0.60
+ */
+void
+vte_terminal_search_find_next_async (VteTerminal *terminal,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(cancellable == nullptr || G_IS_CANCELLABLE(cancellable));
+        IMPL(terminal)->search_find_async(false, cancellable, callback, user_data);
+}
+
+/**
+ * vte_terminal_search_find_finish:
+ * @terminal: a #VteTerminal
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes a search started with vte_terminal_search_find_previous_async()
+ * or vte_terminal_search_find_next_async().
+ *
+ * Returns: %TRUE if a match was found, %FALSE if not or if the search
+ *   was cancelled
+ *
+ * Since: 0.60
+ */
+gboolean
+vte_terminal_search_find_finish (VteTerminal *terminal,
+                                 GAsyncResult *result,
+                                 GError **error)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), FALSE);
+        g_return_val_if_fail(g_task_is_valid(result, terminal), FALSE);
+        return g_task_propagate_boolean(G_TASK(result), error);
+}
+
 /**
  * vte_terminal_search_set_regex:
  * @terminal: a #VteTerminal
@@ -2897,6 +3067,29 @@ vte_terminal_feed(VteTerminal *terminal,
         IMPL(terminal)->feed(data, length);
 }
 
+/**
+ * vte_terminal_feed_bytes:
+ * @terminal: a #VteTerminal
+ * @bytes: data in the terminal's current encoding
+ *
+ * Interprets the contents of @bytes as if they were data received from
+ * a child process, like vte_terminal_feed(), but without copying: the
+ * terminal keeps a reference on @bytes and reads the data in place, so
+ * feeding bulk data from an already-buffered source is cheap regardless
+ * of its size. @bytes must not be modified after this call.
+ *
+ * Since: 0.60
+ */
+void
+vte_terminal_feed_bytes(VteTerminal *terminal,
+                        GBytes *bytes)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(bytes != NULL);
+
+        IMPL(terminal)->feed_bytes(bytes);
+}
+
 /**
  * vte_terminal_feed_child:
  * @terminal: a #VteTerminal
@@ -4528,6 +4721,131 @@ vte_terminal_write_contents_sync (VteTerminal *terminal,
         return IMPL(terminal)->write_contents_sync(stream, flags, cancellable, error);
 }
 
+/**
+ * vte_terminal_write_snapshot_sync:
+ * @terminal: a #VteTerminal
+ * @stream: a #GOutputStream to write to
+ * @cancellable: (allow-none): a #GCancellable object, or %NULL
+ * @error: (allow-none): a #GError location to store the error occuring, or %NULL
+ *
+ * Write a snapshot of @terminal's scrollback contents to @stream, in a
+ * private format that vte_terminal_read_snapshot_sync() can restore from
+ * after a restart. The format is not portable across architectures or vte
+ * versions; a stale snapshot is rejected on restore.
+ *
+ * Unlike vte_terminal_write_contents_sync(), the snapshot preserves
+ * attributes, and restoring it is a bulk copy that does not reparse the
+ * contents. Transient state -- the cursor, terminal modes, the alternate
+ * screen -- is not part of the snapshot, since a restored terminal spawns
+ * a new child which reestablishes those.
+ *
+ * Returns: %TRUE on success, %FALSE if there was an error
+ *
+ * Since: 0.60
+ */
+gboolean
+vte_terminal_write_snapshot_sync (VteTerminal *terminal,
+                                  GOutputStream *stream,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), FALSE);
+        g_return_val_if_fail(G_IS_OUTPUT_STREAM(stream), FALSE);
+
+        return IMPL(terminal)->write_snapshot_sync(stream, cancellable, error);
+}
+
+/**
+ * vte_terminal_read_snapshot_sync:
+ * @terminal: a #VteTerminal
+ * @stream: a #GInputStream to read from
+ * @cancellable: (allow-none): a #GCancellable object, or %NULL
+ * @error: (allow-none): a #GError location to store the error occuring, or %NULL
+ *
+ * Restore scrollback contents previously written with
+ * vte_terminal_write_snapshot_sync(). Any existing contents are replaced:
+ * this is meant to be called on a newly created terminal, before spawning
+ * its child. The restored rows become scrollback history above a blank
+ * screen; they are thawed lazily as they are scrolled into view, so
+ * restoring is fast regardless of the history size.
+ *
+ * If the snapshot is invalid or from an incompatible vte, the terminal is
+ * left empty and %FALSE is returned.
+ *
+ * Returns: %TRUE on success, %FALSE if there was an error
+ *
+ * Since: 0.60
+ */
+gboolean
+vte_terminal_read_snapshot_sync (VteTerminal *terminal,
+                                 GInputStream *stream,
+                                 GCancellable *cancellable,
+                                 GError **error)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), FALSE);
+        g_return_val_if_fail(G_IS_INPUT_STREAM(stream), FALSE);
+
+        return IMPL(terminal)->read_snapshot_sync(stream, cancellable, error);
+}
+
+/**
+ * vte_terminal_write_contents_async:
+ * @terminal: a #VteTerminal
+ * @stream: a #GOutputStream to write to
+ * @flags: a set of #VteWriteFlags
+ * @cancellable: (allow-none): a #GCancellable object, or %NULL
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the write terminates
+ * @user_data: user data to pass to @callback
+ *
+ * Like vte_terminal_write_contents_sync(), but writes incrementally from
+ * the main loop instead of blocking until the whole scrollback has been
+ * serialized. Output produced by the terminal after this call is not
+ * included in the dump; however, if scrollback lines are dropped from the
+ * history before they have been written out, the operation fails.
+ * Starting another write, synchronous or asynchronous, cancels a write
+ * still in flight.
+ *
+ * Get the result with vte_terminal_write_contents_finish().
+ *
+ * Since: 0.60
+ */
+void
+vte_terminal_write_contents_async (VteTerminal *terminal,
+                                   GOutputStream *stream,
+                                   VteWriteFlags flags,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(G_IS_OUTPUT_STREAM(stream));
+        g_return_if_fail(cancellable == nullptr || G_IS_CANCELLABLE(cancellable));
+        IMPL(terminal)->write_contents_async(stream, flags, cancellable, callback, user_data);
+}
+
+/**
+ * vte_terminal_write_contents_finish:
+ * @terminal: a #VteTerminal
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Collects the result of a vte_terminal_write_contents_async() operation.
+ *
+ * Returns: %TRUE on success, %FALSE if there was an error or the
+ *   operation was cancelled with %G_IO_ERROR_CANCELLED
+ *
+ * Since: 0.60
+ */
+gboolean
+vte_terminal_write_contents_finish (VteTerminal *terminal,
+                                    GAsyncResult *result,
+                                    GError **error)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), FALSE);
+        g_return_val_if_fail(g_task_is_valid(result, terminal), FALSE);
+        return g_task_propagate_boolean(G_TASK(result), error);
+}
+
 /**
  * vte_terminal_set_clear_background:
  * @terminal: a #VteTerminal
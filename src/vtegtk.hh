@@ -31,6 +31,7 @@ enum {
         SIGNAL_CHILD_EXITED,
         SIGNAL_COMMIT,
         SIGNAL_CONTENTS_CHANGED,
+        SIGNAL_CONTENTS_MODIFIED,
         SIGNAL_COPY_CLIPBOARD,
         SIGNAL_CURRENT_DIRECTORY_URI_CHANGED,
         SIGNAL_CURRENT_FILE_URI_CHANGED,
@@ -46,6 +47,7 @@ enum {
         SIGNAL_LOWER_WINDOW,
         SIGNAL_MAXIMIZE_WINDOW,
         SIGNAL_MOVE_WINDOW,
+        SIGNAL_OUTPUT_ACTIVITY_CHANGED,
         SIGNAL_PASTE_CLIPBOARD,
         SIGNAL_RAISE_WINDOW,
         SIGNAL_REFRESH_WINDOW,
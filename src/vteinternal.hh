@@ -26,6 +26,7 @@
 #include "reaper.hh"
 #include "ring.hh"
 #include "ringview.hh"
+#include "sixel.hh"
 #include "buffer.h"
 #include "parser.hh"
 #include "parser-glue.hh"
@@ -37,9 +38,12 @@
 #include "vteregexinternal.hh"
 
 #include "chunk.hh"
+#include "parserthread.hh"
 #include "utf8.hh"
 
+#include <deque>
 #include <list>
+#include <memory>
 #include <queue>
 #include <string>
 #include <vector>
@@ -95,6 +99,20 @@ enum {
         VTE_BIDI_FLAG_ALL        = (1 << 4) - 1,
 };
 
+/* Buffered signal and property emissions, flushed with last-writer-wins
+ * semantics by Terminal::emit_pending_signals(). */
+enum {
+        VTE_PENDING_WINDOW_TITLE          = 1 << 0,
+        VTE_PENDING_CURRENT_DIRECTORY_URI = 1 << 1,
+        VTE_PENDING_CURRENT_FILE_URI      = 1 << 2,
+        VTE_PENDING_CURSOR_MOVED          = 1 << 3,
+        VTE_PENDING_TEXT_MODIFIED         = 1 << 4,
+        VTE_PENDING_TEXT_INSERTED         = 1 << 5,
+        VTE_PENDING_TEXT_DELETED          = 1 << 6,
+        VTE_PENDING_CONTENTS_CHANGED      = 1 << 7,
+        VTE_PENDING_BELL                  = 1 << 8,
+};
+
 struct vte_regex_and_flags {
         VteRegex *regex;
         guint32 match_flags;
@@ -328,18 +346,35 @@ public:
 
 	/* PTY handling data. */
         VtePty *m_pty;
-        GIOChannel *m_pty_channel;      /* master channel */
+        int m_pty_fd{-1};               /* cached master fd, owned by m_pty */
         guint m_pty_input_source;
         guint m_pty_output_source;
         gboolean m_pty_input_active;
         pid_t m_pty_pid{-1};           /* pid of child process */
         VteReaper *m_reaper;
+        void* m_record_stream{nullptr}; /* Session recorder; a gzFile, kept as
+                                         * void* to confine <zlib.h> to vte.cc.
+                                         * See pty_record(). */
+
+        /* Input-to-paint latency accounting: the arrival time of the oldest
+         * input applied to the screen model but not yet painted, and the
+         * last computed latency (for the VTE_DEBUG=latency overlay).  See
+         * note_input_arrival() callers and widget_draw(). */
+        gint64 m_input_latency_mark{0};
+        gint64 m_input_latency_last{0};
 
 	/* Queue of chunks of data read from the PTY.
          * Chunks are inserted at the back, and processed from the front.
          */
         std::queue<vte::base::Chunk::unique_type, std::list<vte::base::Chunk::unique_type>> m_incoming_queue;
 
+        /* Optional dedicated parsing thread; see parserthread.hh.
+         * When set (and the pty encoding is UTF-8), chunks are handed
+         * over to it instead of being decoded and parsed from
+         * process_incoming().
+         */
+        std::unique_ptr<vte::base::ParserThread> m_parser_thread{};
+
         vte::base::UTF8Decoder m_utf8_decoder;
         bool m_using_utf8{true};
         const char *m_encoding;            /* the pty's encoding */
@@ -354,12 +389,34 @@ public:
          * and means that this terminal is processing data.
          */
         GList *m_active_terminals_link;
+        /* The frame clock of our widget while realized. When set,
+         * processing is scheduled from the clock's "update" phase instead
+         * of the global process/update timeouts, so that each parsing
+         * pass finishes just before its frame is painted.
+         */
+        GdkFrameClock *m_frame_clock{nullptr};
+        gulong m_frame_clock_update_id{0};
+        /* Whether we called gdk_frame_clock_begin_updating(). */
+        bool m_frame_clock_updating{false};
+        bool m_in_destruction{false};  /* suppresses signal emission while the dtor runs */
         // FIXMEchpe should these two be g[s]size ?
         size_t m_input_bytes;
         glong m_max_input_bytes;
+        size_t m_input_backlog{0};  /* bytes read from the pty but not yet applied to the screen model */
+        bool m_input_paused{false}; /* reading stopped until the backlog drains, see process() */
 
 	/* Output data queue. */
-        VteByteArray *m_outgoing; /* pending input characters */
+        /* Pending bytes to write to the child, as a list of segments drained
+         * with writev() so that a partial write never has to memmove the
+         * remainder (multi-megabyte pastes used to go quadratic there). */
+        std::deque<vte::base::Chunk::unique_type> m_outgoing_queue;
+        size_t m_outgoing_start{0}; /* offset of the first unwritten byte in the front segment */
+        /* While m_outgoing_defer is set, connect_pty_write() only notes that
+         * a flush is wanted.  process_incoming() sets it for the duration of
+         * a pass so that the replies to a burst of query sequences coalesce
+         * into a single pty write. */
+        bool m_outgoing_defer{false};
+        bool m_outgoing_deferred{false};
 
 #ifdef WITH_ICONV
         /* Legacy charset support */
@@ -384,12 +441,27 @@ public:
                                       colors (fore, back, deco) but no other attributes,
                                       and the U+0000 character that denotes erased cells. */
 
+        /* Memo cache for reset-prefixed SGR sequences, whose outcome doesn't
+         * depend on the current attributes; see Terminal::SGR(). */
+        struct sgr_cache_entry {
+                unsigned int len{0};  /* 0 = unused entry */
+                uint32_t params[VTE_SGR_CACHE_MAX_PARAMS];
+                VteCellAttr attr;
+        };
+        sgr_cache_entry m_sgr_cache[VTE_SGR_CACHE_SIZE];
+        unsigned int m_sgr_cache_next{0};
+
         VteCharacterReplacement m_character_replacements[2];  /* charsets in the G0 and G1 slots */
         VteCharacterReplacement *m_character_replacement;     /* pointer to the active one */
 
         /* Word chars */
         std::string m_word_char_exceptions_string;
         std::u32string m_word_char_exceptions;
+        /* is_word_char() compiled into a two-level bitmap over the BMP;
+         * see compile_word_char_bitmap().  32 bytes (256 code points) per
+         * deduplicated page. */
+        std::vector<uint8_t> m_word_char_bitmap;
+        uint8_t m_word_char_pages[256]{};
 
 	/* Selection information. */
         gboolean m_selecting;
@@ -402,6 +474,7 @@ public:
 
 	/* Clipboard data information. */
         bool m_selection_owned[LAST_VTE_SELECTION];
+        bool m_selection_pending[LAST_VTE_SELECTION]; /* owned but text not built yet, see materialize_selection() */
         VteFormat m_selection_format[LAST_VTE_SELECTION];
         bool m_changing_selection;
         GString *m_selection[LAST_VTE_SELECTION];  // FIXMEegmont rename this so that m_selection_resolved can become m_selection?
@@ -415,9 +488,6 @@ public:
         gboolean m_audible_bell;
         gboolean m_allow_bold;
         gboolean m_bold_is_bright;
-        gboolean m_text_modified_flag;
-        gboolean m_text_inserted_flag;
-        gboolean m_text_deleted_flag;
         gboolean m_rewrap_on_resize;
 
 	/* Scrolling options. */
@@ -428,6 +498,15 @@ public:
         /* Restricted scrolling */
         struct vte_scrolling_region m_scrolling_region;     /* the region we scroll in */
         gboolean m_scrolling_restricted;
+        /* Cursor addressing context resolved from the scrolling region,
+         * origin mode and row count: the row offset applied in origin mode
+         * and the inclusive clamp bound.  Kept current by
+         * update_addressing_context() whenever any of those change, so the
+         * extremely frequent movement sequences only add and clamp. */
+        struct {
+                vte::grid::row_t origin{0};
+                vte::grid::row_t last_row{VTE_ROWS - 1};
+        } m_addressing;
 
 	/* Cursor shape, as set via API */
         VteCursorShape m_cursor_shape;
@@ -436,7 +515,7 @@ public:
 	/* Cursor blinking, as set in dconf. */
         VteCursorBlinkMode m_cursor_blink_mode;
         gboolean m_cursor_blink_state;
-        guint m_cursor_blink_tag;           /* cursor blinking timeout ID */
+        guint m_cursor_blink_tag;           /* nonzero while registered with the blink ticker */
         gint m_cursor_blink_cycle;          /* gtk-cursor-blink-time / 2 */
         gint m_cursor_blink_timeout;        /* gtk-cursor-blink-timeout */
         gboolean m_cursor_blinks;           /* whether the cursor is actually blinking */
@@ -448,7 +527,7 @@ public:
         gint m_text_blink_cycle;  /* gtk-cursor-blink-time / 2 */
         bool m_text_blink_state;  /* whether blinking text should be visible at this very moment */
         bool m_text_to_blink;     /* drawing signals here if it encounters any cell with blink attribute */
-        guint m_text_blink_tag;   /* timeout ID for redrawing due to blinking */
+        guint m_text_blink_tag;   /* nonzero while registered with the blink ticker */
 
         /* DECSCUSR cursor style (shape and blinking possibly overridden
          * via escape sequence) */
@@ -466,13 +545,48 @@ public:
          * the viewable area, and also want to catch in-cell movements if they make the pointer visible.
          */
         vte::view::coords m_mouse_last_position;
+        guint m_hover_update_source{0};  /* collapses hover re-evaluation to once per frame; see queue_hover_update() */
+
+        /* In-flight streaming paste; see widget_paste_received(). */
+        struct {
+                char* text{nullptr};  /* the full clipboard text, owned */
+                gsize length{0};
+                gsize offset{0};      /* next byte to convert */
+                guint source{0};
+                bool bracketed{false};
+        } m_paste;
+
+        /* Interactive resize debouncing; see queue_size_update(). */
+        guint m_resize_debounce_source{0};
+
+        /* Deferred font rebuild; see queue_ensure_font(). */
+        guint m_ensure_font_source{0};
+        long m_resize_pending_columns{-1};
+        long m_resize_pending_rows{-1};
         guint m_mouse_autoscroll_tag;
         double m_mouse_smooth_scroll_delta{0.0};
 
+        /* Debounced rewrapping of a large scrollback history, see screen_set_size(). */
+        guint m_deferred_rewrap_tag{0};
+
 	/* State variables for handling match checks. */
         char* m_match_contents;
         GArray* m_match_attributes;
         GArray* m_match_regexes;
+        /* Match spans of every dingu over the already-scanned lines of
+         * m_match_contents, so hover hit-testing within a line is a plain
+         * array walk. Cleared together with m_match_contents, and whenever
+         * the set of dingus changes. */
+        struct dingu_span {
+                gsize start, end;  /* offsets into m_match_contents; end exclusive */
+                int tag;
+        };
+        struct dingu_scanned_line {
+                gsize sattr, eattr;
+                guint spans_offset, n_spans;  /* span range in m_match_span_cache */
+        };
+        GArray* m_match_line_cache{nullptr};  /* of dingu_scanned_line */
+        GArray* m_match_span_cache{nullptr};  /* of dingu_span */
         char* m_match;
         int m_match_tag;
         /* If m_match non-null, then m_match_span contains the region of the match.
@@ -486,6 +600,37 @@ public:
         struct vte_regex_and_flags m_search_regex;
         gboolean m_search_wrap_around;
         GArray* m_search_attrs; /* Cache attrs */
+        GHashTable* m_search_result_cache{nullptr}; /* Paragraph start rows known
+                                                     * not to match; see
+                                                     * search_cache_store_nomatch() */
+
+        /* In-flight asynchronous search, see search_find_async(). The rows
+         * are positions within the two ranges search_find() scans (the
+         * primary one and, with wrap-around, the remainder). */
+        GTask* m_search_task{nullptr};
+        guint m_search_task_tag{0};
+        bool m_search_task_backward;
+        bool m_search_task_wrapped;
+        vte::grid::row_t m_search_task_row;
+        vte::grid::row_t m_search_task_limit;
+        vte::grid::row_t m_search_task_wrap_row;
+        vte::grid::row_t m_search_task_wrap_limit;
+        guint64 m_search_task_byteset;
+        pcre2_match_context_8* m_search_task_match_context{nullptr};
+        pcre2_match_data_8* m_search_task_match_data{nullptr};
+
+        /* Reusable match context, match data and JIT stack shared by hover
+         * matching and synchronous search; see ensure_match_context(). */
+        pcre2_match_context_8* m_match_context{nullptr};
+        pcre2_match_data_8* m_match_data{nullptr};
+        pcre2_jit_stack_8* m_jit_stack{nullptr};
+
+        /* In-flight asynchronous contents write, see write_contents_async(). */
+        GTask* m_write_contents_task{nullptr};
+        guint m_write_contents_task_tag{0};
+        GOutputStream* m_write_contents_stream{nullptr};
+        VteRing* m_write_contents_ring{nullptr};
+        VteRing::WriteContentsState m_write_contents_state;
 
 	/* Data used when rendering the text which does not require server
 	 * resources and which can be kept after unrealizing. */
@@ -540,6 +685,9 @@ public:
         bool m_clear_background{true};
 
         VtePaletteColor m_palette[VTE_PALETTE_SIZE];
+        /* Bumped whenever the effective colors change (palette edits,
+         * DECSCNM); the frame cache re-renders when it lags behind. */
+        guint64 m_color_generation{0};
 
 	/* Mouse cursors. */
         gboolean m_mouse_cursor_over_widget; /* as per enter and leave events */
@@ -557,8 +705,20 @@ public:
         /* Adjustment updates pending. */
         gboolean m_adjustment_changed_pending;
         gboolean m_adjustment_value_changed_pending;
-        gboolean m_cursor_moved_pending;
-        gboolean m_contents_changed_pending;
+        int m_scroll_direction{0};  /* sign of the last scroll_delta change, for thaw prefetch */
+        gint64 m_last_viewed{0};  /* when this terminal last painted; eviction order of the scrollback budget */
+
+        /* Bitmask of VTE_PENDING_* emissions queued for the next
+         * emit_pending_signals(). */
+        unsigned int m_pending_changes{0};
+
+        /* Damage range for the "contents-modified" signal: the absolute rows
+         * whose contents may have changed since the last emission, or -1/-1
+         * when nothing fine-grained was recorded (the emission then falls
+         * back to reporting the whole ring). */
+        vte::grid::row_t m_contents_damage_start{-1};
+        vte::grid::row_t m_contents_damage_end{-1};
+        guint64 m_contents_generation{0};
 
         std::string m_window_title{};
         std::string m_current_directory_uri{};
@@ -566,9 +726,6 @@ public:
         std::string m_window_title_pending{};
         std::string m_current_directory_uri_pending{};
         std::string m_current_file_uri_pending{};
-        bool m_window_title_changed{false};
-        bool m_current_directory_uri_changed{false};
-        bool m_current_file_uri_changed{false};
 
         std::vector<std::string> m_window_title_stack{};
 
@@ -577,7 +734,6 @@ public:
 
         /* Bell */
         int64_t m_bell_timestamp;
-        bool m_bell_pending{false};
 
 	/* Key modifiers. */
         guint m_modifiers;
@@ -613,6 +769,36 @@ public:
         const char *m_hyperlink_hover_uri; /* data is owned by the ring */
         long m_hyperlink_auto_id;
 
+        /* Cache of the last hyperlink_check() resolution. Applications
+         * typically call vte_terminal_hyperlink_check_event() on every
+         * motion event, and resolving a cell in a frozen scrollback row
+         * thaws that row from the stream each time. Valid as long as the
+         * pointer stays over the same cell and the contents don't change. */
+        vte::grid::row_t m_hyperlink_check_row{-1};  /* -1 if the cache is empty */
+        vte::grid::column_t m_hyperlink_check_col{-1};
+        char *m_hyperlink_check_uri{nullptr};  /* owned; nullptr if the cell has no hyperlink */
+
+        /* SIXEL graphics. The decoder is created on the first image and
+         * reused; the images are anchored to absolute ring rows and
+         * dropped when those rows leave the ring, see prune_images(). */
+        std::unique_ptr<vte::sixel::Context> m_sixel_context{};
+        std::vector<std::unique_ptr<vte::sixel::Image>> m_images{};
+
+        /* Retained frame cache: the last rendered frame, the region of it
+         * that is stale, and the state it was rendered against. The dirty
+         * region is kept in buffer-anchored pixel coordinates (view
+         * coordinates plus the scroll origin), so damage recorded before
+         * and after a scroll combines correctly. See widget_draw(). */
+        cairo_surface_t* m_frame_cache{nullptr};
+        cairo_surface_t* m_frame_cache_scratch{nullptr};
+        cairo_region_t* m_frame_cache_dirty{nullptr};
+        long m_frame_cache_origin{0};
+        int m_frame_cache_width{0};
+        int m_frame_cache_height{0};
+        int m_frame_cache_cell_height{0};
+        VteScreen const* m_frame_cache_screen{nullptr};
+        guint64 m_frame_cache_color_generation{0};
+
         /* RingView and friends */
         vte::base::RingView m_ringview;
         bool m_enable_bidi{true};
@@ -628,6 +814,10 @@ public:
                                        bool fill);
         /* inline */ VteRowData* ring_append(bool fill);
         /* inline */ void ring_remove(vte::grid::row_t position);
+        /* inline */ void ring_rotate(vte::grid::row_t start,
+                                      vte::grid::row_t end,
+                                      vte::grid::row_t amount,
+                                      bool fill);
         inline VteRowData const* find_row_data(vte::grid::row_t row) const;
         inline VteRowData* find_row_data_writable(vte::grid::row_t row) const;
         inline VteCell const* find_charcell(vte::grid::column_t col,
@@ -664,13 +854,18 @@ public:
         void insert_char(gunichar c,
                          bool insert,
                          bool invalidate_now);
+        void insert_text_run(gunichar const* chars,
+                             int n_chars);
 
         void invalidate_row(vte::grid::row_t row);
+        void invalidate_cursor_cells();
         void invalidate_rows(vte::grid::row_t row_start,
                              vte::grid::row_t row_end /* inclusive */);
         void invalidate_row_and_context(vte::grid::row_t row);
         void invalidate_rows_and_context(vte::grid::row_t row_start,
                                          vte::grid::row_t row_end /* inclusive */);
+        void contents_damaged(vte::grid::row_t row_start,
+                              vte::grid::row_t row_end /* inclusive */);
         void invalidate(vte::grid::span const& s);
         void invalidate_symmetrical_difference(vte::grid::span const& a, vte::grid::span const& b, bool block);
         void invalidate_match_span();
@@ -682,12 +877,30 @@ public:
 
         void reset_update_rects();
         bool invalidate_dirty_rects_and_process_updates();
+        double max_process_time() const;
         void time_process_incoming();
         void process_incoming();
         bool process(bool emit_adj_changed);
-        inline bool is_processing() const { return m_active_terminals_link != nullptr; }
+        inline bool is_processing() const { return m_active_terminals_link != nullptr ||
+                                                   m_frame_clock_updating ||
+                                                   m_background_timer != 0; }
         void start_processing();
 
+        /* Background throttle: while the widget is unmapped (e.g. a
+         * hidden notebook tab), pending input is processed in large
+         * batches on a slow timer instead of at frame rate, and the
+         * blink timers stay suspended; see widget_unmap(). */
+        bool m_widget_unmapped{false};
+        guint m_background_timer{0};
+        void background_schedule();
+        bool background_process();
+
+        void connect_frame_clock();
+        void disconnect_frame_clock();
+        bool frame_clock_schedule();
+        void frame_clock_unschedule();
+        void frame_clock_update();
+
         gssize get_preedit_width(bool left_only);
         gssize get_preedit_length(bool left_only);
 
@@ -745,6 +958,9 @@ public:
         void widget_copy(VteSelection sel,
                          VteFormat format);
         void widget_paste_received(char const* text);
+        void paste_slice();
+        void stop_paste();
+        void materialize_selection(VteSelection sel);
         void widget_clipboard_cleared(GtkClipboard *clipboard);
         void widget_clipboard_requested(GtkClipboard *target_clipboard,
                                         GtkSelectionData *data,
@@ -756,6 +972,7 @@ public:
         void widget_constructed();
         void widget_realize();
         void widget_unrealize();
+        void widget_map();
         void widget_unmap();
         void widget_style_updated();
         void widget_focus_in(GdkEventFocus *event);
@@ -829,11 +1046,22 @@ public:
         void pty_termios_changed();
         void pty_scroll_lock_changed(bool locked);
 
+        inline void note_input_arrival(vte::base::Chunk const* chunk)
+        {
+                if (G_UNLIKELY (chunk->arrival_time != 0 && m_input_latency_mark == 0))
+                        m_input_latency_mark = chunk->arrival_time;
+        }
+
+        void pty_record_open();
+        void pty_record(guint8 const* data,
+                        gsize length);
+
         void pty_channel_eof();
-        bool pty_io_read(GIOChannel *channel,
-                         GIOCondition condition);
-        bool pty_io_write(GIOChannel *channel,
-                          GIOCondition condition);
+        bool pty_io_read(GIOCondition condition);
+        bool pty_io_write(GIOCondition condition);
+
+        void outgoing_queue_append(guint8 const* data,
+                                   gsize length);
 
         void send_child(char const* data,
                         gssize length,
@@ -891,16 +1119,24 @@ public:
         void feed(char const* data,
                   gssize length,
                   bool start_processsing_ = true);
+        void feed_bytes(GBytes* bytes);
         void feed_child(char const *text,
                         gssize length);
         void feed_child_binary(guint8 const* data,
                                gsize length);
 
         bool is_word_char(gunichar c) const;
+        bool is_word_char_slow(gunichar c) const;
+        void compile_word_char_bitmap();
         bool is_same_class(vte::grid::column_t acol,
                            vte::grid::row_t arow,
                            vte::grid::column_t bcol,
                            vte::grid::row_t brow) const;
+        vte::grid::column_t same_class_run_start(VteRowData const* rowdata,
+                                                 vte::grid::column_t col) const;
+        vte::grid::column_t same_class_run_end(VteRowData const* rowdata,
+                                               vte::grid::column_t col,
+                                               vte::grid::column_t len) const;
 
         GString* get_text(vte::grid::row_t start_row,
                           vte::grid::column_t start_col,
@@ -908,7 +1144,12 @@ public:
                           vte::grid::column_t end_col,
                           bool block,
                           bool wrap,
-                          GArray* attributes = nullptr);
+                          GArray* attributes = nullptr,
+                          GString* text = nullptr);
+
+        GString* get_row_text(vte::grid::row_t row,
+                              GString* text = nullptr,
+                              GArray* attributes = nullptr);
 
         GString* get_text_displayed(bool wrap,
                                     GArray* attributes = nullptr);
@@ -964,6 +1205,8 @@ public:
         void reset_default_attributes(bool reset_hyperlink);
 
         void ensure_font();
+        void queue_ensure_font();
+        void ensure_font_debounce();
         void update_font();
         void apply_font_metrics(int cell_width,
                                 int cell_height,
@@ -976,6 +1219,9 @@ public:
                              long old_columns,
                              long old_rows,
                              bool do_rewrap);
+        void defer_rewrap();
+        void stop_deferred_rewrap();
+        void deferred_rewrap();
 
         void vadjustment_value_changed();
 
@@ -995,6 +1241,8 @@ public:
         void queue_adjustment_changed();
         void queue_adjustment_value_changed(double v);
         void queue_adjustment_value_changed_clamped(double v);
+        void prefetch_scrollback();
+        void enforce_scrollback_budget();
         void adjust_adjustments();
         void adjust_adjustments_full();
 
@@ -1011,6 +1259,7 @@ public:
         void emit_text_inserted();
         void emit_text_modified();
         void emit_text_scrolled(long delta);
+        void emit_output_activity_changed(bool active);
         void emit_pending_signals();
         void emit_char_size_changed(int width,
                                     int height);
@@ -1034,6 +1283,9 @@ public:
 
         void hyperlink_invalidate_and_get_bbox(vte::base::Ring::hyperlink_idx_t idx, GdkRectangle *bbox);
         void hyperlink_hilite_update();
+        void queue_hover_update();
+        void hover_update();
+        void hyperlink_check_cache_clear();
 
         void match_contents_clear();
         void match_contents_refresh();
@@ -1075,6 +1327,7 @@ public:
                                     gsize *eattr_ptr);
 
         pcre2_match_context_8 *create_match_context();
+        pcre2_match_context_8 *ensure_match_context();
         bool match_check_pcre(pcre2_match_data_8 *match_data,
                               pcre2_match_context_8 *match_context,
                               VteRegex *regex,
@@ -1087,6 +1340,16 @@ public:
                               gsize *end,
                               gsize *sblank_ptr,
                               gsize *eblank_ptr);
+        void match_span_cache_clear();
+        void match_scan_pcre(pcre2_match_data_8 *match_data,
+                             pcre2_match_context_8 *match_context,
+                             VteRegex *regex,
+                             guint32 match_flags,
+                             gsize sattr,
+                             gsize eattr,
+                             int tag);
+        void match_scan_line(gsize sattr,
+                             gsize eattr);
         char *match_check_internal_pcre(vte::grid::column_t column,
                                         vte::grid::row_t row,
                                         int *tag,
@@ -1126,9 +1389,25 @@ public:
                               vte::grid::row_t start_row,
                               vte::grid::row_t end_row,
                               bool backward);
+        guint64 search_pattern_byteset();
+        bool search_cache_lookup_nomatch(vte::grid::row_t row);
+        void search_cache_store_nomatch(vte::grid::row_t start_row,
+                                        vte::grid::row_t end_row);
+        void search_cache_clear();
         bool search_find(bool backward);
+        void search_find_async(bool backward,
+                               GCancellable* cancellable,
+                               GAsyncReadyCallback callback,
+                               void* user_data);
+        bool search_async_tick();
+        void finish_search_task(bool found,
+                                bool cancelled);
+        void stop_search_task();
         bool search_set_wrap_around(bool wrap);
 
+        void queue_size_update(long columns,
+                               long rows);
+        void resize_debounce();
         void set_size(long columns,
                       long rows);
 
@@ -1196,6 +1475,21 @@ public:
                                   VteWriteFlags flags,
                                   GCancellable *cancellable,
                                   GError **error);
+        bool write_snapshot_sync(GOutputStream* stream,
+                                 GCancellable* cancellable,
+                                 GError** error);
+        bool read_snapshot_sync(GInputStream* stream,
+                                GCancellable* cancellable,
+                                GError** error);
+        void write_contents_async(GOutputStream* stream,
+                                  VteWriteFlags flags,
+                                  GCancellable* cancellable,
+                                  GAsyncReadyCallback callback,
+                                  void* user_data);
+        bool write_contents_tick();
+        void finish_write_contents_task(GError* error,
+                                        bool cancelled);
+        void stop_write_contents_task();
 
         inline void ensure_cursor_is_onscreen();
         inline void home_cursor();
@@ -1225,12 +1519,13 @@ public:
         inline void clear_to_bol();
         inline void clear_below_current();
         inline void clear_to_eol();
-        inline void delete_character();
+        inline void delete_characters(long count);
         inline void set_cursor_column(vte::grid::column_t col);
         inline void set_cursor_column1(vte::grid::column_t col); /* 1-based */
         inline int get_cursor_column() const noexcept { return CLAMP(m_screen->cursor.col, 0, m_column_count - 1); }
         inline int get_cursor_column1() const noexcept { return get_cursor_column() + 1; }
         inline void set_cursor_row(vte::grid::row_t row /* relative to scrolling region */);
+        void update_addressing_context();
         inline void set_cursor_row1(vte::grid::row_t row /* relative to scrolling region */); /* 1-based */
         inline int get_cursor_row() const noexcept { return CLAMP(m_screen->cursor.row, 0, m_row_count - 1); }
         inline int get_cursor_row1() const noexcept { return get_cursor_row() + 1; }
@@ -1243,7 +1538,7 @@ public:
         inline void move_cursor_up(vte::grid::row_t rows);
         inline void move_cursor_down(vte::grid::row_t rows);
         inline void erase_characters(long count);
-        inline void insert_blank_character();
+        inline void insert_blank_characters(long count);
 
         template<unsigned int redbits, unsigned int greenbits, unsigned int bluebits>
         inline bool seq_parse_sgr_color(vte::parser::Sequence const& seq,
@@ -1299,6 +1594,9 @@ public:
                    std::initializer_list<int> params,
                    char const* format,
                    ...) noexcept G_GNUC_PRINTF(5, 6);
+        void reply_cached(std::string& cache,
+                          unsigned int type,
+                          std::initializer_list<int> params) noexcept;
 
         /* OSC handler helpers */
         bool get_osc_color_index(int osc,
@@ -1339,8 +1637,27 @@ public:
 
         void ringview_update();
 
+        void sixel_start(vte::parser::Sequence const& seq);
+        void paint_images(cairo_t* cr);
+        void prune_images();
+        void frame_cache_mark_dirty(cairo_rectangle_int_t const* rect);
+        void frame_cache_mark_all_dirty();
+        void frame_cache_drop();
+        bool frame_cache_prepare(cairo_t* cr,
+                                 int allocated_width,
+                                 int allocated_height);
+        void frame_cache_shift(long origin);
+        void frame_cache_render(int allocated_width,
+                                int allocated_height);
+        bool text_to_blink_in_viewport();
+
         /* Sequence handlers */
         bool m_line_wrapped; // signals line wrapped from character insertion
+
+        /* Whether the last insert_char()/insert_text_run() actually
+         * changed any cell; identical overwrites are suppressed, so a
+         * visually unchanged full-screen redraw causes no repaint. */
+        bool m_text_changed{false};
         // Note: inlining the handlers seems to worsen the performance, so we don't do that
 #define _VTE_CMD(cmd) \
 	/* inline */ void cmd (vte::parser::Sequence const& seq);
@@ -1370,3 +1687,7 @@ _vte_double_equal(double a,
 #define VTE_TEST_FLAG_DECRQCRA (G_GUINT64_CONSTANT(1) << 0)
 
 extern uint64_t g_test_flags;
+
+/* Defined in vtestream-file.h (with C linkage); see
+ * vte_set_scrollback_encryption(). */
+extern "C" gboolean _vte_scrollback_encryption_enabled;
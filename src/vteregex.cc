@@ -31,10 +31,13 @@
 
 #include "vteregexinternal.hh"
 
+#include <string.h>
+
 struct _VteRegex {
         volatile int ref_count;
         VteRegexPurpose purpose;
         pcre2_code_8 *code;
+        char *pattern; /* for refinement detection, see _vte_regex_get_pattern() */
 };
 
 #define DEFAULT_COMPILE_OPTIONS (PCRE2_UTF)
@@ -72,7 +75,9 @@ translate_flags(FlagTranslation const* const table,
 
 static VteRegex *
 regex_new(pcre2_code_8 *code,
-          VteRegexPurpose purpose)
+          VteRegexPurpose purpose,
+          const char *pattern,
+          gssize pattern_length)
 {
         VteRegex *regex;
 
@@ -80,6 +85,8 @@ regex_new(pcre2_code_8 *code,
         regex->ref_count = 1;
         regex->purpose = purpose;
         regex->code = code;
+        regex->pattern = g_strndup(pattern,
+                                   pattern_length >= 0 ? (gsize)pattern_length : strlen(pattern));
 
         return regex;
 }
@@ -88,6 +95,7 @@ static void
 regex_free(VteRegex *regex)
 {
         pcre2_code_free_8(regex->code);
+        g_free(regex->pattern);
         g_slice_free(VteRegex, regex);
 }
 
@@ -217,7 +225,7 @@ vte_regex_new(VteRegexPurpose purpose,
                 return NULL;
         }
 
-        return regex_new(code, purpose);
+        return regex_new(code, purpose, pattern, pattern_length);
 }
 
 VteRegex *
@@ -393,6 +401,15 @@ _vte_regex_get_pcre(VteRegex const* regex)
         return regex->code;
 }
 
+/* The pattern string the regex was compiled from */
+const char *
+_vte_regex_get_pattern(VteRegex const* regex)
+{
+        g_return_val_if_fail(regex != nullptr, nullptr);
+
+        return regex->pattern;
+}
+
 /**
  * vte_regex_jit:
  * @regex: a #VteRegex
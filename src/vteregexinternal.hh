@@ -31,6 +31,8 @@ guint32 _vte_regex_get_compile_flags (VteRegex *regex);
 
 const pcre2_code_8 *_vte_regex_get_pcre (VteRegex const* regex);
 
+const char *_vte_regex_get_pattern (VteRegex const* regex);
+
 /* GRegex translation */
 VteRegex *_vte_regex_new_gregex(VteRegexPurpose purpose,
                                 GRegex *gregex);
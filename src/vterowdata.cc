@@ -43,25 +43,67 @@ static_assert(std::is_trivially_move_assignable<VteCell>::value, "VteCell is not
 typedef struct _VteCells VteCells;
 struct _VteCells {
 	guint32 alloc_len;
-	VteCell cells[1];
+	union {
+		VteCell cells[1];
+		/* Freed arrays are chained through here; see _vte_cells_free(). */
+		VteCells *next_free;
+	} u;
 };
 
+/*
+ * Freed cell arrays are recycled instead of returned to malloc.
+ *
+ * Allocations are quantized to 2^k - 1 cells (see _vte_cells_alloc()),
+ * so freed arrays simply go on one free list per size class, keyed by
+ * that exponent.  The Ring churns row allocations constantly while
+ * scrolling; with the free lists the steady state never touches the
+ * allocator, and rows of the same terminal width all share one class.
+ */
+
+#define VTE_CELLS_MAX_FREE_PER_CLASS 256
+
+static VteCells *free_cells[sizeof (guint32) * 8];
+static guint free_cells_len[G_N_ELEMENTS (free_cells)];
+static struct {
+	guint64 hits;
+	guint64 misses;
+	guint64 free_bytes;
+} cells_arena_stats;
+
 static inline VteCells *
 _vte_cells_for_cell_array (VteCell *cells)
 {
 	if (G_UNLIKELY (!cells))
 		return NULL;
 
-	return (VteCells *) (((guchar *) cells) - G_STRUCT_OFFSET (VteCells, cells));
+	return (VteCells *) (((guchar *) cells) - G_STRUCT_OFFSET (VteCells, u.cells));
+}
+
+static inline gsize
+_vte_cells_size (guint32 alloc_len)
+{
+	return G_STRUCT_OFFSET (VteCells, u.cells) + alloc_len * sizeof (VteCell);
 }
 
 static VteCells *
-_vte_cells_realloc (VteCells *cells, guint32 len)
+_vte_cells_alloc (guint32 len)
 {
-	guint32 alloc_len = (1 << g_bit_storage (MAX (len, 80))) - 1;
+	guint klass = g_bit_storage (MAX (len, 80));
+	guint32 alloc_len = (1 << klass) - 1;
+	VteCells *cells;
+
+	cells = free_cells[klass];
+	if (G_LIKELY (cells)) {
+		free_cells[klass] = cells->u.next_free;
+		free_cells_len[klass]--;
+		cells_arena_stats.hits++;
+		cells_arena_stats.free_bytes -= _vte_cells_size (alloc_len);
+		return cells;
+	}
 
-	_vte_debug_print(VTE_DEBUG_RING, "Enlarging cell array of %d cells to %d cells\n", cells ? cells->alloc_len : 0, alloc_len);
-	cells = (VteCells *)g_realloc (cells, G_STRUCT_OFFSET (VteCells, cells) + alloc_len * sizeof (cells->cells[0]));
+	cells_arena_stats.misses++;
+	_vte_debug_print(VTE_DEBUG_RING, "Allocating new cell array of %d cells\n", alloc_len);
+	cells = (VteCells *)g_malloc (_vte_cells_size (alloc_len));
 	cells->alloc_len = alloc_len;
 
 	return cells;
@@ -70,10 +112,49 @@ _vte_cells_realloc (VteCells *cells, guint32 len)
 static void
 _vte_cells_free (VteCells *cells)
 {
+	guint klass = g_bit_storage (cells->alloc_len);
+
+	if (G_LIKELY (free_cells_len[klass] < VTE_CELLS_MAX_FREE_PER_CLASS)) {
+		cells->u.next_free = free_cells[klass];
+		free_cells[klass] = cells;
+		free_cells_len[klass]++;
+		cells_arena_stats.free_bytes += _vte_cells_size (cells->alloc_len);
+		return;
+	}
+
 	_vte_debug_print(VTE_DEBUG_RING, "Freeing cell array of %d cells\n", cells->alloc_len);
 	g_free (cells);
 }
 
+static VteCells *
+_vte_cells_realloc (VteCells *cells, guint32 len)
+{
+	VteCells *new_cells;
+
+	_vte_debug_print(VTE_DEBUG_RING, "Enlarging cell array of %d cells to fit %d cells\n", cells ? cells->alloc_len : 0, len);
+
+	new_cells = _vte_cells_alloc (len);
+	if (cells) {
+		memcpy (new_cells->u.cells, cells->u.cells, cells->alloc_len * sizeof (VteCell));
+		_vte_cells_free (cells);
+	}
+
+	return new_cells;
+}
+
+/* Report the free lists' hit rate and retained memory, for sizing
+ * VTE_CELLS_MAX_FREE_PER_CLASS. */
+void
+_vte_row_data_arena_stats (guint64 *hits, guint64 *misses, guint64 *free_bytes)
+{
+	if (hits)
+		*hits = cells_arena_stats.hits;
+	if (misses)
+		*misses = cells_arena_stats.misses;
+	if (free_bytes)
+		*free_bytes = cells_arena_stats.free_bytes;
+}
+
 
 /*
  * VteRowData: A row's data
@@ -111,48 +192,108 @@ _vte_row_data_ensure (VteRowData *row, gulong len)
 	if (G_UNLIKELY (len >= 0xFFFF))
 		return FALSE;
 
-	row->cells = _vte_cells_realloc (cells, len)->cells;
+	row->cells = _vte_cells_realloc (cells, len)->u.cells;
 
 	return TRUE;
 }
 
+/* Release a row's cell array back to the free lists when it is at least
+ * two size classes larger than @len requires; rows that once held a very
+ * long line would otherwise pin their widest-ever allocation for as long
+ * as they stay in the ring.  One class of slack avoids churning rows
+ * that hover near a class boundary.  The first @len cells are kept,
+ * unless a pending fill makes the array contents irrelevant. */
+static void
+_vte_row_data_shrink_alloc (VteRowData *row, gulong len)
+{
+	VteCells *cells = _vte_cells_for_cell_array (row->cells);
+	guint klass = g_bit_storage (MAX (len, 80));
+
+	if (G_LIKELY (!cells || g_bit_storage (cells->alloc_len) <= klass + 1))
+		return;
+
+	if (len == 0 || row->fill_pending) {
+		row->cells = NULL;
+	} else {
+		VteCells *new_cells = _vte_cells_alloc (len);
+		memcpy (new_cells->u.cells, cells->u.cells, len * sizeof (VteCell));
+		row->cells = new_cells->u.cells;
+	}
+	_vte_cells_free (cells);
+}
+
+/* Write out the cells of a pending _vte_row_data_clear_fill(). */
 void
-_vte_row_data_insert (VteRowData *row, gulong col, const VteCell *cell)
+_vte_row_data_materialize_fill (VteRowData *row)
+{
+	gulong i, len = row->len;
+
+	row->fill_pending = FALSE;
+	row->len = 0;
+	if (G_UNLIKELY (!_vte_row_data_ensure (row, len)))
+		return;
+
+	for (i = 0; i < len; i++)
+		row->cells[i] = row->fill_cell;
+
+	row->len = len;
+}
+
+/* Insert @count copies of @cell at @col, shifting the tail right in a
+ * single move; VteCell is trivially copyable (see the static_asserts
+ * above), so memmove relocates the cells. */
+void
+_vte_row_data_insert_cells (VteRowData *row, gulong col, const VteCell *cell, gulong count)
 {
 	gulong i;
 
-	if (G_UNLIKELY (!_vte_row_data_ensure (row, row->len + 1)))
+	_vte_row_data_materialize (row);
+
+	if (G_UNLIKELY (count == 0 || !_vte_row_data_ensure (row, row->len + count)))
 		return;
 
-	for (i = row->len; i > col; i--)
-		row->cells[i] = row->cells[i - 1];
+	if (col < row->len)
+		memmove (row->cells + col + count, row->cells + col,
+			 (row->len - col) * sizeof (VteCell));
 
-	row->cells[col] = *cell;
-	row->len++;
+	for (i = 0; i < count; i++)
+		row->cells[col + i] = *cell;
+
+	row->len += count;
+	row->attr.blink_maybe |= cell->attr.blink();
 }
 
 void _vte_row_data_append (VteRowData *row, const VteCell *cell)
 {
+	_vte_row_data_materialize (row);
+
 	if (G_UNLIKELY (!_vte_row_data_ensure (row, row->len + 1)))
 		return;
 
 	row->cells[row->len] = *cell;
 	row->len++;
+	row->attr.blink_maybe |= cell->attr.blink();
 }
 
-void _vte_row_data_remove (VteRowData *row, gulong col)
+/* Remove @count cells starting at @col, shifting the tail left in a
+ * single move. */
+void _vte_row_data_remove_cells (VteRowData *row, gulong col, gulong count)
 {
-	gulong i;
+	_vte_row_data_materialize (row);
 
-	for (i = col + 1; i < row->len; i++)
-		row->cells[i - 1] = row->cells[i];
+	if (G_UNLIKELY (col >= row->len))
+		return;
 
-	if (G_LIKELY (row->len))
-		row->len--;
+	count = MIN (count, row->len - col);
+	memmove (row->cells + col, row->cells + col + count,
+		 (row->len - col - count) * sizeof (VteCell));
+	row->len -= count;
 }
 
 void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len)
 {
+	_vte_row_data_materialize (row);
+
 	if (row->len < len) {
 		gulong i;
 
@@ -163,20 +304,56 @@ void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len)
 			row->cells[i] = *cell;
 
 		row->len = len;
+		row->attr.blink_maybe |= cell->attr.blink();
 	}
 }
 
+/* Clear the row to @len copies of @cell in O(1) time.  The cell writes are
+ * deferred until the row is next accessed, so rows that are erased and then
+ * erased again or promptly overwritten never pay for the fill.
+ */
+void _vte_row_data_clear_fill (VteRowData *row, const VteCell *cell, gulong len)
+{
+	if (G_UNLIKELY (len >= 0xFFFF)) {
+		/* What an eager fill would have left behind; see
+		 * _vte_row_data_ensure(). */
+		row->len = 0;
+		row->fill_pending = FALSE;
+		row->attr.blink_maybe = 0;
+		return;
+	}
+
+	row->len = len;
+	row->fill_pending = len != 0;
+	row->fill_cell = *cell;
+	/* The row now consists of @len copies of @cell, nothing else */
+	row->attr.blink_maybe = cell->attr.blink();
+
+	/* The array contents are dead now; drop a grossly oversized one. */
+	_vte_row_data_shrink_alloc (row, len);
+}
+
 void _vte_row_data_shrink (VteRowData *row, gulong max_len)
 {
-	if (max_len < row->len)
+	/* No need to materialize a pending fill; it just gets shorter. */
+	if (max_len < row->len) {
 		row->len = max_len;
+		_vte_row_data_shrink_alloc (row, max_len);
+	}
 }
 
 void _vte_row_data_copy (const VteRowData *src, VteRowData *dst)
 {
-        _vte_row_data_ensure (dst, src->len);
         dst->len = src->len;
         dst->attr = src->attr;
+        dst->fill_pending = src->fill_pending;
+        dst->fill_cell = src->fill_cell;
+
+        /* A pending fill is copied as such, keeping the copy O(1) too. */
+        if (G_UNLIKELY (src->fill_pending))
+                return;
+
+        _vte_row_data_ensure (dst, src->len);
         memcpy(dst->cells, src->cells, src->len * sizeof (src->cells[0]));
 }
 
@@ -185,6 +362,10 @@ guint16 _vte_row_data_nonempty_length (const VteRowData *row)
 {
         guint16 len;
         const VteCell *cell;
+
+        if (G_UNLIKELY (row->fill_pending))
+                return (row->fill_cell.attr.fragment() || row->fill_cell.c != 0) ? row->len : 0;
+
         for (len = row->len; len > 0; len--) {
                 cell = &row->cells[len - 1];
                 if (cell->attr.fragment() || cell->c != 0)
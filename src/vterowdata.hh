@@ -38,6 +38,13 @@ G_BEGIN_DECLS
 typedef struct _VteRowAttr {
         guint8 soft_wrapped  : 1;
         guint8 bidi_flags    : 4;
+        /* Whether any cell in the row may carry the blink attribute.
+         * A conservative summary maintained by the cell writers and
+         * cleared with the row: false positives are possible until the
+         * row is cleared or verified, false negatives are not.  Lets
+         * the draw path decide text-blink timer arming per row instead
+         * of per cell. */
+        guint8 blink_maybe   : 1;
 } VteRowAttr;
 static_assert(sizeof (VteRowAttr) == 1, "VteRowAttr has wrong size");
 
@@ -49,17 +56,36 @@ typedef struct _VteRowData {
 	VteCell *cells;
 	guint16 len;
 	VteRowAttr attr;
+	/* Whether the cell array is stale: the row was cleared with
+	 * _vte_row_data_clear_fill() and logically consists of @len
+	 * copies of @fill_cell that haven't been written out yet. */
+	guint8 fill_pending;
+	VteCell fill_cell;
 } VteRowData;
 
 
 #define _vte_row_data_length(__row)			((__row)->len + 0)
 
+void _vte_row_data_materialize_fill (VteRowData *row);
+
+/* Write out a pending lazy clear (see _vte_row_data_clear_fill()) so that
+ * the cell array matches the row's length again.  Must be called before
+ * accessing row->cells directly.  Logically const: the row's contents are
+ * unchanged. */
+static inline void
+_vte_row_data_materialize (const VteRowData *row)
+{
+	if (G_UNLIKELY (row->fill_pending))
+		_vte_row_data_materialize_fill ((VteRowData *) row);
+}
+
 static inline const VteCell *
 _vte_row_data_get (const VteRowData *row, gulong col)
 {
 	if (G_UNLIKELY (row->len <= col))
 		return NULL;
 
+	_vte_row_data_materialize (row);
 	return &row->cells[col];
 }
 
@@ -69,18 +95,21 @@ _vte_row_data_get_writable (VteRowData *row, gulong col)
 	if (G_UNLIKELY (row->len <= col))
 		return NULL;
 
+	_vte_row_data_materialize (row);
 	return &row->cells[col];
 }
 
 void _vte_row_data_init (VteRowData *row);
 void _vte_row_data_clear (VteRowData *row);
 void _vte_row_data_fini (VteRowData *row);
-void _vte_row_data_insert (VteRowData *row, gulong col, const VteCell *cell);
+void _vte_row_data_insert_cells (VteRowData *row, gulong col, const VteCell *cell, gulong count);
 void _vte_row_data_append (VteRowData *row, const VteCell *cell);
-void _vte_row_data_remove (VteRowData *row, gulong col);
+void _vte_row_data_remove_cells (VteRowData *row, gulong col, gulong count);
 void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len);
+void _vte_row_data_clear_fill (VteRowData *row, const VteCell *cell, gulong len);
 void _vte_row_data_shrink (VteRowData *row, gulong max_len);
 void _vte_row_data_copy (const VteRowData *src, VteRowData *dst);
 guint16 _vte_row_data_nonempty_length (const VteRowData *row);
+void _vte_row_data_arena_stats (guint64 *hits, guint64 *misses, guint64 *free_bytes);
 
 G_END_DECLS
@@ -62,9 +62,8 @@ vte::parser::Sequence::print() const noexcept
                 g_printerr(" ]");
         }
         if (m_seq->type == VTE_SEQ_OSC) {
-                char* str = string_param();
-                g_printerr(" \"%s\"", str);
-                g_free(str);
+                auto const str = string();
+                g_printerr(" \"%.*s\"", (int)str.size(), str.data());
         }
         g_printerr("\n");
 #endif
@@ -110,60 +109,6 @@ vte::parser::Sequence::command_string() const
         }
 }
 
-// FIXMEchpe optimise this
-std::string
-vte::parser::Sequence::string_utf8() const noexcept
-{
-        std::string str;
-
-        size_t len;
-        auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-
-        char u[6];
-        for (size_t i = 0; i < len; ++i) {
-                auto ulen = g_unichar_to_utf8(buf[i], u);
-                str.append((char const*)u, ulen);
-        }
-
-        return str;
-}
-
-/* A couple are duplicated from vte.c, to keep them static... */
-
-/* Check how long a string of unichars is.  Slow version. */
-static gsize
-vte_unichar_strlen(gunichar const* c)
-{
-	gsize i;
-	for (i = 0; c[i] != 0; i++) ;
-	return i;
-}
-
-/* Convert a wide character string to a multibyte string */
-/* Simplified from glib's g_ucs4_to_utf8() to simply allocate the maximum
- * length instead of walking the input twice.
- */
-char*
-vte::parser::Sequence::ucs4_to_utf8(gunichar const* str,
-                                    ssize_t len) const noexcept
-{
-        if (len < 0)
-                len = vte_unichar_strlen(str);
-        auto outlen = (len * VTE_UTF8_BPC) + 1;
-
-        auto result = (char*)g_try_malloc(outlen);
-        if (result == nullptr)
-                return nullptr;
-
-        auto end = str + len;
-        auto p = result;
-        for (auto i = str; i < end; i++)
-                p += g_unichar_to_utf8(*i, p);
-        *p = '\0';
-
-        return result;
-}
-
 namespace vte {
 namespace terminal {
 
@@ -282,6 +227,32 @@ Terminal::home_cursor()
 void
 Terminal::clear_screen()
 {
+        /* The alternate screen has no scrollback to preserve: clear the
+         * existing rows in place instead of scrolling a screenful of
+         * fresh rows in.  Apps that bounce between the screens (pagers,
+         * fzf popups) clear on every entry, so keep the row storage
+         * pooled rather than churning the ring. */
+        if (m_screen == &m_alternate_screen) {
+                auto const delta = m_screen->insert_delta;
+                for (auto i = 0; i < m_row_count; i++) {
+                        VteRowData *rowdata;
+                        if (_vte_ring_next(m_screen->row_data) > delta + i)
+                                rowdata = _vte_ring_index_writable(m_screen->row_data, delta + i);
+                        else
+                                rowdata = ring_append(false);
+                        /* Clear it to a full row of default cells, lazily. */
+                        _vte_row_data_clear_fill (rowdata, &m_color_defaults, m_column_count);
+                        set_hard_wrapped(delta + i);
+                        rowdata->attr.bidi_flags = get_bidi_flags();
+                }
+                adjust_adjustments();
+                /* Redraw everything. */
+                invalidate_all();
+                /* We've modified the display.  Make a note of it. */
+                m_pending_changes |= VTE_PENDING_TEXT_DELETED;
+                return;
+        }
+
         auto row = m_screen->cursor.row - m_screen->insert_delta;
         auto initial = _vte_ring_next(m_screen->row_data);
 	/* Add a new screen's worth of rows. */
@@ -295,7 +266,7 @@ Terminal::clear_screen()
 	/* Redraw everything. */
         invalidate_all();
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 /* Clear the current line. */
@@ -310,10 +281,8 @@ Terminal::clear_current_line()
 		/* Get the data for the row which the cursor points to. */
                 rowdata = _vte_ring_index_writable(m_screen->row_data, m_screen->cursor.row);
 		g_assert(rowdata != NULL);
-		/* Remove it. */
-		_vte_row_data_shrink (rowdata, 0);
-		/* Add enough cells to the end of the line to fill out the row. */
-                _vte_row_data_fill (rowdata, &m_color_defaults, m_column_count);
+		/* Clear it to a full row of default cells, lazily. */
+                _vte_row_data_clear_fill (rowdata, &m_color_defaults, m_column_count);
                 set_hard_wrapped(m_screen->cursor.row);
                 rowdata->attr.bidi_flags = get_bidi_flags();
                 /* Repaint this row's paragraph (might need to extend upwards). */
@@ -321,7 +290,7 @@ Terminal::clear_current_line()
 	}
 
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 /* Clear above the current line. */
@@ -338,10 +307,8 @@ Terminal::clear_above_current()
 			/* Get the data for the row we're erasing. */
                         auto rowdata = _vte_ring_index_writable(m_screen->row_data, i);
 			g_assert(rowdata != NULL);
-			/* Remove it. */
-			_vte_row_data_shrink (rowdata, 0);
-			/* Add new cells until we fill the row. */
-                        _vte_row_data_fill (rowdata, &m_color_defaults, m_column_count);
+			/* Clear it to a full row of default cells, lazily. */
+                        _vte_row_data_clear_fill (rowdata, &m_color_defaults, m_column_count);
                         set_hard_wrapped(i);
                         rowdata->attr.bidi_flags = get_bidi_flags();
 		}
@@ -350,7 +317,7 @@ Terminal::clear_above_current()
          * invalidating the context lines if necessary. */
         invalidate_rows(m_screen->insert_delta, m_screen->cursor.row - 1);
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 /* Scroll the text, but don't move the cursor.  Negative = up, positive = down. */
@@ -370,11 +337,9 @@ Terminal::scroll_text(vte::grid::row_t scroll_amount)
                 ring_append(false);
 
 	if (scroll_amount > 0) {
-                /* Scroll down. */
-		for (auto i = 0; i < scroll_amount; i++) {
-                        ring_remove(end);
-                        ring_insert(start, true);
-		}
+                /* Scroll down: rotate the region in one pass instead of
+                 * removing and inserting a row per line scrolled. */
+                ring_rotate(start, end, scroll_amount, true);
                 /* Set the boundaries to hard wrapped where we tore apart the contents.
                  * Need to do it after scrolling down, for the end row to be the desired one. */
                 set_hard_wrapped(start - 1);
@@ -385,10 +350,7 @@ Terminal::scroll_text(vte::grid::row_t scroll_amount)
                 set_hard_wrapped(start - 1);
                 set_hard_wrapped(end);
                 /* Scroll up. */
-		for (auto i = 0; i < -scroll_amount; i++) {
-                        ring_remove(start);
-                        ring_insert(end, true);
-		}
+                ring_rotate(start, end, scroll_amount, true);
 	}
 
         /* Repaint the affected lines. No need to extend, set_hard_wrapped() took care of
@@ -399,8 +361,8 @@ Terminal::scroll_text(vte::grid::row_t scroll_amount)
         adjust_adjustments();
 
 	/* We've modified the display.  Make a note of it. */
-        m_text_inserted_flag = TRUE;
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_INSERTED;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 void
@@ -432,16 +394,20 @@ Terminal::switch_screen(VteScreen *new_screen)
          * wouldn't make sense and could lead to crashes.
          * Ideally we'd carry the target URI itself, but I'm just lazy.
          * Also, run a GC before we switch away from that screen. */
+        auto const had_hover_uri = m_hyperlink_hover_uri != NULL;
         m_hyperlink_hover_idx = _vte_ring_get_hyperlink_at_position(m_screen->row_data, -1, -1, true, NULL);
         g_assert (m_hyperlink_hover_idx == 0);
         m_hyperlink_hover_uri = NULL;
-        emit_hyperlink_hover_uri_changed(NULL);  /* FIXME only emit if really changed */
+        if (had_hover_uri)
+                emit_hyperlink_hover_uri_changed(NULL);
         m_defaults.attr.hyperlink_idx = _vte_ring_get_hyperlink_idx(m_screen->row_data, NULL);
         g_assert (m_defaults.attr.hyperlink_idx == 0);
 
         /* cursor.row includes insert_delta, adjust accordingly */
         auto cr = m_screen->cursor.row - m_screen->insert_delta;
         m_screen = new_screen;
+        /* Cached search verdicts are per screen. */
+        search_cache_clear();
         m_screen->cursor.row = cr + m_screen->insert_delta;
 
         /* Make sure the ring is large enough */
@@ -538,10 +504,14 @@ Terminal::set_mode_private(int mode,
                 break;
 
         case vte::terminal::modes::Private::eDEC_REVERSE_IMAGE:
+                /* Reverse video is applied at draw time in
+                 * determine_colors(); just repaint with the new sense. */
+                m_color_generation++;
                 invalidate_all();
                 break;
 
         case vte::terminal::modes::Private::eDEC_ORIGIN:
+                update_addressing_context();
                 /* Reposition the cursor in its new home position. */
                 home_cursor();
                 break;
@@ -577,9 +547,11 @@ Terminal::set_mode_private(int mode,
                                 restore_cursor();
                 }
 
-                /* Reset scrollbars and repaint everything. */
-                gtk_adjustment_set_value(m_vadjustment,
-                                         m_screen->scroll_delta);
+                /* Reset scrollbars and repaint everything.  No synchronous
+                 * gtk_adjustment_set_value() here: set_scrollback_lines()
+                 * re-clamps the rings and force-queues the new scroll
+                 * position, so a quick bounce between the screens
+                 * coalesces into a single adjustment update. */
                 set_scrollback_lines(m_scrollback_lines);
                 queue_contents_changed();
                 invalidate_all();
@@ -719,7 +691,7 @@ Terminal::clear_to_bol()
         invalidate_row_and_context(m_screen->cursor.row);
 
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 /* Clear to the right of the cursor and below the current line. */
@@ -767,7 +739,10 @@ Terminal::clear_below_current()
 		}
 		/* Pad out the row. */
                 if (not_default_bg) {
-                        _vte_row_data_fill(rowdata, &m_color_defaults, m_column_count);
+                        if (i == m_screen->cursor.row)
+                                _vte_row_data_fill(rowdata, &m_color_defaults, m_column_count);
+                        else
+                                _vte_row_data_clear_fill(rowdata, &m_color_defaults, m_column_count);
 		}
                 set_hard_wrapped(i);
                 if (i > m_screen->cursor.row)
@@ -777,7 +752,7 @@ Terminal::clear_below_current()
         invalidate_rows_and_context(m_screen->cursor.row, m_screen->insert_delta + m_row_count - 1);
 
 	/* We've modified the display.  Make a note of it. */
-	m_text_deleted_flag = TRUE;
+	m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 /* Clear from the cursor position to the end of the line. */
@@ -802,7 +777,7 @@ Terminal::clear_to_eol()
                  * is the end of the array. */
                 _vte_row_data_shrink(rowdata, m_screen->cursor.col);
 		/* We've modified the display.  Make a note of it. */
-		m_text_deleted_flag = TRUE;
+		m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 	}
         bool const not_default_bg = (m_color_defaults.attr.back() != VTE_DEFAULT_BG);
 
@@ -845,19 +820,29 @@ Terminal::set_cursor_column1(vte::grid::column_t col)
 void
 Terminal::set_cursor_row(vte::grid::row_t row)
 {
-        vte::grid::row_t start_row, end_row;
+        row += m_addressing.origin;
+        row = CLAMP(row, m_addressing.origin, m_addressing.last_row);
+
+        m_screen->cursor.row = row + m_screen->insert_delta;
+}
+
+/*
+ * Terminal::update_addressing_context:
+ *
+ * Re-resolves m_addressing.  Must be called whenever the scrolling region,
+ * the origin mode or the row count changes.
+ */
+void
+Terminal::update_addressing_context()
+{
         if (m_modes_private.DEC_ORIGIN() &&
             m_scrolling_restricted) {
-                start_row = m_scrolling_region.start;
-                end_row = m_scrolling_region.end;
+                m_addressing.origin = m_scrolling_region.start;
+                m_addressing.last_row = m_scrolling_region.end;
         } else {
-                start_row = 0;
-                end_row = m_row_count - 1;
+                m_addressing.origin = 0;
+                m_addressing.last_row = m_row_count - 1;
         }
-        row += start_row;
-        row = CLAMP(row, start_row, end_row);
-
-        m_screen->cursor.row = row + m_screen->insert_delta;
 }
 
 void
@@ -915,9 +900,9 @@ Terminal::set_cursor_coords1(vte::grid::row_t row,
         set_cursor_row1(row);
 }
 
-/* Delete a character at the current cursor position. */
+/* Delete characters at the current cursor position. */
 void
-Terminal::delete_character()
+Terminal::delete_characters(long count)
 {
 	VteRowData *rowdata;
 	long col;
@@ -938,15 +923,15 @@ Terminal::delete_character()
                         len = m_column_count;
                 }
 
-		/* Remove the column. */
+		/* Remove the columns in one span. */
 		if (col < len) {
+                        count = MIN(count, len - col);
                         /* Clean up Tab/CJK fragments. */
-                        cleanup_fragments(col, col + 1);
-			_vte_row_data_remove (rowdata, col);
+                        cleanup_fragments(col, col + count);
+			_vte_row_data_remove_cells (rowdata, col, count);
 
                         if (not_default_bg) {
                                 _vte_row_data_fill(rowdata, &m_color_defaults, m_column_count);
-                                len = m_column_count;
 			}
                         set_hard_wrapped(m_screen->cursor.row);
                         /* Repaint this row's paragraph. */
@@ -955,7 +940,7 @@ Terminal::delete_character()
 	}
 
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 void
@@ -1013,18 +998,36 @@ Terminal::erase_characters(long count)
 	}
 
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
-/* Insert a blank character. */
+/* Insert blank characters at the cursor position, shifting the tail of
+ * the row right in one go. The cursor does not move. */
 void
-Terminal::insert_blank_character()
+Terminal::insert_blank_characters(long count)
 {
         ensure_cursor_is_onscreen();
 
-        auto save = m_screen->cursor;
-        insert_char(' ', true, true);
-        m_screen->cursor = save;
+        auto row = ensure_cursor();
+        g_assert(row != NULL);
+        auto const col = m_screen->cursor.col;
+
+        /* Clean up a Tab/CJK fragment straddling the insertion point. */
+        cleanup_fragments(col, col);
+
+        auto cell = m_defaults;
+        cell.c = ' ';
+        cell.attr.set_columns(1);
+        _vte_row_data_insert_cells (row, col, &cell, count);
+
+        if (_vte_row_data_length (row) > m_column_count)
+                cleanup_fragments(m_column_count, _vte_row_data_length (row));
+        _vte_row_data_shrink (row, m_column_count);
+
+        invalidate_row_and_context(m_screen->cursor.row);
+
+	/* We added text, so make a note of it. */
+	m_pending_changes |= VTE_PENDING_TEXT_INSERTED;
 }
 
 void
@@ -1099,6 +1102,16 @@ Terminal::move_cursor_tab_forward(int count)
 
         VteRowData *rowdata = ensure_row();
         auto const old_len = _vte_row_data_length (rowdata);
+
+        if ((glong)newcol <= old_len) {
+                /* All the cells we tab over exist already, so nothing in
+                 * the row changes: this is a pure cursor move.  The cursor
+                 * repaint is taken care of at the end of the processing
+                 * pass. */
+                m_screen->cursor.col = newcol;
+                return;
+        }
+
         _vte_row_data_fill (rowdata, &basic_cell, newcol);
 
         /* Insert smart tab if there's nothing in the line after
@@ -1283,7 +1296,7 @@ Terminal::erase_in_display(vte::parser::Sequence const& seq)
 		break;
 	}
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 void
@@ -1311,13 +1324,13 @@ Terminal::erase_in_line(vte::parser::Sequence const& seq)
 		break;
 	}
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 void
 Terminal::insert_lines(vte::grid::row_t param)
 {
-        vte::grid::row_t end, i;
+        vte::grid::row_t end;
 
 	/* Find the region we're messing with. */
         auto row = m_screen->cursor.row;
@@ -1333,12 +1346,9 @@ Terminal::insert_lines(vte::grid::row_t param)
         auto limit = end - row + 1;
         param = MIN (param, limit);
 
-	for (i = 0; i < param; i++) {
-		/* Clear a line off the end of the region and add one to the
-		 * top of the region. */
-                ring_remove(end);
-                ring_insert(row, true);
-	}
+	/* Clear param lines off the end of the region and add that many
+	 * to the top of the region, in a single rotation. */
+        ring_rotate(row, end, param, true);
 
         /* Set the boundaries to hard wrapped where we tore apart the contents.
          * Need to do it after scrolling down, for the end row to be the desired one. */
@@ -1353,13 +1363,13 @@ Terminal::insert_lines(vte::grid::row_t param)
 	/* Adjust the scrollbars if necessary. */
         adjust_adjustments();
 	/* We've modified the display.  Make a note of it. */
-        m_text_inserted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_INSERTED;
 }
 
 void
 Terminal::delete_lines(vte::grid::row_t param)
 {
-        vte::grid::row_t end, i;
+        vte::grid::row_t end;
 
 	/* Find the region we're messing with. */
         auto row = m_screen->cursor.row;
@@ -1380,13 +1390,10 @@ Terminal::delete_lines(vte::grid::row_t param)
         auto limit = end - row + 1;
         param = MIN (param, limit);
 
-	/* Clear them from below the current cursor. */
-	for (i = 0; i < param; i++) {
-		/* Insert a line at the end of the region and remove one from
-		 * the top of the region. */
-                ring_remove(row);
-                ring_insert(end, true);
-	}
+	/* Clear them from below the current cursor: insert param lines at
+	 * the end of the region and remove that many from the top of the
+	 * region, in a single rotation. */
+        ring_rotate(row, end, -param, true);
         m_screen->cursor.col = 0;
 
         /* Repaint the affected lines. No need to extend, set_hard_wrapped() took care of
@@ -1395,7 +1402,7 @@ Terminal::delete_lines(vte::grid::row_t param)
 	/* Adjust the scrollbars if necessary. */
         adjust_adjustments();
 	/* We've modified the display.  Make a note of it. */
-        m_text_deleted_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_DELETED;
 }
 
 bool
@@ -1563,7 +1570,7 @@ Terminal::set_current_directory_uri(vte::parser::Sequence const& seq,
         }
 
         m_current_directory_uri_pending.swap(uri);
-        m_current_directory_uri_changed = true;
+        m_pending_changes |= VTE_PENDING_CURRENT_DIRECTORY_URI;
 }
 
 void
@@ -1586,7 +1593,7 @@ Terminal::set_current_file_uri(vte::parser::Sequence const& seq,
         }
 
         m_current_file_uri_pending.swap(uri);
-        m_current_file_uri_changed = true;
+        m_pending_changes |= VTE_PENDING_CURRENT_FILE_URI;
 }
 
 void
@@ -1722,7 +1729,7 @@ Terminal::ACK(vte::parser::Sequence const& seq)
          *             ECMA-16 § 3.1.6
          */
 
-        m_bell_pending = true;
+        m_pending_changes |= VTE_PENDING_BELL;
 }
 
 void
@@ -1838,7 +1845,7 @@ Terminal::BEL(vte::parser::Sequence const& seq)
          * References: ECMA-48 § 8.3.3
          */
 
-        m_bell_pending = true;
+        m_pending_changes |= VTE_PENDING_BELL;
 }
 
 void
@@ -2395,7 +2402,8 @@ Terminal::DA1(vte::parser::Sequence const& seq)
         if (seq.collect1(0, 0) != 0)
                 return;
 
-        reply(seq, VTE_REPLY_DECDA1R, {65, 1, 9});
+        static std::string da1_reply;
+        reply_cached(da1_reply, VTE_REPLY_DECDA1R, {65, 1, 4, 9});
 }
 
 void
@@ -2425,7 +2433,8 @@ Terminal::DA2(vte::parser::Sequence const& seq)
                 return;
 
         int const version = (VTE_MAJOR_VERSION * 100 + VTE_MINOR_VERSION) * 100 + VTE_MICRO_VERSION;
-        reply(seq, VTE_REPLY_DECDA2R, {65, version, 1});
+        static std::string da2_reply;
+        reply_cached(da2_reply, VTE_REPLY_DECDA2R, {65, version, 1});
 }
 
 void
@@ -2446,7 +2455,8 @@ Terminal::DA3(vte::parser::Sequence const& seq)
         if (seq.collect1(0, 0) != 0)
                 return;
 
-        reply(seq, VTE_REPLY_DECRPTUI, {});
+        static std::string da3_reply;
+        reply_cached(da3_reply, VTE_REPLY_DECRPTUI, {});
 }
 
 void
@@ -2545,10 +2555,7 @@ Terminal::DCH(vte::parser::Sequence const& seq)
 
         auto const value = seq.collect1(0, 1, 1, int(m_column_count - m_screen->cursor.col));
 
-        // FIXMEchpe pass count to delete_character() and simplify
-        // to only cleanup fragments once
-        for (auto i = 0; i < value; i++)
-                delete_character();
+        delete_characters(value);
 }
 
 void
@@ -2607,7 +2614,7 @@ Terminal::DECALN(vte::parser::Sequence const& seq)
         invalidate_all();
 
 	/* We modified the display, so make a note of it for completeness. */
-        m_text_modified_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_MODIFIED;
 }
 
 void
@@ -3739,7 +3746,7 @@ Terminal::DECRQSS(vte::parser::Sequence const& seq)
         auto const str = seq.string();
         size_t i;
         for (i = 0; i < str.size(); ++i) {
-                auto const c = str[i];
+                auto const c = (unsigned char)str[i];
                 if (c < 0x20 || c >= 0x7f)
                         break;
                 rv = parser.feed(c);
@@ -4333,14 +4340,69 @@ Terminal::DECSGR(vte::parser::Sequence const& seq)
         /* TODO: consider implementing sub/superscript? */
 }
 
+/*
+ * Set up the SIXEL decoder from the DCS parameters. The data characters
+ * follow one by one as %VTE_SEQ_SIXEL_DATA (see parser_dcs_collect());
+ * DECSIXEL() below commits the image at the string terminator.
+ */
+void
+Terminal::sixel_start(vte::parser::Sequence const& seq)
+{
+        if (!m_sixel_context)
+                m_sixel_context = std::make_unique<vte::sixel::Context>();
+
+        /* P2 == 1: zero sixels leave the background visible; any other
+         * value fills them with color register 0. An aborted earlier
+         * image (CAN/SUB/ESC before the terminator) is discarded here. */
+        m_sixel_context->start(seq.collect1(1, 0) == 1);
+}
+
 void
 Terminal::DECSIXEL(vte::parser::Sequence const& seq)
 {
         /*
          * DECSIXEL - SIXEL graphics
          *
+         * Arguments:
+         *   args[0]: pixel aspect ratio (unsupported)
+         *   args[1]: how to paint zero sixels, see sixel_start()
+         *   args[2]: horizontal grid size (ignored)
+         *
          * References: VT330
          */
+
+        if (m_sixel_context == nullptr || !m_sixel_context->active())
+                return;
+
+        int width, height;
+        auto surface = m_sixel_context->finish(&width, &height);
+        if (surface == nullptr)
+                return;
+
+        if (m_cell_width <= 0 || m_cell_height <= 0) {
+                cairo_surface_destroy(surface);
+                return;
+        }
+
+        auto image = std::make_unique<vte::sixel::Image>(surface, width, height);
+        image->left_column = m_screen->cursor.col;
+        image->top_row = m_screen->cursor.row;
+        image->columns = (width + m_cell_width - 1) / m_cell_width;
+        image->rows = (height + m_cell_height - 1) / m_cell_height;
+        image->screen = m_screen;
+
+        auto const top_row = image->top_row;
+        auto const rows = image->rows;
+
+        m_images.push_back(std::move(image));
+        prune_images();
+
+        /* Move the cursor below the image, scrolling as needed; the
+         * image stays anchored to the rows it was printed onto. */
+        for (auto i = 0l; i < rows; ++i)
+                cursor_down(false);
+
+        invalidate_rows(top_row, top_row + rows - 1);
 }
 
 void
@@ -4769,6 +4831,7 @@ Terminal::DECSTBM(vte::parser::Sequence const& seq)
         if (start > m_row_count ||
             end <= start) {
                 m_scrolling_restricted = FALSE;
+                update_addressing_context();
                 home_cursor();
                 return;
         }
@@ -4789,6 +4852,7 @@ Terminal::DECSTBM(vte::parser::Sequence const& seq)
                 while (_vte_ring_next(m_screen->row_data) < m_screen->insert_delta + m_row_count)
                         _vte_ring_insert(m_screen->row_data, _vte_ring_next(m_screen->row_data), get_bidi_flags());
 	}
+        update_addressing_context();
 
         home_cursor();
 }
@@ -5966,9 +6030,7 @@ Terminal::ICH(vte::parser::Sequence const& seq)
 
         auto const count = seq.collect1(0, 1, 1, int(m_column_count - m_screen->cursor.col));
 
-        /* TODOegmont: Insert them in a single run, so that we call cleanup_fragments only once. */
-        for (auto i = 0; i < count; i++)
-                insert_blank_character();
+        insert_blank_characters(count);
 }
 
 void
@@ -6402,7 +6464,7 @@ Terminal::OSC(vte::parser::Sequence const& seq)
          * First, extract the number.
          */
 
-        auto str = seq.string_utf8();
+        auto const str = seq.string();
         vte::parser::StringTokeniser tokeniser{str, ';'};
         auto it = tokeniser.cbegin();
         int osc;
@@ -6434,7 +6496,7 @@ Terminal::OSC(vte::parser::Sequence const& seq)
                     it.size_remaining() < VTE_WINDOW_TITLE_MAX_LENGTH)
                         title = it.string_remaining();
                 m_window_title_pending.swap(title);
-                m_window_title_changed = true;
+                m_pending_changes |= VTE_PENDING_WINDOW_TITLE;
                 break;
         }
 
@@ -6784,8 +6846,7 @@ Terminal::RI(vte::parser::Sequence const& seq)
         if (m_screen->cursor.row == start) {
 		/* If we're at the top of the scrolling region, add a
 		 * line at the top to scroll the bottom off. */
-		ring_remove(end);
-		ring_insert(start, true);
+                ring_rotate(start, end, 1, true);
 
                 /* Set the boundaries to hard wrapped where we tore apart the contents.
                  * Need to do it after scrolling down, for the end row to be the desired one. */
@@ -6802,7 +6863,7 @@ Terminal::RI(vte::parser::Sequence const& seq)
 	/* Adjust the scrollbars if necessary. */
         adjust_adjustments();
 	/* We modified the display, so make a note of it. */
-        m_text_modified_flag = TRUE;
+        m_pending_changes |= VTE_PENDING_TEXT_MODIFIED;
 }
 
 void
@@ -7154,6 +7215,42 @@ Terminal::SGR(vte::parser::Sequence const& seq)
                 return;
 	}
 
+        /* A sequence that begins with a complete reset produces attributes
+         * that don't depend on the current ones, so its outcome can be
+         * memoized on the raw parameter list. Colorizers (ls --color, grep
+         * and friends) endlessly reuse a handful of such reset-prefixed
+         * combinations, saving us the parameter walk below almost always. */
+        uint32_t sgr_cache_key[VTE_SGR_CACHE_MAX_PARAMS];
+        sgr_cache_entry *sgr_cache_slot = nullptr;
+        auto const param0 = seq.param(0);
+        if ((param0 == -1 || param0 == VTE_SGR_RESET_ALL) &&
+            n_params <= G_N_ELEMENTS(sgr_cache_key)) {
+                for (unsigned int i = 0; i < n_params; i++) {
+                        /* Encode the subparam ("nonfinal") flag too, so that
+                         * e.g. 38:5:208 and 38;5;208 don't collide. */
+                        sgr_cache_key[i] = uint32_t(seq.param(i) + 1) |
+                                           (seq.param_nonfinal(i) ? 1u << 31 : 0u);
+                }
+                for (auto& candidate : m_sgr_cache) {
+                        if (candidate.len != n_params ||
+                            memcmp(candidate.params, sgr_cache_key, n_params * sizeof(sgr_cache_key[0])) != 0)
+                                continue;
+
+                        /* Replaying the parameters from the reset state would
+                         * yield exactly the memoized attributes. */
+                        auto const hyperlink_idx_save = m_defaults.attr.hyperlink_idx;
+                        m_defaults = m_color_defaults = basic_cell;
+                        m_defaults.attr = candidate.attr;
+                        m_defaults.attr.hyperlink_idx = hyperlink_idx_save;
+                        m_color_defaults.attr.copy_colors(m_defaults.attr);
+                        return;
+                }
+
+                /* Not seen recently; compute below and memoize. */
+                sgr_cache_slot = &m_sgr_cache[m_sgr_cache_next];
+                m_sgr_cache_next = (m_sgr_cache_next + 1) % G_N_ELEMENTS(m_sgr_cache);
+        }
+
         for (unsigned int i = 0; i < n_params; i = seq.next(i)) {
                 auto const param = seq.param(i);
                 switch (param) {
@@ -7271,6 +7368,14 @@ Terminal::SGR(vte::parser::Sequence const& seq)
 
 	/* Save the new colors. */
         m_color_defaults.attr.copy_colors(m_defaults.attr);
+
+        if (sgr_cache_slot != nullptr) {
+                sgr_cache_slot->len = n_params;
+                memcpy(sgr_cache_slot->params, sgr_cache_key, n_params * sizeof(sgr_cache_key[0]));
+                sgr_cache_slot->attr = m_defaults.attr;
+                /* Entries are shared across hyperlinks; see the hit path. */
+                sgr_cache_slot->attr.hyperlink_idx = basic_cell.attr.hyperlink_idx;
+        }
 }
 
 void
@@ -8783,7 +8888,7 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                                 m_window_title_stack.erase(m_window_title_stack.cbegin());
                         }
 
-                        if (m_window_title_changed)
+                        if (m_pending_changes & VTE_PENDING_WINDOW_TITLE)
                                 m_window_title_stack.emplace(m_window_title_stack.cend(),
                                                              m_window_title_pending);
                         else
@@ -8807,7 +8912,7 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                         if (m_window_title_stack.empty())
                                 break;
 
-                        m_window_title_changed = true;
+                        m_pending_changes |= VTE_PENDING_WINDOW_TITLE;
                         m_window_title_pending.swap(m_window_title_stack.back());
                         m_window_title_stack.pop_back();
                         break;
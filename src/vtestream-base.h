@@ -68,12 +68,14 @@ _vte_stream_reset (VteStream *stream, gsize offset)
 gboolean
 _vte_stream_read (VteStream *stream, gsize offset, char *data, gsize len)
 {
+	_vte_trace2(stream_read, offset, len);
 	return VTE_STREAM_GET_CLASS (stream)->read (stream, offset, data, len);
 }
 
 void
 _vte_stream_append (VteStream *stream, const char *data, gsize len)
 {
+	_vte_trace1(stream_append, len);
 	VTE_STREAM_GET_CLASS (stream)->append (stream, data, len);
 }
 
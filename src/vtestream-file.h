@@ -93,6 +93,11 @@
 
 G_BEGIN_DECLS
 
+/* Whether newly created streams encrypt and authenticate their blocks;
+ * toggled via vte_set_scrollback_encryption(). Each stream samples this
+ * when it is created so that all of its blocks are treated alike. */
+gboolean _vte_scrollback_encryption_enabled = TRUE;
+
 #ifdef WITH_GNUTLS
 /* Currently the code requires that a stream cipher (e.g. GCM) is used
  * which can encrypt any amount of data without need for padding. */
@@ -125,6 +130,17 @@ typedef guint8 _vte_overwrite_counter_t;
 #define ALIGN_BOA(x) ((x) / VTE_BOA_BLOCKSIZE * VTE_BOA_BLOCKSIZE)
 #define MOD_BOA(x)   ((x) % VTE_BOA_BLOCKSIZE)
 
+#if !defined(VTESTREAM_MAIN) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# define VTE_SNAKE_MMAP 1
+/* How many blocks the memory-mapped read window covers (1 MB). */
+# define VTE_SNAKE_MMAP_BLOCKS 16
+#endif
+
+/* Preallocate the scrollback file in extents of this many blocks (1 MB);
+ * see _vte_snake_write(). */
+#define VTE_SNAKE_PREALLOC_BLOCKS 16
+
 /******************************************************************************************/
 
 #ifndef HAVE_EXPLICIT_BZERO
@@ -178,12 +194,6 @@ _file_try_truncate (int fd, gsize offset)
 	return !ret;
 }
 
-static void
-_file_reset (int fd)
-{
-        _file_try_truncate (fd, 0);
-}
-
 static gboolean
 _file_try_punch_hole (int fd, gsize offset, gsize len)
 {
@@ -221,6 +231,33 @@ _file_try_punch_hole (int fd, gsize offset, gsize len)
 #endif
 }
 
+/*
+ * Allocate disk space for the given physical range, extending the file size
+ * as necessary.  Returns FALSE if fallocate() isn't available or the
+ * filesystem doesn't support it, in which case the caller has to grow the
+ * file with sparse blocks instead.
+ */
+static gboolean
+_file_try_fallocate (int fd, gsize offset, gsize len)
+{
+#if !defined(VTESTREAM_MAIN) && defined(FALLOC_FL_PUNCH_HOLE)
+        int ret;
+
+        if (G_UNLIKELY (fd == -1))
+                return FALSE;
+
+        do {
+                ret = fallocate (fd, 0, offset, len);
+        } while (ret == -1 && errno == EINTR);
+
+        return !ret;
+#else
+        /* The unit tests grow the file one block at a time so that its
+         * contents can be inspected right away. */
+        return FALSE;
+#endif
+}
+
 static gsize
 _file_read (int fd, char *data, gsize len, gsize offset)
 {
@@ -347,6 +384,18 @@ typedef struct _VteSnake {
                 gsize fd_head;  /* FD's physical head offset. One of these four is redundant, nevermind. */
         } segment[3];           /* At most 3 segments, [0] at the tail. */
         gsize tail, head;       /* These are redundant too, for convenience. */
+        gsize fd_alloc;         /* Physical extent preallocated with fallocate(); see _vte_snake_write(). */
+        gboolean no_fallocate;  /* fallocate() failed, grow the file with sparse blocks instead. */
+#ifndef VTESTREAM_MAIN
+        guint trim_tag;         /* Idle source reclaiming unused file space; see _vte_snake_schedule_trim(). */
+        gboolean trim_inline;   /* Trim synchronously instead; set when a write-behind queue owns this snake. */
+#endif
+#ifdef VTE_SNAKE_MMAP
+        /* Memory-mapped read window; see _vte_snake_read(). */
+        char *map;
+        gsize map_tail, map_head;  /* Physical (file) offsets covered by the window. */
+        gsize last_read_offset;    /* The previous read's physical offset, for guessing the scroll direction. */
+#endif
 } VteSnake;
 #define VTE_SNAKE_SEGMENTS(s) ((s)->state == 4 ? 2 : (s)->state)
 
@@ -374,11 +423,170 @@ _vte_snake_init (VteSnake *snake)
         snake->state = 1;
 }
 
+#ifdef VTE_SNAKE_MMAP
+
+static void
+_vte_snake_unmap (VteSnake *snake)
+{
+        if (snake->map == NULL)
+                return;
+
+        munmap (snake->map, snake->map_head - snake->map_tail);
+        snake->map = NULL;
+        snake->map_tail = snake->map_head = 0;
+}
+
+/* Drop the read window if it overlaps the physical range [offset, offset + len). */
+static inline void
+_vte_snake_invalidate_map (VteSnake *snake, gsize offset, gsize len)
+{
+        if (G_UNLIKELY (snake->map != NULL && offset < snake->map_head && offset + len > snake->map_tail))
+                _vte_snake_unmap (snake);
+}
+
+/* Drop the read window if it extends beyond the given file size; pages past
+ * EOF would raise SIGBUS when touched. */
+static inline void
+_vte_snake_clamp_map (VteSnake *snake, gsize size)
+{
+        if (G_UNLIKELY (snake->map != NULL && snake->map_head > size))
+                _vte_snake_unmap (snake);
+}
+
+/*
+ * Copy the block at the physical offset from the read window, remapping the
+ * window if the block falls outside of it.  The window is placed so that it
+ * extends in the direction the reads are going: backwards of the requested
+ * block while scrolling up through the history, forwards while scrolling back
+ * down, so consecutive thaws are served from the same mapping and the kernel
+ * is told to read the right range ahead.  Returns FALSE if mmap() failed and
+ * the caller should fall back to pread().
+ */
+static gboolean
+_vte_snake_read_mmap (VteSnake *snake, gsize fd_offset, char *data)
+{
+        if (G_UNLIKELY (snake->map == NULL ||
+                        fd_offset < snake->map_tail ||
+                        fd_offset + VTE_SNAKE_BLOCKSIZE > snake->map_head)) {
+                const gsize page_size = (gsize) sysconf (_SC_PAGESIZE);
+                const gsize window = (gsize) VTE_SNAKE_MMAP_BLOCKS * VTE_SNAKE_BLOCKSIZE;
+                gsize file_size, map_tail, map_head;
+                int i;
+
+                _vte_snake_unmap (snake);
+
+                /* All the segments' physical extents are within the file. */
+                file_size = 0;
+                for (i = 0; i < VTE_SNAKE_SEGMENTS(snake); i++)
+                        file_size = MAX (file_size, snake->segment[i].fd_head);
+
+                if (fd_offset <= snake->last_read_offset)
+                        map_tail = fd_offset + VTE_SNAKE_BLOCKSIZE > window
+                                   ? fd_offset + VTE_SNAKE_BLOCKSIZE - window : 0;
+                else
+                        map_tail = fd_offset;
+                map_tail = map_tail / page_size * page_size;
+                map_head = MIN (map_tail + window, file_size);
+
+                snake->map = (char *) mmap (NULL, map_head - map_tail, PROT_READ, MAP_SHARED,
+                                            snake->fd, map_tail);
+                if (G_UNLIKELY (snake->map == MAP_FAILED)) {
+                        snake->map = NULL;
+                        return FALSE;
+                }
+                snake->map_tail = map_tail;
+                snake->map_head = map_head;
+#ifdef MADV_WILLNEED
+                madvise (snake->map, map_head - map_tail, MADV_WILLNEED);
+#endif
+        }
+
+        snake->last_read_offset = fd_offset;
+        memcpy (data, snake->map + (fd_offset - snake->map_tail), VTE_SNAKE_BLOCKSIZE);
+        return TRUE;
+}
+
+#else
+
+#define _vte_snake_unmap(snake) do { } while (0)
+#define _vte_snake_invalidate_map(snake, offset, len) do { } while (0)
+#define _vte_snake_clamp_map(snake, size) do { } while (0)
+
+#endif /* VTE_SNAKE_MMAP */
+
+/* Truncate the file down to the physical extent still in use. */
+static void
+_vte_snake_trim (VteSnake *snake)
+{
+        gsize file_size = 0;
+        int i;
+
+        for (i = 0; i < VTE_SNAKE_SEGMENTS(snake); i++)
+                file_size = MAX (file_size, snake->segment[i].fd_head);
+
+        _vte_snake_clamp_map (snake, file_size);
+        _file_try_truncate (snake->fd, file_size);
+        snake->fd_alloc = MIN (snake->fd_alloc, file_size);
+}
+
+#ifndef VTESTREAM_MAIN
+static gboolean
+_vte_snake_trim_cb (gpointer data)
+{
+        VteSnake *snake = (VteSnake *) data;
+
+        snake->trim_tag = 0;
+        _vte_snake_trim (snake);
+        return G_SOURCE_REMOVE;
+}
+#endif
+
+/*
+ * Arrange for _vte_snake_trim() to run from an idle callback. Truncation can
+ * be proportional to the amount of data dropped, so resetting or advancing
+ * over a large stream (e.g. "clear" during heavy output) shouldn't pay for
+ * it synchronously; the trim computes the in-use extent when it actually
+ * runs, so any single-threaded activity in between is fine.
+ *
+ * When a write-behind queue owns the snake, the idle would run the trim
+ * on the GTK thread concurrently with the worker mutating the same
+ * state, mapping and file; trim synchronously instead.  Every path that
+ * gets here in that configuration is off the hot GTK path already: the
+ * worker itself, or a reset, which the stream precedes with a drain so
+ * the worker is idle.
+ */
+static void
+_vte_snake_schedule_trim (VteSnake *snake)
+{
+        if (G_UNLIKELY (snake->fd == -1))
+                return;
+
+#ifndef VTESTREAM_MAIN
+        if (snake->trim_inline) {
+                _vte_snake_trim (snake);
+                return;
+        }
+
+        if (snake->trim_tag == 0)
+                snake->trim_tag = g_idle_add_full (G_PRIORITY_LOW, _vte_snake_trim_cb, snake, NULL);
+#else
+        /* The unit tests inspect the file synchronously. */
+        _vte_snake_trim (snake);
+#endif
+}
+
 static void
 _vte_snake_finalize (GObject *object)
 {
         VteSnake *snake = (VteSnake *) object;
 
+#ifndef VTESTREAM_MAIN
+        if (snake->trim_tag != 0) {
+                g_source_remove (snake->trim_tag);
+                snake->trim_tag = 0;
+        }
+#endif
+        _vte_snake_unmap (snake);
         _file_close (snake->fd);
 
         G_OBJECT_CLASS (_vte_snake_parent_class)->finalize(object);
@@ -403,10 +611,13 @@ _vte_snake_reset (VteSnake *snake, gsize offset)
         g_assert_cmpuint (offset, >=, snake->tail);
 
         if (G_LIKELY (offset >= snake->head)) {
-                _file_reset (snake->fd);
+                _vte_snake_unmap (snake);
                 snake->segment[0].st_tail = snake->segment[0].st_head = snake->tail = snake->head = offset;
                 snake->segment[0].fd_tail = snake->segment[0].fd_head = 0;
                 snake->state = 1;
+                /* The old contents are unreachable already; give the disk
+                 * space back lazily so reset stays constant time. */
+                _vte_snake_schedule_trim (snake);
         } else {
                 /* Never retreat the head: bug 748484. */
                 _vte_snake_advance_tail (snake, offset);
@@ -445,6 +656,11 @@ _vte_snake_read (VteSnake *snake, gsize offset, char *data)
 
         fd_offset = _vte_snake_offset_map(snake, offset);
 
+#ifdef VTE_SNAKE_MMAP
+        if (G_LIKELY (_vte_snake_read_mmap (snake, fd_offset, data)))
+                return TRUE;
+        /* mmap() failed, fall back to pread(). */
+#endif
         return (_file_read (snake->fd, data, VTE_SNAKE_BLOCKSIZE, fd_offset) == VTE_SNAKE_BLOCKSIZE);
 }
 
@@ -492,9 +708,21 @@ _vte_snake_write (VteSnake *snake, gsize offset, const char *data, gsize len)
                         snake->segment[last_segment].fd_head += VTE_SNAKE_BLOCKSIZE;
                 }
                 if (snake->state != 2) {
-                        /* Grow the file with sparse blocks to make sure that later pread() can
-                         * read back a whole block, even if we are about to write a shorter one. */
-                        _file_try_truncate (snake->fd, fd_offset + VTE_SNAKE_BLOCKSIZE);
+                        /* Grow the file to make sure that later pread() can read back a
+                         * whole block, even if we are about to write a shorter one.
+                         * Preallocate in large extents so that under sustained logging
+                         * the filesystem is asked for space rarely and can hand it out
+                         * contiguously, rather than one sparse block at a time. */
+                        if (G_UNLIKELY (fd_offset + VTE_SNAKE_BLOCKSIZE > snake->fd_alloc)) {
+                                gsize alloc_head = fd_offset + (gsize) VTE_SNAKE_PREALLOC_BLOCKS * VTE_SNAKE_BLOCKSIZE;
+                                if (G_LIKELY (!snake->no_fallocate &&
+                                              _file_try_fallocate (snake->fd, snake->fd_alloc, alloc_head - snake->fd_alloc))) {
+                                        snake->fd_alloc = alloc_head;
+                                } else {
+                                        snake->no_fallocate = TRUE;
+                                        _file_try_truncate (snake->fd, fd_offset + VTE_SNAKE_BLOCKSIZE);
+                                }
+                        }
 #ifdef VTESTREAM_MAIN
                         /* For convenient unit testing only: fill with dots. */
                         _file_try_punch_hole (snake->fd, fd_offset, VTE_SNAKE_BLOCKSIZE);
@@ -507,6 +735,8 @@ _vte_snake_write (VteSnake *snake, gsize offset, const char *data, gsize len)
                 fd_offset = _vte_snake_offset_map(snake, offset);
                 _file_try_punch_hole (snake->fd, fd_offset, VTE_SNAKE_BLOCKSIZE);
         }
+        /* Keep the read window coherent without relying on unified page caches. */
+        _vte_snake_invalidate_map (snake, fd_offset, VTE_SNAKE_BLOCKSIZE);
         _file_write (snake->fd, data, len, fd_offset);
 }
 
@@ -542,8 +772,8 @@ _vte_snake_advance_tail (VteSnake *snake, gsize offset)
                                 break;
                         case 2:
                                 snake->segment[0] = snake->segment[1];
-                                _file_try_truncate (snake->fd, snake->segment[0].fd_head);
                                 snake->state = 1;
+                                _vte_snake_schedule_trim (snake);
                                 break;
                         case 3:
                                 _file_try_punch_hole (snake->fd, snake->segment[0].fd_tail, snake->segment[0].fd_head - snake->segment[0].fd_tail);
@@ -642,6 +872,26 @@ _vte_snake_class_init (VteSnakeClass *klass)
         } VteIv;
 #endif
 
+#ifndef VTESTREAM_MAIN
+/*
+ * VteCompressor: a compression backend for the boa layer.
+ *
+ * Compression happens on the plaintext, below the AES-GCM framing of
+ * _vte_boa_write()/_vte_boa_read_with_overwrite_counter(), so backends
+ * only see whole VTE_BOA_BLOCKSIZE blocks. The backend is chosen once
+ * per process and the blocks don't record which one wrote them; that's
+ * fine because the streams never outlive the process.
+ */
+typedef struct _VteCompressor {
+        const char *name;
+        int (*bound) (unsigned int len);
+        /* Returns the compressed size, which might be bigger than srclen;
+         * the caller then stores the block uncompressed instead. */
+        unsigned int (*compress) (char *dst, unsigned int dstlen, const char *src, unsigned int srclen);
+        unsigned int (*uncompress) (char *dst, unsigned int dstlen, const char *src, unsigned int srclen);
+} VteCompressor;
+#endif
+
 typedef struct _VteBoa {
         VteSnake parent;
         gsize tail, head;
@@ -649,6 +899,15 @@ typedef struct _VteBoa {
 #if !defined VTESTREAM_MAIN && defined WITH_GNUTLS
         gnutls_cipher_hd_t cipher_hd;
         VteIv iv;
+        gboolean encrypted;  /* sampled from _vte_scrollback_encryption_enabled at init */
+#endif
+#ifndef VTESTREAM_MAIN
+        const VteCompressor *compressor;
+
+        /* In-memory tier, see VteBoaCacheEntry. */
+        GQueue cache;            /* VteBoaCacheEntry's, most recently used first. */
+        GHashTable *cache_map;   /* block-aligned offset -> GList* into cache. */
+        gsize cache_bytes;       /* Sum of the entries' compressed_len. */
 #endif
         int compressBound;
 } VteBoa;
@@ -680,6 +939,12 @@ _vte_boa_encrypt (VteBoa *boa, gsize offset, guint32 overwrite_counter, char *da
 {
 #ifndef VTESTREAM_MAIN
 # ifdef WITH_GNUTLS
+        if (G_UNLIKELY (!boa->encrypted)) {
+                /* Scrollback protection is off; blocks carry an all-zero tag. */
+                memset (data + len, 0, VTE_CIPHER_TAG_SIZE);
+                return;
+        }
+
         boa->iv.offset = offset;
         boa->iv.overwrite_counter = overwrite_counter;
         gnutls_cipher_set_iv (boa->cipher_hd, &boa->iv, VTE_CIPHER_IV_SIZE);
@@ -711,11 +976,15 @@ _vte_boa_decrypt (VteBoa *boa, gsize offset, guint32 overwrite_counter, char *da
 
 #ifndef VTESTREAM_MAIN
 # ifdef WITH_GNUTLS
-        boa->iv.offset = offset;
-        boa->iv.overwrite_counter = overwrite_counter;
-        gnutls_cipher_set_iv (boa->cipher_hd, &boa->iv, VTE_CIPHER_IV_SIZE);
-        gnutls_cipher_decrypt (boa->cipher_hd, data, len);
-        gnutls_cipher_tag (boa->cipher_hd, tag, VTE_CIPHER_TAG_SIZE);
+        if (G_UNLIKELY (!boa->encrypted)) {
+                memset (tag, 0, VTE_CIPHER_TAG_SIZE);
+        } else {
+                boa->iv.offset = offset;
+                boa->iv.overwrite_counter = overwrite_counter;
+                gnutls_cipher_set_iv (boa->cipher_hd, &boa->iv, VTE_CIPHER_IV_SIZE);
+                gnutls_cipher_decrypt (boa->cipher_hd, data, len);
+                gnutls_cipher_tag (boa->cipher_hd, tag, VTE_CIPHER_TAG_SIZE);
+        }
 # endif
 #else
         /* Fake decryption for unit testing; see above. */
@@ -734,11 +1003,167 @@ _vte_boa_decrypt (VteBoa *boa, gsize offset, guint32 overwrite_counter, char *da
         return !faulty;
 }
 
+#ifndef VTESTREAM_MAIN
+
 static int
-_vte_boa_compressBound (unsigned int len)
+_vte_compressor_zlib_bound (unsigned int len)
+{
+        return compressBound (len);
+}
+
+static unsigned int
+_vte_compressor_zlib_compress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen, int level)
+{
+        uLongf dstlen_ulongf = dstlen;
+        unsigned int z_ret;
+
+        z_ret = compress2 ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen, level);
+        g_assert_cmpuint (z_ret, ==, Z_OK);
+        return dstlen_ulongf;
+}
+
+static unsigned int
+_vte_compressor_zlib_fast_compress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+{
+        return _vte_compressor_zlib_compress (dst, dstlen, src, srclen, Z_BEST_SPEED);
+}
+
+static unsigned int
+_vte_compressor_zlib_best_compress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+{
+        return _vte_compressor_zlib_compress (dst, dstlen, src, srclen, Z_BEST_COMPRESSION);
+}
+
+static unsigned int
+_vte_compressor_zlib_uncompress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+{
+        uLongf dstlen_ulongf = dstlen;
+        unsigned int z_ret;
+
+        z_ret = uncompress ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen);
+        g_assert_cmpuint (z_ret, ==, Z_OK);
+        return dstlen_ulongf;
+}
+
+/* LZ4/zstd backends slot in here once we grow those dependencies. */
+static const VteCompressor _vte_compressors[] = {
+        /* The fast tier and the default. */
+        { "zlib", _vte_compressor_zlib_bound,
+          _vte_compressor_zlib_fast_compress, _vte_compressor_zlib_uncompress },
+        /* The archival tier: denser blocks, much slower. */
+        { "zlib-best", _vte_compressor_zlib_bound,
+          _vte_compressor_zlib_best_compress, _vte_compressor_zlib_uncompress },
+};
+
+static const VteCompressor *
+_vte_compressor_get (void)
+{
+        static const VteCompressor *compressor = NULL;
+
+        if (G_UNLIKELY (compressor == NULL)) {
+                const char *name = g_getenv ("VTE_COMPRESSION");
+                guint i;
+
+                compressor = &_vte_compressors[0];
+                if (name != NULL) {
+                        for (i = 0; i < G_N_ELEMENTS (_vte_compressors); i++) {
+                                if (g_str_equal (name, _vte_compressors[i].name)) {
+                                        compressor = &_vte_compressors[i];
+                                        break;
+                                }
+                        }
+                }
+        }
+
+        return compressor;
+}
+
+/*
+ * An in-memory tier in front of the on-disk stream: the most recently
+ * written and read blocks are kept around in compressed (but decrypted)
+ * form, capped by their compressed size.  Scrolling back up through the
+ * recent history then only costs a decompression per block, not a disk
+ * read plus a decryption.
+ */
+
+#define VTE_BOA_CACHE_BYTES (4 * 1024 * 1024)
+
+typedef struct _VteBoaCacheEntry {
+        gsize offset;                           /* Block-aligned boa offset. */
+        _vte_block_datalength_t compressed_len;
+        char data[1];                           /* compressed_len bytes. */
+} VteBoaCacheEntry;
+
+static void
+_vte_boa_cache_drop (VteBoa *boa, GList *link)
+{
+        VteBoaCacheEntry *entry = (VteBoaCacheEntry *) link->data;
+
+        g_hash_table_remove (boa->cache_map, GSIZE_TO_POINTER (entry->offset));
+        boa->cache_bytes -= entry->compressed_len;
+        g_queue_delete_link (&boa->cache, link);
+        g_free (entry);
+}
+
+/* Look up a block, making it the most recently used. */
+static VteBoaCacheEntry *
+_vte_boa_cache_lookup (VteBoa *boa, gsize offset)
+{
+        GList *link = (GList *) g_hash_table_lookup (boa->cache_map, GSIZE_TO_POINTER (offset));
+
+        if (link == NULL)
+                return NULL;
+
+        g_queue_unlink (&boa->cache, link);
+        g_queue_push_head_link (&boa->cache, link);
+        return (VteBoaCacheEntry *) link->data;
+}
+
+/* (Re)insert a block's compressed data, evicting the least recently used
+ * blocks if the cache grew too large. */
+static void
+_vte_boa_cache_insert (VteBoa *boa, gsize offset, const char *data, _vte_block_datalength_t compressed_len)
+{
+        VteBoaCacheEntry *entry;
+        GList *link = (GList *) g_hash_table_lookup (boa->cache_map, GSIZE_TO_POINTER (offset));
+
+        if (link != NULL)
+                _vte_boa_cache_drop (boa, link);
+
+        entry = (VteBoaCacheEntry *) g_malloc (G_STRUCT_OFFSET (VteBoaCacheEntry, data) + compressed_len);
+        entry->offset = offset;
+        entry->compressed_len = compressed_len;
+        memcpy (entry->data, data, compressed_len);
+
+        g_queue_push_head (&boa->cache, entry);
+        g_hash_table_insert (boa->cache_map, GSIZE_TO_POINTER (offset), boa->cache.head);
+        boa->cache_bytes += compressed_len;
+
+        while (boa->cache_bytes > VTE_BOA_CACHE_BYTES && !g_queue_is_empty (&boa->cache))
+                _vte_boa_cache_drop (boa, boa->cache.tail);
+}
+
+/* Drop all blocks below the given offset; for advancing the tail and resetting. */
+static void
+_vte_boa_cache_trim (VteBoa *boa, gsize offset)
+{
+        GList *link = boa->cache.head, *next;
+
+        while (link != NULL) {
+                next = link->next;
+                if (((VteBoaCacheEntry *) link->data)->offset < offset)
+                        _vte_boa_cache_drop (boa, link);
+                link = next;
+        }
+}
+
+#endif /* !VTESTREAM_MAIN */
+
+static int
+_vte_boa_compressBound (VteBoa *boa, unsigned int len)
 {
 #ifndef VTESTREAM_MAIN
-        return compressBound(len);
+        return boa->compressor->bound (len);
 #else
         return 2 * len;
 #endif
@@ -746,15 +1171,13 @@ _vte_boa_compressBound (unsigned int len)
 
 /* Compress; returns the compressed size which might be bigger than the original. */
 static unsigned int
-_vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+_vte_boa_compress (VteBoa *boa, char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
 {
 #ifndef VTESTREAM_MAIN
-        uLongf dstlen_ulongf = dstlen;
-        unsigned int z_ret;
-
-        z_ret = compress2 ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen, 1);
-        g_assert_cmpuint (z_ret, ==, Z_OK);
-        return dstlen_ulongf;
+        unsigned int ret = boa->compressor->compress (dst, dstlen, src, srclen);
+        vte::stats::add(vte::stats::counters.stream_bytes_in, srclen);
+        vte::stats::add(vte::stats::counters.stream_bytes_out, ret);
+        return ret;
 #else
         /* Fake compression for unit testing:
          * Each char gets prefixed by a repetition count. This prefix is omitted if it would be the
@@ -784,15 +1207,10 @@ _vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int
 
 /* Uncompress; returns the uncompressed size. */
 static unsigned int
-_vte_boa_uncompress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+_vte_boa_uncompress (VteBoa *boa, char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
 {
 #ifndef VTESTREAM_MAIN
-        uLongf dstlen_ulongf = dstlen;
-        unsigned int z_ret;
-
-        z_ret = uncompress ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen);
-        g_assert_cmpuint (z_ret, ==, Z_OK);
-        return dstlen_ulongf;
+        return boa->compressor->uncompress (dst, dstlen, src, srclen);
 #else
         /* Fake decompression for unit testing; see above. */
         unsigned int len = 0, repeat = 0;
@@ -819,6 +1237,10 @@ _vte_boa_init (VteBoa *boa)
         unsigned char key[VTE_CIPHER_KEY_SIZE];
         gnutls_datum_t datum_key;
 
+        boa->encrypted = _vte_scrollback_encryption_enabled;
+        if (G_UNLIKELY (!boa->encrypted))
+                goto no_cipher;
+
         gnutls_global_init ();
 
         /* Assert that VTE_CIPHER_* constants are defined correctly. Should happen compile-time, nevermind. */
@@ -838,21 +1260,38 @@ _vte_boa_init (VteBoa *boa)
 
         /* Empty IV. */
         explicit_bzero(&boa->iv, sizeof(boa->iv));
+
+no_cipher:
 #endif
 
-        boa->compressBound = _vte_boa_compressBound(VTE_BOA_BLOCKSIZE);
+#ifndef VTESTREAM_MAIN
+        boa->compressor = _vte_compressor_get ();
+
+        g_queue_init (&boa->cache);
+        boa->cache_map = g_hash_table_new (NULL, NULL);
+        boa->cache_bytes = 0;
+#endif
+        boa->compressBound = _vte_boa_compressBound(boa, VTE_BOA_BLOCKSIZE);
 }
 
 static void
 _vte_boa_finalize (GObject *object)
 {
-#if !defined VTESTREAM_MAIN && defined WITH_GNUTLS
+#ifndef VTESTREAM_MAIN
         VteBoa *boa = (VteBoa *) object;
 
-        explicit_bzero(&boa->iv, sizeof(boa->iv));
+        while (!g_queue_is_empty (&boa->cache))
+                _vte_boa_cache_drop (boa, boa->cache.head);
+        g_hash_table_destroy (boa->cache_map);
+
+# ifdef WITH_GNUTLS
+        if (boa->encrypted) {
+                explicit_bzero(&boa->iv, sizeof(boa->iv));
 
-        gnutls_cipher_deinit (boa->cipher_hd);
-        gnutls_global_deinit ();
+                gnutls_cipher_deinit (boa->cipher_hd);
+                gnutls_global_deinit ();
+        }
+# endif
 #endif
 
         G_OBJECT_CLASS (_vte_boa_parent_class)->finalize(object);
@@ -874,6 +1313,10 @@ _vte_boa_reset (VteBoa *boa, gsize offset)
 
         _vte_snake_reset (&boa->parent, OFFSET_BOA_TO_SNAKE(offset));
 
+#ifndef VTESTREAM_MAIN
+        _vte_boa_cache_trim (boa, offset);
+#endif
+
         boa->tail = offset;
         /* Never retreat the head: bug 748484. */
         boa->head = MAX(boa->head, offset);
@@ -904,13 +1347,19 @@ _vte_boa_read_with_overwrite_counter (VteBoa *boa, gsize offset, char *data, _vt
         if (G_UNLIKELY (!_vte_boa_decrypt (boa, offset, *overwrite_counter, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len)))
                 return FALSE;
 
+#ifndef VTESTREAM_MAIN
+        /* Remember the decrypted, still compressed block in the in-memory tier. */
+        if (G_LIKELY (data != NULL))
+                _vte_boa_cache_insert (boa, offset, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
+#endif
+
         /* Uncompress, or copy if wasn't compressable */
         if (G_LIKELY (data != NULL)) {
                 if (G_UNLIKELY (compressed_len >= VTE_BOA_BLOCKSIZE)) {
                         memcpy (data, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, VTE_BOA_BLOCKSIZE);
                 } else {
                         unsigned int uncompressed_len;
-                        uncompressed_len = _vte_boa_uncompress(data, VTE_BOA_BLOCKSIZE, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
+                        uncompressed_len = _vte_boa_uncompress(boa, data, VTE_BOA_BLOCKSIZE, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
                         g_assert_cmpuint (uncompressed_len, ==, VTE_BOA_BLOCKSIZE);
                 }
         }
@@ -921,6 +1370,21 @@ static gboolean
 _vte_boa_read (VteBoa *boa, gsize offset, char *data)
 {
         _vte_overwrite_counter_t overwrite_counter;
+
+#ifndef VTESTREAM_MAIN
+        VteBoaCacheEntry *entry = _vte_boa_cache_lookup (boa, offset);
+        if (G_LIKELY (entry != NULL)) {
+                if (G_UNLIKELY (entry->compressed_len >= VTE_BOA_BLOCKSIZE)) {
+                        memcpy (data, entry->data, VTE_BOA_BLOCKSIZE);
+                } else {
+                        unsigned int uncompressed_len;
+                        uncompressed_len = _vte_boa_uncompress (boa, data, VTE_BOA_BLOCKSIZE, entry->data, entry->compressed_len);
+                        g_assert_cmpuint (uncompressed_len, ==, VTE_BOA_BLOCKSIZE);
+                }
+                return TRUE;
+        }
+#endif
+
         return _vte_boa_read_with_overwrite_counter (boa, offset, data, &overwrite_counter);
 }
 
@@ -967,7 +1431,7 @@ _vte_boa_write (VteBoa *boa, gsize offset, const char *data)
         _vte_block_datalength_t compressed_len;
 
         /* Compress, or copy if uncompressable */
-        compressed_len = _vte_boa_compress (buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, boa->compressBound,
+        compressed_len = _vte_boa_compress (boa, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, boa->compressBound,
                                             data, VTE_BOA_BLOCKSIZE);
         if (G_UNLIKELY (compressed_len >= VTE_BOA_BLOCKSIZE)) {
                 memcpy (buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, data, VTE_BOA_BLOCKSIZE);
@@ -977,6 +1441,11 @@ _vte_boa_write (VteBoa *boa, gsize offset, const char *data)
         *((_vte_block_datalength_t *) buf) = (_vte_block_datalength_t) compressed_len;
         *((_vte_overwrite_counter_t *) (buf + VTE_BLOCK_DATALENGTH_SIZE)) = (_vte_overwrite_counter_t) overwrite_counter;
 
+#ifndef VTESTREAM_MAIN
+        /* Remember the block in the in-memory tier before it's encrypted in place. */
+        _vte_boa_cache_insert (boa, offset, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
+#endif
+
         /* Encrypt */
         _vte_boa_encrypt (boa, offset, overwrite_counter, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
 
@@ -997,6 +1466,10 @@ _vte_boa_advance_tail (VteBoa *boa, gsize offset)
 
         _vte_snake_advance_tail (&boa->parent, OFFSET_BOA_TO_SNAKE(offset));
 
+#ifndef VTESTREAM_MAIN
+        _vte_boa_cache_trim (boa, offset);
+#endif
+
         boa->tail = offset;
 }
 
@@ -1029,6 +1502,198 @@ _vte_boa_class_init (VteBoaClass *klass)
 
 /******************************************************************************************/
 
+#ifndef VTESTREAM_MAIN
+
+/*
+ * VteWriteBehind: a write-behind queue in front of VteBoa.
+ *
+ * Full blocks are handed over to a worker thread, taking the
+ * compression, encryption and pwrite() of scrolled-off rows out of the
+ * GTK thread. All boa calls are made on the worker, in queue order.
+ * Reads get read-your-writes semantics by fetching still-queued blocks
+ * directly from the queue; the rare operations that must call into the
+ * boa from the caller's thread (reading flushed blocks, truncate,
+ * reset) drain the queue first, which also keeps the boa's cipher
+ * handle single-threaded at any point in time.
+ *
+ * Only enabled when the VTE_ASYNC_SCROLLBACK environment variable is
+ * set.
+ */
+
+typedef struct _VteWriteBehindOp {
+        enum {
+                VTE_WRITE_BEHIND_WRITE,
+                VTE_WRITE_BEHIND_ADVANCE_TAIL
+        } op;
+        gsize offset;
+        char data[1];  /* VTE_BOA_BLOCKSIZE bytes, for WRITE only */
+} VteWriteBehindOp;
+
+typedef struct _VteWriteBehind {
+        VteBoa *boa;
+
+        GThread *thread;
+        GMutex mutex;
+        GCond cond;
+
+        /* All of the below are guarded by the mutex. */
+        GQueue queue;                /* VteWriteBehindOp, oldest first */
+        VteWriteBehindOp *inflight;  /* the op being carried out right now */
+        gboolean quit;
+} VteWriteBehind;
+
+static gboolean
+_vte_write_behind_enabled (void)
+{
+        static int enabled = -1;
+
+        if (G_UNLIKELY (enabled == -1))
+                enabled = g_getenv ("VTE_ASYNC_SCROLLBACK") != NULL;
+        return enabled;
+}
+
+static gpointer
+_vte_write_behind_thread (gpointer data)
+{
+        VteWriteBehind *wb = (VteWriteBehind *) data;
+
+        g_mutex_lock (&wb->mutex);
+        for (;;) {
+                VteWriteBehindOp *op;
+
+                while (!wb->quit && g_queue_is_empty (&wb->queue))
+                        g_cond_wait (&wb->cond, &wb->mutex);
+                if (wb->quit)
+                        break;
+
+                op = (VteWriteBehindOp *) g_queue_pop_head (&wb->queue);
+                wb->inflight = op;
+                g_mutex_unlock (&wb->mutex);
+
+                switch (op->op) {
+                case VTE_WRITE_BEHIND_WRITE:
+                        _vte_boa_write (wb->boa, op->offset, op->data);
+                        break;
+                case VTE_WRITE_BEHIND_ADVANCE_TAIL:
+                        _vte_boa_advance_tail (wb->boa, op->offset);
+                        break;
+                }
+
+                g_mutex_lock (&wb->mutex);
+                wb->inflight = NULL;
+                g_free (op);
+                g_cond_broadcast (&wb->cond);
+        }
+        g_mutex_unlock (&wb->mutex);
+
+        return NULL;
+}
+
+static VteWriteBehind *
+_vte_write_behind_new (VteBoa *boa)
+{
+        VteWriteBehind *wb = g_new0 (VteWriteBehind, 1);
+
+        wb->boa = boa;
+        g_mutex_init (&wb->mutex);
+        g_cond_init (&wb->cond);
+        g_queue_init (&wb->queue);
+        wb->thread = g_thread_new ("vte-scrollback", _vte_write_behind_thread, wb);
+
+        return wb;
+}
+
+/* Wait until every queued operation has hit the boa, making it safe to
+ * call into the boa from the caller's thread. */
+static void
+_vte_write_behind_drain (VteWriteBehind *wb)
+{
+        g_mutex_lock (&wb->mutex);
+        while (wb->inflight != NULL || !g_queue_is_empty (&wb->queue))
+                g_cond_wait (&wb->cond, &wb->mutex);
+        g_mutex_unlock (&wb->mutex);
+}
+
+static void
+_vte_write_behind_free (VteWriteBehind *wb)
+{
+        _vte_write_behind_drain (wb);
+
+        g_mutex_lock (&wb->mutex);
+        wb->quit = TRUE;
+        g_cond_broadcast (&wb->cond);
+        g_mutex_unlock (&wb->mutex);
+        g_thread_join (wb->thread);
+
+        g_cond_clear (&wb->cond);
+        g_mutex_clear (&wb->mutex);
+        g_free (wb);
+}
+
+static void
+_vte_write_behind_write (VteWriteBehind *wb, gsize offset, const char *data)
+{
+        VteWriteBehindOp *op = (VteWriteBehindOp *) g_malloc (G_STRUCT_OFFSET (VteWriteBehindOp, data) + VTE_BOA_BLOCKSIZE);
+
+        op->op = VTE_WRITE_BEHIND_WRITE;
+        op->offset = offset;
+        memcpy (op->data, data, VTE_BOA_BLOCKSIZE);
+
+        g_mutex_lock (&wb->mutex);
+        g_queue_push_tail (&wb->queue, op);
+        g_cond_broadcast (&wb->cond);
+        g_mutex_unlock (&wb->mutex);
+}
+
+static void
+_vte_write_behind_advance_tail (VteWriteBehind *wb, gsize offset)
+{
+        /* Queued rather than called directly, so that punching out old
+         * blocks stays ordered with the writes. */
+        VteWriteBehindOp *op = (VteWriteBehindOp *) g_malloc (G_STRUCT_OFFSET (VteWriteBehindOp, data));
+
+        op->op = VTE_WRITE_BEHIND_ADVANCE_TAIL;
+        op->offset = offset;
+
+        g_mutex_lock (&wb->mutex);
+        g_queue_push_tail (&wb->queue, op);
+        g_cond_broadcast (&wb->cond);
+        g_mutex_unlock (&wb->mutex);
+}
+
+/* Read-your-writes: fetch the newest still-queued block for @offset, if
+ * any. The worker never modifies an op's data, so copying it out under
+ * the mutex is safe even for the in-flight op. */
+static gboolean
+_vte_write_behind_read (VteWriteBehind *wb, gsize offset, char *data)
+{
+        GList *l;
+        gboolean found = FALSE;
+
+        g_mutex_lock (&wb->mutex);
+        if (wb->inflight != NULL &&
+            wb->inflight->op == VTE_WRITE_BEHIND_WRITE &&
+            wb->inflight->offset == offset) {
+                memcpy (data, wb->inflight->data, VTE_BOA_BLOCKSIZE);
+                found = TRUE;
+        }
+        /* Oldest to newest; the last hit wins. */
+        for (l = wb->queue.head; l != NULL; l = l->next) {
+                VteWriteBehindOp *op = (VteWriteBehindOp *) l->data;
+                if (op->op == VTE_WRITE_BEHIND_WRITE && op->offset == offset) {
+                        memcpy (data, op->data, VTE_BOA_BLOCKSIZE);
+                        found = TRUE;
+                }
+        }
+        g_mutex_unlock (&wb->mutex);
+
+        return found;
+}
+
+#endif /* !VTESTREAM_MAIN */
+
+/******************************************************************************************/
+
 /*
  * VteFileStream: Implement buffering/caching on top of VteBoa.
  */
@@ -1037,6 +1702,9 @@ typedef struct _VteFileStream {
         GObject parent;
 
         VteBoa *boa;
+#ifndef VTESTREAM_MAIN
+        VteWriteBehind *write_behind;  /* or NULL when writing synchronously */
+#endif
 
         char *rbuf;
         /* Offset of the cached record, always a multiple of block size.
@@ -1067,17 +1735,79 @@ static void
 _vte_file_stream_init (VteFileStream *stream)
 {
         stream->boa = (VteBoa *)g_object_new (VTE_TYPE_BOA, NULL);
+#ifndef VTESTREAM_MAIN
+        if (_vte_write_behind_enabled ()) {
+                stream->write_behind = _vte_write_behind_new (stream->boa);
+                /* All snake mutation, including the deferred trim, must
+                 * stay on one thread; see _vte_snake_schedule_trim(). */
+                ((VteSnake *) stream->boa)->trim_inline = TRUE;
+        }
+#endif
 
         stream->rbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
         stream->wbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
         stream->rbuf_offset = 1;  /* Invalidate */
 }
 
+/* Wrappers dispatching between the write-behind queue and the boa. */
+
+static void
+_vte_file_stream_drain (VteFileStream *stream)
+{
+#ifndef VTESTREAM_MAIN
+        if (stream->write_behind != NULL)
+                _vte_write_behind_drain (stream->write_behind);
+#endif
+}
+
+static void
+_vte_file_stream_boa_write (VteFileStream *stream, gsize offset, const char *data)
+{
+#ifndef VTESTREAM_MAIN
+        if (stream->write_behind != NULL) {
+                _vte_write_behind_write (stream->write_behind, offset, data);
+                return;
+        }
+#endif
+        _vte_boa_write (stream->boa, offset, data);
+}
+
+static gboolean
+_vte_file_stream_boa_read (VteFileStream *stream, gsize offset, char *data)
+{
+#ifndef VTESTREAM_MAIN
+        if (stream->write_behind != NULL) {
+                if (_vte_write_behind_read (stream->write_behind, offset, data))
+                        return TRUE;
+                /* Not pending, so it's on disk; drain so that the boa
+                 * can be used from this thread. */
+                _vte_write_behind_drain (stream->write_behind);
+        }
+#endif
+        return _vte_boa_read (stream->boa, offset, data);
+}
+
+static void
+_vte_file_stream_boa_advance_tail (VteFileStream *stream, gsize offset)
+{
+#ifndef VTESTREAM_MAIN
+        if (stream->write_behind != NULL) {
+                _vte_write_behind_advance_tail (stream->write_behind, offset);
+                return;
+        }
+#endif
+        _vte_boa_advance_tail (stream->boa, offset);
+}
+
 static void
 _vte_file_stream_finalize (GObject *object)
 {
         VteFileStream *stream = (VteFileStream *) object;
 
+#ifndef VTESTREAM_MAIN
+        if (stream->write_behind != NULL)
+                _vte_write_behind_free (stream->write_behind);
+#endif
         g_free(stream->rbuf);
         g_free(stream->wbuf);
         g_object_unref (stream->boa);
@@ -1095,6 +1825,7 @@ _vte_file_stream_reset (VteStream *astream, gsize offset)
          * to catch if this expectation is broken within a block. */
         g_assert_cmpuint (offset, >=, stream->head);
 
+        _vte_file_stream_drain (stream);
         _vte_boa_reset (stream->boa, offset_aligned);
         stream->tail = stream->head = offset;
 
@@ -1136,7 +1867,7 @@ _vte_file_stream_read (VteStream *astream, gsize offset, char *data, gsize len)
                 gsize l = MIN(VTE_BOA_BLOCKSIZE - MOD_BOA(offset), len);
                 gsize offset_aligned = ALIGN_BOA(offset);
                 if (offset_aligned != stream->rbuf_offset) {
-                        if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->rbuf)))
+                        if (G_UNLIKELY (!_vte_file_stream_boa_read (stream, offset_aligned, stream->rbuf)))
                                 return FALSE;
                         stream->rbuf_offset = offset_aligned;
                 }
@@ -1160,7 +1891,7 @@ _vte_file_stream_append (VteStream *astream, const char *data, gsize len)
                 memcpy(stream->wbuf + stream->wbuf_len, data, l);
                 stream->wbuf_len += l; data += l; len -= l;
                 if (stream->wbuf_len == VTE_BOA_BLOCKSIZE) {
-                        _vte_boa_write (stream->boa, ALIGN_BOA(stream->head), stream->wbuf);
+                        _vte_file_stream_boa_write (stream, ALIGN_BOA(stream->head), stream->wbuf);
                         stream->wbuf_len = 0;
                 }
                 stream->head += l;
@@ -1183,7 +1914,7 @@ _vte_file_stream_truncate (VteStream *astream, gsize offset)
                  * intact, that is, read back the new partial last block to
                  * the write cache. */
                 gsize offset_aligned = ALIGN_BOA(offset);
-                if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->wbuf))) {
+                if (G_UNLIKELY (!_vte_file_stream_boa_read (stream, offset_aligned, stream->wbuf))) {
                         /* what now? */
                         memset(stream->wbuf, 0, VTE_BOA_BLOCKSIZE);
                 }
@@ -1205,7 +1936,7 @@ _vte_file_stream_advance_tail (VteStream *astream, gsize offset)
         g_assert_cmpuint (offset, <=, stream->head);
 
         if (ALIGN_BOA(offset) > ALIGN_BOA(stream->tail))
-                _vte_boa_advance_tail (stream->boa, ALIGN_BOA(offset));
+                _vte_file_stream_boa_advance_tail (stream, ALIGN_BOA(offset));
 
         stream->tail = offset;
 }
@@ -1327,38 +2058,38 @@ test_fakes (void)
 
         /* Compress, but becomes bigger */
         strcpy(buf, "abcdef");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 6), ==, 7);
+        g_assert_cmpuint(_vte_boa_compress (boa, buf2, 100, buf, 6), ==, 7);
         g_assert(strncmp (buf2, "1abcdef", 7) == 0);
 
         /* Uncompress */
         strcpy(buf, "1abcdef");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 6);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, buf2, 100, buf, 7), ==, 6);
         g_assert(strncmp (buf2, "abcdef", 6) == 0);
 
         /* Compress, becomes smaller */
         strcpy(buf, "www");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 3), ==, 2);
+        g_assert_cmpuint(_vte_boa_compress (boa, buf2, 100, buf, 3), ==, 2);
         g_assert(strncmp (buf2, "3w", 2) == 0);
 
         /* Uncompress */
         strcpy(buf, "3w");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 2), ==, 3);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, buf2, 100, buf, 2), ==, 3);
         g_assert(strncmp (buf2, "www", 3) == 0);
 
         /* Compress, remains the same size */
         strcpy(buf, "zebraaa");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 7), ==, 7);
+        g_assert_cmpuint(_vte_boa_compress (boa, buf2, 100, buf, 7), ==, 7);
         g_assert(strncmp (buf2, "1zebr3a", 7) == 0);
 
         /* Uncompress */
         strcpy(buf, "1zebr3a");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 7);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, buf2, 100, buf, 7), ==, 7);
         g_assert(strncmp (buf2, "zebraaa", 7) == 0);
 
         /* Trying to uncompress the original does *not* give back the same contents.
          * This will be important below. */
         strcpy(buf, "zebraaa");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 0);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, buf2, 100, buf, 7), ==, 0);
 
         g_object_unref (boa);
 }
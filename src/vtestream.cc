@@ -21,6 +21,7 @@
 #include <config.h>
 
 #include "debug.h"
+#include "stats.hh"
 #include "vtestream.h"
 
 
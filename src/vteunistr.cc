@@ -61,19 +61,20 @@
  * Given a vteunistr and a gunichar, we have to walk over the entire
  * decomposition table to see if we have already registered (encoded) this
  * combination.  To make that operation fast, we use a reverse map, that is,
- * a GHashTable named unistr_comp.  The hash table maps a decomposition to its
- * encoded vteunistr value.  The value obviously fits in a pointer and does
- * not need memory allocation.  We also want to avoid allocating memory for
- * the key of the hash table entries, as we already have those decompositions
- * in the memory in the unistr_decomp array.  We cannot use direct pointers
- * though as when growing, the GArray may resize and move to a new memory
- * buffer, rendering all our pointers invalid.  For this reason, we keep the
- * index into the array as our hash table key.  When we want to perform a
- * lookup in the hash table, we insert the decomposition that we are searching
- * for as item zero in the unistr_decomp table, then lookup for an equal entry
- * of it in the hash table.  Finally, if the hash lookup fails, we add the new
- * decomposition to the lookup array and the hash table, and return the newly
- * encoded vteunistr value.
+ * an open-addressing hash table named unistr_comp.  It is a plain array of
+ * encoded vteunistr values (zero meaning an empty slot) probed linearly by
+ * the hash of the (prefix, suffix) pair; the keys need no storage of their
+ * own since every stored value can be turned back into its decomposition
+ * through the unistr_decomp array.  No memory is allocated per entry, a
+ * lookup touches a single cache line in the common case, and growing the
+ * table is a simple rehash of the values.
+ *
+ * Note that encoded vteunistr's are never garbage collected: they may be
+ * referenced not just from the cells of the Rings of every terminal in the
+ * process, but also from frozen rows that have been compressed into the
+ * scrollback streams, which cannot be swept without decoding all of the
+ * history.  The cap on the number of entries below keeps the worst case
+ * bounded.
  */
 
 #define VTE_UNISTR_START 0x80000000
@@ -83,28 +84,58 @@ static vteunistr unistr_next = VTE_UNISTR_START + 1;
 struct VteUnistrDecomp {
 	vteunistr prefix;
 	gunichar  suffix;
+	/* Cached properties of the whole sequence, filled in at intern
+	 * time; they make _vte_unistr_get_base() and _vte_unistr_strlen()
+	 * O(1) instead of a walk along the prefix chain. */
+	gunichar  base;
+	guint32   len;
 };
 
 GArray     *unistr_decomp;
-GHashTable *unistr_comp;
+
+static guint32 *unistr_comp;		/* open addressing; 0 denotes an empty slot */
+static guint    unistr_comp_mask;	/* the table's capacity (a power of two) minus one */
+static guint    unistr_comp_len;	/* number of used slots */
+
+#define UNISTR_COMP_INITIAL_CAPACITY 256
 
 #define DECOMP_FROM_INDEX(i)	g_array_index (unistr_decomp, struct VteUnistrDecomp, (i))
 #define DECOMP_FROM_UNISTR(s)	DECOMP_FROM_INDEX ((s) - VTE_UNISTR_START)
 
-static guint
-unistr_comp_hash (gconstpointer key)
+static inline guint
+unistr_comp_hash (vteunistr prefix, gunichar suffix)
 {
-	struct VteUnistrDecomp *decomp;
-	decomp = &DECOMP_FROM_INDEX (GPOINTER_TO_UINT (key));
-	return decomp->prefix ^ decomp->suffix;
+	/* Knuth's multiplicative hash to spread out the mostly-sequential
+	 * prefix values; the suffix perturbs the low bits used for probing. */
+	return prefix * 2654435761u ^ suffix;
 }
 
-static gboolean
-unistr_comp_equal (gconstpointer a, gconstpointer b)
+static void
+unistr_comp_insert (vteunistr s)
 {
-	return 0 == memcmp (&DECOMP_FROM_INDEX (GPOINTER_TO_UINT (a)),
-			    &DECOMP_FROM_INDEX (GPOINTER_TO_UINT (b)),
-			    sizeof (struct VteUnistrDecomp));
+	struct VteUnistrDecomp *decomp = &DECOMP_FROM_UNISTR (s);
+	guint i = unistr_comp_hash (decomp->prefix, decomp->suffix) & unistr_comp_mask;
+
+	while (unistr_comp[i] != 0)
+		i = (i + 1) & unistr_comp_mask;
+	unistr_comp[i] = s;
+	unistr_comp_len++;
+}
+
+static void
+unistr_comp_grow (void)
+{
+	guint i;
+
+	g_free (unistr_comp);
+	unistr_comp_mask = unistr_comp_mask * 2 + 1;
+	unistr_comp = g_new0 (guint32, unistr_comp_mask + 1);
+
+	/* Rehash all the values; their decompositions are in unistr_decomp
+	 * (whose first entry is unused). */
+	unistr_comp_len = 0;
+	for (i = 1; i < unistr_decomp->len; i++)
+		unistr_comp_insert (VTE_UNISTR_START + i);
 }
 
 vteunistr
@@ -113,16 +144,23 @@ _vte_unistr_append_unichar (vteunistr s, gunichar c)
 	struct VteUnistrDecomp decomp;
 	vteunistr ret = 0;
 
-	decomp.prefix = s;
-	decomp.suffix = c;
-
 	if (G_UNLIKELY (!unistr_decomp)) {
 		unistr_decomp = g_array_new (FALSE, TRUE, sizeof (struct VteUnistrDecomp));
 		g_array_set_size (unistr_decomp, 1);
-		unistr_comp = g_hash_table_new (unistr_comp_hash, unistr_comp_equal);
+		unistr_comp = g_new0 (guint32, UNISTR_COMP_INITIAL_CAPACITY);
+		unistr_comp_mask = UNISTR_COMP_INITIAL_CAPACITY - 1;
 	} else {
-		DECOMP_FROM_INDEX (0) = decomp;
-		ret = GPOINTER_TO_UINT (g_hash_table_lookup (unistr_comp, GUINT_TO_POINTER (0)));
+		guint i = unistr_comp_hash (s, c) & unistr_comp_mask;
+		vteunistr v;
+
+		while ((v = unistr_comp[i]) != 0) {
+			struct VteUnistrDecomp *d = &DECOMP_FROM_UNISTR (v);
+			if (d->prefix == s && d->suffix == c) {
+				ret = v;
+				break;
+			}
+			i = (i + 1) & unistr_comp_mask;
+		}
 	}
 
 	if (G_UNLIKELY (!ret)) {
@@ -130,11 +168,17 @@ _vte_unistr_append_unichar (vteunistr s, gunichar c)
 		if (G_UNLIKELY (_vte_unistr_strlen (s) > 10 || unistr_next - VTE_UNISTR_START > 100000))
 			return s;
 
+		/* Keep the load factor below 3/4. */
+		if (G_UNLIKELY ((unistr_comp_len + 1) * 4 > (unistr_comp_mask + 1) * 3))
+			unistr_comp_grow ();
+
 		ret = unistr_next++;
+		decomp.prefix = s;
+		decomp.suffix = c;
+		decomp.base = _vte_unistr_get_base (s);
+		decomp.len = _vte_unistr_strlen (s) + 1;
 		g_array_append_val (unistr_decomp, decomp);
-		g_hash_table_insert (unistr_comp,
-				     GUINT_TO_POINTER (ret - VTE_UNISTR_START),
-				     GUINT_TO_POINTER (ret));
+		unistr_comp_insert (ret);
 	}
 
 	return ret;
@@ -157,8 +201,8 @@ gunichar
 _vte_unistr_get_base (vteunistr s)
 {
 	g_return_val_if_fail (s < unistr_next, s);
-	while (G_UNLIKELY (s >= VTE_UNISTR_START))
-		s = DECOMP_FROM_UNISTR (s).prefix;
+	if (G_UNLIKELY (s >= VTE_UNISTR_START))
+		return DECOMP_FROM_UNISTR (s).base;
 	return (gunichar) s;
 }
 
@@ -211,11 +255,8 @@ _vte_unistr_append_to_string (vteunistr s, GString *gs)
 int
 _vte_unistr_strlen (vteunistr s)
 {
-	int len = 1;
-	g_return_val_if_fail (s < unistr_next, len);
-	while (G_UNLIKELY (s >= VTE_UNISTR_START)) {
-		s = DECOMP_FROM_UNISTR (s).prefix;
-		len++;
-	}
-	return len;
+	g_return_val_if_fail (s < unistr_next, 1);
+	if (G_UNLIKELY (s >= VTE_UNISTR_START))
+		return DECOMP_FROM_UNISTR (s).len;
+	return 1;
 }
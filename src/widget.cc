@@ -187,6 +187,8 @@ Widget::im_set_cursor_location(cairo_rectangle_int_t const* rect) noexcept
 void
 Widget::map() noexcept
 {
+        m_terminal->widget_map();
+
         if (m_event_window)
                 gdk_window_show_unraised(m_event_window);
 }
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# Copyright © 2019 the VTE contributors
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+'''
+Generates widthtable.hh, a two-level lookup table classifying each
+codepoint's character width for _vte_unichar_width() in vte.cc.
+
+The classification mirrors the combination of g_unichar_iszerowidth(),
+g_unichar_iswide() and g_unichar_iswide_cjk() that used to be called per
+character, in the same order of precedence:
+
+  - zero width: Mn, Me and Cf characters (except U+00AD SOFT HYPHEN),
+    the Hangul jamo medial vowels and final consonants, and
+    U+200B ZERO WIDTH SPACE;
+  - wide: East Asian Width W and F;
+  - ambiguous: East Asian Width A, wide only in CJK legacy context;
+  - everything else is narrow.
+
+Codepoints are split into pages of 256; identical pages are shared.
+Each page packs the 2-bit classes of its codepoints four to a byte.
+
+Usage: widthtable-generate.py > widthtable.hh
+'''
+
+import sys
+import unicodedata
+
+NARROW, ZEROWIDTH, WIDE, AMBIGUOUS = range(4)
+
+PAGE_SIZE = 256
+N_CODEPOINTS = 0x110000
+
+
+def classify(c):
+    category = unicodedata.category(chr(c))
+    if ((category in ('Mn', 'Me', 'Cf') and c != 0x00AD) or
+            (0x1160 <= c < 0x1200) or c == 0x200B):
+        return ZEROWIDTH
+    eaw = unicodedata.east_asian_width(chr(c))
+    if eaw in ('W', 'F'):
+        return WIDE
+    if eaw == 'A':
+        return AMBIGUOUS
+    return NARROW
+
+
+def make_page(start):
+    page = bytearray(PAGE_SIZE // 4)
+    for i in range(PAGE_SIZE):
+        page[i // 4] |= classify(start + i) << (2 * (i % 4))
+    return bytes(page)
+
+
+def main():
+    pages = []        # unique pages, in order of first appearance
+    page_index = {}   # page data -> index into pages
+    index = []        # page number -> index into pages
+
+    for start in range(0, N_CODEPOINTS, PAGE_SIZE):
+        page = make_page(start)
+        if page not in page_index:
+            page_index[page] = len(pages)
+            pages.append(page)
+        index.append(page_index[page])
+
+    if len(pages) > 256:
+        sys.exit('Too many unique pages for a uint8_t index')
+
+    out = sys.stdout
+    out.write('/* Generated by widthtable-generate.py from Unicode %s data;\n'
+              ' * do not edit. */\n\n' % unicodedata.unidata_version)
+    out.write('/* Each codepoint has one of these 2-bit width classes. */\n')
+    out.write('#define VTE_WIDTH_NARROW    0\n')
+    out.write('#define VTE_WIDTH_ZEROWIDTH 1\n')
+    out.write('#define VTE_WIDTH_WIDE      2\n')
+    out.write('#define VTE_WIDTH_AMBIGUOUS 3\n\n')
+
+    out.write('static uint8_t const width_table_index[%d] = {' % len(index))
+    for i, page in enumerate(index):
+        out.write('%s%d,' % ('\n        ' if i % 16 == 0 else ' ', page))
+    out.write('\n};\n\n')
+
+    out.write('static uint8_t const width_table_pages[%d][%d] = {\n'
+              % (len(pages), PAGE_SIZE // 4))
+    for page in pages:
+        out.write('        {')
+        for i, byte in enumerate(page):
+            out.write('%s0x%02x,' % ('\n         ' if i and i % 12 == 0 else ' ', byte))
+        out.write('\n        },\n')
+    out.write('};\n')
+
+
+if __name__ == '__main__':
+    main()